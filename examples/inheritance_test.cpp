@@ -127,7 +127,7 @@ public:
 };
 
 // =============================================================================
-// Test 4: Virtual-like Behavior (Without Virtual Keywords)
+// Test 4: Virtual Functions
 // =============================================================================
 
 // Base class for processors with different processing methods
@@ -138,8 +138,9 @@ protected:
 public:
     DataProcessor(uint8_t type) : processorType(type) {}
     
-    // Non-virtual method that derived classes will "override"
-    float process(float input) {
+    // Virtual method that derived classes override (a vtable slot, or a
+    // direct call when the transpiler can tell the implementation)
+    virtual float process(float input) {
         return input; // Default: pass-through
     }
     
@@ -157,8 +158,8 @@ private:
 public:
     FilterProcessor(float coeff) : DataProcessor(1), filterCoeff(coeff), lastOutput(0.0f) {}
     
-    // "Override" the process method (static dispatch)
-    float process(float input) {
+    // Override the process method (dynamic dispatch)
+    float process(float input) override {
         lastOutput = (filterCoeff * input) + ((1.0f - filterCoeff) * lastOutput);
         return lastOutput;
     }
@@ -9,8 +9,18 @@ __version__ = "0.1.0"
 __author__ = "Sébastien Celles"
 __email__ = "s.celles@gmail.com"
 
-# Import from the new transpilers module structure
-from .transpilers.unified_transpiler import XC8Transpiler
-from .transpilers.python_backend import TranspilerResult
-
 __all__ = ["XC8Transpiler", "TranspilerResult"]
+
+
+def __getattr__(name):
+    # Transpiler classes are imported on first access so that light commands
+    # (e.g. `xc8plusplus version`) do not pay for loading the backends.
+    if name == "XC8Transpiler":
+        from .transpilers.unified_transpiler import XC8Transpiler
+
+        return XC8Transpiler
+    if name == "TranspilerResult":
+        from .transpilers.python_backend import TranspilerResult
+
+        return TranspilerResult
+    raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
@@ -1,8 +1,26 @@
 """
 Entry point for running xc8plusplus as a module.
+
+``xc8plusplus version`` is answered here without importing the Typer CLI so
+that build scripts querying the tool version do not pay its startup cost.
 """
 
-from .cli import main
+import sys
+
+
+def main() -> None:
+    """Console script entry point with a fast path for version queries."""
+    if sys.argv[1:] in (["version"], ["--version"]):
+        from . import __author__, __version__
+
+        print(f"xc8plusplus version {__version__}")
+        print(f"Author: {__author__}")
+        return
+
+    from .cli import main as cli_main
+
+    cli_main()
+
 
 if __name__ == "__main__":
     main()
@@ -2,36 +2,51 @@
 CLI interface for xc8plusplus transpiler using Typer.
 """
 
+import functools
 from pathlib import Path
 from typing import Optional, List
 
 import typer
-from rich.console import Console
-from rich.progress import Progress, SpinnerColumn, TextColumn
-from rich.table import Table
-from rich.panel import Panel
-
-# Import from the new transpilers module structure
-from .transpilers.unified_transpiler import (
-    XC8Transpiler,
-    get_native_version,
-    check_llvm,
-)
 
-# Check for native transpiler availability
-try:
-    from .transpilers.native_backend import is_available as native_available
+from .transpilers.passes import PassManager
+
+# Rich rendering, the transpiler backends and native library probing are
+# imported inside the commands that need them: the CLI is typically invoked
+# once per module by build systems, so startup cost matters.
+
+
+@functools.lru_cache(maxsize=None)
+def _native_available() -> bool:
+    """Check for native transpiler availability (probes the shared library)"""
+    try:
+        from .transpilers.native_backend import is_available as native_available
+
+        return native_available()
+    except ImportError:
+        return False
+
+
+@functools.lru_cache(maxsize=None)
+def _get_console():
+    """Create the rich Console on first use"""
+    from rich.console import Console
+
+    return Console()
+
+
+class _LazyConsole:
+    """Proxy forwarding attribute access to the lazily created Console"""
+
+    def __getattr__(self, name):
+        return getattr(_get_console(), name)
 
-    NATIVE_AVAILABLE = native_available()
-except ImportError:
-    NATIVE_AVAILABLE = False
 
 app = typer.Typer(
     name="xc8plusplus",
     help="C++ to C transpiler for Microchip XC8 compiler",
     add_completion=False,
 )
-console = Console()
+console = _LazyConsole()
 
 # Create a subcommand group for transpile operations
 transpile_app = typer.Typer(
@@ -79,19 +94,71 @@ def transpile_file(
     no_optimization: bool = typer.Option(
         False,
         "--no-optimization",
-        help="Disable optimizations",
+        help="Disable optimizations (same as -O0)",
+    ),
+    opt_level: Optional[str] = typer.Option(
+        None,
+        "--opt-level",
+        "-O",
+        help="Optimization level: '0' (none), 's' (size, default) or '2' (speed)",
+    ),
+    passes: List[str] = typer.Option(
+        [],
+        "--pass",
+        "-f",
+        help="Enable (-fNAME) or disable (-fno-NAME) an optimization pass (can be used multiple times)",
+    ),
+    opt_bisect_limit: Optional[int] = typer.Option(
+        None,
+        "--opt-bisect-limit",
+        help="Run only the first N optimization passes, to find one that miscompiles (python backend)",
     ),
     no_pragmas: bool = typer.Option(
         False,
         "--no-pragmas",
         help="Disable XC8 pragma generation",
     ),
+    inline_goal: Optional[str] = typer.Option(
+        None,
+        "--inline-goal",
+        help="Inline small methods only when the program does not grow ('size') or always ('speed'); default: the goal of the optimization level",
+    ),
+    stack_check: str = typer.Option(
+        "warn",
+        "--stack-check",
+        help="On hardware stack overflow or recursion: 'warn', 'error' (fail) or 'off'",
+    ),
+    pack_structs: bool = typer.Option(
+        False,
+        "--pack-structs",
+        help="Pack bool and small enum fields into bit-fields and report struct sizes",
+    ),
+    bit_types: bool = typer.Option(
+        False,
+        "--bit-types",
+        help="Lower bool globals, static locals and predicate return values to XC8 __bit where safe",
+    ),
+    bank_placement: bool = typer.Option(
+        False,
+        "--bank-placement",
+        help="Place hot globals in common RAM (__near) and the others in banks (__bank(n))",
+    ),
     backend: str = typer.Option(
         "native",
         "--backend",
         "-b",
         help="Transpiler backend to use: 'native' (LLVM LibTooling) or 'python' (Clang AST)",
     ),
+    depfile: Optional[Path] = typer.Option(
+        None,
+        "--depfile",
+        help="Write a Makefile-format dependency file (.d) listing the C++ sources and headers of the outputs",
+    ),
+    cache_dir: Optional[Path] = typer.Option(
+        None,
+        "--cache-dir",
+        help="Directory for the function lowering memo reused across runs (python backend)",
+    ),
     verbose: bool = typer.Option(
         False,
         "--verbose",
@@ -111,6 +178,22 @@ def transpile_file(
         console.print(f"[bold red]❌ Error:[/bold red] Invalid backend '{backend}'. Must be 'native' or 'python'.")
         raise typer.Exit(1)
 
+    if inline_goal is not None and inline_goal not in ["size", "speed"]:
+        console.print(f"[bold red]❌ Error:[/bold red] Invalid inlining goal '{inline_goal}'. Must be 'size' or 'speed'.")
+        raise typer.Exit(1)
+
+    if no_optimization:
+        opt_level = "0"
+    try:
+        PassManager(opt_level or "s", passes)
+    except ValueError as e:
+        console.print(f"[bold red]❌ Error:[/bold red] {e}.")
+        raise typer.Exit(1)
+
+    if stack_check not in ["warn", "error", "off"]:
+        console.print(f"[bold red]❌ Error:[/bold red] Invalid stack check '{stack_check}'. Must be 'warn', 'error' or 'off'.")
+        raise typer.Exit(1)
+
     # Set default output file if not provided
     if output_file is None:
         output_file = input_file.with_suffix(".c")
@@ -120,14 +203,18 @@ def transpile_file(
         console.print(f"[bold blue]Output:[/bold blue] {output_file}")
         console.print(f"[bold blue]Target Device:[/bold blue] {target_device}")
         console.print(
-            f"[bold blue]Native Backend Available:[/bold blue] {'Yes' if NATIVE_AVAILABLE else 'No'}"
+            f"[bold blue]Native Backend Available:[/bold blue] {'Yes' if _native_available() else 'No'}"
         )
 
+    from rich.progress import Progress, SpinnerColumn, TextColumn
+
+    from .transpilers.unified_transpiler import XC8Transpiler
+
     try:
         with Progress(
             SpinnerColumn(),
             TextColumn("[progress.description]{task.description}"),
-            console=console,
+            console=_get_console(),
             transient=True,
         ) as progress:
             task = progress.add_task("Transpiling C++ to C...", total=None)
@@ -140,6 +227,15 @@ def transpile_file(
                 target_device=target_device,
                 include_paths=include_dirs,
                 defines=defines,
+                cache_dir=str(cache_dir) if cache_dir else None,
+                inline_goal=inline_goal,
+                opt_level=opt_level,
+                passes=passes,
+                opt_bisect_limit=opt_bisect_limit,
+                stack_check=stack_check,
+                pack_structs=pack_structs,
+                bit_types=bit_types,
+                bank_placement=bank_placement,
             )
 
             # Show backend info
@@ -152,6 +248,12 @@ def transpile_file(
             # Perform transpilation
             result = transpiler.transpile_file(str(input_file), str(output_file))
 
+            if result.success and depfile:
+                outputs = [output_file, output_file.with_suffix(".h")]
+                transpiler.write_depfile(
+                    depfile, [path for path in outputs if path.exists()], [input_file]
+                )
+
             progress.remove_task(task)
 
         if result.success:
@@ -235,19 +337,86 @@ def transpile_batch(
     no_optimization: bool = typer.Option(
         False,
         "--no-optimization",
-        help="Disable optimizations",
+        help="Disable optimizations (same as -O0)",
+    ),
+    opt_level: Optional[str] = typer.Option(
+        None,
+        "--opt-level",
+        "-O",
+        help="Optimization level: '0' (none), 's' (size, default) or '2' (speed)",
+    ),
+    passes: List[str] = typer.Option(
+        [],
+        "--pass",
+        "-f",
+        help="Enable (-fNAME) or disable (-fno-NAME) an optimization pass (can be used multiple times)",
+    ),
+    opt_bisect_limit: Optional[int] = typer.Option(
+        None,
+        "--opt-bisect-limit",
+        help="Run only the first N optimization passes, to find one that miscompiles (python backend)",
     ),
     no_pragmas: bool = typer.Option(
         False,
         "--no-pragmas",
         help="Disable XC8 pragma generation",
     ),
+    inline_goal: Optional[str] = typer.Option(
+        None,
+        "--inline-goal",
+        help="Inline small methods only when the program does not grow ('size') or always ('speed'); default: the goal of the optimization level",
+    ),
+    stack_check: str = typer.Option(
+        "warn",
+        "--stack-check",
+        help="On hardware stack overflow or recursion: 'warn', 'error' (fail) or 'off'",
+    ),
+    pack_structs: bool = typer.Option(
+        False,
+        "--pack-structs",
+        help="Pack bool and small enum fields into bit-fields and report struct sizes",
+    ),
+    bit_types: bool = typer.Option(
+        False,
+        "--bit-types",
+        help="Lower bool globals, static locals and predicate return values to XC8 __bit where safe",
+    ),
+    bank_placement: bool = typer.Option(
+        False,
+        "--bank-placement",
+        help="Place hot globals in common RAM (__near) and the others in banks (__bank(n))",
+    ),
+    amalgamate: bool = typer.Option(
+        False,
+        "--amalgamate",
+        help="Emit one self-contained firmware.c, everything static but main and the ISRs (python backend)",
+    ),
     backend: str = typer.Option(
         "native",
         "--backend",
         "-b",
         help="Transpiler backend to use: 'native' (LLVM LibTooling) or 'python' (Clang AST)",
     ),
+    build_system: Optional[str] = typer.Option(
+        None,
+        "--build-system",
+        help="Also write a build file compiling the outputs with XC8: 'make' (Makefile) or 'ninja' (build.ninja)",
+    ),
+    build_cc: str = typer.Option(
+        "xc8-cc",
+        "--cc",
+        help="Compiler command used by the generated build file",
+    ),
+    depfile: Optional[Path] = typer.Option(
+        None,
+        "--depfile",
+        help="Write a Makefile-format dependency file (.d) listing the C++ sources and headers of the outputs",
+    ),
+    cache_dir: Optional[Path] = typer.Option(
+        None,
+        "--cache-dir",
+        help="Directory for the function lowering memo reused across runs (python backend)",
+    ),
     verbose: bool = typer.Option(
         False,
         "--verbose",
@@ -268,6 +437,30 @@ def transpile_batch(
         console.print(f"[bold red]❌ Error:[/bold red] Invalid backend '{backend}'. Must be 'native' or 'python'.")
         raise typer.Exit(1)
 
+    if amalgamate and backend != "python":
+        console.print("[bold red]❌ Error:[/bold red] --amalgamate requires the python backend.")
+        raise typer.Exit(1)
+
+    if inline_goal is not None and inline_goal not in ["size", "speed"]:
+        console.print(f"[bold red]❌ Error:[/bold red] Invalid inlining goal '{inline_goal}'. Must be 'size' or 'speed'.")
+        raise typer.Exit(1)
+
+    if no_optimization:
+        opt_level = "0"
+    try:
+        PassManager(opt_level or "s", passes)
+    except ValueError as e:
+        console.print(f"[bold red]❌ Error:[/bold red] {e}.")
+        raise typer.Exit(1)
+
+    if stack_check not in ["warn", "error", "off"]:
+        console.print(f"[bold red]❌ Error:[/bold red] Invalid stack check '{stack_check}'. Must be 'warn', 'error' or 'off'.")
+        raise typer.Exit(1)
+
+    if build_system is not None and build_system not in ["make", "ninja"]:
+        console.print(f"[bold red]❌ Error:[/bold red] Invalid build system '{build_system}'. Must be 'make' or 'ninja'.")
+        raise typer.Exit(1)
+
     # Set default output directory if not provided
     if output_dir is None:
         output_dir = source_dir / "generated_c"
@@ -278,11 +471,11 @@ def transpile_batch(
         console.print(f"[bold blue]Base Name:[/bold blue] {base_name}")
         console.print(f"[bold blue]Target Device:[/bold blue] {target_device}")
         console.print(
-            f"[bold blue]Native Backend Available:[/bold blue] {'Yes' if NATIVE_AVAILABLE else 'No'}"
+            f"[bold blue]Native Backend Available:[/bold blue] {'Yes' if _native_available() else 'No'}"
         )
 
     # Find C++ files
-    cpp_files = list(source_dir.glob("*.cpp")) + list(source_dir.glob("*.hpp"))
+    cpp_files = sorted(source_dir.glob("*.cpp")) + sorted(source_dir.glob("*.hpp"))
 
     if not cpp_files:
         console.print(
@@ -294,11 +487,16 @@ def transpile_batch(
     for cpp_file in cpp_files:
         console.print(f"  • {cpp_file.name}")
 
+    from rich.progress import Progress, SpinnerColumn, TextColumn
+
+    from .transpilers.python_backend import AMALGAMATED_FILENAME
+    from .transpilers.unified_transpiler import XC8Transpiler
+
     try:
         with Progress(
             SpinnerColumn(),
             TextColumn("[progress.description]{task.description}"),
-            console=console,
+            console=_get_console(),
             transient=True,
         ) as progress:
             task = progress.add_task("Analyzing and transpiling files...", total=None)
@@ -314,6 +512,16 @@ def transpile_batch(
                 target_device=target_device,
                 include_paths=include_dirs,
                 defines=defines,
+                cache_dir=str(cache_dir) if cache_dir else None,
+                inline_goal=inline_goal,
+                opt_level=opt_level,
+                passes=passes,
+                opt_bisect_limit=opt_bisect_limit,
+                stack_check=stack_check,
+                pack_structs=pack_structs,
+                bit_types=bit_types,
+                bank_placement=bank_placement,
+                amalgamate=amalgamate,
             )
 
             # Show backend info
@@ -338,7 +546,42 @@ def transpile_batch(
             progress.remove_task(task)
 
         # Copy supporting C and H files that are not generated
-        _copy_supporting_files(source_dir, output_dir, cpp_files)
+        supporting_files = _copy_supporting_files(source_dir, output_dir, cpp_files)
+        # The C files generated from the C++ sources
+        if amalgamate:
+            generated_c = {AMALGAMATED_FILENAME}
+        else:
+            generated_c = {f"{cpp_file.stem}.c" for cpp_file in cpp_files}
+
+        if all_success and depfile:
+            if amalgamate:
+                outputs = [Path(output_dir) / AMALGAMATED_FILENAME]
+            else:
+                outputs = [Path(output_dir) / "shared_definitions.h"]
+                for stem in sorted({cpp_file.stem for cpp_file in cpp_files}):
+                    for suffix in (".c", ".h"):
+                        output = Path(output_dir) / f"{stem}{suffix}"
+                        if output.exists():
+                            outputs.append(output)
+            outputs.extend(Path(output_dir) / file.name for file in supporting_files)
+            transpiler.write_depfile(depfile, outputs, cpp_files, supporting_files)
+
+        if all_success and build_system:
+            from .transpilers.buildgraph import write_build_file
+
+            c_files = sorted(
+                generated_c
+                | {file.name for file in supporting_files if file.suffix == ".c"}
+            )
+            build_file = write_build_file(
+                build_system,
+                output_dir,
+                [name for name in c_files if (Path(output_dir) / name).exists()],
+                target_device,
+                base_name,
+                build_cc,
+            )
+            console.print(f"[bold]Build file:[/bold] {build_file}")
 
         if all_success:
             console.print(
@@ -360,7 +603,8 @@ def transpile_batch(
                 console.print(f"\n[bold]Generated Files:[/bold]")
                 for cpp_file, result in results:
                     status = "✅" if result.success else "❌"
-                    console.print(f"  {status} {cpp_file.name} → {cpp_file.stem}.c")
+                    c_file = AMALGAMATED_FILENAME if amalgamate else f"{cpp_file.stem}.c"
+                    console.print(f"  {status} {cpp_file.name} → {c_file}")
         else:
             console.print("[bold red]❌ Error:[/bold red] Some transpilations failed")
             for cpp_file, result in results:
@@ -413,6 +657,8 @@ def info() -> None:
     console.print("[bold blue]🔧 XC8++ Transpiler Information[/bold blue]")
     console.print()
 
+    from rich.table import Table
+
     # Show backend availability
     table = Table(title="Available Backends")
     table.add_column("Backend", style="cyan")
@@ -421,7 +667,7 @@ def info() -> None:
     table.add_column("Features", style="yellow")
 
     # Native C++ backend
-    if NATIVE_AVAILABLE:
+    if _native_available():
         try:
             from .transpilers.native_backend import get_version, check_llvm
 
@@ -458,7 +704,7 @@ def info() -> None:
     console.print("  [cyan]xc8plusplus --backend python transpile input.cpp[/cyan]")
     console.print()
 
-    if NATIVE_AVAILABLE:
+    if _native_available():
         try:
             from .transpilers.native_backend import check_llvm
 
@@ -487,6 +733,8 @@ def check() -> None:
     console.print("[bold blue]🔍 XC8++ System Check[/bold blue]")
     console.print()
 
+    from .transpilers.unified_transpiler import XC8Transpiler
+
     # Check Python backend
     console.print("[bold]Python Backend:[/bold]")
     try:
@@ -499,7 +747,7 @@ def check() -> None:
 
     # Check native backend
     console.print("[bold]Native C++ Backend:[/bold]")
-    if NATIVE_AVAILABLE:
+    if _native_available():
         try:
             from .transpilers.native_backend import check_llvm, get_version
 
@@ -538,7 +786,7 @@ def check() -> None:
     console.print()
 
     # Overall status
-    if NATIVE_AVAILABLE:
+    if _native_available():
         console.print(
             "[bold green]🎉 System Status: Ready for professional transpilation![/bold green]"
         )
@@ -549,16 +797,19 @@ def check() -> None:
         console.print("[italic]   Build native backend for full functionality[/italic]")
 
 
-def _copy_supporting_files(source_dir: Path, output_dir: Path, cpp_files: List[Path]) -> None:
-    """Copy supporting C and H files that are not generated from C++ transpilation."""
-    import shutil
+def _copy_supporting_files(source_dir: Path, output_dir: Path, cpp_files: List[Path]) -> List[Path]:
+    """
+    Copy supporting C and H files that are not generated from C++ transpilation.
+    Returns the list of supporting source files.
+    """
+    from .transpilers.output import copy_if_changed
     
     # Get list of base names that will be generated from C++ files
     generated_names = {cpp_file.stem for cpp_file in cpp_files}
     
     # Find all C and H files in source directory
-    c_files = list(source_dir.glob("*.c"))
-    h_files = list(source_dir.glob("*.h"))
+    c_files = sorted(source_dir.glob("*.c"))
+    h_files = sorted(source_dir.glob("*.h"))
     
     supporting_files = []
     
@@ -576,8 +827,12 @@ def _copy_supporting_files(source_dir: Path, output_dir: Path, cpp_files: List[P
         console.print(f"\n[bold]Copying {len(supporting_files)} supporting files:[/bold]")
         for file in supporting_files:
             dest_file = output_dir / file.name
-            shutil.copy2(file, dest_file)
-            console.print(f"  • {file.name}")
+            if copy_if_changed(file, dest_file):
+                console.print(f"  • {file.name}")
+            else:
+                console.print(f"  • {file.name} (unchanged)")
+
+    return supporting_files
 
 
 def main() -> None:
@@ -7,27 +7,37 @@ for use with the Microchip XC8 compiler.
 Available transpilers:
 - Native transpiler: LLVM LibTooling-based transpiler (C++)
 - Python transpiler: Fallback transpiler using Clang AST dumps
+
+Backends are imported lazily on first attribute access.
 """
 
-from .unified_transpiler import XC8Transpiler
-from .python_backend import PythonTranspiler, TranspilerResult
-
-try:
-    from .native_backend import (
-        NativeTranspiler,
-        TranspilerConfig,
-        get_version,
-        check_llvm,
-    )
-
-    __all__ = [
-        "XC8Transpiler",
-        "TranspilerResult",
-        "NativeTranspiler",
-        "TranspilerConfig",
-        "PythonTranspiler",
-        "get_version",
-        "check_llvm",
-    ]
-except ImportError:
-    __all__ = ["XC8Transpiler", "TranspilerResult", "PythonTranspiler"]
+__all__ = [
+    "XC8Transpiler",
+    "TranspilerResult",
+    "NativeTranspiler",
+    "TranspilerConfig",
+    "PythonTranspiler",
+    "get_version",
+    "check_llvm",
+]
+
+_EXPORTS = {
+    "XC8Transpiler": "unified_transpiler",
+    "TranspilerResult": "python_backend",
+    "PythonTranspiler": "python_backend",
+    "NativeTranspiler": "native_backend",
+    "TranspilerConfig": "native_backend",
+    "get_version": "native_backend",
+    "check_llvm": "native_backend",
+}
+
+
+def __getattr__(name):
+    module_name = _EXPORTS.get(name)
+    if module_name is None:
+        raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
+
+    from importlib import import_module
+
+    module = import_module(f".{module_name}", __name__)
+    return getattr(module, name)
@@ -0,0 +1,187 @@
+"""
+XC8 __bit lowering for boolean objects and return values
+
+XC8 can keep a flag in a single bit of RAM (`__bit`), test it with one
+BTFSS/BTFSC instruction and return it from a function in the carry flag.
+A `__bit` is not a drop-in `bool` though: its address cannot be taken, and
+storing an integer wider than a bit keeps only its least significant bit,
+where a bool would become 1 for any non-zero value. An object or function is
+therefore only lowered to `__bit` when its address never escapes and every
+value stored to it or returned from it is already 0 or 1 (a comparison, a
+logical operation, a literal or another boolean); everything else stays bool.
+"""
+
+import re
+from typing import Iterable, Set, Tuple
+
+from .callgraph import strip_comments_and_literals
+
+_BOOLEAN_LITERALS = {"true", "false", "0", "1"}
+
+# A single operand: a (member) name, optionally called, after _flatten
+_OPERAND = re.compile(r"[A-Za-z_]\w*(?:\s*(?:\.|->)\s*[A-Za-z_]\w*)*\s*(?:\(\s*\))?")
+
+_COMPARISON = re.compile(r"==|!=|<=|>=|(?<![<\-])<(?![<=])|(?<![>\-])>(?![>=])")
+
+# Stores that keep a 0/1 value 0/1 when the stored value is boolean
+_BOOLEAN_STORES = ("=", "&=", "|=", "^=")
+
+
+def _flatten(expr: str) -> str:
+    """Blank out the contents of parentheses and brackets, keeping them"""
+    result = []
+    depth = 0
+    for char in expr:
+        if char in ")]":
+            depth -= 1
+        result.append(" " if depth > 0 else char)
+        if char in "([":
+            depth += 1
+    return "".join(result)
+
+
+def _strip_parentheses(expr: str) -> str:
+    """Remove parentheses enclosing a whole expression"""
+    expr = expr.strip()
+    while expr.startswith("(") and expr.endswith(")"):
+        flat = _flatten(expr)
+        if flat.find(")") != len(expr) - 1:
+            break
+        expr = expr[1:-1].strip()
+    return expr
+
+
+def _split_top_level(expr: str, flat: str, pattern: str):
+    """Split an expression at top-level matches of pattern"""
+    parts = []
+    start = 0
+    for match in re.finditer(pattern, flat):
+        parts.append(expr[start:match.start()])
+        start = match.end()
+    parts.append(expr[start:])
+    return parts
+
+
+def _split_conditional(expr: str, flat: str):
+    """(condition, then, else) of a top-level ?: expression, or None"""
+    question = flat.find("?")
+    if question < 0:
+        return None
+    nested = 0
+    for index in range(question + 1, len(flat)):
+        if flat[index] == "?":
+            nested += 1
+        elif flat[index] == ":":
+            if nested == 0:
+                return expr[:question], expr[question + 1:index], expr[index + 1:]
+            nested -= 1
+    return None
+
+
+def is_boolean_expression(expr: str, boolean_names: Iterable[str] = ()) -> bool:
+    """
+    Check whether a C expression always evaluates to 0 or 1.
+
+    Args:
+        expr: C expression
+        boolean_names: Variables, fields and functions known to hold or
+            return a boolean
+
+    Returns:
+        True for comparisons, logical operations, boolean literals and
+        boolean names; False when unsure
+    """
+    boolean_names = set(boolean_names)
+    expr = _strip_parentheses(expr)
+    if not expr:
+        return False
+    flat = _flatten(expr)
+
+    conditional = _split_conditional(expr, flat)
+    if conditional:
+        return all(is_boolean_expression(part, boolean_names) for part in conditional[1:])
+
+    if "||" in flat or "&&" in flat:
+        return True
+
+    # Bitwise operators bind looser than comparisons: a == b | c is an int
+    parts = _split_top_level(expr, flat, r"(?<![|&])[|&^](?![|&=])")
+    if len(parts) > 1:
+        return all(is_boolean_expression(part, boolean_names) for part in parts)
+
+    if _COMPARISON.search(flat):
+        return True
+
+    if flat.startswith("!"):
+        negated = flat.lstrip("! ")
+        return bool(_OPERAND.fullmatch(negated) or re.fullmatch(r"\(\s*\)", negated))
+
+    if expr in _BOOLEAN_LITERALS:
+        return True
+
+    # A boolean variable, field (self->ready) or call (Led_isOn(self))
+    if _OPERAND.fullmatch(flat):
+        return re.findall(r"[A-Za-z_]\w*", flat)[-1] in boolean_names
+    return False
+
+
+def address_taken(code: str, name: str) -> bool:
+    """Check whether code takes the address of name (&name, &obj.name)"""
+    code = strip_comments_and_literals(code)
+    return re.search(
+        rf"(?<![&\w)\]])&\s*\(?\s*(?:\w+\s*(?:\.|->)\s*)*{re.escape(name)}\b", code
+    ) is not None
+
+
+def stores_are_boolean(code: str, name: str, boolean_names: Iterable[str] = ()) -> bool:
+    """
+    Check that every store to name in code keeps it 0 or 1, and that its
+    address is not taken.
+    """
+    code = strip_comments_and_literals(code)
+    if address_taken(code, name):
+        return False
+    if re.search(rf"(\+\+|--)\s*{re.escape(name)}\b|\b{re.escape(name)}\s*(\+\+|--)", code):
+        return False
+
+    store = re.compile(
+        rf"(?<![\w.>]){re.escape(name)}\s*(=(?!=)|[-+*/%&|^]=|<<=|>>=)\s*([^;]*);"
+    )
+    for match in store.finditer(code):
+        operator, value = match.group(1), match.group(2)
+        if operator not in _BOOLEAN_STORES or not is_boolean_expression(value, boolean_names):
+            return False
+    return True
+
+
+def returns_are_boolean(code: str, boolean_names: Iterable[str] = ()) -> bool:
+    """Check that every value code returns is 0 or 1 (and that it returns one)"""
+    values = re.findall(r"\breturn\b([^;]*);", strip_comments_and_literals(code))
+    return bool(values) and all(
+        is_boolean_expression(value, boolean_names) for value in values
+    )
+
+
+def lower_static_bits(code: str, boolean_names: Iterable[str] = ()) -> Tuple[str, Set[str]]:
+    """
+    Lower eligible `static bool` locals of a function body to `static __bit`.
+
+    Returns:
+        The lowered body and the names of the locals lowered
+    """
+    boolean_names = set(boolean_names)
+    declaration = re.compile(r"\bstatic\s+bool\s+(\w+)\s*(=\s*([^;,]*))?;")
+    lowered = set()
+    for match in declaration.finditer(code):
+        name, initializer = match.group(1), match.group(3)
+        if initializer is not None and not is_boolean_expression(initializer, boolean_names):
+            continue
+        if stores_are_boolean(code, name, boolean_names | {name}):
+            lowered.add(name)
+
+    def lower(match):
+        if match.group(1) not in lowered:
+            return match.group(0)
+        return match.group(0).replace("bool", "__bit", 1)
+
+    return declaration.sub(lower, code), lowered
@@ -0,0 +1,247 @@
+"""
+Build graph generation for the downstream XC8 compile
+
+After a batch transpilation, the output directory holds the generated C
+modules, shared_definitions.h and the copied supporting files. This module
+writes a Makefile or Ninja file next to them that compiles every .c file to an
+XC8 object (.p1) and links the objects for the target device. The device
+selection flags depend on the compiler (-mcpu= for XC8, -mpic14/-mpic16 -p
+for sdcc) and sit in their own variable, next to the compiler's.
+
+Header dependencies are taken from the quoted #include directives of the
+files, so editing one module only rebuilds its object.
+"""
+
+import re
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional, Union
+
+from .output import write_if_changed
+
+PathLike = Union[str, Path]
+
+BUILD_SYSTEMS = {"make": "Makefile", "ninja": "build.ninja"}
+
+DEFAULT_COMPILER = "xc8-cc"
+
+# PIC18 devices, built by the pic16 port of sdcc
+_PIC18_DEVICE = re.compile(r"^(?:PIC)?18", re.IGNORECASE)
+
+_INCLUDE_PATTERN = re.compile(r'^\s*#\s*include\s+"([^"]+)"', re.MULTILINE)
+
+
+def local_header_dependencies(c_file: PathLike, search_dir: PathLike) -> List[str]:
+    """
+    Collect the headers of search_dir a C file includes, directly or through
+    other headers. System includes (<xc.h>) are not followed.
+
+    Returns:
+        Header file names relative to search_dir, in inclusion order
+    """
+    search_dir = Path(search_dir)
+    headers: Dict[str, None] = {}
+    pending = [Path(c_file)]
+
+    while pending:
+        current = pending.pop(0)
+        try:
+            content = current.read_text(encoding="utf-8", errors="replace")
+        except OSError:
+            continue
+
+        for name in _INCLUDE_PATTERN.findall(content):
+            header = search_dir / name
+            if name not in headers and header.is_file():
+                headers[name] = None
+                pending.append(header)
+
+    return list(headers)
+
+
+def device_flags(compiler: str, target_device: str, device_variable: str) -> str:
+    """
+    Flags selecting the target device for a compiler. XC8 takes the device
+    through a variable (-mcpu=$(DEVICE)) so it can be overridden when
+    building; sdcc needs the port of the device family and its lowercase
+    name (-mpic14 -p16f876a), so they are derived from target_device.
+
+    Args:
+        compiler: Compiler command; its program name selects the flags
+        target_device: PIC device, e.g. PIC16F876A
+        device_variable: Reference to the device variable of the build file
+    """
+    program = Path(compiler.split()[0]).name if compiler.strip() else ""
+    if program.startswith("sdcc"):
+        device = re.sub(r"^PIC", "", target_device, flags=re.IGNORECASE).lower()
+        port = "pic16" if _PIC18_DEVICE.match(target_device) else "pic14"
+        return f"-m{port} -p{device}"
+    return f"-mcpu={device_variable}"
+
+
+def _escape_make(name: str) -> str:
+    return name.replace("$", "$$").replace(" ", "\\ ")
+
+
+def _escape_ninja(name: str) -> str:
+    return name.replace("$", "$$").replace(" ", "$ ").replace(":", "$:")
+
+
+def generate_makefile(
+    output_dir: PathLike,
+    c_files: Iterable[str],
+    target_device: str,
+    project_name: str,
+    compiler: str = DEFAULT_COMPILER,
+) -> str:
+    """
+    Generate a Makefile compiling c_files to .p1 objects and linking them.
+
+    Args:
+        output_dir: Directory holding the C files (the Makefile's directory)
+        c_files: C file names relative to output_dir
+        target_device: PIC device, see device_flags
+        project_name: Base name of the linked image
+        compiler: Default compiler command (overridable with `make CC=...
+            DEVICE_FLAGS=...`)
+
+    Returns:
+        Makefile text
+    """
+    c_files = sorted(c_files)
+    objects = [str(Path(name).with_suffix(".p1")) for name in c_files]
+
+    lines = [
+        "# Generated by xc8plusplus - builds the transpiled C modules with XC8",
+        "# Override the toolchain with e.g. `make CC=sdcc DEVICE_FLAGS=... CFLAGS=...`",
+        "",
+        # Plain assignment: make predefines CC, so ?= would never apply
+        f"CC = {compiler}",
+        f"DEVICE ?= {target_device}",
+        f"DEVICE_FLAGS ?= {device_flags(compiler, target_device, '$(DEVICE)')}",
+        "CFLAGS ?=",
+        "LDFLAGS ?=",
+        "",
+        f"IMAGE = {_escape_make(project_name)}.hex",
+        "OBJS = " + " ".join(_escape_make(obj) for obj in objects),
+        "",
+        ".PHONY: all clean",
+        "",
+        "all: $(IMAGE)",
+        "",
+        "$(IMAGE): $(OBJS)",
+        "\t$(CC) $(DEVICE_FLAGS) $(LDFLAGS) -o $@ $(OBJS)",
+        "",
+    ]
+
+    for c_file, obj in zip(c_files, objects):
+        prerequisites = [c_file] + local_header_dependencies(
+            Path(output_dir) / c_file, output_dir
+        )
+        lines.append(
+            f"{_escape_make(obj)}: "
+            + " ".join(_escape_make(name) for name in prerequisites)
+        )
+        lines.append("\t$(CC) $(DEVICE_FLAGS) $(CFLAGS) -c -o $@ $<")
+        lines.append("")
+
+    lines.append("clean:")
+    lines.append("\trm -f $(OBJS) $(IMAGE)")
+
+    return "\n".join(lines) + "\n"
+
+
+def generate_ninja(
+    output_dir: PathLike,
+    c_files: Iterable[str],
+    target_device: str,
+    project_name: str,
+    compiler: str = DEFAULT_COMPILER,
+) -> str:
+    """
+    Generate a Ninja file compiling c_files to .p1 objects and linking them.
+
+    Args:
+        output_dir: Directory holding the C files (ninja runs from there)
+        c_files: C file names relative to output_dir
+        target_device: PIC device, see device_flags
+        project_name: Base name of the linked image
+        compiler: Compiler command
+
+    Returns:
+        Ninja file text
+    """
+    c_files = sorted(c_files)
+    objects = [str(Path(name).with_suffix(".p1")) for name in c_files]
+
+    lines = [
+        "# Generated by xc8plusplus - builds the transpiled C modules with XC8",
+        "",
+        f"cc = {compiler}",
+        f"device = {target_device}",
+        f"device_flags = {device_flags(compiler, target_device, '$device')}",
+        "cflags =",
+        "ldflags =",
+        "",
+        "rule cc",
+        "  command = $cc $device_flags $cflags -c -o $out $in",
+        "  description = CC $out",
+        "",
+        "rule link",
+        "  command = $cc $device_flags $ldflags -o $out $in",
+        "  description = LINK $out",
+        "",
+    ]
+
+    for c_file, obj in zip(c_files, objects):
+        headers = local_header_dependencies(Path(output_dir) / c_file, output_dir)
+        line = f"build {_escape_ninja(obj)}: cc {_escape_ninja(c_file)}"
+        if headers:
+            line += " | " + " ".join(_escape_ninja(name) for name in headers)
+        lines.append(line)
+
+    image = _escape_ninja(f"{project_name}.hex")
+    lines.append("")
+    lines.append(
+        f"build {image}: link " + " ".join(_escape_ninja(obj) for obj in objects)
+    )
+    lines.append(f"default {image}")
+
+    return "\n".join(lines) + "\n"
+
+
+def write_build_file(
+    build_system: str,
+    output_dir: PathLike,
+    c_files: Iterable[str],
+    target_device: str,
+    project_name: str,
+    compiler: Optional[str] = None,
+) -> Path:
+    """
+    Write a Makefile or build.ninja into output_dir (only if its content changed).
+
+    Args:
+        build_system: "make" or "ninja"
+        output_dir: Directory holding the C files
+        c_files: C file names relative to output_dir
+        target_device: PIC device, see device_flags
+        project_name: Base name of the linked image
+        compiler: Compiler command (default: xc8-cc)
+
+    Returns:
+        Path of the build file
+    """
+    if build_system not in BUILD_SYSTEMS:
+        raise ValueError(
+            f"Invalid build system '{build_system}'. Must be one of: "
+            + ", ".join(sorted(BUILD_SYSTEMS))
+        )
+
+    generate = generate_makefile if build_system == "make" else generate_ninja
+    content = generate(
+        output_dir, c_files, target_device, project_name, compiler or DEFAULT_COMPILER
+    )
+
+    build_file = Path(output_dir) / BUILD_SYSTEMS[build_system]
+    write_if_changed(build_file, content)
+    return build_file
@@ -0,0 +1,313 @@
+"""
+C++ to C type mapping for XC8
+
+Clang prints each declaration type as 'spelled' or 'spelled':'canonical'
+(e.g. 'uint8_t':'unsigned char'). On 8-bit PIC parts the width of every
+type matters, so types are carried through faithfully: exact-width integers,
+signedness, pointers, arrays, qualifiers and typedefs (through their
+canonical type) are all preserved. Only types that cannot be resolved at all
+fall back to int.
+"""
+
+import re
+from typing import Dict, Iterable, Optional, Tuple
+
+# Built-in C types, keyed by the spellings Clang may use
+BUILTIN_TYPES = {
+    "void": "void",
+    "bool": "bool",
+    "_Bool": "bool",
+    "char": "char",
+    "signed char": "signed char",
+    "unsigned char": "unsigned char",
+    "short": "short",
+    "short int": "short",
+    "signed short": "short",
+    "unsigned short": "unsigned short",
+    "unsigned short int": "unsigned short",
+    "int": "int",
+    "signed": "int",
+    "signed int": "int",
+    "unsigned": "unsigned int",
+    "unsigned int": "unsigned int",
+    "long": "long",
+    "long int": "long",
+    "unsigned long": "unsigned long",
+    "unsigned long int": "unsigned long",
+    "long long": "long long",
+    "unsigned long long": "unsigned long long",
+    "float": "float",
+    "double": "double",
+    "long double": "long double",
+    # XC8 single-bit type
+    "__bit": "__bit",
+}
+
+# <stdint.h>/<stddef.h> names, kept as spelled in the generated C
+_STANDARD_TYPEDEF = re.compile(
+    r"^(u?int(_least|_fast)?(8|16|24|32|64)_t|u?intptr_t|u?intmax_t|size_t|ptrdiff_t)$"
+)
+
+QUALIFIERS = ("const", "volatile")
+
+_ARRAY_SUFFIX = re.compile(r"^(.*?)\s*((?:\[\d*\])+)$")
+
+# Reference to an array, e.g. "const uint8_t (&)[4]"
+_ARRAY_REFERENCE = re.compile(r"^(.*?)\s*\(\s*&&?\s*\)\s*\[\d*\]((?:\[\d*\])*)$")
+
+_INTEGER_SPECIFIERS = ("signed", "unsigned", "char", "short", "int", "long")
+
+# Exact-width types tried, smallest first, when narrowing enum storage
+_INTEGER_RANGES = (
+    ("uint8_t", 0, 0xFF),
+    ("int8_t", -0x80, 0x7F),
+    ("uint16_t", 0, 0xFFFF),
+    ("int16_t", -0x8000, 0x7FFF),
+    ("uint32_t", 0, 0xFFFFFFFF),
+    ("int32_t", -0x80000000, 0x7FFFFFFF),
+)
+
+
+def split_ast_type(text: str) -> Tuple[Optional[str], Optional[str]]:
+    """
+    Split a Clang AST type annotation into its spelled and canonical types.
+
+    "'uint8_t':'unsigned char'" -> ("uint8_t", "unsigned char")
+    "'int'" -> ("int", None)
+    """
+    match = re.search(r"'([^']*)'(?::'([^']*)')?", text)
+    if not match:
+        return None, None
+    return match.group(1), match.group(2)
+
+
+def is_standard_typedef(name: str) -> bool:
+    """Check whether a name is an exact-width or <stddef.h> typedef"""
+    return bool(_STANDARD_TYPEDEF.match(name))
+
+
+def _strip_elaborations(cpp_type: str) -> str:
+    """Drop elaborated type keywords and the std namespace"""
+    cpp_type = re.sub(r"\b(class|struct|enum|union)\s+", "", cpp_type)
+    cpp_type = re.sub(r"\bstd::", "", cpp_type)
+    return re.sub(r"\s+", " ", cpp_type).strip()
+
+
+def _normalize(cpp_type: str) -> str:
+    """Strip elaborations and put a single space before each * and &"""
+    cpp_type = re.sub(r"\s*([*&])\s*", r" \1", _strip_elaborations(cpp_type))
+    return cpp_type.replace("& &", "&&")
+
+
+def _integer_type(core: str) -> Optional[str]:
+    """
+    Map an integer type spelled with several specifiers in any order, e.g.
+    "long long int" or "signed long", to the exact-width type of its size
+    on XC8 (see C_TYPE_SIZES); None if core is not such a spelling.
+    """
+    tokens = core.split()
+    if not tokens or any(token not in _INTEGER_SPECIFIERS for token in tokens):
+        return None
+    unsigned = "unsigned" in tokens
+    if "char" in tokens:
+        return "unsigned char" if unsigned else "signed char"
+    longs = tokens.count("long")
+    if "short" in tokens:
+        spelled = "short"
+    else:
+        spelled = ("int", "long", "long long")[min(longs, 2)]
+    return f"{'u' if unsigned else ''}int{C_TYPE_SIZES[spelled] * 8}_t"
+
+
+def _map_base(base: str, known_types: Iterable[str]) -> Optional[str]:
+    """Map a base type (no pointers or arrays); None if it is unknown"""
+    tokens = base.split()
+    qualifiers = [token for token in tokens if token in QUALIFIERS]
+    core = " ".join(token for token in tokens if token not in QUALIFIERS)
+
+    if core in BUILTIN_TYPES:
+        mapped = BUILTIN_TYPES[core]
+    elif is_standard_typedef(core) or core in known_types:
+        mapped = core
+    else:
+        mapped = _integer_type(core)
+        if mapped is None:
+            return None
+
+    return " ".join(qualifiers + [mapped])
+
+
+def map_type(
+    cpp_type: str,
+    canonical_type: Optional[str] = None,
+    known_types: Iterable[str] = (),
+) -> str:
+    """
+    Map a C++ type to the C type emitted for XC8.
+
+    Args:
+        cpp_type: Type as spelled in the source (Clang's first type)
+        canonical_type: Canonical type, used for typedefs unknown to C
+        known_types: Class and enum names emitted in the generated C
+
+    Returns:
+        C type. Arrays keep their dimensions ("uint8_t [16]"); use
+        c_declaration() to attach a declarator name. A reference to an
+        array becomes a pointer to its element ("uint8_t (&)[4]" ->
+        "uint8_t *"), which the array decays to at the call.
+    """
+    known_types = set(known_types)
+
+    array_reference = _ARRAY_REFERENCE.match(_strip_elaborations(cpp_type))
+    if array_reference:
+        element = array_reference.group(1) + array_reference.group(2)
+        canonical = _ARRAY_REFERENCE.match(_strip_elaborations(canonical_type or ""))
+        if canonical:
+            canonical = canonical.group(1) + canonical.group(2)
+        element_type = map_type(element, canonical, known_types)
+        # Inner dimensions ("(&)[2][3]") stay on the element type
+        dimensions = _ARRAY_SUFFIX.match(element_type)
+        if dimensions:
+            return f"{dimensions.group(1)} (*){dimensions.group(2)}"
+        return element_type + " *"
+
+    # Function types and function pointers are already valid C
+    if "(" in cpp_type:
+        return _strip_elaborations(cpp_type)
+
+    cpp_type = _normalize(cpp_type)
+
+    dimensions = ""
+    array_match = _ARRAY_SUFFIX.match(cpp_type)
+    if array_match:
+        cpp_type, dimensions = array_match.group(1), array_match.group(2)
+
+    # Pointer/reference declarator part, e.g. "* const *"; references
+    # become pointers in C
+    star = re.search(r"[*&]", cpp_type)
+    base = cpp_type[: star.start()].strip() if star else cpp_type
+    declarator = cpp_type[star.start():] if star else ""
+    declarator = declarator.replace("&&", "*").replace("&", "*").replace(" ", "")
+    declarator = re.sub(r"(const|volatile)", r" \1 ", declarator).strip()
+
+    mapped = _map_base(base, known_types)
+    if mapped is None:
+        if canonical_type and canonical_type != cpp_type:
+            return map_type(canonical_type, None, known_types)
+        # Unresolvable: pointers become untyped, values default to int
+        mapped = "void" if declarator else "int"
+
+    result = mapped
+    if declarator:
+        result += " " + re.sub(r"\s+", " ", declarator)
+    if dimensions:
+        result += " " + dimensions
+    return result
+
+
+def is_integral_type(c_type: str) -> bool:
+    """Check whether a mapped C type is an integer (or bool) scalar"""
+    core = " ".join(token for token in c_type.split() if token not in QUALIFIERS)
+    if core in ("void", "float", "double", "long double", "__bit"):
+        return False
+    return core in BUILTIN_TYPES.values() or is_standard_typedef(core)
+
+
+def c_declaration(c_type: str, name: str) -> str:
+    """
+    Build a C declaration from a mapped type and a name.
+
+    "uint8_t [16]", "buffer" -> "uint8_t buffer[16]"
+    "unsigned char *", "data" -> "unsigned char *data"
+    "void (*)(int)", "handler" -> "void (*handler)(int)"
+    """
+    if "(*)" in c_type:
+        return c_type.replace("(*)", f"(*{name})", 1)
+
+    dimensions = ""
+    array_match = _ARRAY_SUFFIX.match(c_type)
+    if array_match:
+        c_type, dimensions = array_match.group(1), array_match.group(2)
+
+    if c_type.endswith("*"):
+        return f"{c_type}{name}{dimensions}"
+    return f"{c_type} {name}{dimensions}"
+
+
+def smallest_integer_type(values: Iterable[int]) -> str:
+    """
+    Smallest exact-width integer type holding all values (uint8_t for none).
+
+    [0, 4] -> "uint8_t", [-1, 1] -> "int8_t", [0, 300] -> "uint16_t"
+    """
+    values = list(values) or [0]
+    low, high = min(values), max(values)
+    for c_type, type_min, type_max in _INTEGER_RANGES:
+        if type_min <= low and high <= type_max:
+            return c_type
+    return "int64_t" if low < 0 else "uint64_t"
+
+
+# Sizes in bytes of the built-in C types on 8-bit PIC with XC8 (int is 16
+# bits, double is 32 bits by default)
+C_TYPE_SIZES = {
+    "bool": 1,
+    "char": 1,
+    "signed char": 1,
+    "unsigned char": 1,
+    "short": 2,
+    "unsigned short": 2,
+    "int": 2,
+    "unsigned int": 2,
+    "long": 4,
+    "unsigned long": 4,
+    "long long": 8,
+    "unsigned long long": 8,
+    "float": 4,
+    "double": 4,
+    "long double": 4,
+    "size_t": 2,
+    "ptrdiff_t": 2,
+    "intptr_t": 2,
+    "uintptr_t": 2,
+    "intmax_t": 4,
+    "uintmax_t": 4,
+}
+
+POINTER_SIZE = 2
+
+_EXACT_WIDTH = re.compile(r"^u?int(?:_least|_fast)?(8|16|24|32|64)_t$")
+
+
+def c_type_size(c_type: str, known_sizes: Optional[Dict[str, int]] = None) -> int:
+    """
+    Size in bytes of a mapped C type on 8-bit PIC.
+
+    Args:
+        c_type: C type as returned by map_type()
+        known_sizes: Sizes of the structs and enums of the program
+
+    Returns:
+        Size in bytes; types of unknown size count as an int
+    """
+    known_sizes = known_sizes or {}
+
+    count = 1
+    array_match = _ARRAY_SUFFIX.match(c_type)
+    if array_match:
+        c_type = array_match.group(1)
+        for dimension in re.findall(r"\[(\d*)\]", array_match.group(2)):
+            count *= int(dimension or 0)
+
+    if "*" in c_type or "(" in c_type:
+        return POINTER_SIZE * count
+
+    core = " ".join(token for token in c_type.split() if token not in QUALIFIERS)
+    width = _EXACT_WIDTH.match(core)
+    if width:
+        size = int(width.group(1)) // 8
+    elif core in known_sizes:
+        size = known_sizes[core]
+    else:
+        size = C_TYPE_SIZES.get(core, C_TYPE_SIZES["int"])
+    return size * count
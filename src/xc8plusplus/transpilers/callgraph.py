@@ -0,0 +1,142 @@
+"""
+Call graph of the lowered C program
+
+Each symbol the backend can emit (functions, methods as Class_method, the
+Class_init/Class_cleanup helpers, structs, enums and globals) is described by
+the C text it would produce: its types and its lowered body. Identifiers in
+that text that name other symbols become edges - calls when followed by "(",
+plain references otherwise. Working on the lowered C rather than on the C++
+means the graph sees exactly the calls the generated code makes, including
+those the lowering itself introduces.
+"""
+
+import re
+from typing import Dict, Iterable, List, Optional, Set, Tuple
+
+_IDENTIFIER = re.compile(r"\b([A-Za-z_]\w*)\b(\s*\()?")
+
+# Comments and string/character literals never reference symbols
+_COMMENT_OR_LITERAL = re.compile(
+    r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\\n])*"|\'(?:\\.|[^\'\\\n])*\'', re.DOTALL
+)
+
+
+def strip_comments_and_literals(code: str) -> str:
+    """Blank out comments and string/character literals of C code"""
+    return _COMMENT_OR_LITERAL.sub(" ", code)
+
+
+def scan_symbols(
+    text: str, name: str, symbols, aliases: Optional[Dict[str, str]] = None
+) -> Tuple[List[str], List[str]]:
+    """
+    Resolve the identifiers of the C text of a symbol.
+
+    Args:
+        text: Lowered C text
+        name: Symbol the text belongs to (not a reference to itself)
+        symbols: Names of the symbols of the program
+        aliases: Other identifiers standing for a symbol
+
+    Returns:
+        The calls, one per call expression in order, and the other symbols
+        referenced, each once
+    """
+    aliases = aliases or {}
+    calls: List[str] = []
+    references: Dict[str, None] = {}
+    for match in _IDENTIFIER.finditer(strip_comments_and_literals(text)):
+        identifier = match.group(1)
+        target = identifier if identifier in symbols else aliases.get(identifier)
+        if target is None:
+            continue
+        if match.group(2) and target == identifier:
+            calls.append(target)
+        elif target != name:
+            references[target] = None
+    return calls, list(references)
+
+
+class CallGraph:
+    """Calls and references between the symbols of a lowered C program"""
+
+    def __init__(
+        self, definitions: Dict[str, str], aliases: Optional[Dict[str, str]] = None
+    ):
+        """
+        Build the graph.
+
+        Args:
+            definitions: C text of each symbol, keyed by its C name. The text
+                must not contain the symbol's own declarator (its name would
+                read as a self-call).
+            aliases: Other identifiers standing for a symbol, e.g. enum
+                constants ("LedId_LED_0" -> "LedId")
+        """
+        edges = {
+            name: scan_symbols(text, name, definitions, aliases)
+            for name, text in definitions.items()
+        }
+        self._connect(definitions, edges)
+
+    @classmethod
+    def from_edges(
+        cls, definitions: Dict[str, str], edges: Dict[str, Tuple[List[str], List[str]]]
+    ) -> "CallGraph":
+        """
+        Build the graph from symbols already resolved (see scan_symbols).
+
+        Args:
+            definitions: C text of each symbol
+            edges: Calls (one per call expression) and references of each symbol
+        """
+        graph = cls.__new__(cls)
+        graph._connect(definitions, edges)
+        return graph
+
+    def _connect(self, definitions, edges):
+        """Record the symbols and their deduplicated edges and call counts"""
+        self.symbols = list(definitions)
+        # C text of each symbol, for passes reading the lowered code
+        self.definitions: Dict[str, str] = dict(definitions)
+        self.calls: Dict[str, List[str]] = {}
+        self.references: Dict[str, List[str]] = {}
+        # Number of call expressions targeting each symbol
+        self.call_sites: Dict[str, int] = {}
+
+        for name, (calls, references) in edges.items():
+            for target in calls:
+                self.call_sites[target] = self.call_sites.get(target, 0) + 1
+            self.calls[name] = list(dict.fromkeys(calls))
+            self.references[name] = list(references)
+
+    def reachable(self, roots: Iterable[str]) -> Set[str]:
+        """Symbols reachable from roots through calls and references"""
+        live: Set[str] = set()
+        pending = [root for root in roots if root in self.calls]
+        while pending:
+            name = pending.pop()
+            if name in live:
+                continue
+            live.add(name)
+            pending.extend(self.calls[name])
+            pending.extend(self.references[name])
+        return live
+
+    def call_depths(self, roots: Iterable[str]) -> Dict[str, int]:
+        """
+        Deepest call nesting each symbol reachable through calls runs at
+        (roots are at 0). Recursive cycles are cut off after as many levels
+        as there are symbols.
+        """
+        depths = {root: 0 for root in roots if root in self.calls}
+        limit = len(self.symbols)
+        changed = True
+        while changed:
+            changed = False
+            for caller, depth in list(depths.items()):
+                for callee in self.calls[caller]:
+                    if depth + 1 > depths.get(callee, -1) and depth + 1 <= limit:
+                        depths[callee] = depth + 1
+                        changed = True
+        return depths
@@ -0,0 +1,85 @@
+"""
+Makefile-format dependency files (.d) for build-system integration
+
+A depfile lists the C++ sources and headers the generated C outputs depend on,
+so Make and Ninja can re-run the transpile step only when one of them changes.
+"""
+
+import re
+from pathlib import Path
+from typing import Iterable, List, Union
+
+from .output import write_if_changed
+
+PathLike = Union[str, Path]
+
+
+def parse_make_dependencies(text: str) -> List[str]:
+    """
+    Parse the prerequisites of a Make rule as written by `clang -MD -MF`.
+
+    Args:
+        text: Make rule text ("target: dep1 \\\\\\n  dep2 ...")
+
+    Returns:
+        Prerequisite paths in order of appearance, without duplicates
+    """
+    # Join continuation lines
+    text = text.replace("\\\r\n", " ").replace("\\\n", " ")
+
+    dependencies = []
+    for line in text.splitlines():
+        # The target ends at the first colon followed by whitespace or end of
+        # line, which keeps Windows drive letters ("C:\\...") intact
+        match = re.search(r":(\s|$)", line)
+        if not match:
+            continue
+
+        prerequisites = line[match.end():]
+        # Split on unescaped whitespace, then unescape "\ ", "\#" and "$$"
+        for token in re.split(r"(?<!\\)\s+", prerequisites.strip()):
+            if token:
+                dependencies.append(_unescape(token))
+
+    return list(dict.fromkeys(dependencies))
+
+
+def _unescape(token: str) -> str:
+    """Undo the Makefile escaping of a path (see _escape)"""
+    return token.replace("\\ ", " ").replace("\\#", "#").replace("$$", "$")
+
+
+def _escape(path: PathLike) -> str:
+    """Escape a path for use in a Makefile rule"""
+    return str(path).replace("$", "$$").replace("#", "\\#").replace(" ", "\\ ")
+
+
+def format_depfile(targets: Iterable[PathLike], dependencies: Iterable[PathLike]) -> str:
+    """
+    Format a Makefile-format depfile.
+
+    Args:
+        targets: Generated files (the first one is the primary output)
+        dependencies: Files the targets depend on
+
+    Returns:
+        Depfile text
+    """
+    rule = " ".join(_escape(target) for target in targets) + ":"
+    for dependency in dict.fromkeys(str(dep) for dep in dependencies):
+        rule += " \\\n  " + _escape(dependency)
+    return rule + "\n"
+
+
+def write_depfile(
+    depfile: PathLike, targets: Iterable[PathLike], dependencies: Iterable[PathLike]
+) -> bool:
+    """
+    Write a depfile, leaving it untouched if its content did not change.
+
+    Returns:
+        True if the depfile was written
+    """
+    depfile = Path(depfile)
+    depfile.parent.mkdir(parents=True, exist_ok=True)
+    return write_if_changed(depfile, format_depfile(targets, dependencies))
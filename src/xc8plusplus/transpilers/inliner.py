@@ -0,0 +1,165 @@
+"""
+Inlining decisions for lowered methods
+
+Every call on PIC16 costs a CALL/RETURN pair, the setup of self (FSR) and the
+arguments, and one of only 8 hardware return-stack levels. Small leaf methods
+such as accessors are cheaper as `static inline` functions the compiler
+expands at each call site. Which methods qualify follows a cost model: when
+optimizing for size a method is inlined only if that does not grow the
+program, when optimizing for speed every small leaf is inlined. Methods
+called at a depth that would exhaust the hardware stack are inlined either
+way, as long as they stay below the speed limit.
+
+Only bodies that compute a value qualify: a few statements without loops,
+switches or directives (#pragma) that store nothing but their own locals.
+A method that changes its object or the hardware stays a single function.
+"""
+
+import re
+from dataclasses import dataclass
+from typing import Dict, Iterable, Set
+
+from .callgraph import CallGraph, strip_comments_and_literals
+
+INLINE_GOALS = ("size", "speed")
+
+_TOKEN = re.compile(r"->|\+\+|--|<<=?|>>=?|[<>!=]=|&&|\|\||\w+|[^\s\w]")
+
+# Tokens that cost no code of their own
+_FREE_TOKENS = {"return", ";", "{", "}", "(", ")", "self", "->", "."}
+
+# Control flow other than if/return, and preprocessor directives
+_CONTROL_FLOW = re.compile(r"\b(?:switch|for|while|do|goto|asm)\b|^[ \t]*#", re.M)
+
+# Stores: assignments (not comparisons), compound assignments, ++ and --
+_STORE = re.compile(r"<<=|>>=|(?<![=!<>])=(?!=)|\+\+|--")
+
+# Declaration of a local with its initializer: "uint8_t level = "
+_LOCAL_INITIALIZER = re.compile(
+    r"^\s*(?!return\b)\w+(?:\s+\w+)*(?:\s+|\s*\*+\s*)\w+\s*=(?!=)"
+)
+
+
+@dataclass
+class InlineCostModel:
+    """
+    Cost model for inlining, in approximate instruction words.
+
+    Attributes:
+        goal: "size" (inline only if the program does not grow) or "speed"
+            (inline every leaf up to speed_limit)
+        call_overhead: Cost of one call: CALL, RETURN and loading self
+        argument_cost: Extra cost of each argument passed
+        speed_limit: Largest body ever inlined (0 disables inlining)
+        statement_limit: Most statements of a body ever inlined
+        stack_budget: Hardware return-stack levels of the device
+        stack_reserve: Levels kept free (one for the interrupt)
+    """
+
+    goal: str = "size"
+    call_overhead: int = 4
+    argument_cost: int = 2
+    speed_limit: int = 24
+    statement_limit: int = 2
+    stack_budget: int = 8
+    stack_reserve: int = 1
+
+    def __post_init__(self):
+        if self.goal not in INLINE_GOALS:
+            raise ValueError(
+                f"Invalid inlining goal '{self.goal}'. Must be one of: "
+                + ", ".join(INLINE_GOALS)
+            )
+
+    def body_cost(self, body: str) -> int:
+        """Estimated size of a lowered function body (directives cost nothing)"""
+        body = re.sub(r"^[ \t]*#[^\n]*", "", strip_comments_and_literals(body), flags=re.M)
+        tokens = _TOKEN.findall(body)
+        return max(1, sum(1 for token in tokens if token not in _FREE_TOKENS))
+
+    def is_inlinable(self, body: str) -> bool:
+        """
+        Check whether a lowered body may be inlined at all: at most
+        statement_limit statements, no control flow other than if and
+        return, no directives, and no stores but the initializers of its
+        own locals.
+        """
+        body = strip_comments_and_literals(body)
+        if _CONTROL_FLOW.search(body):
+            return False
+        statements = [statement for statement in re.split(r"[;{}]", body) if statement.strip()]
+        if len(statements) > self.statement_limit:
+            return False
+        for statement in statements:
+            local = _LOCAL_INITIALIZER.match(statement)
+            if _STORE.search(statement[local.end():] if local else statement):
+                return False
+        return True
+
+    def call_cost(self, arguments: int) -> int:
+        """Estimated size of one call site"""
+        return self.call_overhead + self.argument_cost * arguments
+
+    def should_inline(self, body_cost: int, call_sites: int, arguments: int, depth: int) -> bool:
+        """
+        Decide whether a leaf function is inlined.
+
+        Args:
+            body_cost: Estimated size of its body
+            call_sites: Number of calls to it in the program
+            arguments: Number of arguments it takes, self included
+            depth: Deepest return-stack level it runs at
+        """
+        if body_cost > self.speed_limit:
+            return False
+        if depth > self.stack_budget - self.stack_reserve:
+            return True
+        if self.goal == "speed":
+            return True
+
+        # Out of line: one body plus RETURN, and a call per site
+        out_of_line = body_cost + 1 + call_sites * self.call_cost(arguments)
+        return call_sites * body_cost <= out_of_line
+
+
+def select_inline_candidates(
+    graph: CallGraph,
+    candidates: Dict[str, str],
+    arguments: Dict[str, int],
+    roots: Iterable[str],
+    model: InlineCostModel,
+    globals_: Iterable[str] = (),
+) -> Set[str]:
+    """
+    Choose the functions to emit as `static inline`: leaves whose body is
+    inlinable (see InlineCostModel.is_inlinable) and worth inlining.
+
+    Args:
+        graph: Call graph of the lowered program
+        candidates: Lowered body of each function that may be inlined
+        arguments: Number of arguments of each candidate, self included
+        roots: Entry points (main and interrupt handlers)
+        model: Cost model
+        globals_: Global variables; a header-defined inline function cannot
+            reference them
+
+    Returns:
+        Names of the functions to inline
+    """
+    globals_ = set(globals_)
+    depths = graph.call_depths(roots)
+    selected = set()
+
+    for name, body in candidates.items():
+        # Only leaves: inlined bodies go to headers, before other functions
+        if graph.calls.get(name) or globals_ & set(graph.references.get(name, ())):
+            continue
+        if model.is_inlinable(body) and model.should_inline(
+            model.body_cost(body),
+            graph.call_sites.get(name, 0),
+            arguments.get(name, 1),
+            depths.get(name, 0),
+        ):
+            selected.add(name)
+
+    return selected
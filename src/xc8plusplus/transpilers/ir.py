@@ -0,0 +1,463 @@
+"""
+Typed intermediate representation of the lowered program
+
+The analysis of the Clang AST yields loosely-typed dicts and C++ bodies. Once
+the bodies are lowered, the backend describes the C program it is about to
+emit as an IRProgram: structs with typed fields, scoped enums with their
+storage type and constants, globals with their C type and initializer, and
+functions (free functions, Class_method methods, the Class_init/Class_cleanup
+helpers, global_constructors and main) with a return type, typed parameters
+and a body split into top-level statements.
+
+Every statement, and the declaration part of every symbol (field types,
+signature, initializer), carries the symbols it resolves to: the calls it
+makes, one per call expression, and the other symbols it names. The call
+graph is built from those resolved edges, and the passes working on the
+whole program read the IR: dead code elimination, inlining, internal
+linkage, __bit lowering, bank placement and the stack check take the
+typed symbols and the lowered bodies from it rather than lowering the
+analyzed C++ again.
+
+Statements are still C text, and the IR describes the program without
+producing it: the C files are emitted from the analysis, each body going
+through the lowering memo again once the passes have decided.
+
+An IRProgram serializes to a compact binary form (to_bytes/from_bytes): a
+string table followed by the records, all integers as varints. With a
+cache directory the backend saves it as program.xir, tagged with a hash of
+the inputs it was built from, and a later run on the same inputs loads it
+instead of lowering every body for the analyses (load_program).
+"""
+
+import re
+from dataclasses import dataclass, fields
+from pathlib import Path
+from typing import Dict, Iterable, List, Optional, Tuple
+
+from .c_types import c_declaration
+from .callgraph import CallGraph, scan_symbols
+from .specialize import mask_comments
+from .staticinit import split_statements
+
+IR_MAGIC = b"XCIR"
+
+# Bump whenever a record changes shape
+IR_VERSION = 3
+
+IR_FILENAME = "program.xir"
+
+_DECLARATION = re.compile(r"^(.*?\S)\s*\b(\w+)((?:\[[^\]]*\])*)$")
+
+
+@dataclass(frozen=True)
+class IRStatement:
+    """
+    A top-level statement of a lowered body, or the declaration part of a
+    symbol, with the symbols it resolves to.
+
+    Attributes:
+        text: Lowered C text
+        calls: Called symbols, one per call expression, in order
+        references: Other symbols named, each once
+    """
+
+    text: str
+    calls: Tuple[str, ...] = ()
+    references: Tuple[str, ...] = ()
+
+
+@dataclass(frozen=True)
+class IRVariable:
+    """A typed name: struct field or function parameter"""
+
+    name: str
+    c_type: str
+
+    def declaration(self) -> str:
+        """C declaration ("uint8_t buffer[16]")"""
+        return c_declaration(self.c_type, self.name)
+
+
+@dataclass(frozen=True)
+class IRStruct:
+    """A lowered class: its fields, in declaration order"""
+
+    name: str
+    fields: Tuple[IRVariable, ...]
+    header: IRStatement
+    unit: str = ""
+
+
+@dataclass(frozen=True)
+class IREnum:
+    """A scoped enum: storage type and C constants with their values"""
+
+    name: str
+    storage_type: str
+    constants: Tuple[Tuple[str, int], ...]
+    header: IRStatement
+    unit: str = ""
+
+
+@dataclass(frozen=True)
+class IRGlobal:
+    """A global variable with its C type and constant initializer, if any"""
+
+    name: str
+    c_type: str
+    initializer: str
+    header: IRStatement
+    unit: str = ""
+
+
+@dataclass(frozen=True)
+class IRFunction:
+    """
+    A C function of the program.
+
+    Attributes:
+        name: C name (Class_method for methods)
+        kind: "function", "method", "init", "cleanup", "startup" or "main"
+        return_type: C return type
+        parameters: Parameters, without the self pointer of methods
+        owner: Struct of a method or helper, "" otherwise
+        body: Top-level statements of the lowered body
+        header: Declaration part (return type, owner, parameters)
+        interrupt: Whether the function is an interrupt handler
+        unit: Translation unit emitting the function
+    """
+
+    name: str
+    kind: str
+    return_type: str
+    parameters: Tuple[IRVariable, ...]
+    owner: str
+    body: Tuple[IRStatement, ...]
+    header: IRStatement
+    interrupt: bool = False
+    unit: str = ""
+
+    @property
+    def code(self) -> str:
+        """Lowered body, one top-level statement per line"""
+        return "\n".join(statement.text for statement in self.body)
+
+
+@dataclass(frozen=True)
+class IRProgram:
+    """
+    The symbols of the lowered program, in emission order.
+
+    Attributes:
+        fingerprint: Hash of the inputs the program was built from, "" when
+            it is not cached
+    """
+
+    structs: Tuple[IRStruct, ...] = ()
+    enums: Tuple[IREnum, ...] = ()
+    globals: Tuple[IRGlobal, ...] = ()
+    functions: Tuple[IRFunction, ...] = ()
+    fingerprint: str = ""
+
+    def symbols(self) -> Dict[str, object]:
+        """Every symbol by its C name"""
+        table: Dict[str, object] = {}
+        for group in (self.enums, self.structs, self.globals, self.functions):
+            for symbol in group:
+                table.setdefault(symbol.name, symbol)
+        return table
+
+    def split_units(self) -> Dict[str, "IRProgram"]:
+        """The IR of each translation unit: the symbols it defines"""
+        units: Dict[str, Dict[str, list]] = {}
+        for group in ("structs", "enums", "globals", "functions"):
+            for symbol in getattr(self, group):
+                unit = units.setdefault(symbol.unit, {})
+                unit.setdefault(group, []).append(symbol)
+        return {
+            name: IRProgram(**{group: tuple(symbols) for group, symbols in groups.items()})
+            for name, groups in units.items()
+        }
+
+    def function(self, name: str) -> Optional[IRFunction]:
+        """Function of a C name, or None"""
+        return next((function for function in self.functions if function.name == name), None)
+
+    def call_graph(self) -> CallGraph:
+        """Call graph over the resolved statements"""
+        definitions = {}
+        edges = {}
+        for name, symbol in self.symbols().items():
+            statements = (symbol.header,) + tuple(getattr(symbol, "body", ()))
+            definitions[name] = " ".join(
+                statement.text for statement in statements if statement.text
+            )
+            references = [
+                target for statement in statements for target in statement.references
+            ]
+            edges[name] = (
+                [target for statement in statements for target in statement.calls],
+                list(dict.fromkeys(references)),
+            )
+        return CallGraph.from_edges(definitions, edges)
+
+    def to_bytes(self) -> bytes:
+        """Compact binary serialization"""
+        return _Writer().program(self)
+
+    @classmethod
+    def from_bytes(cls, data: bytes) -> "IRProgram":
+        """Read a program written by to_bytes()"""
+        return _Reader(data).program()
+
+
+class ProgramBuilder:
+    """
+    Collects the symbols of a program, then resolves every statement once
+    all the names are known.
+    """
+
+    def __init__(self):
+        self.aliases: Dict[str, str] = {}
+        self._structs = []
+        self._enums = []
+        self._globals = []
+        self._functions = []
+
+    def struct(self, name: str, fields: Iterable[IRVariable], unit: str = ""):
+        """Add a struct with its fields"""
+        fields = tuple(fields)
+        header = " ".join(f.declaration() for f in fields)
+        self._structs.append((name, fields, header, unit))
+
+    def enum(
+        self,
+        name: str,
+        storage_type: str,
+        constants: Iterable[Tuple[str, int]],
+        unit: str = "",
+    ):
+        """Add a scoped enum; its C constants resolve to the enum"""
+        constants = tuple((constant, int(value)) for constant, value in constants)
+        for constant, _ in constants:
+            self.aliases[constant] = name
+        self._enums.append((name, storage_type, constants, storage_type, unit))
+
+    def variable(self, name: str, c_type: str, initializer: str = "", unit: str = ""):
+        """Add a global variable"""
+        header = f"{c_type} {initializer}"
+        self._globals.append((name, c_type, initializer, header, unit))
+
+    def function(
+        self,
+        name: str,
+        kind: str,
+        return_type: str,
+        parameters: Iterable[IRVariable],
+        body: str,
+        owner: str = "",
+        interrupt: bool = False,
+        unit: str = "",
+    ):
+        """Add a function with its lowered body"""
+        parameters = tuple(parameters)
+        header = " ".join(
+            part for part in (
+                return_type, owner, ", ".join(p.declaration() for p in parameters)
+            ) if part
+        )
+        self._functions.append(
+            (name, kind, return_type, parameters, owner, body, header, interrupt, unit)
+        )
+
+    def build(self) -> IRProgram:
+        """Resolve the statements against the symbols collected"""
+        names = {}
+        for group in (self._enums, self._structs, self._globals, self._functions):
+            for entry in group:
+                names.setdefault(entry[0], None)
+
+        def resolve(text, owner):
+            calls, references = scan_symbols(text, owner, names, self.aliases)
+            return IRStatement(text, tuple(calls), tuple(references))
+
+        return IRProgram(
+            structs=tuple(
+                IRStruct(name, fields, resolve(header, name), unit)
+                for name, fields, header, unit in self._structs
+            ),
+            enums=tuple(
+                IREnum(name, storage, constants, resolve(header, name), unit)
+                for name, storage, constants, header, unit in self._enums
+            ),
+            globals=tuple(
+                IRGlobal(name, c_type, initializer, resolve(header, name), unit)
+                for name, c_type, initializer, header, unit in self._globals
+            ),
+            functions=tuple(
+                IRFunction(
+                    name,
+                    kind,
+                    return_type,
+                    parameters,
+                    owner,
+                    tuple(resolve(statement, name) for statement in lowered_statements(body)),
+                    resolve(header, name),
+                    interrupt,
+                    unit,
+                )
+                for name, kind, return_type, parameters, owner, body, header, interrupt, unit
+                in self._functions
+            ),
+        )
+
+
+def load_program(ir_file: Path, fingerprint: str) -> Optional[IRProgram]:
+    """
+    Program a previous run saved to ir_file, when it was built from the
+    inputs of this fingerprint; None otherwise (also for a missing,
+    unreadable or stale file)
+    """
+    ir_file = Path(ir_file)
+    if not ir_file.exists():
+        return None
+    try:
+        program = IRProgram.from_bytes(ir_file.read_bytes())
+    except (OSError, ValueError, IndexError, TypeError) as e:
+        print(f"Warning: Ignoring unreadable program IR {ir_file}: {e}")
+        return None
+    return program if program.fingerprint == fingerprint else None
+
+
+def lowered_statements(code: str) -> List[str]:
+    """
+    Top-level statements of lowered C code. Comments between statements are
+    dropped; a ';' or brace inside a comment does not split.
+    """
+    masked = mask_comments(code)
+    statements = []
+    position = 0
+    for piece in split_statements(masked):
+        position = masked.index(piece, position)
+        statements.append(code[position:position + len(piece)])
+        position += len(piece)
+    return statements
+
+
+def parse_parameters(parameters: str) -> Tuple[IRVariable, ...]:
+    """Typed parameters of a C parameter list ("uint8_t pin, bool on")"""
+    variables = []
+    for declaration in parameters.split(","):
+        match = _DECLARATION.match(declaration.strip())
+        if match and match.group(1) != "void":
+            variables.append(IRVariable(match.group(2), match.group(1) + match.group(3)))
+    return tuple(variables)
+
+
+# Binary serialization: each value is a tag followed by its payload
+_NONE, _FALSE, _TRUE, _INT, _STRING, _TUPLE = range(6)
+_RECORDS = (IRStatement, IRVariable, IRStruct, IREnum, IRGlobal, IRFunction, IRProgram)
+_RECORD_TAG = 6
+
+
+class _Writer:
+    """Encodes a program: header, string table, then the records"""
+
+    def __init__(self):
+        self.strings: Dict[str, int] = {}
+        self.body = bytearray()
+
+    def program(self, program: IRProgram) -> bytes:
+        self._value(program)
+        out = bytearray(IR_MAGIC)
+        _put_varint(out, IR_VERSION)
+        _put_varint(out, len(self.strings))
+        for string in self.strings:
+            encoded = string.encode("utf-8")
+            _put_varint(out, len(encoded))
+            out += encoded
+        return bytes(out + self.body)
+
+    def _value(self, value):
+        body = self.body
+        if value is None:
+            body.append(_NONE)
+        elif isinstance(value, bool):
+            body.append(_TRUE if value else _FALSE)
+        elif isinstance(value, int):
+            body.append(_INT)
+            _put_varint(body, (value << 1) ^ (value >> 63))
+        elif isinstance(value, str):
+            body.append(_STRING)
+            _put_varint(body, self.strings.setdefault(value, len(self.strings)))
+        elif isinstance(value, tuple):
+            body.append(_TUPLE)
+            _put_varint(body, len(value))
+            for item in value:
+                self._value(item)
+        else:
+            body.append(_RECORD_TAG + _RECORDS.index(type(value)))
+            for record_field in fields(value):
+                self._value(getattr(value, record_field.name))
+
+
+class _Reader:
+    """Decodes what _Writer produced"""
+
+    def __init__(self, data: bytes):
+        self.data = data
+        self.position = 0
+
+    def program(self) -> IRProgram:
+        if self.data[:len(IR_MAGIC)] != IR_MAGIC:
+            raise ValueError("Not a serialized IR program")
+        self.position = len(IR_MAGIC)
+        version = self._varint()
+        if version != IR_VERSION:
+            raise ValueError(f"IR version {version} is not supported (expected {IR_VERSION})")
+        self.strings = []
+        for _ in range(self._varint()):
+            length = self._varint()
+            self.strings.append(
+                self.data[self.position:self.position + length].decode("utf-8")
+            )
+            self.position += length
+        program = self._value()
+        if not isinstance(program, IRProgram):
+            raise ValueError("Serialized IR does not hold a program")
+        return program
+
+    def _varint(self) -> int:
+        value = shift = 0
+        while True:
+            byte = self.data[self.position]
+            self.position += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+    def _value(self):
+        tag = self.data[self.position]
+        self.position += 1
+        if tag == _NONE:
+            return None
+        if tag in (_FALSE, _TRUE):
+            return tag == _TRUE
+        if tag == _INT:
+            encoded = self._varint()
+            return (encoded >> 1) ^ -(encoded & 1)
+        if tag == _STRING:
+            return self.strings[self._varint()]
+        if tag == _TUPLE:
+            return tuple(self._value() for _ in range(self._varint()))
+        record = _RECORDS[tag - _RECORD_TAG]
+        return record(*(self._value() for _ in fields(record)))
+
+
+def _put_varint(out: bytearray, value: int):
+    """Append an unsigned LEB128 varint"""
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
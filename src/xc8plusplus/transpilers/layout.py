@@ -0,0 +1,148 @@
+"""
+Struct layout packing for lowered classes
+
+XC8 lays out struct members in declaration order without padding, so the
+only RAM to win back is in members wider than the values they hold: a bool
+takes a whole byte, and so does an enum with three constants. Such members
+can become bit-fields, which XC8 packs into 8-bit storage units (a bit-field
+never straddles two units). Bit-fields are slower to access and their
+address cannot be taken, so the backend only offers members whose address
+never escapes, and a layout is only used when it actually saves bytes.
+"""
+
+from dataclasses import dataclass, field
+from typing import List, Optional, Tuple
+
+STORAGE_UNIT_BITS = 8
+
+
+@dataclass
+class Member:
+    """
+    A struct member considered for packing.
+
+    Attributes:
+        name: Member name
+        declaration: Plain C declaration ("uint8_t count")
+        size: Size in bytes of the plain declaration
+        bits: (bit-field type, width) when the member may be packed
+    """
+
+    name: str
+    declaration: str
+    size: int
+    bits: Optional[Tuple[str, int]] = None
+
+
+@dataclass
+class StructLayout:
+    """
+    Member declarations of a struct and its size before and after packing.
+
+    Attributes:
+        declarations: C member declarations, in emission order
+        size_before: Bytes per instance with the plain declarations
+        size_after: Bytes per instance with this layout
+        packed: Names of the members turned into bit-fields
+    """
+
+    declarations: List[str]
+    size_before: int
+    size_after: int
+    packed: List[str] = field(default_factory=list)
+
+
+def _bit_field(member: Member) -> str:
+    bit_type, width = member.bits
+    return f"{bit_type} {member.name} : {width}"
+
+
+def _next_fit(members: List[Member]) -> List[List[Member]]:
+    """Pack bit-fields into storage units in the given order"""
+    units: List[List[Member]] = []
+    used = STORAGE_UNIT_BITS
+    for member in members:
+        width = member.bits[1]
+        if used + width > STORAGE_UNIT_BITS:
+            units.append([])
+            used = 0
+        units[-1].append(member)
+        used += width
+    return units
+
+
+def _first_fit_decreasing(members: List[Member]) -> List[List[Member]]:
+    """Pack bit-fields into as few storage units as possible"""
+    units: List[List[Member]] = []
+    free: List[int] = []
+    for member in sorted(members, key=lambda m: -m.bits[1]):
+        width = member.bits[1]
+        for index, bits in enumerate(free):
+            if width <= bits:
+                units[index].append(member)
+                free[index] -= width
+                break
+        else:
+            units.append([member])
+            free.append(STORAGE_UNIT_BITS - width)
+    return units
+
+
+def _runs(members: List[Member], reorder: bool) -> List[List[Member]]:
+    """
+    Groups of members laid out together: plain members on their own, and
+    runs of packable ones (all of them at the end when reordering, else
+    each run of adjacent ones in place)
+    """
+    if reorder:
+        runs = [[member] for member in members if not member.bits]
+        packable = [member for member in members if member.bits]
+        return runs + ([packable] if packable else [])
+
+    runs: List[List[Member]] = []
+    for member in members:
+        if member.bits and runs and runs[-1][-1].bits:
+            runs[-1].append(member)
+        else:
+            runs.append([member])
+    return runs
+
+
+def pack_struct(members: List[Member], reorder: bool = True) -> StructLayout:
+    """
+    Plan the layout of a struct.
+
+    Args:
+        members: Members in declaration order
+        reorder: Whether members may move. When False (the struct has
+            positional initializers) only runs of adjacent packable members
+            are merged, so every member keeps its place in the initializer.
+
+    Returns:
+        The packed layout, or the declaration-order layout when packing does
+        not save any byte
+    """
+    size_before = sum(member.size for member in members)
+    pack = _first_fit_decreasing if reorder else _next_fit
+
+    declarations: List[str] = []
+    packed: List[str] = []
+    size_after = 0
+    for run in _runs(members, reorder):
+        run_size = sum(member.size for member in run)
+        units = pack(run) if run[0].bits else []
+        if not units or len(units) >= run_size:
+            # Plain members, and runs that bit-fields would not shrink
+            declarations.extend(member.declaration for member in run)
+            size_after += run_size
+            continue
+        for unit in units:
+            declarations.extend(_bit_field(member) for member in unit)
+            packed.extend(member.name for member in unit)
+        size_after += len(units)
+
+    if size_after >= size_before:
+        return StructLayout(
+            [member.declaration for member in members], size_before, size_before
+        )
+    return StructLayout(declarations, size_before, size_after, packed)
@@ -0,0 +1,146 @@
+"""
+Link step of batch transpilation
+
+Each translation unit of a batch (led.cpp with led.hpp, button.cpp, ...)
+yields the IR of the symbols it defines. Linking merges those per-unit
+programs into one whole-program module, the way a linker resolves object
+files:
+
+- every symbol gets its defining unit; a function or global defined by
+  several units is a multiple definition (the first one is kept);
+- the references of each unit to symbols another unit defines become its
+  imports, resolved to the providing unit;
+- the globals of each struct type are listed, so passes see which types
+  have a single instance in the whole program.
+
+The interprocedural passes then run on the merged module. Once they are
+done, the symbols used only by the unit defining them get internal linkage
+(`static`) when the output is partitioned back per unit.
+"""
+
+from dataclasses import dataclass, field
+from typing import Dict, Iterable, Set, Tuple
+
+from .ir import IRFunction, IRGlobal, IRProgram
+
+# Function kinds that can get internal linkage; the Class_init and
+# Class_cleanup helpers, global_constructors and main keep their prototypes
+INTERNAL_KINDS = ("function", "method")
+
+
+@dataclass
+class LinkedProgram:
+    """
+    Whole-program module built from the IR of each translation unit.
+
+    Attributes:
+        program: Merged program
+        units: Defining unit of each symbol
+        imports: Symbols each unit uses from other units, with their unit
+        duplicates: Functions and globals defined by several units
+        instances: Globals of each struct type
+    """
+
+    program: IRProgram
+    units: Dict[str, str] = field(default_factory=dict)
+    imports: Dict[str, Dict[str, str]] = field(default_factory=dict)
+    duplicates: Dict[str, Tuple[str, ...]] = field(default_factory=dict)
+    instances: Dict[str, Tuple[str, ...]] = field(default_factory=dict)
+
+    def internal_symbols(self, live: Iterable[str], shared: Iterable[str] = ()) -> Set[str]:
+        """
+        Functions, methods and globals only the unit defining them uses.
+
+        Args:
+            live: Symbols the program emits (main, interrupt handlers and
+                symbols never referenced are never internal)
+            shared: Symbols whose definition goes to a header every unit
+                includes (inline functions): their uses count in every unit
+        """
+        live = set(live)
+        shared = set(shared)
+        users: Dict[str, Set[str]] = {}
+        for name, symbol in self.program.symbols().items():
+            if name not in live:
+                continue
+            unit = "*" if name in shared else self.units.get(name, "")
+            statements = (symbol.header,) + tuple(getattr(symbol, "body", ()))
+            for statement in statements:
+                for target in statement.calls + statement.references:
+                    if target != name:
+                        users.setdefault(target, set()).add(unit)
+
+        internal = set()
+        for name, symbol in self.program.symbols().items():
+            if isinstance(symbol, IRFunction):
+                if symbol.kind not in INTERNAL_KINDS or symbol.interrupt or not symbol.body:
+                    continue
+            elif not isinstance(symbol, IRGlobal):
+                continue
+            if name in live and name not in shared and users.get(name) == {symbol.unit}:
+                internal.add(name)
+        return internal
+
+    def format(self) -> str:
+        """Human-readable summary of the link"""
+        imported = sum(len(symbols) for symbols in self.imports.values())
+        # Unit "" holds the symbols of shared headers only (enums)
+        units = [unit for unit in self.imports if unit]
+        lines = [
+            f"Link: {len(units)} units, {len(self.units)} symbols, "
+            f"{imported} cross-unit references"
+        ]
+        for name, defining in sorted(self.duplicates.items()):
+            lines.append(f"  Warning: {name} is defined in {', '.join(defining)}")
+        return "\n".join(lines)
+
+
+def link(units: Dict[str, IRProgram]) -> LinkedProgram:
+    """
+    Merge the IR of each translation unit into a whole-program module.
+
+    Args:
+        units: IR of each unit, by unit name
+
+    Returns:
+        LinkedProgram with the defining unit of each symbol, the imports of
+        each unit, multiple definitions and the instances of each struct
+    """
+    groups = {"structs": [], "enums": [], "globals": [], "functions": []}
+    defined: Dict[str, str] = {}
+    duplicates: Dict[str, Tuple[str, ...]] = {}
+
+    for unit_name, program in units.items():
+        for group, symbols in groups.items():
+            for symbol in getattr(program, group):
+                if symbol.name not in defined:
+                    defined[symbol.name] = unit_name
+                    symbols.append(symbol)
+                elif group in ("globals", "functions"):
+                    # Types come from headers several units include
+                    first = duplicates.get(symbol.name, (defined[symbol.name],))
+                    duplicates[symbol.name] = first + (unit_name,)
+
+    imports: Dict[str, Dict[str, str]] = {}
+    for unit_name, program in units.items():
+        unit_imports = imports.setdefault(unit_name, {})
+        for symbol in program.symbols().values():
+            statements = (symbol.header,) + tuple(getattr(symbol, "body", ()))
+            for statement in statements:
+                for target in statement.calls + statement.references:
+                    provider = defined.get(target)
+                    if provider is not None and provider != unit_name:
+                        unit_imports[target] = provider
+
+    instances: Dict[str, Tuple[str, ...]] = {}
+    for variable in groups["globals"]:
+        if variable.c_type in {struct.name for struct in groups["structs"]}:
+            instances[variable.c_type] = instances.get(variable.c_type, ()) + (variable.name,)
+
+    return LinkedProgram(
+        program=IRProgram(**{group: tuple(symbols) for group, symbols in groups.items()}),
+        units=defined,
+        imports=imports,
+        duplicates=duplicates,
+        instances=instances,
+    )
@@ -0,0 +1,148 @@
+"""
+Function-level lowering memo for the Python backend
+
+Lowering the statements of a method body to C only depends on the body text
+and on the part of the symbol environment the body references (field names,
+methods reachable by bare calls, classes of the objects it calls into). Each
+statement-level lowering is stored under a key made of the body hash and the
+hash of that referenced environment, so editing one method of a large class
+only re-lowers that method's statements.
+
+What is memoized is that intermediate C, not the emitted text: the rewrites
+that depend on whole-program decisions (static members, reference
+arguments, singletons, specialized calls, switch tables, __bit) are applied
+again after every lookup.
+
+The memo is kept in memory and, when a cache directory is given, persisted
+between runs as a single JSON file. Hits and misses count the first lookup
+of each key in a run, so a body lowered several times within one run (for
+the analyses, then for the output) is counted once.
+"""
+
+import hashlib
+import json
+import os
+from pathlib import Path
+from typing import Dict, Optional
+
+# Bump whenever the lowering rules change so stale entries are discarded
+LOWERING_VERSION = 6
+
+MEMO_FILENAME = "lowering_memo.json"
+
+
+def _digest(data: str) -> str:
+    """Short stable hash of a string"""
+    return hashlib.sha256(data.encode("utf-8")).hexdigest()[:32]
+
+
+class LoweringMemo:
+    """Memo of lowered function bodies keyed by body and environment hashes"""
+
+    def __init__(self, cache_dir: Optional[str] = None):
+        """
+        Initialize the memo.
+
+        Args:
+            cache_dir: Directory used to persist the memo between runs
+                (in-memory only when None)
+        """
+        self.cache_dir = cache_dir
+        self.entries: Dict[str, str] = {}
+        self.hits = 0
+        self.misses = 0
+        self._dirty = False
+        # Keys looked up in the current run
+        self._looked_up = set()
+
+        if cache_dir:
+            self._load()
+
+    @property
+    def memo_file(self) -> Optional[Path]:
+        """Path of the persisted memo, if any"""
+        if not self.cache_dir:
+            return None
+        return Path(self.cache_dir) / MEMO_FILENAME
+
+    @staticmethod
+    def make_key(kind: str, body: str, environment) -> str:
+        """
+        Build the memo key of a function.
+
+        Args:
+            kind: Lowering routine the body goes through
+            body: C++ function body
+            environment: JSON-serializable description of the symbols the
+                body references
+
+        Returns:
+            "<body hash>-<environment hash>"
+        """
+        body_hash = _digest(body)
+        env_hash = _digest(
+            json.dumps([LOWERING_VERSION, kind, environment], sort_keys=True)
+        )
+        return f"{body_hash}-{env_hash}"
+
+    def begin_run(self):
+        """Start counting the hits and misses of a new transpilation"""
+        self.hits = 0
+        self.misses = 0
+        self._looked_up = set()
+
+    def lookup(self, key: str) -> Optional[str]:
+        """
+        Return the lowered C for a key, or None on a miss. Only the first
+        lookup of a key in a run counts as a hit or a miss.
+        """
+        lowered = self.entries.get(key)
+        if key not in self._looked_up:
+            self._looked_up.add(key)
+            if lowered is None:
+                self.misses += 1
+            else:
+                self.hits += 1
+        return lowered
+
+    def store(self, key: str, lowered: str):
+        """Record the lowered C for a key"""
+        if self.entries.get(key) != lowered:
+            self.entries[key] = lowered
+            self._dirty = True
+
+    def save(self):
+        """Persist the memo if a cache directory is configured and it changed"""
+        memo_file = self.memo_file
+        if memo_file is None or not self._dirty:
+            return
+
+        try:
+            memo_file.parent.mkdir(parents=True, exist_ok=True)
+            tmp_file = memo_file.with_suffix(".tmp")
+            with open(tmp_file, "w", encoding="utf-8") as f:
+                json.dump(
+                    {"version": LOWERING_VERSION, "entries": self.entries},
+                    f,
+                    sort_keys=True,
+                )
+            os.replace(tmp_file, memo_file)
+            self._dirty = False
+        except OSError as e:
+            print(f"Warning: Could not save lowering memo {memo_file}: {e}")
+
+    def _load(self):
+        """Load a previously persisted memo, ignoring stale or corrupt files"""
+        memo_file = self.memo_file
+        if not memo_file.exists():
+            return
+
+        try:
+            with open(memo_file, "r", encoding="utf-8") as f:
+                data = json.load(f)
+        except (OSError, ValueError) as e:
+            print(f"Warning: Ignoring unreadable lowering memo {memo_file}: {e}")
+            return
+
+        if data.get("version") == LOWERING_VERSION:
+            self.entries = dict(data.get("entries", {}))
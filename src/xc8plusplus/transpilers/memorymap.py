@@ -0,0 +1,292 @@
+"""
+Device data-memory maps and bank placement
+
+The data memory of a mid-range PIC is split into banks of 128 addresses, and
+an instruction only encodes the offset within the selected bank: reaching an
+object in another bank than the last one used costs BANKSEL instructions
+(two BCF/BSF on STATUS on PIC16F87xA, one MOVLB on enhanced parts). A few
+bytes of common RAM are mirrored in every bank and never need a bank switch;
+PIC18 parts have the equivalent access RAM. XC8 places objects without
+knowing which of them are hot, so this pass counts the accesses of each
+global in the lowered code, weighting those inside loops, and places:
+
+- the hottest small objects, and first those shared with an interrupt
+  handler (which cannot assume any bank on entry), in common RAM (`__near`);
+- the others with `__bank(n)`, objects used by the same functions in the
+  same bank so that the code touching them switches bank once.
+"""
+
+import re
+from dataclasses import dataclass, field, replace
+from typing import Dict, Iterable, List, Optional, Tuple
+
+from .callgraph import strip_comments_and_literals
+
+# Weight of an access per enclosing loop level
+LOOP_WEIGHT = 8
+
+# Bytes of bank 0 left to XC8's compiled stack (parameters and autos)
+COMPILED_STACK_RESERVE = 16
+
+AddressRange = Tuple[int, int]
+
+
+@dataclass(frozen=True)
+class MemoryMap:
+    """
+    Data memory of a device.
+
+    Attributes:
+        device: PIC device the map describes
+        banks: General purpose RAM of each bank, as (first, last) address,
+            common RAM excluded
+        common: RAM reachable from every bank without switching (mid-range
+            common RAM, PIC18 access RAM), or None
+        sfrs: Address ranges of the special function registers
+        common_reserved: Common bytes XC8 keeps for itself (interrupt
+            context saving, temporaries)
+    """
+
+    device: str
+    banks: Tuple[AddressRange, ...]
+    common: Optional[AddressRange]
+    sfrs: Tuple[AddressRange, ...]
+    common_reserved: int = 0
+
+    def bank_size(self, bank: int) -> int:
+        """General purpose bytes of a bank"""
+        first, last = self.banks[bank]
+        return last - first + 1
+
+    @property
+    def common_size(self) -> int:
+        """Common bytes available to the program's objects"""
+        if self.common is None:
+            return 0
+        return max(0, self.common[1] - self.common[0] + 1 - self.common_reserved)
+
+    def is_sfr(self, address: int) -> bool:
+        """Check whether an address is a special function register"""
+        return any(first <= address <= last for first, last in self.sfrs)
+
+
+def _midrange_banks(count: int, first: int, last: int) -> Tuple[AddressRange, ...]:
+    """Same general purpose range in each of count 128-address banks"""
+    return tuple((bank * 0x80 + first, bank * 0x80 + last) for bank in range(count))
+
+
+# PIC16F876A/877A (and PIC16F886/887) share the 368-byte layout
+_PIC16F87XA = MemoryMap(
+    device="PIC16F877A",
+    banks=((0x020, 0x06F), (0x0A0, 0x0EF), (0x110, 0x16F), (0x190, 0x1EF)),
+    common=(0x070, 0x07F),
+    sfrs=((0x000, 0x01F), (0x080, 0x09F), (0x100, 0x10F), (0x180, 0x18F)),
+    common_reserved=6,
+)
+
+# PIC16F873A/874A: 192 bytes in banks 0 and 1, which banks 2 and 3 mirror,
+# and no common RAM
+_PIC16F87XA_SMALL = MemoryMap(
+    device="PIC16F874A",
+    banks=((0x020, 0x07F), (0x0A0, 0x0FF)),
+    common=None,
+    sfrs=((0x000, 0x01F), (0x080, 0x09F), (0x100, 0x10F), (0x180, 0x18F)),
+)
+
+# Enhanced mid-range: 80 bytes per bank, shadow registers save the context
+_PIC16F1619 = MemoryMap(
+    device="PIC16F1619",
+    banks=_midrange_banks(12, 0x20, 0x6F) + ((0x620, 0x64F),),
+    common=(0x070, 0x07F),
+    sfrs=_midrange_banks(32, 0x00, 0x1F),
+    common_reserved=2,
+)
+
+# PIC18: 256-byte banks, the low 96 bytes of bank 0 are access RAM
+_PIC18F4550 = MemoryMap(
+    device="PIC18F4550",
+    banks=((0x060, 0x0FF),) + tuple((bank * 0x100, bank * 0x100 + 0xFF) for bank in range(1, 8)),
+    common=(0x000, 0x05F),
+    sfrs=((0xF60, 0xFFF),),
+    common_reserved=16,
+)
+
+MEMORY_MAPS = {
+    "PIC16F873A": _PIC16F87XA_SMALL,
+    "PIC16F874A": _PIC16F87XA_SMALL,
+    "PIC16F876A": _PIC16F87XA,
+    "PIC16F877A": _PIC16F87XA,
+    "PIC16F886": _PIC16F87XA,
+    "PIC16F887": _PIC16F87XA,
+    "PIC16F1619": _PIC16F1619,
+    "PIC18F2455": _PIC18F4550,
+    "PIC18F2550": _PIC18F4550,
+    "PIC18F4455": _PIC18F4550,
+    "PIC18F4550": _PIC18F4550,
+}
+
+
+def device_memory_map(device: str) -> Optional[MemoryMap]:
+    """
+    Data memory map of a PIC device, or None if it is not listed. Members of
+    a family differ in their RAM size, common RAM and mirrored banks, so an
+    unlisted part is not given a guessed map: placing objects in a bank it
+    does not have would alias other data or fail to link.
+    """
+    memory_map = MEMORY_MAPS.get(device.upper())
+    if memory_map is None:
+        return None
+    return replace(memory_map, device=device)
+
+
+_ACCESS_TOKEN = re.compile(r"[A-Za-z_]\w*|[(){};]")
+
+
+def count_accesses(code: str, names: Iterable[str]) -> Dict[str, int]:
+    """
+    Count the static accesses to names in lowered C code. An access inside
+    n nested loops (for, while, do) counts LOOP_WEIGHT ** n.
+    """
+    names = set(names)
+    counts: Dict[str, int] = {}
+    loops: List[bool] = []
+    pending_loop = False
+    parentheses = 0
+    for match in _ACCESS_TOKEN.finditer(strip_comments_and_literals(code)):
+        token = match.group()
+        if token in ("for", "while", "do"):
+            pending_loop = True
+        elif token == "(":
+            parentheses += 1
+        elif token == ")":
+            parentheses -= 1
+        elif token == "{":
+            loops.append(pending_loop)
+            pending_loop = False
+        elif token == "}":
+            if loops:
+                loops.pop()
+        elif token == ";" and parentheses == 0:
+            # End of a braceless loop body or of do { } while (...);
+            pending_loop = False
+        elif token in names:
+            # The condition and a braceless body belong to the loop too
+            depth = sum(loops) + (1 if pending_loop else 0)
+            counts[token] = counts.get(token, 0) + LOOP_WEIGHT ** depth
+    return counts
+
+
+@dataclass
+class PlacedObject:
+    """A global to place, with its size and weighted access count"""
+
+    name: str
+    size: int
+    accesses: int
+    interrupt_shared: bool = False
+
+
+@dataclass
+class Placement:
+    """
+    Result of the bank placement.
+
+    Attributes:
+        memory_map: Map of the target device
+        objects: The objects considered, by name
+        common: Objects placed in common RAM
+        banks: Bank of each object placed in a bank
+    """
+
+    memory_map: MemoryMap
+    objects: Dict[str, PlacedObject] = field(default_factory=dict)
+    common: List[str] = field(default_factory=list)
+    banks: Dict[str, int] = field(default_factory=dict)
+
+    def qualifier(self, name: str) -> str:
+        """XC8 qualifier placing an object: "__near", "__bank(n)" or "" """
+        if name in self.common:
+            return "__near"
+        if name in self.banks:
+            return f"__bank({self.banks[name]})"
+        return ""
+
+    def format(self) -> str:
+        """Human-readable report of the placement"""
+        memory_map = self.memory_map
+        lines = [
+            f"Data placement ({memory_map.device}, {memory_map.common_size} bytes "
+            f"common RAM, {len(memory_map.banks)} banks):"
+        ]
+
+        def describe(names):
+            return ", ".join(
+                f"{name} ({self.objects[name].size} B, {self.objects[name].accesses} accesses)"
+                for name in names
+            )
+
+        if self.common:
+            lines.append(f"  common: {describe(self.common)}")
+        for bank in sorted(set(self.banks.values())):
+            names = [name for name, placed in self.banks.items() if placed == bank]
+            lines.append(f"  bank {bank}: {describe(names)}")
+        left = [name for name in self.objects if not self.qualifier(name)]
+        if left:
+            lines.append(f"  left to XC8: {', '.join(left)}")
+        return "\n".join(lines)
+
+
+def plan_placement(
+    objects: Iterable[PlacedObject],
+    affinity: Dict[Tuple[str, str], int],
+    memory_map: MemoryMap,
+) -> Placement:
+    """
+    Place objects in common RAM and banks.
+
+    Common RAM takes the objects with the most accesses per byte, those
+    shared with an interrupt handler first. The others go, hottest first, to
+    the bank holding the objects they are most used with, or the lowest bank
+    with room; bank 0 keeps COMPILED_STACK_RESERVE bytes for XC8's compiled
+    stack. Objects never accessed, or too large for any bank, are left to
+    XC8.
+
+    Args:
+        objects: Globals to place
+        affinity: Weighted number of accesses shared by two objects in the
+            same functions, keyed by (name, name) in sorted order
+        memory_map: Data memory of the target device
+    """
+    placement = Placement(memory_map, {placed.name: placed for placed in objects})
+    candidates = [placed for placed in placement.objects.values() if placed.accesses > 0]
+
+    free_common = memory_map.common_size
+    by_density = sorted(
+        candidates,
+        key=lambda placed: (placed.interrupt_shared, placed.accesses / max(placed.size, 1)),
+        reverse=True,
+    )
+    for placed in by_density:
+        if placed.size <= free_common:
+            placement.common.append(placed.name)
+            free_common -= placed.size
+
+    free = [memory_map.bank_size(bank) for bank in range(len(memory_map.banks))]
+    free[0] -= COMPILED_STACK_RESERVE
+    remaining = [placed for placed in candidates if placed.name not in placement.common]
+    for placed in sorted(remaining, key=lambda placed: placed.accesses, reverse=True):
+        best = None
+        for bank, room in enumerate(free):
+            if placed.size > room:
+                continue
+            together = sum(
+                affinity.get(tuple(sorted((placed.name, other))), 0)
+                for other, other_bank in placement.banks.items() if other_bank == bank
+            )
+            if best is None or together > best[0]:
+                best = (together, bank)
+        if best is None:
+            continue
+        placement.banks[placed.name] = best[1]
+        free[best[1]] -= placed.size
+    return placement
@@ -60,13 +60,28 @@ def _find_transpiler_library():
     )
 
 
-# Load the library
-try:
-    _lib_path = _find_transpiler_library()
-    _lib = ctypes.CDLL(_lib_path)
-except Exception as e:
-    _lib = None
-    _lib_error = str(e)
+# The library is located and loaded on first use rather than at import time:
+# probing scans several directories plus LD_LIBRARY_PATH and calls
+# ctypes.CDLL, which would slow down every CLI invocation.
+_lib = None
+_lib_error = ""
+_lib_loaded = False
+
+
+def _get_lib():
+    """Load the native library on first use; returns None if unavailable"""
+    global _lib, _lib_error, _lib_loaded
+
+    if not _lib_loaded:
+        _lib_loaded = True
+        try:
+            _lib = ctypes.CDLL(_find_transpiler_library())
+            _configure_library(_lib)
+        except Exception as e:
+            _lib = None
+            _lib_error = str(e)
+
+    return _lib
 
 
 # Define C structures
@@ -94,45 +109,45 @@ class CTranspilerResult(ctypes.Structure):
     ]
 
 
-# Define function signatures if library is available
-if _lib:
+def _configure_library(lib):
+    """Declare the C API function signatures"""
     # xc8_transpiler_create
-    _lib.xc8_transpiler_create.argtypes = [ctypes.POINTER(CTranspilerConfig)]
-    _lib.xc8_transpiler_create.restype = ctypes.c_void_p
+    lib.xc8_transpiler_create.argtypes = [ctypes.POINTER(CTranspilerConfig)]
+    lib.xc8_transpiler_create.restype = ctypes.c_void_p
 
     # xc8_transpiler_destroy
-    _lib.xc8_transpiler_destroy.argtypes = [ctypes.c_void_p]
-    _lib.xc8_transpiler_destroy.restype = None
+    lib.xc8_transpiler_destroy.argtypes = [ctypes.c_void_p]
+    lib.xc8_transpiler_destroy.restype = None
 
     # xc8_transpiler_transpile_string
-    _lib.xc8_transpiler_transpile_string.argtypes = [
+    lib.xc8_transpiler_transpile_string.argtypes = [
         ctypes.c_void_p,
         ctypes.c_char_p,
         ctypes.c_char_p,
         ctypes.POINTER(CTranspilerResult),
     ]
-    _lib.xc8_transpiler_transpile_string.restype = ctypes.c_int
+    lib.xc8_transpiler_transpile_string.restype = ctypes.c_int
 
     # xc8_transpiler_transpile_file
-    _lib.xc8_transpiler_transpile_file.argtypes = [
+    lib.xc8_transpiler_transpile_file.argtypes = [
         ctypes.c_void_p,
         ctypes.c_char_p,
         ctypes.c_char_p,
         ctypes.POINTER(CTranspilerResult),
     ]
-    _lib.xc8_transpiler_transpile_file.restype = ctypes.c_int
+    lib.xc8_transpiler_transpile_file.restype = ctypes.c_int
 
     # xc8_transpiler_result_free
-    _lib.xc8_transpiler_result_free.argtypes = [ctypes.POINTER(CTranspilerResult)]
-    _lib.xc8_transpiler_result_free.restype = None
+    lib.xc8_transpiler_result_free.argtypes = [ctypes.POINTER(CTranspilerResult)]
+    lib.xc8_transpiler_result_free.restype = None
 
     # xc8_transpiler_version
-    _lib.xc8_transpiler_version.argtypes = []
-    _lib.xc8_transpiler_version.restype = ctypes.c_char_p
+    lib.xc8_transpiler_version.argtypes = []
+    lib.xc8_transpiler_version.restype = ctypes.c_char_p
 
     # xc8_transpiler_check_llvm
-    _lib.xc8_transpiler_check_llvm.argtypes = []
-    _lib.xc8_transpiler_check_llvm.restype = ctypes.c_bool
+    lib.xc8_transpiler_check_llvm.argtypes = []
+    lib.xc8_transpiler_check_llvm.restype = ctypes.c_bool
 
 
 class TranspilerConfig:
@@ -170,7 +185,7 @@ class NativeTranspiler:
     """Native C++ transpiler using LLVM LibTooling"""
 
     def __init__(self, config: Optional[TranspilerConfig] = None):
-        if _lib is None:
+        if _get_lib() is None:
             raise RuntimeError(f"Native transpiler library not available: {_lib_error}")
 
         self.config = config or TranspilerConfig()
@@ -312,7 +327,7 @@ class NativeTranspiler:
 
 def get_version() -> str:
     """Get the version of the native transpiler"""
-    if _lib is None:
+    if _get_lib() is None:
         return "Native transpiler not available"
 
     version_bytes = _lib.xc8_transpiler_version()
@@ -321,7 +336,7 @@ def get_version() -> str:
 
 def check_llvm() -> bool:
     """Check if LLVM/Clang is available"""
-    if _lib is None:
+    if _get_lib() is None:
         return False
 
     return _lib.xc8_transpiler_check_llvm()
@@ -329,4 +344,4 @@ def check_llvm() -> bool:
 
 def is_available() -> bool:
     """Check if the native transpiler is available"""
-    return _lib is not None
+    return _get_lib() is not None
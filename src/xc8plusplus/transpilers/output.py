@@ -0,0 +1,70 @@
+"""
+Output helpers for generated files
+
+Generated C sources and headers are only written when their content changes,
+so unchanged outputs keep their modification time and downstream builds (XC8,
+Make, MPLAB X) do not recompile them.
+"""
+
+import contextlib
+import io
+import shutil
+from pathlib import Path
+from typing import Iterator, Union
+
+PathLike = Union[str, Path]
+
+
+def write_if_changed(path: PathLike, content: str) -> bool:
+    """
+    Write text content to a file unless it already holds exactly that content.
+
+    Args:
+        path: Output file path
+        content: Text to write
+
+    Returns:
+        True if the file was written, False if it was left untouched
+    """
+    path = Path(path)
+    data = content.encode("utf-8")
+
+    try:
+        if path.read_bytes() == data:
+            return False
+    except OSError:
+        pass
+
+    path.write_bytes(data)
+    return True
+
+
+@contextlib.contextmanager
+def open_if_changed(path: PathLike) -> Iterator[io.StringIO]:
+    """
+    Context manager collecting text that is written to path on exit, only if
+    it differs from the current file content.
+    """
+    buffer = io.StringIO()
+    yield buffer
+    write_if_changed(path, buffer.getvalue())
+
+
+def copy_if_changed(source: PathLike, destination: PathLike) -> bool:
+    """
+    Copy a file unless the destination already has identical content.
+
+    Returns:
+        True if the file was copied, False if it was left untouched
+    """
+    source = Path(source)
+    destination = Path(destination)
+
+    try:
+        if destination.read_bytes() == source.read_bytes():
+            return False
+    except OSError:
+        pass
+
+    shutil.copy2(source, destination)
+    return True
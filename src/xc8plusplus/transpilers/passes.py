@@ -0,0 +1,182 @@
+"""
+Optimization pass manager
+
+The whole-program optimizations of the python backend run as named passes
+over the lowered program. An optimization level selects the default set,
+like a C compiler's:
+
+- `-O0`: no optimization pass (the generated C follows the C++ one to one);
+- `-Os`: the passes that make the program smaller, inlining and the other
+  cost decisions aimed at size;
+- `-O2`: the same passes with the cost decisions aimed at speed.
+
+Individual passes are switched on or off on top of the level with
+`-fNAME`/`-fno-NAME`. The opt-in passes (struct packing, __bit types, bank
+placement) are off at every level. Each pass run is timed and reports how
+many changes it made, and a bisect limit runs only the first N passes, to
+find the one behind a miscompilation.
+"""
+
+import time
+from dataclasses import dataclass, field
+from typing import Callable, Dict, Iterable, List, Optional, Tuple
+
+OPTIMIZATION_LEVELS = ("0", "s", "2")
+
+# Inlining goal (and the other cost decisions) of each level
+LEVEL_GOALS = {"0": "size", "s": "size", "2": "speed"}
+
+
+@dataclass(frozen=True)
+class PassInfo:
+    """
+    A registered optimization pass.
+
+    Attributes:
+        name: Name used by -fNAME/-fno-NAME
+        description: What the pass does
+        levels: Optimization levels running the pass by default
+    """
+
+    name: str
+    description: str
+    levels: Tuple[str, ...] = ("s", "2")
+
+
+# Passes in pipeline order
+PASSES = (
+    PassInfo("switch-tables", "turn dense dispatch switches into table lookups"),
+    PassInfo("devirtualize", "call virtual methods with a single possible target directly"),
+    PassInfo("tag-dispatch", "dispatch small class hierarchies with a switch on a type tag"),
+    PassInfo("singletons", "drop the self pointer of classes with a single instance"),
+    PassInfo("specialize", "clone methods per value of constant-configured fields"),
+    PassInfo("dce", "remove the functions, globals and types nothing reaches"),
+    PassInfo("inline", "emit small leaf methods as static inline functions"),
+    PassInfo("internalize", "make symbols only their own unit uses static (batch)"),
+    PassInfo("pack-structs", "pack bool and small enum fields into bit-fields", ()),
+    PassInfo("bit-types", "lower eligible booleans to __bit", ()),
+    PassInfo("bank-placement", "place globals in common RAM and banks", ()),
+)
+
+PASS_NAMES = tuple(info.name for info in PASSES)
+
+
+@dataclass
+class PassStats:
+    """Time spent and changes made by a pass, over all its runs"""
+
+    name: str
+    seconds: float = 0.0
+    changes: int = 0
+    runs: int = 0
+
+
+@dataclass
+class PassManager:
+    """
+    Decides which passes run and collects their statistics.
+
+    Attributes:
+        level: Optimization level ("0", "s" or "2")
+        toggles: Pass names to enable ("inline") or disable ("no-inline")
+        bisect_limit: Run only this many passes, skipping the later ones
+            (None runs them all)
+    """
+
+    level: str = "s"
+    toggles: Iterable[str] = ()
+    bisect_limit: Optional[int] = None
+    stats: Dict[str, PassStats] = field(default_factory=dict)
+    started: int = 0
+
+    def __post_init__(self):
+        self.level = str(self.level).upper().lstrip("O").lower()
+        if self.level not in OPTIMIZATION_LEVELS:
+            raise ValueError(
+                f"Invalid optimization level '{self.level}'. Must be one of: "
+                + ", ".join(f"O{level}" for level in OPTIMIZATION_LEVELS)
+            )
+        self.toggles = list(self.toggles)
+        self._overrides = {}
+        for toggle in self.toggles:
+            name = toggle[3:] if toggle.startswith("no-") else toggle
+            if name not in PASS_NAMES:
+                raise ValueError(
+                    f"Unknown optimization pass '{name}'. Must be one of: "
+                    + ", ".join(PASS_NAMES)
+                )
+            self._overrides[name] = not toggle.startswith("no-")
+
+    @property
+    def goal(self) -> str:
+        """Cost goal of the level: "size" or "speed" """
+        return LEVEL_GOALS[self.level]
+
+    def enabled(self, name: str) -> bool:
+        """Check whether a pass is selected by the level and the toggles"""
+        info = next(info for info in PASSES if info.name == name)
+        return self._overrides.get(name, self.level in info.levels)
+
+    def reset(self):
+        """Forget the statistics of a previous program"""
+        self.stats = {}
+        self.started = 0
+
+    def admit(self, name: str) -> bool:
+        """
+        Check whether a pass runs: it is enabled and within the bisect limit.
+        Each admitted or skipped pass counts towards the limit.
+        """
+        if not self.enabled(name):
+            return False
+        self.started += 1
+        if self.bisect_limit is not None and self.started > self.bisect_limit:
+            print(f"Optimization bisect: skipping pass {self.started} ({name})")
+            return False
+        return True
+
+    def run(self, name: str, function: Callable[[], Optional[int]]) -> bool:
+        """
+        Run a pass if it is admitted, timing it and counting its changes.
+
+        Args:
+            name: Registered pass name
+            function: Runs the pass and returns the number of changes made
+
+        Returns:
+            Whether the pass ran
+        """
+        if not self.admit(name):
+            return False
+        start = time.perf_counter()
+        changes = function() or 0
+        self.record(name, time.perf_counter() - start, changes)
+        return True
+
+    def record(self, name: str, seconds: float, changes: int):
+        """Account the work of a pass applied piecewise (per function body)"""
+        stats = self.stats.setdefault(name, PassStats(name))
+        stats.seconds += seconds
+        stats.changes += changes
+        stats.runs += 1
+
+    def metrics(self) -> Dict[str, object]:
+        """Pass statistics for TranspilerResult.metrics"""
+        return {
+            "opt_level": f"O{self.level}",
+            "passes": [
+                {"name": stats.name, "seconds": stats.seconds, "changes": stats.changes}
+                for stats in self.stats.values()
+            ],
+        }
+
+    def format(self) -> List[str]:
+        """Human-readable report of the passes that ran"""
+        lines = [f"Optimization passes (-O{self.level}):"]
+        for stats in self.stats.values():
+            plural = "" if stats.changes == 1 else "s"
+            lines.append(
+                f"  {stats.name}: {stats.changes} change{plural}, "
+                f"{stats.seconds * 1000:.1f} ms"
+            )
+        return lines
@@ -0,0 +1,100 @@
+"""
+Program-memory placement of const data
+
+Data memory is the scarcest resource on PIC (368 bytes on a PIC16F876A)
+while program memory holds kilowords, and XC8 places every const-qualified
+object of static storage in program memory. How such data is read depends on
+the device family: baseline and mid-range parts have no data path to program
+memory, so each byte becomes a RETLW instruction of a table reached through
+a computed goto; enhanced mid-range parts map program memory into the FSR
+address space, one byte per word as well; PIC18 parts read it with TBLRD,
+two bytes per word.
+
+A pointer must say where it may point: XC8 sizes pointers for the memory
+spaces of their targets, and the address of const data cannot be stored in a
+pointer to non-const. The backend therefore keeps const on every lowered
+signature (const methods take `const Class* self`), and const local tables
+are made static so they leave the compiled stack for program memory.
+"""
+
+import re
+from typing import Callable
+
+from .stackdepth import device_family
+from .staticinit import matching_close
+
+# How each device family reads program memory data
+PROGRAM_MEMORY_READS = {
+    "baseline": "RETLW tables",
+    "midrange": "RETLW tables",
+    "enhanced": "FSR (program memory mapped at 0x8000)",
+    "pic18": "TBLRD",
+}
+
+_DIMENSIONS = re.compile(r"\s*(?:\[\d*\]\s*)+$")
+
+# A local const aggregate with a braced initializer ("const uint8_t lut[] = {")
+_CONST_AGGREGATE = re.compile(
+    r"(?<![\w])(?<!static )const\s+[A-Za-z_][\w ]*?\s+\w+\s*(?:\[[^\]]*\]\s*)*=\s*\{"
+)
+
+
+def program_memory_read(device: str) -> str:
+    """How a device reads data placed in program memory"""
+    return PROGRAM_MEMORY_READS[device_family(device)]
+
+
+def program_memory_words(size: int, device: str) -> int:
+    """Program memory words taken by size bytes of const data"""
+    if device_family(device) == "pic18":
+        return (size + 1) // 2
+    return size
+
+
+def is_const_object(c_type: str) -> bool:
+    """
+    Check whether an object of a C type is itself const ("const uint8_t [4]",
+    "const Led", "char * const"), as opposed to a pointer to const
+    ("const char *").
+    """
+    c_type = _DIMENSIONS.sub("", c_type).strip()
+    if "*" in c_type:
+        return re.search(r"\*\s*const\s*$", c_type) is not None
+    return re.search(r"\bconst\b", c_type) is not None
+
+
+def without_const(c_type: str) -> str:
+    """Drop the const qualifier of the object itself, keeping pointee qualifiers"""
+    dimensions = _DIMENSIONS.search(c_type)
+    suffix = dimensions.group(0) if dimensions else ""
+    base = c_type[: len(c_type) - len(suffix)].strip()
+    if "*" in base:
+        base = re.sub(r"\s*\bconst\s*$", "", base)
+    else:
+        base = re.sub(r"\s+", " ", re.sub(r"\bconst\b", "", base)).strip()
+    return base + suffix
+
+
+def static_const_locals(code: str, is_constant: Callable[[str], bool]) -> str:
+    """
+    Make the const local aggregates of a lowered body static, so XC8 places
+    them in program memory instead of building them on the compiled stack.
+
+    Args:
+        code: Lowered C body
+        is_constant: Checks that a braced initializer is constant (a static
+            local cannot be initialized from parameters or other locals)
+    """
+    result = []
+    position = 0
+    for match in _CONST_AGGREGATE.finditer(code):
+        if not re.search(r"(?:^|[;{}])\s*$", code[:match.start()]):
+            continue
+        close = matching_close(code, match.end() - 1)
+        if close < 0 or not is_constant(code[match.end() - 1:close + 1]):
+            continue
+        result.append(code[position:match.start()])
+        result.append("static ")
+        position = match.start()
+    result.append(code[position:])
+    return "".join(result)
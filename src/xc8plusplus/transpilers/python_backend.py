@@ -5,15 +5,92 @@ This module provides a Python-based fallback transpiler that uses Clang AST dump
 to analyze C++ code and generate equivalent C code for XC8 compatibility.
 """
 
+import functools
+import hashlib
+import json
 import os
 import re
 import sys
 import tempfile
+import time
 import subprocess
 import shutil
+from dataclasses import asdict, replace
 from pathlib import Path
 from typing import Dict, List, Optional, Union
 
+from .bits import lower_static_bits, returns_are_boolean, stores_are_boolean
+from .callgraph import CallGraph, scan_symbols, strip_comments_and_literals
+from .c_types import (
+    c_declaration,
+    c_type_size,
+    is_integral_type,
+    map_type,
+    smallest_integer_type,
+    split_ast_type,
+)
+from .depfile import parse_make_dependencies
+from .inliner import InlineCostModel, select_inline_candidates
+from .layout import Member, pack_struct
+from .ir import IR_FILENAME, IRVariable, ProgramBuilder, load_program, parse_parameters
+from .link import link
+from .lowering_memo import LOWERING_VERSION, LoweringMemo
+from .passes import PassManager
+from .memorymap import PlacedObject, count_accesses, device_memory_map, plan_placement
+from .output import open_if_changed, write_if_changed
+from .progmem import (
+    is_const_object,
+    program_memory_read,
+    program_memory_words,
+    static_const_locals,
+    without_const,
+)
+from .references import dereference_parameters, pass_addresses
+from .singletons import bind_instance, drop_instance_argument
+from .specialize import clone_suffix, fold_constant_switches, rename_calls, substitute_field
+from .switches import lower_switches, pin_definitions
+from .stackdepth import (
+    HELPER_CALL_FAMILIES,
+    STACK_CHECKS,
+    analyze_stack,
+    calls_arithmetic_helper,
+    device_family,
+    device_stack_levels,
+)
+from .virtuals import (
+    DISPATCH_ANNOTATIONS,
+    NULL_POINTERS,
+    TAG_DISPATCH_MAX_CLASSES,
+    TAG_FIELD,
+    VPTR_FIELD,
+    ClassHierarchy,
+    cast_object,
+    dispatch_object,
+    is_object_argument,
+    pointer_class,
+    rewrite_calls,
+    tag_switch,
+)
+from .staticinit import (
+    find_constructors,
+    is_constant_expression,
+    is_zero_initializer,
+    matching_close,
+    member_assignment,
+    order_by_dependency,
+    split_arguments,
+    split_statements,
+    strip_comments,
+    substitute_names,
+)
+
+# Single C file a batch is emitted as with amalgamate
+AMALGAMATED_FILENAME = "firmware.c"
+
+# Parameter list of a definition, with parenthesized declarators such as
+# reference-to-array parameters: (const uint8_t (&values)[4])
+PARAMETER_LIST = r"\((?:[^()]|\([^()]*\))*\)"
+
 
 class TranspilerResult:
     """Result of a transpilation operation"""
@@ -24,6 +101,8 @@ class TranspilerResult:
         self.generated_c_code: str = ""
         self.generated_header_code: str = ""
         self.warnings: List[str] = []
+        # Optimization level and per-pass timing and change counts
+        self.metrics: Dict[str, object] = {}
 
 
 class PythonTranspiler:
@@ -42,25 +121,101 @@ class PythonTranspiler:
         target_device: str = "PIC16F876A",
         include_paths: Optional[List[str]] = None,
         defines: Optional[List[str]] = None,
+        cache_dir: Optional[str] = None,
+        inline_model: Optional[InlineCostModel] = None,
+        stack_check: str = "warn",
+        pack_structs: bool = False,
+        bit_types: bool = False,
+        bank_placement: bool = False,
+        opt_level: Optional[str] = None,
+        passes: Optional[List[str]] = None,
+        opt_bisect_limit: Optional[int] = None,
+        amalgamate: bool = False,
     ):
         """
         Initialize the Python transpiler.
 
         Args:
-            enable_optimization: Enable XC8-specific optimizations
+            enable_optimization: Enable XC8-specific optimizations (-Os when
+                opt_level is not given, -O0 when off)
             generate_xc8_pragmas: Generate XC8 configuration pragmas
             preserve_comments: Preserve comments in generated code
             target_device: Target PIC device name
             include_paths: Additional include directories
             defines: Preprocessor definitions
+            cache_dir: Directory for the persistent function lowering memo
+            inline_model: Cost model deciding which methods are emitted as
+                static inline functions (default: the goal of the
+                optimization level, within the stack of the target device)
+            stack_check: What exceeding the device's hardware stack or
+                recursing does: 'warn', 'error' (fail the transpilation) or
+                'off'
+            pack_structs: Pack bool and small enum fields of the lowered
+                structs into bit-fields where that saves RAM
+            bit_types: Lower bool globals, static locals and predicate return
+                values to XC8's __bit where that is safe
+            bank_placement: Place the hottest globals in common RAM (__near)
+                and the others in banks (__bank(n)) by their accesses, using
+                the memory map of the target device
+            opt_level: Optimization level, "0", "s" or "2" (overrides
+                enable_optimization)
+            passes: Passes to enable ("inline") or disable ("no-inline") on
+                top of the level, as -fNAME/-fno-NAME
+            opt_bisect_limit: Run only this many optimization passes, to
+                find the one behind a miscompilation
+            amalgamate: Emit a batch as one self-contained firmware.c
+                instead of a C file per translation unit
         """
+        if stack_check not in STACK_CHECKS:
+            raise ValueError(
+                f"Invalid stack check '{stack_check}'. Must be one of: "
+                + ", ".join(STACK_CHECKS)
+            )
+
+        # Optimization passes: the level and toggles decide, the opt-in passes
+        # also have their own flags
+        if opt_level is None:
+            opt_level = "s" if enable_optimization else "0"
+        toggles = list(passes or []) + [
+            name for name, enabled in (
+                ("pack-structs", pack_structs),
+                ("bit-types", bit_types),
+                ("bank-placement", bank_placement),
+            ) if enabled
+        ]
+        self.pass_manager = PassManager(opt_level, toggles, opt_bisect_limit)
+
         # Configuration
-        self.enable_optimization = enable_optimization
+        self.enable_optimization = self.pass_manager.level != "0"
         self.generate_xc8_pragmas = generate_xc8_pragmas
         self.preserve_comments = preserve_comments
         self.target_device = target_device
         self.include_paths = include_paths or []
         self.defines = defines or []
+        self.cache_dir = cache_dir
+        self.inline_model = inline_model or InlineCostModel(
+            goal=self.pass_manager.goal, stack_budget=device_stack_levels(target_device)
+        )
+        self.stack_check = stack_check
+        self.amalgamate = amalgamate
+        self.pack_structs = self.pass_manager.enabled("pack-structs")
+        self.bit_types = self.pass_manager.enabled("bit-types")
+        self.bank_placement = self.pass_manager.enabled("bank-placement")
+        self.switch_tables = self.pass_manager.enabled("switch-tables")
+        # Set once the analyses are done and the bodies lowered are written
+        self.emitting = False
+
+        # Lowered function bodies, reused when a body and the symbols it
+        # references are unchanged
+        self.lowering_memo = LoweringMemo(cache_dir)
+        # Typed IR of the lowered program the passes run on (linked in batch
+        # mode), and the IR as built or loaded, before linking, which is
+        # what program.xir holds
+        self.program_ir = None
+        self.built_ir = None
+        # Files each analyzed source includes, as written by Clang during
+        # the AST pass: {source: [source, headers...]}
+        self.dependencies: Dict[str, List[str]] = {}
 
         # Analysis state
         self.classes = {}
@@ -69,13 +224,66 @@ class PythonTranspiler:
         self.overloaded_functions = {}
         self.main_function = None
         self.variables = []
-        self.global_variables = []
         self.includes = []
         self.source_code = ""  # Store original source for body extraction
         self.temp_files = []  # Track temporary files for cleanup
         self.source_files = {}  # Track analyzed source files
         self.xc8_stubs_enabled = True  # Enable XC8 stubs by default
         self.all_source_codes = {}  # Store all source files content for body extraction
+        # C symbols reachable from main and the interrupt handlers; None
+        # emits everything (optimizations off, or no entry point to root at)
+        self.live_symbols = None
+        # Deepest call chains and recursion of the last program transpiled
+        self.stack_report = None
+        # Packed member layout of each struct, when pack_structs is on
+        self.struct_layouts = {}
+        # Globals and functions (C names) lowered to __bit, and the names
+        # known to hold 0 or 1, when bit_types is on
+        self.bit_variables = set()
+        self.bit_functions = set()
+        self.boolean_names = set()
+        # Methods (Class_method) emitted as static inline functions in headers
+        self.inlined_methods = set()
+        # Constant initializer of each global evaluated from its constructor,
+        # and the lowered statements left to global_constructors() as
+        # (global, code) in construction order
+        self.static_initializers = {}
+        self.global_constructors = []
+        # Integral compile-time constants emitted as #define (name -> value),
+        # const globals kept in RAM because they need startup code, and the
+        # bytes of const data placed in program memory (name -> size)
+        self.constant_definitions = {}
+        self.ram_constants = set()
+        self.program_memory_data = {}
+        # Common RAM and bank of the globals, when bank_placement is on
+        self.data_placement = None
+        # Classes with a single instance whose methods take no self pointer
+        # (class name -> instance), when optimizations are enabled
+        self.singletons = {}
+        # Whole-program module of a batch, and the symbols only their own
+        # translation unit uses (emitted static)
+        self.linked_program = None
+        self.internal_symbols = set()
+        # Pin macros of the sources (name -> PORTxbits.Rxn), read on first use
+        self.pin_macros = None
+        # Methods cloned for constant-configured instances: Class_method ->
+        # {instance: Class_method__VALUE}, when optimizations are enabled
+        self.specializations = {}
+        # Inheritance of the classes, the C names of the methods callable on
+        # each class of a hierarchy (Class_method -> (class, method)), the
+        # virtual calls with a known target ((class, method) -> class of the
+        # implementation), the roots of the hierarchies dispatching
+        # through vtables and with a switch on a type tag (root -> slots),
+        # and the bodies of the generated dispatch functions (already C)
+        self.hierarchy = ClassHierarchy()
+        self.hierarchy_calls = {}
+        self.devirtualized = {}
+        self.vtables = {}
+        self.tag_dispatch = {}
+        self.dispatch_bodies = set()
+        # Reference parameters lowered to pointers, by C function:
+        # {name: {argument index (self counts): type pointed to}}
+        self.reference_parameters = {}
 
     def transpile_string(
         self, cpp_source: str, filename: str = "input.cpp"
@@ -91,48 +299,47 @@ class PythonTranspiler:
             TranspilerResult with generated C code or error information
         """
         try:
-            # Create a temporary file for the source
-            with tempfile.NamedTemporaryFile(
-                mode="w", suffix=".cpp", delete=False
-            ) as temp_input:
-                temp_input.write(cpp_source)
-                temp_input_path = temp_input.name
-
-            with tempfile.NamedTemporaryFile(
-                mode="w", suffix=".c", delete=False
-            ) as temp_output:
-                temp_output_path = temp_output.name
+            temp_input_path, temp_output_path = self._write_string_to_temp(cpp_source)
 
             try:
                 # Use the existing transpile method
                 success = self.transpile(temp_input_path, temp_output_path)
+                return self._result_from_output(success, temp_output_path)
 
-                result = TranspilerResult()
+            finally:
+                self._remove_temp_files(temp_input_path, temp_output_path)
 
-                if success:
-                    # Read the generated C code
-                    if os.path.exists(temp_output_path):
-                        with open(temp_output_path, "r", encoding="utf-8") as f:
-                            result.generated_c_code = f.read()
+        except Exception as e:
+            result = TranspilerResult()
+            result.success = False
+            result.error_message = f"Python backend error: {str(e)}"
+            return result
 
-                    result.success = True
-                    result.error_message = ""
-                else:
-                    result.success = False
-                    result.error_message = "Python backend transpilation failed"
+    async def transpile_string_async(
+        self, cpp_source: str, filename: str = "input.cpp", semaphore=None
+    ) -> TranspilerResult:
+        """
+        Asynchronous variant of transpile_string().
 
-                return result
+        Args:
+            cpp_source: C++ source code
+            filename: Filename for diagnostics
+            semaphore: Optional asyncio.Semaphore bounding concurrent Clang runs
+
+        Returns:
+            TranspilerResult with generated C code or error information
+        """
+        try:
+            temp_input_path, temp_output_path = self._write_string_to_temp(cpp_source)
+
+            try:
+                success = await self.transpile_async(
+                    temp_input_path, temp_output_path, semaphore
+                )
+                return self._result_from_output(success, temp_output_path)
 
             finally:
-                # Clean up temporary files
-                try:
-                    os.unlink(temp_input_path)
-                except:
-                    pass
-                try:
-                    os.unlink(temp_output_path)
-                except:
-                    pass
+                self._remove_temp_files(temp_input_path, temp_output_path)
 
         except Exception as e:
             result = TranspilerResult()
@@ -156,34 +363,38 @@ class PythonTranspiler:
         try:
             # Generate a temporary output file if none specified
             if output_file is None:
-                import tempfile
-
-                temp_output = tempfile.NamedTemporaryFile(
-                    mode="w", suffix=".c", delete=False
-                )
-                output_file = temp_output.name
-                temp_output.close()
+                output_file = self._temp_output_path()
 
             # Use the existing transpile method
             success = self.transpile(input_file, output_file)
+            return self._result_from_output(success, output_file)
 
+        except Exception as e:
             result = TranspilerResult()
+            result.success = False
+            result.error_message = f"Python backend error: {str(e)}"
+            return result
 
-            if success:
-                # Read the generated C code
-                try:
-                    with open(output_file, "r", encoding="utf-8") as f:
-                        result.generated_c_code = f.read()
-                except Exception as e:
-                    result.generated_c_code = f"// Error reading output file: {e}"
+    async def transpile_file_async(
+        self, input_file: str, output_file: Optional[str] = None, semaphore=None
+    ) -> TranspilerResult:
+        """
+        Asynchronous variant of transpile_file().
 
-                result.success = True
-                result.error_message = ""
-            else:
-                result.success = False
-                result.error_message = "Python backend transpilation failed"
+        Args:
+            input_file: Path to input C++ file
+            output_file: Path to output C file (optional)
+            semaphore: Optional asyncio.Semaphore bounding concurrent Clang runs
 
-            return result
+        Returns:
+            TranspilerResult with generated C code or error information
+        """
+        try:
+            if output_file is None:
+                output_file = self._temp_output_path()
+
+            success = await self.transpile_async(input_file, output_file, semaphore)
+            return self._result_from_output(success, output_file)
 
         except Exception as e:
             result = TranspilerResult()
@@ -191,6 +402,52 @@ class PythonTranspiler:
             result.error_message = f"Python backend error: {str(e)}"
             return result
 
+    def _write_string_to_temp(self, cpp_source):
+        """Write C++ source to a temporary file and reserve a temporary output path"""
+        with tempfile.NamedTemporaryFile(
+            mode="w", suffix=".cpp", delete=False
+        ) as temp_input:
+            temp_input.write(cpp_source)
+            temp_input_path = temp_input.name
+
+        return temp_input_path, self._temp_output_path()
+
+    def _temp_output_path(self):
+        """Reserve a temporary output C file path"""
+        with tempfile.NamedTemporaryFile(
+            mode="w", suffix=".c", delete=False
+        ) as temp_output:
+            return temp_output.name
+
+    def _remove_temp_files(self, *paths):
+        """Remove temporary files, ignoring errors"""
+        for path in paths:
+            try:
+                os.unlink(path)
+            except OSError:
+                pass
+
+    def _result_from_output(self, success, output_file):
+        """Build a TranspilerResult from the transpile() status and output file"""
+        result = TranspilerResult()
+
+        if success:
+            # Read the generated C code
+            try:
+                with open(output_file, "r", encoding="utf-8") as f:
+                    result.generated_c_code = f.read()
+            except Exception as e:
+                result.generated_c_code = f"// Error reading output file: {e}"
+
+            result.success = True
+            result.error_message = ""
+        else:
+            result.success = False
+            result.error_message = "Python backend transpilation failed"
+
+        result.metrics = self.pass_manager.metrics()
+        return result
+
     def transpile(self, input_file, output_file):
         """
         Main transpilation function using Clang AST analysis.
@@ -198,6 +455,53 @@ class PythonTranspiler:
         """
         print(f"XC8 transpilation: {input_file} -> {output_file}")
 
+        # Steps 1-2: Discover and read related files (headers and implementations)
+        related_files = self._load_related_sources(input_file)
+        if related_files is None:
+            return False
+
+        # Step 3: Analyze all files with Clang AST
+        ast_dumps = [self.analyze_with_clang(file_path) for file_path in related_files]
+
+        return self._complete_transpile(output_file, related_files, ast_dumps)
+
+    async def transpile_async(self, input_file, output_file, semaphore=None):
+        """
+        Asynchronous variant of transpile().
+
+        Clang runs through asyncio subprocesses (bounded by ``semaphore`` when
+        given) and code generation runs in the default executor, so the event
+        loop is never blocked.
+        """
+        # asyncio is imported on demand to keep synchronous CLI startup fast
+        import asyncio
+
+        print(f"XC8 transpilation: {input_file} -> {output_file}")
+
+        related_files = self._load_related_sources(input_file)
+        if related_files is None:
+            return False
+
+        ast_dumps = await asyncio.gather(
+            *(
+                self.analyze_with_clang_async(file_path, semaphore)
+                for file_path in related_files
+            )
+        )
+
+        loop = asyncio.get_running_loop()
+        return await loop.run_in_executor(
+            None,
+            functools.partial(
+                self._complete_transpile, output_file, related_files, ast_dumps
+            ),
+        )
+
+    def _load_related_sources(self, input_file):
+        """
+        Discover related files and read them for body extraction.
+        Returns the list of related files, or None if one could not be read.
+        """
         # Step 1: Discover related files (headers and implementations)
         related_files = self._discover_related_files(input_file)
         print(f"Found related files: {related_files}")
@@ -210,33 +514,51 @@ class PythonTranspiler:
                     self.source_files[file_path] = f.read()
             except Exception as e:
                 print(f"Failed to read file {file_path}: {e}")
-                return False
+                return None
 
         # Keep main source for compatibility
-        self.source_code = self.source_files.get(input_file, "")
-        
+        self.source_code = self.source_files.get(str(input_file), "")
+
         # Copy source files to all_source_codes for function body extraction
         self.all_source_codes = self.source_files.copy()
 
-        # Step 3: Analyze all files with Clang AST
-        for file_path in related_files:
-            ast_dump = self.analyze_with_clang(file_path)
+        return related_files
+
+    def _complete_transpile(self, output_file, related_files, ast_dumps):
+        """Parse the AST dumps of related files and generate the C output"""
+        for file_path, ast_dump in zip(related_files, ast_dumps):
             if not ast_dump:
                 print(f"Failed to analyze {file_path} with Clang")
                 continue
-            
+
             # Parse AST semantically for each file
             self.parse_ast_dump(ast_dump, source_file=file_path)
 
         # Step 4: Extract method bodies from implementation files
         self._extract_method_bodies_from_implementations()
+        self._lower_reference_parameters()
+
+        # Drop unreachable code, pick the methods to inline and check the
+        # hardware stack
+        stack_error = self._run_program_passes(
+            self._transpile_method_body,
+            self._transpile_function_body,
+            self._transpile_main_body,
+        )
+        if stack_error:
+            print(f"Error: {stack_error}")
+            return False
+        # Bodies lowered from here on are written out
+        self.emitting = True
 
         # Step 5: Generate C code using semantic information
         self.generate_c_code(output_file)
-        
+
         # Step 6: Generate corresponding header file
         header_file = output_file.replace('.c', '.h')
         self.generate_header_file(header_file)
+        self._save_lowering_memo()
+        self._report_passes()
 
         print("SUCCESS: Transpilation completed!")
         print("Analysis results:")
@@ -264,30 +586,89 @@ class PythonTranspiler:
 
         return True
 
+    def _clang_command(self, cpp_file, dependency_file=None):
+        """
+        Build the Clang command line used for AST analysis. With a
+        dependency_file, Clang also writes the files the source includes
+        there (-MD -MF), as a Make rule.
+        """
+        clang_cmd = [
+            "clang",
+            "-Xclang",
+            "-ast-dump",
+            "-fsyntax-only",
+        ]
+        clang_cmd.extend(self._clang_options())
+        if dependency_file is not None:
+            clang_cmd.extend(["-MD", "-MF", str(dependency_file)])
+
+        # Add the input file
+        clang_cmd.append(str(cpp_file))
+
+        return clang_cmd
+
+    @staticmethod
+    def _dependency_file():
+        """Create the temporary file Clang writes the dependencies of a source to"""
+        handle, path = tempfile.mkstemp(prefix="xc8pp_", suffix=".d")
+        os.close(handle)
+        return Path(path)
+
+    def _record_dependencies(self, cpp_file, dependency_file):
+        """Keep the dependencies Clang wrote for cpp_file, then remove the file"""
+        try:
+            rule = dependency_file.read_text(encoding="utf-8", errors="replace")
+            self.dependencies[str(cpp_file)] = parse_make_dependencies(rule)
+        except OSError:
+            pass
+        finally:
+            dependency_file.unlink(missing_ok=True)
+
+    def _clang_options(self):
+        """Language standard, include paths and defines passed to Clang"""
+        options = ["-std=c++17"]
+
+        # Add include paths
+        for include_path in self.include_paths:
+            options.extend(["-I", include_path])
+
+        # Add defines
+        for define in self.defines:
+            options.append(f"-D{define}")
+
+        return options
+
+    def collect_dependencies(self, cpp_files):
+        """
+        List every C++ source and header the outputs of cpp_files depend on,
+        as resolved by Clang with the configured include paths and defines.
+        They are written by Clang during the AST pass (see _clang_command);
+        a file this transpiler has not analyzed is analyzed first.
+
+        Args:
+            cpp_files: C++ sources (their related headers are included)
+
+        Returns:
+            Dependency paths in a stable order, without duplicates
+        """
+        dependencies = []
+        for cpp_file in cpp_files:
+            for file_path in self._discover_related_files(str(cpp_file)):
+                dependencies.append(file_path)
+                if file_path not in self.dependencies:
+                    self.analyze_with_clang(file_path)
+                dependencies.extend(self.dependencies.get(file_path, []))
+
+        return list(dict.fromkeys(dependencies))
+
     def analyze_with_clang(self, cpp_file):
         """
         Use Clang to get proper AST dump.
         """
+        dependency_file = self._dependency_file()
         try:
             # Use system Clang for AST analysis
-            clang_cmd = [
-                "clang",
-                "-Xclang",
-                "-ast-dump",
-                "-fsyntax-only",
-                "-std=c++17",
-            ]
-            
-            # Add include paths
-            for include_path in self.include_paths:
-                clang_cmd.extend(["-I", include_path])
-            
-            # Add defines
-            for define in self.defines:
-                clang_cmd.append(f"-D{define}")
-            
-            # Add the input file
-            clang_cmd.append(str(cpp_file))
+            clang_cmd = self._clang_command(cpp_file, dependency_file)
 
             result = subprocess.run(clang_cmd, capture_output=True, text=True)
             if result.returncode != 0:
@@ -299,6 +680,43 @@ class PythonTranspiler:
         except Exception as e:
             print(f"Error running Clang analysis: {e}")
             return None
+        finally:
+            self._record_dependencies(cpp_file, dependency_file)
+
+    async def analyze_with_clang_async(self, cpp_file, semaphore=None):
+        """
+        Asynchronous variant of analyze_with_clang() using an asyncio subprocess.
+        The optional semaphore bounds the number of concurrent Clang processes.
+        """
+        if semaphore is None:
+            return await self._run_clang_async(cpp_file)
+
+        async with semaphore:
+            return await self._run_clang_async(cpp_file)
+
+    async def _run_clang_async(self, cpp_file):
+        """Run Clang for one file without blocking the event loop"""
+        import asyncio
+
+        dependency_file = self._dependency_file()
+        try:
+            process = await asyncio.create_subprocess_exec(
+                *self._clang_command(cpp_file, dependency_file),
+                stdout=asyncio.subprocess.PIPE,
+                stderr=asyncio.subprocess.PIPE,
+            )
+            stdout, stderr = await process.communicate()
+            if process.returncode != 0:
+                print(f"Clang analysis failed: {stderr.decode(errors='replace')}")
+                return None
+
+            return stdout.decode(errors="replace")
+
+        except Exception as e:
+            print(f"Error running Clang analysis: {e}")
+            return None
+        finally:
+            self._record_dependencies(cpp_file, dependency_file)
 
     def _discover_related_files(self, input_file):
         """
@@ -349,7 +767,27 @@ class PythonTranspiler:
                             )
                             if body:
                                 method["body"] = body
+                                method["definition_file"] = file_path
                                 break
+                    else:
+                        # Defined in the class (virtual methods usually are)
+                        self._extract_inline_method_body(method, class_name)
+
+    def _extract_inline_method_body(self, method, class_name):
+        """Take the body of a method defined in its class definition"""
+        for file_path, source_code in self.source_files.items():
+            class_match = re.search(
+                rf"\b(?:class|struct)\s+{class_name}\b[^;{{]*\{{", source_code or ""
+            )
+            if not class_match:
+                continue
+            end = matching_close(source_code, class_match.end() - 1)
+            class_body = source_code[class_match.end():end if end > 0 else len(source_code)]
+            body = self._extract_method_from_content(method["name"], class_body)
+            if body:
+                method["body"] = body
+                method["definition_file"] = file_path
+                return
 
     def _extract_method_implementation(self, method_name, class_name, source_code):
         """
@@ -359,11 +797,11 @@ class PythonTranspiler:
         # Pattern for C++ method implementation: ClassName::methodName(params) { body }
         patterns = [
             # Standard pattern: ReturnType ClassName::methodName(params) { ... }
-            rf"\b\w*\s*{class_name}::{method_name}\s*\([^)]*\)\s*(?:const\s*)?\s*\{{",
+            rf"\b\w*\s*{class_name}::{method_name}\s*{PARAMETER_LIST}\s*(?:const\s*)?\s*\{{",
             # Constructor pattern: ClassName::ClassName(params) { ... }
-            rf"\b{class_name}::{method_name}\s*\([^)]*\)\s*(?::\s*[^{{]*?)?\s*\{{",
+            rf"\b{class_name}::{method_name}\s*{PARAMETER_LIST}\s*(?::\s*[^{{]*?)?\s*\{{",
             # Destructor pattern: ClassName::~ClassName() { ... }
-            rf"\b{class_name}::~?{method_name}\s*\([^)]*\)\s*\{{",
+            rf"\b{class_name}::~?{method_name}\s*{PARAMETER_LIST}\s*\{{",
         ]
         
         for pattern in patterns:
@@ -375,6 +813,44 @@ class PythonTranspiler:
         
         return None
 
+    def _lower_reference_parameters(self):
+        """
+        Make the bodies of the functions and methods taking references use
+        the pointers the references are lowered to, and record where their
+        callers pass an address (see references.py)
+        """
+        self.reference_parameters = {}
+        declarations = [(function["name"], function, 0) for function in self.functions]
+        declarations += [
+            (f"{class_name}_{method['name']}", method, 1)
+            for class_name, class_info in self.classes.items()
+            for method in class_info["methods"]
+        ]
+        for name, declaration, offset in declarations:
+            references = []
+            for index, param in enumerate(declaration.get("params") or ()):
+                if "&" not in param["type"] or "(" in param["type"]:
+                    continue
+                c_type = self.map_cpp_type_to_c(param["type"], param.get("canonical_type"))
+                pointee = c_type[:c_type.rindex("*")].strip()
+                self.reference_parameters.setdefault(name, {})[index + offset] = pointee
+                if param["name"]:
+                    references.append(param["name"])
+            if declaration.get("body") and references:
+                declaration["body"] = dereference_parameters(declaration["body"], references)
+
+    def _pass_reference_arguments(self, code):
+        """
+        Pass the address of the arguments of reference parameters in lowered
+        C, also in the calls of inherited methods through a derived class
+        """
+        parameters = dict(self.reference_parameters)
+        for name, (class_name, method) in self.hierarchy_calls.items():
+            owner = f"{self.hierarchy.owner(class_name, method)}_{method}"
+            if owner in self.reference_parameters:
+                parameters.setdefault(name, self.reference_parameters[owner])
+        return pass_addresses(code, parameters, self._is_static_constant)
+
     def _should_ignore_class(self, class_name):
         """
         Determine if a class should be ignored during transpilation.
@@ -457,52 +933,116 @@ class PythonTranspiler:
         lines = ast_dump.split("\n")
         current_class = None
         current_enum_const = None
+        location_file = source_file
+        # Method or function whose ParmVarDecl children are being read
+        param_owner = None
+        param_index = 0
+        # Class whose member declarations are being read (direct children of
+        # a top-level class definition)
+        open_record = None
+        # Class or method a FinalAttr line applies to
+        last_declaration = None
 
         for i, line in enumerate(lines):
+            # Top-level declarations are the direct children of the
+            # translation unit ("|-VarDecl"); deeper ones are locals or members
+            depth = len(line) - len(line.lstrip("|`- "))
+            top_level = depth <= 2
             line = line.strip()
 
-            # Class declarations
-            if "CXXRecordDecl" in line and "class" in line:
-                match = re.search(r"class (\w+)", line)
-                if match:
-                    class_name = match.group(1)
+            # Source file of the declaration on this line
+            decl_file, location_file = self._ast_line_location(line, location_file)
+
+            if top_level and "CXXRecordDecl" not in line:
+                open_record = None
+
+            # Parameters and enumerator values directly follow their declaration
+            if "Decl" in line and "ParmVarDecl" not in line:
+                param_owner = None
+                current_enum_const = None
+
+            # Class declarations, and the named structs of the project (a
+            # struct is a class; the system headers have their own)
+            record = "CXXRecordDecl" in line and re.search(
+                r"\b(class|struct) (?!definition\b)(\w+)", line
+            )
+            if record and (
+                record.group(1) == "class" or top_level and self._is_source_file(decl_file)
+            ):
+                class_name = record.group(2)
+                
+                # Filter out standard library and system classes
+                if self._should_ignore_class(class_name):
+                    current_class = None
+                    continue
                     
-                    # Filter out standard library and system classes
-                    if self._should_ignore_class(class_name):
-                        current_class = None
-                        continue
-                        
-                    # Ignore classes defined in system headers (mock_includes)
-                    if source_file and "mock_includes" in str(source_file):
-                        current_class = None
-                        continue
-                        
-                    current_class = class_name
-                    # Only create if not already exists (avoid overwriting from multiple files)  
-                    if class_name not in self.classes:
-                        self.classes[class_name] = {
-                            "methods": [],
-                            "fields": [],
-                            "constructors": [],
-                            "destructor": None,
-                        }
+                # Ignore classes defined in system headers (mock_includes)
+                if source_file and "mock_includes" in str(source_file):
+                    current_class = None
+                    continue
+                    
+                current_class = class_name
+                if top_level:
+                    open_record = class_name
+                # Only create if not already exists (avoid overwriting from multiple files)  
+                if class_name not in self.classes:
+                    self.classes[class_name] = {
+                        "methods": [],
+                        "fields": [],
+                        "constructors": [],
+                        "destructor": None,
+                        "definition_file": None,
+                    }
+                if "definition" in line and not self.classes[class_name].get("definition_file"):
+                    self.classes[class_name]["definition_file"] = decl_file
+                if top_level:
+                    last_declaration = self.classes[class_name]
+
+            # Base class specifiers of the class definition ("|-public 'Device'")
+            elif current_class and re.match(
+                r"^[|`\-\s]*(?:virtual\s+)?(?:public|protected|private)\b(?:\s+virtual)?\s+'",
+                line,
+            ):
+                base = re.search(r"'(?:class\s+)?(\w+)'", line)
+                class_info = self.classes[current_class]
+                # Single inheritance: further bases are not laid out
+                if base and base.group(1) != current_class and not class_info.get("base"):
+                    class_info["base"] = base.group(1)
+
+            # final on the class or method declared just above
+            elif "FinalAttr" in line:
+                if last_declaration is not None:
+                    last_declaration["final"] = True
+
+            # Dispatch of a hierarchy chosen on its root class:
+            # AnnotateAttr 0x... <col:9, col:41> "xc8::switch_dispatch"
+            elif "AnnotateAttr" in line:
+                annotation = re.search(r'"([^"]*)"', line)
+                if last_declaration is not None and annotation:
+                    strategy = DISPATCH_ANNOTATIONS.get(annotation.group(1))
+                    if strategy:
+                        last_declaration["dispatch"] = strategy
                     
-            # Skip anonymous struct declarations (like PIC register bits)
-            elif "CXXRecordDecl" in line and "struct definition" in line and "class" not in line:
-                # Anonymous struct from system headers - skip entirely
+            # Skip the other structs (like PIC register bits): anonymous or
+            # from system headers
+            elif "CXXRecordDecl" in line and "class" not in line:
                 current_class = None
 
             # Enum declarations (both enum and enum class)
             elif "EnumDecl" in line and "class" in line:
                 # Pattern: EnumDecl 0x... <...> line:18:12 referenced class ButtonId 'int'
+                # (with a fixed underlying type: class LedId 'uint8_t':'unsigned char')
                 match = re.search(r'class (\w+)', line)
                 if match:
                     enum_name = match.group(1)
+                    underlying_type, canonical_type = split_ast_type(line[match.end():])
                     # Only create if not already exists (avoid overwriting from multiple files)
                     if enum_name not in self.enums:
                         self.enums[enum_name] = {
                             "values": [],
-                            "is_class": True
+                            "is_class": True,
+                            "underlying_type": underlying_type or "int",
+                            "canonical_type": canonical_type,
                         }
 
             # Method declarations
@@ -510,26 +1050,40 @@ class PythonTranspiler:
                 match = re.search(r"(\w+) '([^']+)'", line)
                 if match:
                     method_name = match.group(1)
-                    method_type = match.group(2)
+                    method_type, canonical_type = split_ast_type(line[match.start(2) - 1:])
+                    # Clang's markers after the type: "... 'void ()' virtual pure"
+                    markers = line[line.rfind("'") + 1:].split()
                     method_info = {
                         "name": method_name,
                         "type": method_type,
+                        "canonical_type": canonical_type,
+                        # const methods take a pointer to const self
+                        "is_const": bool(re.search(r"\)\s*const\b", method_type or "")),
+                        "is_virtual": "virtual" in markers,
+                        "is_pure": "pure" in markers,
+                        "params": [],
                         "line": line,
                         "body": None,  # Will be filled later in _extract_method_bodies_from_implementations
                         "source_file": source_file,  # Track which file this was found in
                     }
                     # Check if method already exists (avoid duplicates from multiple files)
-                    existing_methods = [m["name"] for m in self.classes[current_class]["methods"]]
-                    if method_name not in existing_methods:
+                    existing_method = next(
+                        (m for m in self.classes[current_class]["methods"] if m["name"] == method_name),
+                        None,
+                    )
+                    if existing_method is None:
                         self.classes[current_class]["methods"].append(method_info)
+                        existing_method = method_info
+                    param_owner = existing_method
+                    last_declaration = existing_method
+                    param_index = 0
 
             # Field declarations
             elif "FieldDecl" in line and current_class:
-                # Pattern: FieldDecl 0x... <...> col:14 buttonId 'ButtonId'
-                match = re.search(r'col:\d+ (\w+) \'([^\']+)\'', line)
-                if match:
-                    field_name = match.group(1)
-                    field_type = match.group(2)
+                # Pattern: FieldDecl 0x... <...> col:14 referenced buttonId 'ButtonId'
+                declaration = self._parse_named_declaration(line)
+                if declaration:
+                    field_name, field_type, canonical_type = declaration
                     
                     # Filter out system/register fields that don't belong to user classes
                     if self._should_ignore_field(field_name, field_type, line):
@@ -539,43 +1093,129 @@ class PythonTranspiler:
                     existing_fields = [f["name"] for f in self.classes[current_class]["fields"]]
                     if field_name not in existing_fields:
                         self.classes[current_class]["fields"].append(
-                            {"name": field_name, "type": field_type}
+                            {
+                                "name": field_name,
+                                "type": field_type,
+                                "canonical_type": canonical_type,
+                                "mutable": bool(re.search(r"\bmutable\s+\w+\s+'", line)),
+                            }
                         )
 
             # Enum constant declarations
             elif "EnumConstantDecl" in line:
-                # Pattern: EnumConstantDecl 0x... <...> col:5 PB_0 'ButtonId'
-                match = re.search(r'col:\d+ (\w+) \'(\w+)\'', line)
-                if match:
-                    const_name = match.group(1)
-                    enum_type = match.group(2)
-                    current_enum_const = {"name": const_name, "type": enum_type, "value": "0"}
+                # Pattern: EnumConstantDecl 0x... <...> col:5 referenced PB_0 'ButtonId'
+                declaration = self._parse_named_declaration(line)
+                current_enum_const = None
+                if declaration and declaration[1] in self.enums:
+                    const_name, enum_type, _ = declaration
+                    values = self.enums[enum_type]["values"]
+                    # Check if value already exists (avoid duplicates from multiple files)
+                    if const_name not in [v["name"] for v in values]:
+                        # Implicit value: previous enumerator + 1, replaced by
+                        # the "value: Int" child when the AST carries one
+                        previous = int(values[-1]["value"]) if values else -1
+                        current_enum_const = {"name": const_name, "value": str(previous + 1)}
+                        values.append(current_enum_const)
                     
             # Look for enum constant values in subsequent lines
             elif current_enum_const and "value: Int" in line:
-                value_match = re.search(r'value: Int (\d+)', line)
+                value_match = re.search(r'value: Int (-?\d+)', line)
                 if value_match:
                     current_enum_const["value"] = value_match.group(1)
-                    
-                    # Add to the correct enum
-                    enum_type = current_enum_const["type"]
-                    if enum_type in self.enums:
-                        # Check if value already exists (avoid duplicates from multiple files)
-                        existing_values = [v["name"] for v in self.enums[enum_type]["values"]]
-                        if current_enum_const["name"] not in existing_values:
-                            self.enums[enum_type]["values"].append({
-                                "name": current_enum_const["name"],
-                                "value": current_enum_const["value"]
-                            })
                     current_enum_const = None
 
             # Function declarations (including main)
             elif "FunctionDecl" in line:
-                self._parse_function_declaration(line)
+                param_owner = self._parse_function_declaration(line)
+                param_index = 0
+
+            # Parameters of the current method or function
+            elif "ParmVarDecl" in line:
+                if param_owner is not None:
+                    self._record_parameter(param_owner, param_index, line)
+                    param_index += 1
             
             # Global variable declarations
             elif "VarDecl" in line and "0x" in line:  # Global scope variables
-                self._parse_global_variable_declaration(line)
+                # An extern declaration defines nothing: the unit defining
+                # the global emits it. Static data members are globals too.
+                static_member_of = None
+                if open_record and depth == 4 and re.search(r"'\s+static\b", line):
+                    static_member_of = open_record
+                self._parse_global_variable_declaration(
+                    line,
+                    decl_file,
+                    (top_level or static_member_of is not None)
+                    and not re.search(r"'\s+extern\b", line),
+                    static_member_of,
+                )
+
+    def _is_source_file(self, path):
+        """Check whether a file is one of the sources transpiled (not a system header)"""
+        if not path:
+            return False
+        sources = {str(Path(source).resolve()) for source in self.source_files}
+        return str(Path(path).resolve()) in sources
+
+    def _parse_named_declaration(self, line):
+        """
+        Parse the name and type of a declaration line, skipping Clang's
+        markers ("col:11 referenced ledId 'LedId'").
+
+        Returns:
+            (name, spelled type, canonical type or None), or None
+        """
+        match = re.search(
+            r"(?:col:\d+|line:\d+:\d+|\S+:\d+:\d+)\s+"
+            r"(?:(?:referenced|used|implicit|invalid|constexpr|mutable)\s+)*"
+            r"(\w+)\s+('[^']*'(?::'[^']*')?)",
+            line,
+        )
+        if not match:
+            return None
+        spelled, canonical = split_ast_type(match.group(2))
+        return match.group(1), spelled, canonical
+
+    def _record_parameter(self, owner, index, line):
+        """
+        Record a ParmVarDecl of a method or function. A declaration seen again
+        (e.g. the out-of-line definition) only fills in missing names.
+        """
+        declaration = self._parse_named_declaration(line)
+        if declaration:
+            name, param_type, canonical_type = declaration
+        else:
+            # Unnamed parameter: ParmVarDecl 0x... <col:19> col:23 'bool'
+            name = None
+            param_type, canonical_type = split_ast_type(line)
+
+        params = owner.setdefault("params", [])
+        if index < len(params):
+            if not params[index]["name"]:
+                params[index]["name"] = name
+        else:
+            params.append(
+                {"name": name, "type": param_type, "canonical_type": canonical_type}
+            )
+
+    def _ast_line_location(self, line, location_file):
+        """
+        Resolve the source file of an AST dump line.
+
+        Clang only prints a file name when it differs from the previously
+        printed location ("<line:12:3, col:9>" otherwise), so the last seen
+        file is carried from line to line.
+
+        Returns:
+            (file of the declaration on this line, last seen file)
+        """
+        decl_file = None
+        for match in re.finditer(r"([^\s<>,']+):\d+:\d+", line):
+            if match.group(1) not in ("line", "col"):
+                location_file = match.group(1)
+            if decl_file is None:
+                decl_file = location_file
+        return decl_file or location_file, location_file
 
     def _extract_method_body_from_source(self, method_name, class_name):
         """Extract method body from the original source code"""
@@ -612,7 +1252,9 @@ class PythonTranspiler:
 
     def _extract_method_from_content(self, method_name, content):
         """Extract method body from content"""
-        method_pattern = rf"\b{method_name}\s*\([^)]*\)\s*(?:const\s*)?\s*\{{"
+        method_pattern = (
+            rf"\b{method_name}\s*{PARAMETER_LIST}\s*(?:const\s*)?(?:(?:override|final)\s*)*\{{"
+        )
         method_match = re.search(method_pattern, content)
         if not method_match:
             return None
@@ -644,64 +1286,117 @@ class PythonTranspiler:
         return body if body else None
 
     def _parse_function_declaration(self, line):
-        """Parse function declarations from AST dump"""
+        """
+        Parse function declarations from AST dump.
+        Returns the function record parameters are attached to.
+        """
         match = re.search(r"(\w+) '([^']+)'", line)
         if match:
             func_name = match.group(1)
-            func_type = match.group(2)
+            func_type, canonical_type = split_ast_type(line[match.start(2) - 1:])
+
+            body, definition_file = self._find_function_definition(func_name)
 
             if func_name == "main":
                 self.main_function = {
                     "name": func_name,
                     "type": func_type,
+                    "canonical_type": canonical_type,
+                    "params": [],
                     "line": line,
-                    "body": self._extract_function_body_from_source(func_name),
+                    "body": body,
+                    "definition_file": definition_file,
                 }
+                return self.main_function
             else:
                 # Parse all other functions (setup, loop, etc.)
                 function_info = {
                     "name": func_name,
                     "type": func_type,
+                    "canonical_type": canonical_type,
+                    "params": [],
                     "line": line,
-                    "body": self._extract_function_body_from_source(func_name),
+                    "body": body,
+                    "definition_file": definition_file,
+                    "is_interrupt": self._is_interrupt_handler(func_name),
                 }
                 # Check if function already exists (avoid duplicates from multiple files)
                 existing_func = next((f for f in self.functions if f["name"] == func_name), None)
                 if not existing_func:
                     self.functions.append(function_info)
+                    return function_info
+                return existing_func
+        return None
+
+    def _is_interrupt_handler(self, func_name):
+        """
+        Check whether a function is an XC8 interrupt service routine
+        (void __interrupt() isr(void), or the older void interrupt isr(void))
+        """
+        pattern = rf"\b(?:__interrupt|interrupt)\b[^;{{}}]*\b{re.escape(func_name)}\s*\("
+        return any(
+            content and re.search(pattern, content)
+            for content in self.all_source_codes.values()
+        )
 
-    def _parse_global_variable_declaration(self, line):
-        """Parse global variable declarations from AST dump"""
+    def _parse_global_variable_declaration(
+        self, line, source_file=None, is_global=True, static_member_of=None
+    ):
+        """
+        Parse variable declarations from AST dump. Locals are recorded too
+        (the lowering looks up the class of objects by name) but only
+        globals are emitted. Static data members (static_member_of: their
+        class) are emitted as globals under their own name, the name method
+        bodies use once lowered.
+        """
         # Example: VarDecl 0x1234567890 <line:21:1, col:8> col:8 timer 'Timer0'
         # Example: VarDecl 0x1234567890 <line:22:1, col:25> col:5 led0 'Led' cinit
-        var_match = re.search(r"VarDecl.*?(\w+)\s+'([^']+)'", line)
+        var_match = re.search(r"VarDecl.*?(\w+)\s+'([^']+)'(?::'([^']+)')?", line)
         if var_match:
             var_name = var_match.group(1)
             var_type = var_match.group(2)
+            canonical_type = var_match.group(3)
             
             # Skip system/library variables (from headers like xc.h)
             if self._is_system_variable(var_name, var_type):
                 return
+            if source_file and "mock_includes" in str(source_file):
+                return
             
             # Extract initialization if present (for constructor calls)
             init_match = re.search(r"cinit", line)
             has_constructor = init_match is not None
             
-            # Extract constructor arguments from source if available
-            constructor_args = self._extract_constructor_args(var_name, var_type)
+            # Initializer as written in the source (constructor arguments or
+            # the expression after "=")
+            initializer = None
+            if is_global:
+                initializer = self._extract_initializer(var_name, var_type, source_file)
             
             variable_info = {
                 "name": var_name,
                 "type": var_type,
+                "canonical_type": canonical_type,
                 "has_constructor": has_constructor,
-                "constructor_args": constructor_args,
-                "line": line
+                "initializer": initializer,
+                "is_global": is_global,
+                "static_member_of": static_member_of,
+                "line": line,
+                "source_file": source_file,
             }
             
-            # Check if variable already exists (avoid duplicates from multiple files)
+            # Check if variable already exists (avoid duplicates from multiple
+            # files); a global wins over a local of the same name
             existing_var = next((v for v in self.variables if v["name"] == var_name), None)
             if not existing_var:
                 self.variables.append(variable_info)
+            elif is_global and not existing_var.get("is_global"):
+                self.variables.remove(existing_var)
+                self.variables.append(variable_info)
+            elif existing_var.get("static_member_of") and initializer and not existing_var.get("initializer"):
+                # Out-of-class definition of a static member
+                existing_var["initializer"] = initializer
+                existing_var["source_file"] = source_file
 
     def _is_system_variable(self, var_name, var_type):
         """Check if a variable is from system headers and should be ignored"""
@@ -724,8 +1419,8 @@ class PythonTranspiler:
         if var_type in system_types or 'unnamed struct' in var_type:
             return True
             
-        # Skip constants and references
-        if 'const' in var_type or '&' in var_type:
+        # Skip references
+        if '&' in var_type:
             return True
             
         # Skip single-character or numeric variable names (likely temporaries)
@@ -734,50 +1429,96 @@ class PythonTranspiler:
             
         return False
 
-    def _extract_constructor_args(self, var_name, var_type):
-        """Extract constructor arguments from source code"""
-        for file_path, content in self.all_source_codes.items():
-            if content:
-                # Look for variable declaration with constructor
-                # Example: Led led0(LedId::LED_0);
-                var_pattern = rf"\b{var_type}\s+{var_name}\s*\(([^)]*)\)"
-                var_match = re.search(var_pattern, content)
-                if var_match:
-                    args_str = var_match.group(1).strip()
-                    if args_str:
-                        # Clean up enum scope (LedId::LED_0 -> LED_0)
-                        args_str = re.sub(r'\w+::', '', args_str)
-                        return args_str
+    def _extract_initializer(self, var_name, var_type, source_file=None):
+        """
+        Find the initializer of a global in the source.
+
+        Returns:
+            (form, text): form is "call" for `T name(args)`, "list" for
+            `T name{args}` and "assign" for `T name = expr`, text the C++
+            between the parentheses/braces or after "=". None when the
+            declaration has no initializer or is not found.
+        """
+        type_name = [
+            word for word in re.findall(r"\w+", re.sub(r"\[[^\]]*\]", "", var_type))
+            if word not in ("const", "volatile")
+        ]
+        if not type_name:
+            return None
+        # Out-of-class static member definitions qualify the name (Font::glyphs)
+        declaration = re.compile(
+            rf"(?:^|[;{{}}])\s*(?:[\w:<>]+\s+)*?\b{re.escape(type_name[-1])}\b[\s*&]*"
+            rf"(?:const\s+)?(?:\w+::)?\b{re.escape(var_name)}\s*(?:\[[^\]]*\]\s*)*([(={{;])",
+            re.MULTILINE,
+        )
+
+        # The file the declaration comes from first
+        source_name = Path(source_file).name if source_file else None
+        files = sorted(
+            self.all_source_codes.items(), key=lambda item: Path(item[0]).name != source_name
+        )
+        for _, content in files:
+            if not content:
+                continue
+            content = strip_comments(content)
+            match = declaration.search(content)
+            if not match:
+                continue
+            start = match.start(1)
+            opener = match.group(1)
+            if opener == ";":
+                return None
+            if opener == "=":
+                end = start + 1
+                depth = 0
+                while end < len(content) and not (content[end] == ";" and depth == 0):
+                    if content[end] in "([{":
+                        depth += 1
+                    elif content[end] in ")]}":
+                        depth -= 1
+                    end += 1
+                return "assign", content[start + 1:end].strip()
+            close = matching_close(content, start)
+            if close < 0:
+                return None
+            return ("call" if opener == "(" else "list"), content[start + 1:close].strip()
         return None
 
     def _extract_function_body_from_source(self, func_name):
         """Extract function body from the original source code"""
+        return self._find_function_definition(func_name)[0]
+
+    def _find_function_definition(self, func_name):
+        """
+        Find a function definition in the original source code.
+        Returns (body, file path of the definition), with None for unknowns.
+        """
+        func_pattern = rf"\b{func_name}\s*{PARAMETER_LIST}\s*\{{"
+
         # First try current source_code
         if self.source_code:
-            func_pattern = rf"\b{func_name}\s*\([^)]*\)\s*\{{"
             func_match = re.search(func_pattern, self.source_code)
             if func_match:
                 return self._extract_method_from_content_at_position(
                     self.source_code, func_match.end() - 1
-                )
+                ), None
         
         # If not found, search through all source files
         for file_path, content in self.all_source_codes.items():
             if content:
-                func_pattern = rf"\b{func_name}\s*\([^)]*\)\s*\{{"
                 func_match = re.search(func_pattern, content)
                 if func_match:
                     return self._extract_method_from_content_at_position(
                         content, func_match.end() - 1
-                    )
+                    ), file_path
         
-        return None
+        return None, None
 
     def generate_c_code(self, output_file):
         """
         Generate C code using semantic analysis.
         """
-        with open(output_file, "w", encoding="utf-8") as f:
+        with open_if_changed(output_file) as f:
             f.write("/*\n")
             f.write(" * XC8 C++ to C Transpilation\n")
             f.write(" * Generated using semantic AST analysis\n")
@@ -791,16 +1532,14 @@ class PythonTranspiler:
             f.write("#include <stddef.h>\n\n")
 
             # Generate C enums from C++ enum classes
-            for enum_name, enum_info in self.enums.items():
+            for enum_name, enum_info in self._live_enums():
                 f.write(f"// === Enum {enum_name} ===\n")
-                f.write(f"typedef enum {{\n")
-                for enum_value in enum_info["values"]:
-                    f.write(f"    {enum_value['name']} = {enum_value['value']},\n")
-                f.write(f"}} {enum_name};\n\n")
+                f.write(self._c_enum_definition(enum_name, enum_info))
 
-            # Add common constants
-            f.write("// === Constants ===\n")
-            f.write("#define DEBOUNCE_THRESHOLD 5\n\n")
+            constants = self._c_constant_definitions()
+            if constants:
+                f.write("// === Constants ===\n")
+                f.write(constants + "\n")
 
             # Add hardware pin definitions if not already included
             f.write("// === Hardware Pin Definitions ===\n")
@@ -817,55 +1556,71 @@ class PythonTranspiler:
             f.write("#endif\n\n")
 
             # First generate all struct definitions
-            for class_name, class_info in self.classes.items():
+            for class_name, class_info in self._live_classes():
                 f.write(f"// === Class {class_name} transformed to C ===\n\n")
                 f.write(f"typedef struct {class_name} {{\n")
-                for field in class_info["fields"]:
-                    c_type = self.map_cpp_type_to_c(field["type"])
-                    f.write(f"    {c_type} {field['name']};\n")
+                for member in self._c_struct_members(class_name):
+                    f.write(f"    {member};\n")
                 f.write(f"}} {class_name};\n\n")
 
+            # Vtables are defined with the methods, globals may point to them
+            f.write(self._c_dispatch_types())
+            live_vtables = self._live_vtables()
+            for class_name in live_vtables:
+                f.write(f"extern {self._c_vtable_declaration(class_name)};\n")
+            if live_vtables:
+                f.write("\n")
+
+            # Generate global variables (singleton methods use them directly)
+            live_variables = self._live_variables()
+            if live_variables:
+                f.write("// === Global Variables ===\n\n")
+                for variable in live_variables:
+                    self._generate_global_variable(f, variable)
+                f.write("\n")
+
             # Generate forward declarations for all methods AFTER struct definitions
             f.write("// === Forward Declarations ===\n")
-            for class_name, class_info in self.classes.items():
-                for method in class_info["methods"]:
-                    return_type = self.extract_return_type(method["type"])
-                    c_return_type = self.map_cpp_type_to_c(return_type)
-                    params = self._extract_method_parameters(method["type"])
-                    param_list = f"{class_name}* self"
-                    if params:
-                        param_list += f", {params}"
-                    f.write(f"{c_return_type} {class_name}_{method['name']}({param_list});\n")
+            for class_name, class_info in self._live_classes():
+                for method in self._live_methods(class_name):
+                    if self._is_inlined(class_name, method):
+                        body = self._transpile_method_body(method["body"], class_name)
+                        f.write(self._c_inline_definition(class_name, method, body))
+                        continue
+                    prototype = self._c_prototype(
+                        method, f"{class_name}_{method['name']}", class_name
+                    )
+                    f.write(f"{prototype};\n")
             f.write("\n")
 
+            if live_vtables:
+                f.write("// === Virtual Tables ===\n\n")
+                for class_name in live_vtables:
+                    f.write(self._c_vtable_definition(class_name))
+
             # Generate implementations
-            for class_name, class_info in self.classes.items():
+            for class_name, class_info in self._live_classes():
                 # Generate constructor function
-                f.write(f"// Constructor for {class_name}\n")
-                f.write(f"void {class_name}_init({class_name}* self) {{\n")
-                f.write(f"    // Initialize {class_name} instance\n")
-                for field in class_info["fields"]:
-                    if field["type"] == "bool":
-                        f.write(f"    self->{field['name']} = false;\n")
-                    elif "int" in field["type"]:
-                        f.write(f"    self->{field['name']} = 0;\n")
-                f.write("}\n\n")
-
-                # Generate method functions
-                for method in class_info["methods"]:
+                if self._is_live(f"{class_name}_init"):
+                    f.write(f"// Constructor for {class_name}\n")
+                    f.write(f"void {class_name}_init({class_name}* self) {{\n")
+                    f.write(f"    // Initialize {class_name} instance\n")
+                    for field in class_info["fields"]:
+                        initializer = self._field_initial_value(class_name, field)
+                        if initializer:
+                            f.write(f"    self->{field['name']} = {initializer};\n")
+                    f.write("}\n\n")
+
+                # Generate method functions (inlined ones are defined above)
+                for method in self._live_methods(class_name):
+                    if self._is_inlined(class_name, method):
+                        continue
                     f.write(f"// Method: {method['name']}\n")
-                    return_type = self.extract_return_type(method["type"])
-                    c_return_type = self.map_cpp_type_to_c(return_type)
-                    
-                    # Extract parameters from method signature
-                    params = self._extract_method_parameters(method["type"])
-                    param_list = f"{class_name}* self"
-                    if params:
-                        param_list += f", {params}"
-
-                    f.write(
-                        f"{c_return_type} {class_name}_{method['name']}({param_list}) {{\n"
+                    c_return_type = self._return_c_type(method)
+                    prototype = self._c_prototype(
+                        method, f"{class_name}_{method['name']}", class_name
                     )
+                    f.write(f"{prototype} {{\n")
 
                     # Generate method body from extracted C++ code
                     if method.get("body"):
@@ -884,22 +1639,23 @@ class PythonTranspiler:
                     f.write("}\n\n")
 
                 # Generate destructor function
-                f.write(f"// Destructor for {class_name}\n")
-                f.write(f"void {class_name}_cleanup({class_name}* self) {{\n")
-                f.write(f"    // Cleanup {class_name} instance\n")
-                f.write("}\n\n")
+                if self._is_live(f"{class_name}_cleanup"):
+                    f.write(f"// Destructor for {class_name}\n")
+                    f.write(f"void {class_name}_cleanup({class_name}* self) {{\n")
+                    f.write(f"    // Cleanup {class_name} instance\n")
+                    f.write("}\n\n")
 
-            # Generate global variables
-            if self.variables:
-                f.write("// === Global Variables ===\n\n")
-                for variable in self.variables:
-                    self._generate_global_variable(f, variable)
-                f.write("\n")
+            # Dynamic part of the global constructors, run first by main
+            global_constructors = self._c_global_constructors()
+            if global_constructors:
+                f.write("// === Global Constructors ===\n\n")
+                f.write(global_constructors)
 
             # Generate standalone functions (setup, loop, etc.)
-            if self.functions:
+            live_functions = self._live_functions()
+            if live_functions:
                 f.write("// === Standalone Functions ===\n\n")
-                for function in self.functions:
+                for function in live_functions:
                     self._generate_function(f, function)
 
             # Generate main function if present
@@ -909,7 +1665,7 @@ class PythonTranspiler:
 
     def generate_header_file(self, header_file):
         """Generate C header file with declarations"""
-        with open(header_file, "w", encoding="utf-8") as f:
+        with open_if_changed(header_file) as f:
             # Header guard
             guard_name = Path(header_file).stem.upper() + "_H"
             f.write(f"#ifndef {guard_name}\n")
@@ -929,67 +1685,67 @@ class PythonTranspiler:
 
             # Generate C enums from C++ enum classes
             if self.enums:
-                for enum_name, enum_info in self.enums.items():
+                for enum_name, enum_info in self._live_enums():
                     f.write(f"// === Enum {enum_name} ===\n")
-                    f.write("typedef enum {\n")
-                    for value in enum_info["values"]:
-                        f.write(f"    {value['name']} = {value['value']},\n")
-                    f.write(f"}} {enum_name};\n\n")
+                    f.write(self._c_enum_definition(enum_name, enum_info))
 
             # Generate constants
-            f.write("// === Constants ===\n")
-            f.write("#define DEBOUNCE_THRESHOLD 5\n\n")
+            constants = self._c_constant_definitions()
+            if constants:
+                f.write("// === Constants ===\n")
+                f.write(constants + "\n")
 
             # Generate struct definitions
             if self.classes:
-                for class_name, class_info in self.classes.items():
+                for class_name, class_info in self._live_classes():
                     f.write(f"// === {class_name} Structure ===\n")
                     f.write(f"typedef struct {class_name} {{\n")
-                    for field in class_info["fields"]:
-                        c_type = self.map_cpp_type_to_c(field["type"])
-                        f.write(f"    {c_type} {field['name']};\n")
+                    for member in self._c_struct_members(class_name):
+                        f.write(f"    {member};\n")
                     f.write(f"}} {class_name};\n\n")
 
+            # Generate global variable declarations
+            live_variables = self._live_variables()
+            if live_variables:
+                f.write("// === Global Variable Declarations ===\n")
+                user_vars = [v for v in live_variables if not self._is_system_parameter(v["name"])]
+                for variable in user_vars:
+                    f.write(f"extern {self._c_variable_declaration(variable)};\n")
+                f.write("\n")
+
             # Generate function declarations
             if self.classes:
                 f.write("// === Function Declarations ===\n")
-                for class_name, class_info in self.classes.items():
+                for class_name, class_info in self._live_classes():
                     # Constructor
-                    f.write(f"void {class_name}_init({class_name}* self);\n")
+                    if self._is_live(f"{class_name}_init"):
+                        f.write(f"void {class_name}_init({class_name}* self);\n")
                     
                     # Methods
-                    for method in class_info["methods"]:
-                        return_type = self.extract_return_type(method["type"])
-                        c_return_type = self.map_cpp_type_to_c(return_type)
-                        params = self._extract_method_parameters(method["type"])
-                        c_params = self._convert_parameters_to_c(params, class_name)
-                        f.write(f"{c_return_type} {class_name}_{method['name']}({c_params});\n")
+                    for method in self._live_methods(class_name):
+                        if self._is_inlined(class_name, method):
+                            body = self._transpile_method_body(method["body"], class_name)
+                            f.write(self._c_inline_definition(class_name, method, body))
+                            continue
+                        prototype = self._c_prototype(
+                            method, f"{class_name}_{method['name']}", class_name
+                        )
+                        f.write(f"{prototype};\n")
                     
                     # Destructor
-                    f.write(f"void {class_name}_cleanup({class_name}* self);\n")
+                    if self._is_live(f"{class_name}_cleanup"):
+                        f.write(f"void {class_name}_cleanup({class_name}* self);\n")
                     f.write("\n")
 
             # Generate standalone function declarations
-            if self.functions:
+            live_functions = self._live_functions()
+            if live_functions:
                 f.write("// === Standalone Function Declarations ===\n")
-                for function in self.functions:
-                    return_type = self.extract_return_type(function["type"])
-                    c_return_type = self.map_cpp_type_to_c(return_type)
-                    f.write(f"{c_return_type} {function['name']}(void);\n")
-                f.write("\n")
-
-            # Generate global variable declarations
-            if self.variables:
-                f.write("// === Global Variable Declarations ===\n")
-                user_vars = [v for v in self.variables if not self._is_system_parameter(v["name"])]
-                for variable in user_vars:
-                    var_name = variable["name"]
-                    var_type = variable["type"]
-                    if variable.get("constructor_args"):
-                        f.write(f"extern {var_type} {var_name};\n")
-                    else:
-                        f.write(f"extern {var_type} {var_name};\n")
+                for function in live_functions:
+                    f.write(f"{self._c_prototype(function, function['name'])};\n")
                 f.write("\n")
+            if self._c_global_constructors():
+                f.write("void global_constructors(void);\n\n")
 
             # End header guard
             f.write(f"#endif // {guard_name}\n")
@@ -999,27 +1755,2103 @@ class PythonTranspiler:
         parameter_names = ['milliseconds', 'rawPressed', 'rawState', 'newState', 'count', 'delayMs']
         return var_name in parameter_names
 
-    def _convert_parameters_to_c(self, params, class_name):
-        """Convert method parameters to C function parameters with self pointer"""
-        if not params or params.strip() == "":
-            return f"{class_name}* self"
-        else:
-            return f"{class_name}* self, {params}"
+    def _class_has_initializer(self, class_name):
+        """Check whether the generated Class_init function clears any field"""
+        return any(
+            self._field_zero_initializer(field)
+            for field in self.classes[class_name]["fields"]
+        )
 
-    def _transpile_method_body(self, body, class_name):
-        """Transpile C++ method body to C"""
-        if not body:
-            return "    // Empty method body\n"
+    def _entry_points(self):
+        """C symbols execution starts from: main and the interrupt handlers"""
+        roots = ["main"] if self.main_function else []
+        roots += [func["name"] for func in self.functions if func.get("is_interrupt")]
+        return roots
 
-        lines = body.split("\n")
-        transpiled_lines = []
+    def build_call_graph(self, lower_method, lower_function, lower_main, fingerprint=""):
+        """
+        Build the call graph of the C program this transpiler emits, from its
+        typed IR (kept as self.program_ir).
+
+        With a fingerprint, the IR a previous run saved to the cache
+        directory is loaded instead when it was built from the same inputs:
+        the bodies are then not lowered for the analyses.
+
+        Args:
+            lower_method: Lowers a method body (body, class_name) -> C
+            lower_function: Lowers a standalone function body -> C
+            lower_main: Lowers the body of main -> C
+            fingerprint: Hash of the inputs of the IR (see
+                _program_fingerprint), "" to always build it
+
+        Returns:
+            CallGraph over functions, Class_method methods, Class_init and
+            Class_cleanup helpers, structs, enums, globals and
+            global_constructors (called first thing by main)
+        """
+        program = None
+        if fingerprint:
+            program = load_program(Path(self.cache_dir) / IR_FILENAME, fingerprint)
+        if program is None:
+            program = replace(
+                self.build_ir(lower_method, lower_function, lower_main), fingerprint=fingerprint
+            )
+        else:
+            print(f"Program IR: loaded {IR_FILENAME}, inputs unchanged")
+        self.built_ir = program
+        self.program_ir = program
+        return program.call_graph()
+
+    def _program_fingerprint(self, link_units):
+        """
+        Hash of what the program IR is built from: the analyzed symbols, the
+        source text, the lowering rules and the options the lowering and the
+        passes planned before the IR depend on
+        """
+        passes = self.pass_manager
+        inputs = [
+            LOWERING_VERSION,
+            link_units,
+            [passes.level, passes.toggles, passes.bisect_limit],
+            [self.target_device, self.generate_xc8_pragmas, self.preserve_comments],
+            asdict(self.inline_model),
+            self.source_files,
+            self.classes,
+            self.enums,
+            self.functions,
+            self.overloaded_functions,
+            self.variables,
+            self.main_function,
+        ]
+        data = json.dumps(inputs, sort_keys=True, default=repr)
+        return hashlib.sha256(data.encode("utf-8")).hexdigest()[:32]
+
+    def build_ir(self, lower_method, lower_function, lower_main):
+        """
+        Describe the C program this transpiler emits as a typed IR: structs,
+        enums, globals and functions with their lowered bodies, every
+        statement resolved to the symbols it calls and references.
+
+        Args:
+            lower_method: Lowers a method body (body, class_name) -> C
+            lower_function: Lowers a standalone function body -> C
+            lower_main: Lowers the body of main -> C
+
+        Returns:
+            IRProgram
+        """
+        builder = ProgramBuilder()
+
+        for enum_name, enum_info in self.enums.items():
+            builder.enum(
+                enum_name,
+                self._enum_storage_type(enum_info),
+                (
+                    (self._enum_constant_name(enum_name, value["name"]), value["value"])
+                    for value in enum_info["values"]
+                ),
+            )
+
+        for class_name, class_info in self.classes.items():
+            unit = self._class_unit(class_name) or ""
+            builder.struct(class_name, (
+                IRVariable(field["name"], self._c_field_type(field))
+                for field in class_info["fields"]
+            ), unit)
+            for helper in ("init", "cleanup"):
+                body = ""
+                if helper == "init" and self._vtable_root(class_name):
+                    body = f"self->{VPTR_FIELD} = &{class_name}_vtable;"
+                elif helper == "init" and self._tag_root(class_name):
+                    body = f"self->{TAG_FIELD} = {class_name}_TAG;"
+                builder.function(
+                    f"{class_name}_{helper}", helper, "void", (), body, class_name, unit=unit
+                )
+            for method in class_info["methods"]:
+                body = method.get("body") or ""
+                if not body and method.get("is_pure"):
+                    continue
+                builder.function(
+                    f"{class_name}_{method['name']}",
+                    "method",
+                    self._return_c_type(method),
+                    parse_parameters(self._c_parameters(method)),
+                    lower_method(body, class_name) if body else "",
+                    class_name,
+                    unit=unit,
+                )
+
+        for root in self.tag_dispatch:
+            builder.enum(
+                f"{root}_Tag", "uint8_t", self._type_tag_constants(root),
+                self._class_unit(root) or "",
+            )
+        for root, slots in self.vtables.items():
+            builder.struct(
+                f"{root}_VTable",
+                (IRVariable(method, self._c_slot_type(root, method)) for method in slots),
+                self._class_unit(root) or "",
+            )
+        for class_name in self.classes:
+            if self._vtable_root(class_name):
+                builder.variable(
+                    f"{class_name}_vtable",
+                    f"const {self._vtable_root(class_name)}_VTable",
+                    f"{{{', '.join(self._vtable_entries(class_name))}}}",
+                    self._class_unit(class_name) or "",
+                )
+
+        for variable in self._global_variables():
+            builder.variable(
+                variable["name"],
+                self._c_variable_type(variable),
+                self.static_initializers.get(variable["name"], ""),
+                self._definition_unit(variable) or "",
+            )
+
+        startup = ""
+        if self.global_constructors:
+            # Emitted with main, or with the first global it constructs
+            constructed = next(
+                var for var in self._global_variables()
+                if var["name"] == self.global_constructors[0][0]
+            )
+            builder.function(
+                "global_constructors",
+                "startup",
+                "void",
+                (),
+                "\n".join(code for _, code in self.global_constructors),
+                unit=self._definition_unit(self.main_function or constructed) or "",
+            )
+            startup = "global_constructors(); "
+
+        for function in self.functions:
+            body = function.get("body") or ""
+            builder.function(
+                function["name"],
+                "function",
+                self._return_c_type(function),
+                parse_parameters(self._c_parameters(function)),
+                lower_function(body) if body else "",
+                interrupt=bool(function.get("is_interrupt")),
+                unit=self._definition_unit(function) or "",
+            )
+
+        if self.main_function:
+            body = self.main_function.get("body") or ""
+            builder.function(
+                "main", "main", "int", (),
+                startup + (lower_main(body) if body else "setup(); loop();"),
+                unit=self._definition_unit(self.main_function) or "",
+            )
+
+        return self._with_dispatch_calls(builder.build())
+
+    def _with_dispatch_calls(self, program):
+        """
+        Resolve the calls through vtables (p->vptr->read(p)) to every
+        implementation of the slot, so that the stack depth and the passes
+        on the call graph see them
+        """
+        if not self.vtables:
+            return program
+        implementations = {}
+        for root, slots in self.vtables.items():
+            for class_name in self.hierarchy.derived(root):
+                for method in slots:
+                    overrider = self.hierarchy.overrider(class_name, method)
+                    if overrider:
+                        targets = implementations.setdefault(method, [])
+                        if f"{overrider}_{method}" not in targets:
+                            targets.append(f"{overrider}_{method}")
+        dispatch = re.compile(rf"->\s*{VPTR_FIELD}\s*->\s*(\w+)\s*\(")
+
+        def resolve(statement):
+            calls = tuple(
+                target for method in dispatch.findall(statement.text)
+                for target in implementations.get(method, ())
+            )
+            return replace(statement, calls=statement.calls + calls) if calls else statement
+
+        return replace(program, functions=tuple(
+            replace(function, body=tuple(resolve(statement) for statement in function.body))
+            for function in program.functions
+        ))
+
+    def _run_program_passes(self, lower_method, lower_function, lower_main, link_units=False):
+        """
+        Run the whole-program passes: static initialization of the globals,
+        then the optimization passes the pass manager selects (self pointer
+        elimination for singleton classes, method specialization, dead code
+        elimination and inlining on the call graph of the lowered program,
+        struct packing), the program memory report, __bit lowering and bank
+        placement when selected, then the stack depth check unless it is
+        off. Switch lowering runs per function body in _memoized_lowering.
+        The passes from dead code elimination on read the program IR.
+
+        With link_units (batch mode), the IR of each translation unit is
+        linked into a whole-program module the passes run on, and the
+        symbols only their own unit uses get internal linkage.
+
+        Returns:
+            Error message when the stack check fails the transpilation,
+            None otherwise
+        """
+        self.live_symbols = None
+        self.program_ir = None
+        self.built_ir = None
+        self.linked_program = None
+        self.internal_symbols = set()
+        self.inlined_methods = set()
+        self.stack_report = None
+        self.struct_layouts = {}
+        self.bit_variables = set()
+        self.bit_functions = set()
+        self.boolean_names = set()
+        self.program_memory_data = {}
+        self.data_placement = None
+        self.singletons = {}
+        self.specializations = {}
+        self.devirtualized = {}
+        self.vtables = {}
+        self.tag_dispatch = {}
+        self.dispatch_bodies = set()
+        self.pass_manager.reset()
+        passes = self.pass_manager
+        self.emitting = False
+        self.lowering_memo.begin_run()
+
+        # Switch tables are applied to each body as it is lowered
+        self.switch_tables = passes.admit("switch-tables")
+        self._layout_class_hierarchies()
+        passes.run("devirtualize", self._plan_devirtualization)
+        passes.run("tag-dispatch", self._plan_tag_dispatch)
+        self._plan_vtables()
+        self._plan_static_initialization()
+        passes.run("singletons", self._plan_singletons)
+        passes.run(
+            "specialize",
+            lambda: self._plan_specializations(lower_method, lower_function, lower_main),
+        )
+
+        graph = None
+        graph_passes = ("singletons", "specialize", "dce", "inline", "bit-types", "bank-placement")
+        if (
+            link_units or self.stack_check != "off"
+            or any(passes.enabled(name) for name in graph_passes)
+        ):
+            graph = self.build_call_graph(
+                lower_method,
+                lower_function,
+                lower_main,
+                self._program_fingerprint(link_units) if self.cache_dir else "",
+            )
+        if link_units:
+            self.linked_program = link(self.program_ir.split_units())
+            print(self.linked_program.format())
+            self.program_ir = self.linked_program.program
+            graph = self.program_ir.call_graph()
+        passes.run("dce", lambda: self._eliminate_dead_code(graph))
+        passes.run("inline", lambda: self._select_inlined_methods(graph))
+        if link_units:
+            passes.run("internalize", lambda: self._plan_internal_linkage(graph))
+        self.pack_structs = passes.run("pack-structs", self._plan_struct_layouts)
+        self._report_program_memory()
+        self.bit_types = passes.run("bit-types", lambda: self._plan_bit_lowering(graph))
+        self.bank_placement = passes.run("bank-placement", lambda: self._plan_bank_placement(graph))
+        if self.stack_check != "off":
+            return self._check_stack_depth(graph)
+        return None
+
+    def _global_variables(self):
+        """
+        Global variables of the program, in declaration order; constants
+        emitted as #define are not variables
+        """
+        return [
+            variable for variable in self.variables
+            if variable.get("is_global", True)
+            and variable["name"] not in self.constant_definitions
+        ]
+
+    def _plan_static_initialization(self):
+        """
+        Evaluate the constructor (or initializer) of every global at
+        transpile time. What only stores constants becomes the global's
+        constant initializer; the remaining dynamic effects are lowered for
+        global_constructors(), ordered so that an object is constructed
+        after the globals its construction uses.
+
+        Startup code goes through the generic call lowering in both output
+        modes: constructors reach methods through bare calls.
+        """
+        self.static_initializers = {}
+        self.global_constructors = []
+        self.constant_definitions = {}
+        self.ram_constants = set()
+
+        self._plan_constant_definitions()
+
+        dynamic = {}
+        for variable in self._global_variables():
+            initializer, code = self._evaluate_global(variable)
+            if initializer and not is_zero_initializer(initializer):
+                self.static_initializers[variable["name"]] = initializer
+            if code:
+                dynamic[variable["name"]] = code
+
+        dependencies = {
+            name: set(re.findall(r"\w+", code)) & set(dynamic)
+            for name, code in dynamic.items()
+        }
+        self.global_constructors = [
+            (name, dynamic[name]) for name in order_by_dependency(list(dynamic), dependencies)
+        ]
+
+        # Const objects written after startup cannot live in program memory
+        for variable in self._global_variables():
+            c_type = self._c_variable_type(variable)
+            if not is_const_object(c_type):
+                continue
+            class_info = self.classes.get(without_const(c_type), {})
+            if variable["name"] in dynamic:
+                reason = "needs startup code"
+            elif any(field.get("mutable") for field in class_info.get("fields", [])):
+                reason = "has mutable members"
+            else:
+                continue
+            self.ram_constants.add(variable["name"])
+            print(f"Note: const global {variable['name']} {reason} and stays in RAM")
+
+    def _plan_constant_definitions(self):
+        """
+        Turn the integral compile-time constants of the program - static
+        const members and const globals with a constant initializer - into
+        #define, so they take neither RAM nor program memory. Constants whose
+        address is taken or bound to a reference stay objects.
+        """
+        escaping = self._escaping_fields()
+        for variable in self._global_variables():
+            c_type = self._c_variable_type(variable)
+            form, text = variable.get("initializer") or (None, None)
+            if (
+                form not in ("assign", "list")
+                or not is_const_object(c_type)
+                or "volatile" in c_type
+                or variable["name"] in escaping
+            ):
+                continue
+            scalar = without_const(c_type)
+            if scalar not in self.enums and not is_integral_type(scalar):
+                continue
+            value = self._lower_static_expression(text)
+            if not is_constant_expression(value, self._static_constants()):
+                continue
+            if not re.fullmatch(r"[\w.']+", value):
+                value = f"({value})"
+            self.constant_definitions[variable["name"]] = value
+
+    def _c_constant_definitions(self):
+        """#define lines of the compile-time constants"""
+        return "".join(
+            f"#define {name} {value}\n" for name, value in self.constant_definitions.items()
+        )
+
+    def _layout_class_hierarchies(self):
+        """
+        Lay out the structs of derived classes: the members of the bases
+        come first, in order, so that a derived object can be used through
+        a pointer to any of its bases. Drops the layout of a previous run.
+        """
+        own_fields = {
+            class_name: [
+                field for field in class_info["fields"]
+                if not field.get("inherited_from")
+                and not field.get("vptr") and not field.get("tag")
+            ]
+            for class_name, class_info in self.classes.items()
+        }
+        for class_info in self.classes.values():
+            class_info["methods"] = [
+                method for method in class_info["methods"] if not method.get("tag_dispatch")
+            ]
+        hierarchy = ClassHierarchy()
+        for class_name, class_info in self.classes.items():
+            base = class_info.get("base")
+            hierarchy.bases[class_name] = base if base in self.classes else None
+            hierarchy.methods[class_name] = [
+                method["name"] for method in class_info["methods"]
+                if not method.get("specialization_of")
+            ]
+            for method in class_info["methods"]:
+                key = (class_name, method["name"])
+                for flag, declared in (
+                    ("is_virtual", hierarchy.virtual),
+                    ("is_pure", hierarchy.pure),
+                    ("final", hierarchy.final_methods),
+                ):
+                    if method.get(flag):
+                        declared.add(key)
+            if class_info.get("final"):
+                hierarchy.final_classes.add(class_name)
+        self.hierarchy = hierarchy
+
+        self.hierarchy_calls = {}
+        for class_name, class_info in self.classes.items():
+            chain = hierarchy.chain(class_name)
+            class_info["fields"] = [
+                dict(field, inherited_from=base)
+                for base in reversed(chain[1:]) for field in own_fields[base]
+            ] + own_fields[class_name]
+            for name in chain:
+                for method in hierarchy.methods[name]:
+                    self.hierarchy_calls.setdefault(f"{class_name}_{method}", (class_name, method))
+        if not any(hierarchy.in_hierarchy(class_name) for class_name in self.classes):
+            self.hierarchy_calls = {}
+
+    def _in_hierarchy(self, class_name):
+        """Check whether a class has a base or derived classes"""
+        return class_name in self.classes and self.hierarchy.in_hierarchy(class_name)
+
+    def _instantiated_classes(self):
+        """
+        Classes the program has objects of: globals, members and the locals
+        of the bodies
+        """
+        instantiated = set()
+        for variable in self._global_variables():
+            match = re.match(r"(?:const\s+)?(\w+)\s*(?:\[|$)", self._c_variable_type(variable))
+            if match:
+                instantiated.add(match.group(1))
+        for class_info in self.classes.values():
+            for field in class_info["fields"]:
+                c_type = self.map_cpp_type_to_c(field["type"], field.get("canonical_type"))
+                match = re.match(r"(\w+)\s*(?:\[|$)", c_type)
+                if match:
+                    instantiated.add(match.group(1))
+        bodies = [
+            method.get("body") or ""
+            for class_info in self.classes.values() for method in class_info["methods"]
+        ] + [function.get("body") or "" for function in self.functions]
+        if self.main_function:
+            bodies.append(self.main_function.get("body") or "")
+        code = strip_comments_and_literals("\n".join(bodies))
+        for class_name in self.classes:
+            if re.search(rf"\b{re.escape(class_name)}\s+\w+\s*[;=({{\[]", code):
+                instantiated.add(class_name)
+        return instantiated & set(self.classes)
+
+    def _plan_devirtualization(self):
+        """
+        Find the virtual calls whose target is known from the classes the
+        program instantiates (class hierarchy analysis) or from final: a
+        call through a pointer to such a class runs that implementation
+        directly. Without entry point, the users of a library may derive
+        other classes, and only final counts.
+        """
+        hierarchy = self.hierarchy
+        instantiated = self._instantiated_classes() if self._entry_points() else None
+        for class_name in self.classes:
+            for method in hierarchy.slots(class_name):
+                target = hierarchy.resolve(class_name, method, instantiated)
+                if target is not None:
+                    self.devirtualized[(class_name, method)] = target
+        if self.devirtualized:
+            print("Devirtualized calls: " + ", ".join(
+                f"{class_name}::{method} -> {target}_{method}"
+                for (class_name, method), target in self.devirtualized.items()
+            ))
+        return len(self.devirtualized)
+
+    def _dispatching_roots(self):
+        """Roots of the hierarchies with a virtual call left to dispatch, with their slots"""
+        hierarchy = self.hierarchy
+        roots = {}
+        for root in self.classes:
+            if hierarchy.bases.get(root) is not None:
+                continue
+            slots = hierarchy.root_slots(root)
+            if slots and not all(
+                (class_name, method) in self.devirtualized
+                for class_name in hierarchy.derived(root) for method in hierarchy.slots(class_name)
+            ):
+                roots[root] = slots
+        return roots
+
+    def _plan_tag_dispatch(self):
+        """
+        Dispatch the small hierarchies with a switch on a type tag instead
+        of vtables: up to TAG_DISPATCH_MAX_CLASSES classes that can be
+        instantiated, unless an attribute of the root chooses. Needs the
+        whole program: the users of a library may derive other classes.
+        """
+        if not self._entry_points():
+            return
+        for root, slots in self._dispatching_roots().items():
+            if self.classes[root].get("dispatch") is None and (
+                len(self.hierarchy.concrete(root)) <= TAG_DISPATCH_MAX_CLASSES
+            ):
+                self.tag_dispatch[root] = slots
+        return len(self.tag_dispatch)
+
+    def _plan_vtables(self):
+        """
+        Give the hierarchies with a virtual call left to dispatch a vtable
+        and a vptr member in their root, or a type tag member and dispatch
+        functions when they switch (laid out first, so that every derived
+        class has it at the same place).
+        """
+        hierarchy = self.hierarchy
+        for root, slots in self._dispatching_roots().items():
+            strategy = self.classes[root].get("dispatch")
+            if strategy == "switch" and hierarchy.concrete(root):
+                self.tag_dispatch[root] = slots
+            elif root not in self.tag_dispatch:
+                self.vtables[root] = slots
+            tag = root in self.tag_dispatch
+            for class_name in hierarchy.derived(root):
+                self.classes[class_name]["fields"].insert(0, {
+                    "name": TAG_FIELD if tag else VPTR_FIELD,
+                    "type": "uint8_t" if tag else f"const struct {root}_VTable *",
+                    "canonical_type": "unsigned char" if tag else None,
+                    "mutable": False,
+                    "tag" if tag else "vptr": True,
+                    "inherited_from": root if class_name != root else None,
+                })
+            if tag:
+                self._add_dispatch_functions(root)
+        dispatching = (("Virtual tables", self.vtables), ("Switch dispatch", self.tag_dispatch))
+        for title, roots in dispatching:
+            if roots:
+                print(f"{title}: " + ", ".join(
+                    f"{root} ({', '.join(slots)})" for root, slots in roots.items()
+                ))
+
+    def _add_dispatch_functions(self, root):
+        """
+        Add to the root of a switch dispatched hierarchy a method per slot,
+        Root_method_dispatch, switching on the type tag with a direct call
+        per implementation
+        """
+        hierarchy = self.hierarchy
+        for method in self.tag_dispatch[root]:
+            declaration = self._slot_declaration(root, method)
+            names = [
+                parameter.name for parameter in parse_parameters(self._c_parameters(declaration))
+            ]
+            self_type = "const " if declaration.get("is_const") else ""
+
+            def call(target, method=method, names=names, self_type=self_type):
+                instance = "self" if target == root else f"({self_type}{target}*)self"
+                return f"{target}_{method}({', '.join([instance] + names)})"
+
+            body = tag_switch(
+                hierarchy.dispatch_arms(root, method),
+                call,
+                self._return_c_type(declaration) != "void",
+            )
+            self.dispatch_bodies.add(body)
+            self.classes[root]["methods"].append(dict(
+                declaration,
+                name=f"{method}_dispatch",
+                body=body,
+                is_virtual=False,
+                is_pure=False,
+                final=False,
+                definition_file=None,
+                tag_dispatch=True,
+            ))
+
+    def _tag_root(self, class_name):
+        """Root of the hierarchy of a class when it dispatches with a switch"""
+        root = self.hierarchy.root(class_name) if class_name in self.classes else None
+        return root if root in self.tag_dispatch else None
+
+    def _vtable_root(self, class_name):
+        """Root of the hierarchy of a class when it dispatches through vtables"""
+        root = self.hierarchy.root(class_name) if class_name in self.classes else None
+        return root if root in self.vtables else None
+
+    def _lower_method_dispatch(self, code, class_name=None):
+        """
+        Resolve the calls to methods of class hierarchies in lowered C.
+
+        A call Class_method(object, ...) targets the class implementing the
+        method for that static type, the object cast to it when it is a
+        base. A virtual call on a pointer goes through the vtable or the
+        dispatch function unless devirtualized; on an object (&x) it runs
+        the object's own class.
+        Within a method of class_name, calls on self use class_name as the
+        static type, whatever class the bare call lowering picked.
+        Before that, the pointers passed to base pointer parameters are cast
+        and the local objects of dispatching classes constructed.
+        """
+        if not self.hierarchy_calls:
+            return code
+        hierarchy = self.hierarchy
+        code = self._construct_local_objects(self._upcast_arguments(code))
+
+        def rewrite(name, arguments):
+            static_type, method = self.hierarchy_calls[name]
+            if (
+                class_name in self.classes and arguments and arguments[0].strip() == "self"
+                and f"{class_name}_{method}" in self.hierarchy_calls
+            ):
+                static_type = class_name
+            if not self._in_hierarchy(static_type) or not arguments:
+                return None
+            instance = arguments[0].strip()
+            target = hierarchy.owner(static_type, method)
+            if hierarchy.is_virtual(static_type, method):
+                target = hierarchy.overrider(static_type, method)
+                if not is_object_argument(instance):
+                    target = self.devirtualized.get((static_type, method))
+                if target is None and self._tag_root(static_type):
+                    root = self._tag_root(static_type)
+                    if static_type != root:
+                        instance = cast_object(instance, root)
+                    return (
+                        f"{root}_{method}_dispatch("
+                        + ", ".join([instance] + arguments[1:]) + ")"
+                    )
+                if target is None and self._vtable_root(static_type):
+                    root = self._vtable_root(static_type)
+                    pointer = dispatch_object(instance)
+                    if static_type != root:
+                        instance = cast_object(instance, root)
+                    return (
+                        f"{pointer}->{VPTR_FIELD}->{method}("
+                        + ", ".join([instance] + arguments[1:]) + ")"
+                    )
+                target = target or hierarchy.owner(static_type, method)
+            if target != static_type:
+                instance = cast_object(instance, target)
+            elif f"{target}_{method}" == name:
+                return None
+            return f"{target}_{method}(" + ", ".join([instance] + arguments[1:]) + ")"
+
+        return rewrite_calls(code, rewrite, self.hierarchy_calls)
+
+    def _base_pointer_parameters(self):
+        """
+        Parameters taking a pointer to a class that has derived classes, by
+        C function: {name: {argument index: class}}, self counting for methods
+        """
+        declarations = [(function["name"], function, 0) for function in self.functions]
+        for name, (class_name, method) in self.hierarchy_calls.items():
+            owner = self.hierarchy.owner(class_name, method)
+            declarations += [
+                (name, declaration, 1) for declaration in self.classes[owner]["methods"]
+                if declaration["name"] == method
+            ]
+        parameters = {}
+        for name, declaration, offset in declarations:
+            for index, param in enumerate(declaration.get("params") or ()):
+                c_type = self.map_cpp_type_to_c(param["type"], param.get("canonical_type"))
+                pointee = re.fullmatch(r"(?:const\s+)?(\w+)\s*\*", c_type)
+                if pointee and len(self.hierarchy.derived(pointee.group(1))) > 1:
+                    parameters.setdefault(name, {})[index + offset] = pointee.group(1)
+        return parameters
+
+    def _hierarchy_variables(self, code):
+        """
+        Objects and pointers of hierarchy classes a lowered body can use: the
+        globals and the locals it declares, as ({name: class}, {name: class})
+        """
+        declarations = [
+            (without_const(self._c_variable_type(variable)), variable["name"])
+            for variable in self._global_variables()
+        ]
+        classes = [name for name in self.classes if self._in_hierarchy(name)]
+        if classes:
+            names = "|".join(sorted(map(re.escape, classes), key=len, reverse=True))
+            declarations += [
+                (f"{class_name} {pointer}{array}", name)
+                for class_name, pointer, name, array in re.findall(
+                    rf"\b({names})\b\s*(\*?)\s*(\w+)\s*(\[?)(?=[\[=;,)])", code
+                )
+            ]
+        objects, pointers = {}, {}
+        for c_type, name in declarations:
+            declared = re.fullmatch(r"(?:const\s+)?(\w+)\s*(\*?)\s*(\[?).*", c_type)
+            if not declared or not self._in_hierarchy(declared.group(1)):
+                continue
+            if not declared.group(2):
+                objects[name] = declared.group(1)
+            if declared.group(2) or declared.group(3):
+                pointers[name] = declared.group(1)
+        return objects, pointers
+
+    def _upcast_arguments(self, code):
+        """
+        Cast the pointers a call passes for a pointer to their base class,
+        which C does not convert implicitly: sample(&thermistor) ->
+        sample((Sensor*)&thermistor). Every argument not evidently of the
+        base class itself is cast, clang having checked that it converts.
+        """
+        bases = self._base_pointer_parameters()
+        if not bases:
+            return code
+        objects, pointers = self._hierarchy_variables(code)
+
+        def rewrite(name, arguments):
+            for index, base in bases[name].items():
+                if index >= len(arguments) or arguments[index].strip() in NULL_POINTERS:
+                    continue
+                if pointer_class(arguments[index], objects, pointers) != base:
+                    arguments[index] = cast_object(arguments[index], base)
+            return f"{name}(" + ", ".join(arguments) + ")"
+
+        return rewrite_calls(code, rewrite, bases)
+
+    def _construct_local_objects(self, code):
+        """
+        Initialize the local objects of classes dispatching through a vptr
+        or a type tag like globals (see _evaluate_construction):
+        Thermistor probe(7); -> Thermistor probe = {&Thermistor_vtable, 7, 0};
+        followed by the dynamic part of the construction, if any.
+        """
+        classes = [
+            name for name in self.classes
+            if (self._vtable_root(name) or self._tag_root(name))
+            and not self.hierarchy.is_abstract(name)
+        ]
+        if not classes:
+            return code
+        names = "|".join(sorted(map(re.escape, classes), key=len, reverse=True))
+        declaration = re.compile(
+            rf"^([ \t]*)({names})\s+(\w+)\s*(?:\((.*)\)|=\s*(?:\2\s*\((.*)\)|\{{(.*)\}}))?\s*;"
+            rf"(?:\s*\2_init\(\s*&\s*\3\s*\);)?[ \t]*$",
+            re.MULTILINE,
+        )
+
+        def construct(match):
+            indent, class_name, name = match.group(1, 2, 3)
+            text = next((text for text in match.group(4, 5, 6) if text is not None), "")
+            initializer, dynamic = self._evaluate_construction(
+                class_name, split_arguments(text), name
+            )
+            lines = [f"{class_name} {name} = {initializer};"] + dynamic.split("\n")
+            return "\n".join(indent + line for line in lines if line)
+
+        return declaration.sub(construct, code)
+
+    def _plan_singletons(self):
+        """
+        Find the classes with exactly one statically allocated instance whose
+        address never escapes, and whose methods do not use `this` other than
+        to reach members. Their methods are emitted without self parameter
+        and work on the instance directly.
+
+        A class is not a singleton when any other global, member, parameter,
+        return type or local mentions it (arrays, pointers, references,
+        other instances). Like inlining this needs the whole program: a
+        library without entry point may be instantiated by its users.
+        """
+        if not self._entry_points():
+            return
+
+        variables = self._global_variables()
+        sources = [strip_comments(content) for content in self.all_source_codes.values() if content]
+        escaping = self._escaping_fields()
+        declarations = [
+            method.get("type") or ""
+            for class_info in self.classes.values() for method in class_info["methods"]
+        ] + [function.get("type") or "" for function in self.functions]
+        bodies = [
+            method.get("body") or ""
+            for class_info in self.classes.values() for method in class_info["methods"]
+        ] + [function.get("body") or "" for function in self.functions]
+        if self.main_function:
+            bodies.append(self.main_function.get("body") or "")
+        bodies = [strip_comments_and_literals(body) for body in bodies]
+
+        for class_name, class_info in self.classes.items():
+            # Methods callable through a base pointer keep their self pointer
+            if not class_info["methods"] or self._in_hierarchy(class_name):
+                continue
+            mention = re.compile(rf"\b{re.escape(class_name)}\b(?!\s*::)")
+            instances = [
+                variable for variable in variables
+                if without_const(self._c_variable_type(variable)) == class_name
+            ]
+            if len(instances) != 1:
+                continue
+            instance = instances[0]["name"]
+            others = [
+                self._c_variable_type(variable) for variable in variables
+                if variable is not instances[0]
+            ] + [
+                field["type"] for info in self.classes.values() for field in info["fields"]
+            ]
+            if any(mention.search(text) for text in others + declarations + bodies):
+                continue
+            address = re.compile(rf"&\s*\(?\s*{re.escape(instance)}\b")
+            if instance in escaping or any(address.search(source) for source in sources):
+                continue
+            own_bodies = [method.get("body") or "" for method in class_info["methods"]] + [
+                constructor.body
+                for source in sources for constructor in find_constructors(source, class_name)
+            ]
+            if any(re.search(r"\bthis\b(?!\s*->)", body) for body in own_bodies):
+                continue
+            self.singletons[class_name] = instance
+
+        if self.singletons:
+            # Startup code was lowered before the singletons were known
+            methods = self._singleton_methods()
+            self.global_constructors = [
+                (name, drop_instance_argument(code, methods))
+                for name, code in self.global_constructors
+            ]
+            print("Singleton classes (no self pointer): " + ", ".join(
+                f"{class_name} ({instance})" for class_name, instance in self.singletons.items()
+            ))
+        return len(self.singletons)
+
+    def _plan_specializations(self, lower_method, lower_function, lower_main):
+        """
+        Clone the methods that read constant fields for each value the
+        program's instances hold.
+
+        A field is constant when no body ever stores to it (assignment,
+        increment, address taken): only its constructor sets it, and the
+        evaluated static initializer of each global instance gives its
+        value. The methods reading such fields, and those calling them on
+        the same object, get a clone per value set with the fields replaced
+        by their values and the switches on them folded. Calls on global
+        instances target the clones; the originals stay for the other
+        objects (locals, pointers) and are dropped by dead code elimination
+        when nothing calls them.
+
+        The inline cost model decides whether a class is worth it: with the
+        size goal the clones and the originals still called must be
+        smaller than the originals, with the speed goal a clone must shrink.
+        """
+        if not self._entry_points():
+            return
+
+        escaping = self._escaping_fields()
+        bodies = [
+            method.get("body") or ""
+            for class_info in self.classes.values() for method in class_info["methods"]
+        ] + [function.get("body") or "" for function in self.functions]
+        if self.main_function:
+            bodies.append(self.main_function.get("body") or "")
+        bodies = [strip_comments_and_literals(body) for body in bodies]
+        # Startup code may call methods, but not store to members directly
+        dynamic = dict(self.global_constructors)
+
+        # Lowered code calling methods from outside their class
+        outside = [code for _, code in self.global_constructors]
+        outside += [
+            lower_function(function["body"])
+            for function in self.functions if function.get("body")
+        ]
+        if self.main_function and self.main_function.get("body"):
+            outside.append(lower_main(self.main_function["body"]))
+
+        for class_name, class_info in list(self.classes.items()):
+            if (
+                class_name in self.singletons or not class_info["methods"]
+                or self._in_hierarchy(class_name)
+            ):
+                continue
+            plan = self._plan_class_specialization(
+                class_name, bodies, escaping, dynamic, outside, lower_method
+            )
+            if plan:
+                for method_name, clones in plan.items():
+                    self.specializations[f"{class_name}_{method_name}"] = clones
+
+        if self.specializations:
+            self.global_constructors = [
+                (name, self._call_specializations(code)) for name, code in self.global_constructors
+            ]
+        return sum(len(set(clones.values())) for clones in self.specializations.values())
+
+    def _plan_class_specialization(
+        self, class_name, bodies, escaping, dynamic, outside, lower_method
+    ):
+        """
+        Specialize the methods of one class (see _plan_specializations).
+
+        Returns:
+            {method: {instance: C name of its clone}}, or None when the class
+            is not specialized
+        """
+        class_info = self.classes[class_name]
+        methods = {method["name"]: method for method in class_info["methods"]}
+
+        constant_fields = []
+        for field in class_info["fields"]:
+            name = field["name"]
+            store = re.compile(
+                rf"(?:(?:\+\+|--)\s*(?:\w+\s*(?:\.|->)\s*)*\b{name}\b"
+                rf"|\b{name}\s*(?:\+\+|--|(?:[-+*/%&|^]|<<|>>)?=(?!=)))"
+            )
+            if (
+                name in escaping
+                or "volatile" in field["type"]
+                or any(store.search(body) for body in bodies)
+            ):
+                continue
+            constant_fields.append(name)
+
+        reads = {
+            name for name, method in methods.items()
+            if any(
+                re.search(
+                    rf"(?<![\w.>:])\b{field}\b|\bthis\s*->\s*{field}\b",
+                    strip_comments_and_literals(method.get("body") or ""),
+                )
+                for field in constant_fields
+            )
+        }
+        if not reads:
+            return None
+        fields = [
+            field for field in constant_fields
+            if any(re.search(rf"\b{field}\b", methods[name].get("body") or "") for name in reads)
+        ]
+
+        # Methods calling specialized methods on the same object are cloned too
+        def self_calls(method_name, candidates):
+            body = strip_comments_and_literals(methods[method_name].get("body") or "")
+            return {
+                other for other in candidates
+                if re.search(rf"(?:\bthis\s*->\s*|(?<![\w.>:]))\b{other}\s*\(", body)
+            }
+
+        specialized = set(reads)
+        while True:
+            callers = {
+                name for name in methods
+                if name not in specialized and self_calls(name, specialized)
+            }
+            if not callers:
+                break
+            specialized |= callers
+
+        # Constant field values of each global instance
+        field_names = [field["name"] for field in class_info["fields"]]
+        values = {}
+        for variable in self._global_variables():
+            if without_const(self._c_variable_type(variable)) != class_name:
+                continue
+            startup = dynamic.get(variable["name"], "")
+            member = rf"\b{re.escape(variable['name'])}\s*\.\s*"
+            if any(
+                re.search(rf"{member}{field}\s*[-+*/%&|^<>]*=(?!=)", startup)
+                for field in fields
+            ):
+                continue
+            initializer = self.static_initializers.get(variable["name"])
+            if initializer is None:
+                initializer = self._evaluate_global(variable)[0]
+            if not initializer:
+                continue
+            elements = split_arguments(initializer.strip()[1:-1])
+            if len(elements) != len(field_names):
+                continue
+            key = tuple(
+                self._constant_value(elements[field_names.index(field)]) for field in fields
+            )
+            if None not in key:
+                values[variable["name"]] = key
+        if not values:
+            return None
+
+        # Clones and originals the program calls
+        names = "|".join(map(re.escape, specialized))
+        call = re.compile(
+            rf"\b{re.escape(class_name)}_({names})\s*\(\s*(?:&\s*(\w+)\s*[,)])?"
+        )
+        callers = list(outside) + [
+            lower_method(method["body"], other)
+            for other, info in self.classes.items() for method in info["methods"]
+            if method.get("body") and (other != class_name or method["name"] not in specialized)
+        ]
+        needed = set()
+        originals = set()
+        for code in callers:
+            for match in call.finditer(code):
+                if match.group(2) in values:
+                    needed.add((match.group(1), values[match.group(2)]))
+                else:
+                    originals.add(match.group(1))
+        if not needed:
+            return None
+        pending = list(needed)
+        while pending:
+            method_name, key = pending.pop()
+            for other in self_calls(method_name, specialized):
+                if (other, key) not in needed:
+                    needed.add((other, key))
+                    pending.append((other, key))
+        pending = list(originals)
+        while pending:
+            for other in self_calls(pending.pop(), specialized):
+                if other not in originals:
+                    originals.add(other)
+                    pending.append(other)
+
+        # Build the clones, next to their originals
+        enum_prefixes = list(self.enums)
+        clones = {}
+        for method_name, key in sorted(needed):
+            suffix = clone_suffix(key, enum_prefixes)
+            body = methods[method_name].get("body") or ""
+            for field, value in zip(fields, key):
+                body = substitute_field(body, field, value)
+            body = fold_constant_switches(body, self._constant_value)
+            renames = {
+                other: f"{other}__{suffix}" for other in self_calls(method_name, specialized)
+            }
+            body = rename_calls(body, renames)
+            clone = dict(methods[method_name], name=f"{method_name}__{suffix}", body=body)
+            clone["specialization_of"] = method_name
+            clones[(method_name, key)] = clone
+        added = list(clones.values())
+        class_info["methods"] = [
+            method
+            for original in class_info["methods"]
+            for method in [original] + [
+                clones[(name, key)] for name, key in sorted(clones) if name == original["name"]
+            ]
+        ]
+
+        def cost(method):
+            body = method.get("body") or ""
+            return self.inline_model.body_cost(lower_method(body, class_name)) + 1 if body else 1
+
+        before = sum(cost(methods[name]) for name in {name for name, _ in needed} | originals)
+        after = sum(cost(clone) for clone in added) + sum(cost(methods[name]) for name in originals)
+        if self.inline_model.goal == "speed":
+            worth = any(cost(clones[(name, key)]) < cost(methods[name]) for name, key in clones)
+        else:
+            worth = after < before
+        if not worth:
+            class_info["methods"] = [
+                method for method in class_info["methods"] if method not in added
+            ]
+            print(f"Method specialization: {class_name} not cloned (cost {before} -> {after})")
+            return None
+
+        plan = {}
+        for instance, key in values.items():
+            for method_name in specialized:
+                if (method_name, key) in clones:
+                    plan.setdefault(method_name, {})[instance] = (
+                        f"{class_name}_{clones[(method_name, key)]['name']}"
+                    )
+        print(
+            f"Method specialization: {len(added)} clones of {class_name} "
+            f"({', '.join(sorted({name for name, _ in needed}))}), cost {before} -> {after}"
+        )
+        return plan
+
+    def _constant_value(self, expr):
+        """
+        Canonical value of a constant C++ expression (enum constant or
+        integer), None when the expression is not constant
+        """
+        expr = self._lower_static_expression(expr)
+        while re.fullmatch(r"\((.*)\)", expr):
+            expr = expr[1:-1].strip()
+        if expr in self.constant_definitions:
+            return self._constant_value(self.constant_definitions[expr])
+        if expr in self._static_constants():
+            return expr
+        if expr in ("true", "false"):
+            return "1" if expr == "true" else "0"
+        literal = re.fullmatch(r"([-+]?)\s*(0[xX][0-9a-fA-F]+|0[0-7]*|[1-9]\d*)[uUlL]*", expr)
+        if literal:
+            digits = literal.group(2)
+            if digits[:2].lower() == "0x":
+                base = 16
+            elif digits.startswith("0") and len(digits) > 1:
+                base = 8
+            else:
+                base = 10
+            return str(int(literal.group(1) + digits, base))
+        return None
+
+    def _numeric_value(self, expr):
+        """Integer value of a constant expression (enum constants resolved), or None"""
+        value = self._constant_value(expr)
+        if value is None:
+            return None
+        for enum_name, enum_info in self.enums.items():
+            for constant in enum_info["values"]:
+                if self._enum_constant_name(enum_name, constant["name"]) == value:
+                    return int(constant["value"])
+        return int(value) if re.fullmatch(r"-?\d+", value) else None
+
+    def _pin_macros(self):
+        """
+        Pin macros (#define LED0 PORTAbits.RA3) of the program's sources and
+        of the headers they include with quotes
+        """
+        if self.pin_macros is None:
+            texts = [content for content in self.all_source_codes.values() if content]
+            for file_path, content in self.all_source_codes.items():
+                for header in re.findall(r'^\s*#\s*include\s*"([^"]+)"', content or "", re.M):
+                    for directory in [Path(file_path).parent] + [Path(p) for p in self.include_paths]:
+                        candidate = directory / header
+                        if str(candidate) not in self.all_source_codes and candidate.is_file():
+                            texts.append(candidate.read_text(errors="replace"))
+                            break
+            self.pin_macros = pin_definitions(texts)
+        return self.pin_macros
+
+    def _call_specializations(self, code):
+        """Point the calls on constant-configured instances at their clones"""
+        for function, clones in self.specializations.items():
+            code = re.sub(
+                rf"\b{re.escape(function)}(\s*\(\s*&\s*(\w+)\s*[,)])",
+                lambda match: (clones.get(match.group(2), function) + match.group(1)),
+                code,
+            )
+        return code
+
+    def _singleton_methods(self):
+        """C names of the methods of the singleton classes"""
+        return {
+            f"{class_name}_{method['name']}"
+            for class_name in self.singletons
+            for method in self.classes[class_name]["methods"]
+        }
+
+    def _static_constants(self):
+        """Names usable in a constant initializer besides literals"""
+        return {
+            self._enum_constant_name(enum_name, value["name"])
+            for enum_name, enum_info in self.enums.items()
+            for value in enum_info["values"]
+        } | set(self.constant_definitions) | set(self.classes)  # classes: in upcasts
+
+    def _lower_static_expression(self, expr):
+        """Lower a C++ initializer expression to C (enum constants, nullptr)"""
+        expr = self._lower_static_members(self._lower_enum_references(expr.strip()))
+        return re.sub(r"\bnullptr\b", "NULL", expr)
+
+    def _is_static_constant(self, expr):
+        """Check whether a lowered expression can initialize a global"""
+        addresses = [variable["name"] for variable in self._global_variables()]
+        return is_constant_expression(expr, self._static_constants(), addresses)
+
+    def _evaluate_global(self, variable):
+        """
+        Evaluate the initialization of a global.
+
+        Returns:
+            (initializer, code): the C initializer (None when there is none)
+            and the lowered statements that must run at startup ("" if none)
+        """
+        name = variable["name"]
+        c_type = self._c_variable_type(variable)
+        form, text = variable.get("initializer") or (None, None)
+
+        if without_const(c_type) in self.classes:
+            c_type = without_const(c_type)
+            if form == "assign":
+                # T name = {args} or T name = T(args)
+                call = re.fullmatch(rf"(?:{re.escape(c_type)}\s*)?[({{](.*)[)}}]", text, re.DOTALL)
+                if not call:
+                    return None, ""
+                text = call.group(1)
+            arguments = [
+                self._lower_static_expression(argument)
+                for argument in split_arguments(text or "")
+            ]
+            return self._evaluate_construction(c_type, arguments, name)
+
+        if text is None:
+            return None, ""
+        expr = self._upcast_addresses(self._lower_static_expression(text), c_type)
+        if form == "list":
+            expr = f"{{{expr}}}" if "[" in c_type else expr
+        if self._is_static_constant(expr):
+            return expr, ""
+        return None, self._lower_startup_code(f"{name} = {text};")
+
+    def _upcast_addresses(self, expr, c_type):
+        """
+        Cast the addresses of derived objects initializing a pointer to their
+        base, which C does not convert implicitly ({&thermistor} ->
+        {(Sensor*)&thermistor})
+        """
+        pointee = re.match(r"(?:const\s+)?(\w+)\s*\*", c_type)
+        if not pointee or not self._in_hierarchy(pointee.group(1)):
+            return expr
+        base = pointee.group(1)
+        classes = {
+            variable["name"]: without_const(self._c_variable_type(variable))
+            for variable in self._global_variables()
+        }
+
+        def upcast(match):
+            class_name = classes.get(match.group(1))
+            if class_name != base and base in self.hierarchy.chain(class_name or ""):
+                return f"({base}*)&{match.group(1)}"
+            return match.group(0)
+
+        return re.sub(r"(?<![\w)])&\s*(\w+)\b(?!\s*(?:[.\[(]|->))", upcast, expr)
+
+    def _find_constructor(self, class_name, argument_count):
+        """
+        Constructor definition of a class taking argument_count arguments,
+        with the default arguments of its declaration
+        """
+        constructors = [
+            constructor
+            for content in self.all_source_codes.values() if content
+            for constructor in find_constructors(content, class_name)
+        ]
+        declarations = [constructor for constructor in constructors if not constructor.defined]
+        for constructor in constructors:
+            if not constructor.defined:
+                continue
+            for declaration in declarations:
+                if len(declaration.params) == len(constructor.params):
+                    constructor.params = [
+                        (name, default if default is not None else declared)
+                        for (name, default), (_, declared) in zip(
+                            constructor.params, declaration.params
+                        )
+                    ]
+            if constructor.accepts(argument_count):
+                return constructor
+        return None
+
+    def _lower_startup_code(self, code):
+        """Lower statements for global_constructors(), one per line"""
+        lowered = self._lower_body(code)
+        return "\n".join(line.strip() for line in lowered.split("\n") if line.strip())
+
+    def _evaluate_construction(self, class_name, arguments, target):
+        """
+        Evaluate the construction of an object of class_name.
+
+        Members take the values of the member initializer list (or zero),
+        then the leading constant stores of the constructor body. A member
+        whose value is not constant, and everything from the first statement
+        of the body that is not a constant member store, is dynamic and
+        lowered as code operating on target (an lvalue: "led0", "box.led").
+        The inherited members come first, from the construction of the base.
+
+        Returns:
+            (initializer, code) like _evaluate_global
+        """
+        values, dynamic = self._construction_values(class_name, arguments, target, class_name)
+        initializer = f"{{{', '.join(values)}}}" if values else None
+        return initializer, "\n".join(dynamic)
+
+    def _construction_values(self, class_name, arguments, target, dynamic_type):
+        """
+        Member values and dynamic code of the construction of an object of
+        dynamic_type, as far as its class_name part (itself or a base) goes
+        """
+        fields = self.classes[class_name]["fields"]
+        field_names = [field["name"] for field in fields]
+        constructor = self._find_constructor(class_name, len(arguments))
+
+        bindings = {}
+        initializers = {}
+        statements = []
+        if constructor:
+            for index, (param, default) in enumerate(constructor.params):
+                if not param:
+                    continue
+                if index < len(arguments):
+                    bindings[param] = arguments[index]
+                elif default is not None:
+                    bindings[param] = self._lower_static_expression(default)
+            initializers = {
+                member: substitute_names(self._lower_static_expression(expr), bindings)
+                for member, expr in constructor.initializers.items()
+            }
+            statements = split_statements(constructor.body)
+        else:
+            # No user constructor: an aggregate initialized member by member
+            initializers = dict(zip(
+                [field["name"] for field in fields if not field.get("inherited_from")], arguments
+            ))
+
+        values = []
+        dynamic = []
+        base = self.hierarchy.bases.get(class_name)
+        if base:
+            values, dynamic = self._construction_values(
+                base, split_arguments(initializers.get(base) or ""), target, dynamic_type
+            )
+        for field in fields:
+            member = field["name"]
+            if field.get("inherited_from"):
+                continue
+            if field.get("vptr"):
+                values.append(f"&{dynamic_type}_vtable")
+                continue
+            if field.get("tag"):
+                values.append(f"{dynamic_type}_TAG")
+                continue
+            c_type = self.map_cpp_type_to_c(field["type"], field.get("canonical_type"))
+            expr = initializers.get(member)
+            if c_type in self.classes:
+                member_arguments = [] if expr is None else split_arguments(expr)
+                value, code = self._evaluate_construction(
+                    c_type, member_arguments, f"{target}.{member}"
+                )
+                values.append(value or "{0}")
+                if code:
+                    dynamic.append(code)
+            elif expr is not None and self._is_static_constant(expr):
+                values.append(expr)
+            else:
+                values.append("{0}" if "[" in c_type else self._field_zero_initializer(field) or "0")
+                if expr is not None:
+                    dynamic.append(f"{target}.{member} = {expr};")
+
+        # Leading constant stores of the body fold into the initializer
+        while statements and not dynamic:
+            store = member_assignment(statements[0])
+            if not store or store[0] not in field_names:
+                break
+            member, expr = store
+            expr = substitute_names(self._lower_static_expression(expr), bindings)
+            if not self._is_static_constant(expr):
+                break
+            values[field_names.index(member)] = expr
+            statements.pop(0)
+
+        if statements:
+            body = substitute_names("\n".join(statements), bindings)
+            code = self._lower_startup_code(body)
+            code = re.sub(r"\bself\s*->\s*", f"{target}.", code)
+            instance = f"&{target}"
+            if class_name != dynamic_type:
+                instance = cast_object(instance, class_name)
+            dynamic.append(re.sub(r"\bself\b", lambda _: instance, code))
+
+        return values, dynamic
+
+    def _c_global_definition(self, variable):
+        """C definition of a global with its evaluated initializer"""
+        definition = self._c_variable_declaration(variable)
+        initializer = self.static_initializers.get(variable["name"])
+        if initializer:
+            definition += f" = {initializer}"
+        return definition + ";"
+
+    def _c_global_constructors(self):
+        """Definition of global_constructors(), or "" when nothing is dynamic"""
+        if not self.global_constructors or not self._is_live("global_constructors"):
+            return ""
+        definition = f"{self._linkage('global_constructors')}void global_constructors(void) {{\n"
+        for name, code in self.global_constructors:
+            definition += f"    // {name}\n"
+            definition += "".join(f"    {line}\n" for line in code.split("\n"))
+        return definition + "}\n\n"
+
+    def _plan_struct_layouts(self):
+        """
+        Pack the bool and small enum fields of each emitted struct into
+        bit-fields, and print the size of every struct before and after.
+
+        A field is only packed when its address never escapes (& or a
+        reference binding anywhere in the program), and only in classes whose
+        method bodies are all known. Structs initialized positionally keep
+        their member order.
+        """
+        escaping = self._escaping_fields()
+        positional = self._positionally_initialized_classes()
+        sizes_before = {
+            name: c_type_size(self._enum_storage_type(info)) for name, info in self.enums.items()
+        }
+        sizes_after = dict(sizes_before)
+
+        def plan(class_name, visiting):
+            fields = self.classes[class_name]["fields"]
+            c_types = [self._c_field_type(field) for field in fields]
+            # Nested structs first, so their sizes are known
+            for c_type in c_types:
+                nested = c_type.split()[-1]
+                if nested in self.classes and nested not in sizes_after and nested not in visiting:
+                    plan(nested, visiting | {class_name})
+
+            bodies_known = all(method.get("body") for method in self._live_methods(class_name))
+            # A derived struct must start like its base: no reordering or packing
+            derived = self._in_hierarchy(class_name)
+            members = [
+                Member(
+                    field["name"],
+                    self._c_field_declaration(field),
+                    c_type_size(c_type, sizes_after),
+                    self._field_bits(c_type)
+                    if bodies_known and not derived and field["name"] not in escaping else None,
+                )
+                for field, c_type in zip(fields, c_types)
+            ]
+            layout = pack_struct(members, reorder=class_name not in positional and not derived)
+            layout.size_before = sum(c_type_size(c_type, sizes_before) for c_type in c_types)
+            sizes_before[class_name] = layout.size_before
+            sizes_after[class_name] = layout.size_after
+            self.struct_layouts[class_name] = layout
+
+        for class_name, _ in self._live_classes():
+            if class_name not in self.struct_layouts:
+                plan(class_name, set())
+
+        print("Struct layout (bytes per instance, before -> after):")
+        for class_name, layout in sorted(self.struct_layouts.items()):
+            packed = f" (bit-fields: {', '.join(layout.packed)})" if layout.packed else ""
+            print(f"  {class_name}: {layout.size_before} -> {layout.size_after}{packed}")
+        return sum(1 for layout in self.struct_layouts.values() if layout.packed)
+
+    def _type_sizes(self):
+        """Size in bytes of each enum and struct of the program, as emitted"""
+        sizes = {
+            name: c_type_size(self._enum_storage_type(info)) for name, info in self.enums.items()
+        }
+
+        def size(class_name, visiting):
+            if class_name in self.struct_layouts:
+                return self.struct_layouts[class_name].size_after
+            total = 0
+            for field in self.classes[class_name]["fields"]:
+                c_type = self.map_cpp_type_to_c(field["type"], field.get("canonical_type"))
+                nested = without_const(c_type).split()[-1]
+                if nested in self.classes and nested not in sizes and nested not in visiting:
+                    sizes[nested] = size(nested, visiting | {class_name})
+                total += c_type_size(c_type, sizes)
+            return total
+
+        for class_name in self.classes:
+            if class_name not in sizes:
+                sizes[class_name] = size(class_name, set())
+        return sizes
+
+    def _report_program_memory(self):
+        """
+        Record and print the const data XC8 places in program memory, with
+        the way the target device reads it back.
+        """
+        sizes = self._type_sizes()
+        for variable in self._global_variables():
+            c_type = self._c_variable_type(variable)
+            if is_const_object(c_type) and self._is_live(variable["name"]):
+                self.program_memory_data[variable["name"]] = c_type_size(c_type, sizes)
+
+        if not self.program_memory_data:
+            return
+        device = self.target_device
+        print(f"Program memory data ({device}, {program_memory_read(device)}):")
+        for name, size in self.program_memory_data.items():
+            words = program_memory_words(size, device)
+            print(f"  {name}: {size} bytes in {words} words")
+
+    def _plan_bit_lowering(self, graph):
+        """
+        Choose the bool globals and the bool-returning methods and functions
+        emitted with XC8's __bit type. A global qualifies when no body takes
+        its address or stores a value other than 0/1 to it; a function when
+        it is only ever called (never referenced as a value) and every value
+        it returns is 0/1. Interrupt handlers and main keep their types.
+
+        Types and lowered bodies come from the program IR.
+        """
+        program = self.program_ir
+        boolean_names = {
+            field.name
+            for struct in program.structs
+            for field in struct.fields
+            if field.c_type == "bool"
+        }
+        boolean_names.update(
+            variable.name for variable in program.globals if variable.c_type == "bool"
+        )
+
+        # Lowered body of every bool-returning method and function
+        functions = [
+            function for function in program.functions
+            if function.kind in ("method", "function", "main") and function.body
+        ]
+        predicates = {
+            function.name: function.code
+            for function in functions
+            if function.kind != "main" and function.return_type == "bool"
+            and not function.interrupt
+            # Vtable slots keep the declared return type
+            and not (
+                function.kind == "method"
+                and self.hierarchy.is_virtual(
+                    function.owner, function.name[len(function.owner) + 1:]
+                )
+            )
+        }
+        boolean_names.update(predicates)
+        self.boolean_names = boolean_names
+
+        referenced = {
+            target for targets in graph.references.values() for target in targets
+        }
+        self.bit_functions = {
+            name for name, body in predicates.items()
+            if name not in referenced and self._is_live(name)
+            and returns_are_boolean(body, boolean_names)
+        }
+
+        bodies = [function.code for function in functions]
+        self.bit_variables = {
+            variable.name for variable in program.globals
+            if variable.c_type == "bool" and self._is_live(variable.name)
+            and not self._is_system_parameter(variable.name)
+            and not variable.initializer
+            and variable.name not in dict(self.global_constructors)
+            and all(stores_are_boolean(body, variable.name, boolean_names) for body in bodies)
+        }
+
+        lowered = sorted(self.bit_variables | self.bit_functions)
+        if lowered:
+            print(f"Bit lowering: {', '.join(lowered)}")
+        return len(lowered)
+
+    def _plan_bank_placement(self, graph):
+        """
+        Count the accesses of each global RAM object in the lowered code of
+        the live functions, then place the hottest in common RAM and the
+        others in the bank of the objects they are used with.
+
+        Const data (program memory) and __bit globals are left alone, as is
+        everything on devices without a memory map. The globals and the
+        lowered functions come from the program IR.
+        """
+        memory_map = device_memory_map(self.target_device)
+        if memory_map is None or len(memory_map.banks) < 2:
+            print(
+                f"Warning: no banked memory map for {self.target_device}, "
+                "data placement skipped"
+            )
+            return
+
+        program = self.program_ir
+        sizes = self._type_sizes()
+        candidates = {
+            variable.name: c_type_size(variable.c_type, sizes)
+            for variable in program.globals
+            if self._is_live(variable.name)
+            and variable.name not in self.bit_variables
+            and not is_const_object(variable.c_type)
+        }
+        accesses = {
+            function.name: count_accesses(function.code, candidates)
+            for function in program.functions if self._is_live(function.name)
+        }
+
+        # Globals reached both from an interrupt handler and from main
+        interrupts = [root for root in self._entry_points() if root != "main"]
+        handler_side = graph.reachable(interrupts)
+        main_side = graph.reachable(["main"])
+        shared = set()
+        if interrupts:
+            from_handlers = {g for name in accesses if name in handler_side for g in accesses[name]}
+            from_main = {g for name in accesses if name in main_side for g in accesses[name]}
+            shared = from_handlers & from_main
+
+        affinity = {}
+        for counts in accesses.values():
+            names = sorted(counts)
+            for index, first in enumerate(names):
+                for second in names[index + 1:]:
+                    together = min(counts[first], counts[second])
+                    affinity[(first, second)] = affinity.get((first, second), 0) + together
+
+        objects = [
+            PlacedObject(
+                name,
+                size,
+                sum(counts.get(name, 0) for counts in accesses.values()),
+                name in shared,
+            )
+            for name, size in candidates.items()
+        ]
+        self.data_placement = plan_placement(objects, affinity, memory_map)
+        print(self.data_placement.format())
+        return len(self.data_placement.common) + len(self.data_placement.banks)
+
+    def _c_variable_type(self, variable):
+        """C type of a global variable"""
+        c_type = self.map_cpp_type_to_c(variable["type"], variable.get("canonical_type"))
+        if variable["name"] in self.ram_constants:
+            return without_const(c_type)
+        return c_type
+
+    def _escaping_fields(self):
+        """Names whose address is taken or bound to a reference in any body"""
+        member_path = r"(?:this\s*->\s*|\w+\s*(?:\.|->)\s*)*"
+        address_of = re.compile(r"(?<![&\w)\]])&\s*\(?\s*" + member_path + r"(\w+)")
+        reference = re.compile(r"\w\s*&\s*\w+\s*=\s*" + member_path + r"(\w+)")
+
+        bodies = [
+            method.get("body") or ""
+            for class_info in self.classes.values()
+            for method in class_info["methods"]
+        ]
+        bodies += [function.get("body") or "" for function in self.functions]
+        if self.main_function:
+            bodies.append(self.main_function.get("body") or "")
+
+        escaping = set()
+        for body in bodies:
+            escaping.update(address_of.findall(body))
+            escaping.update(reference.findall(body))
+        return escaping
+
+    def _positionally_initialized_classes(self):
+        """
+        Classes of globals defined with a positional "= {...}" initializer,
+        and the classes of their object members
+        """
+        pending = [
+            without_const(self._c_variable_type(variable))
+            for variable in self._global_variables()
+            if variable["name"] in self.static_initializers
+        ]
+        classes = set()
+        while pending:
+            class_name = pending.pop()
+            if class_name not in self.classes or class_name in classes:
+                continue
+            classes.add(class_name)
+            pending += [
+                self.map_cpp_type_to_c(field["type"], field.get("canonical_type"))
+                for field in self.classes[class_name]["fields"]
+            ]
+        return classes
+
+    def _field_bits(self, c_type):
+        """
+        (bit-field type, width) a field of this C type packs into, or None:
+        a bool takes one bit, an unsigned enum the bits of its largest value
+        """
+        if c_type == "bool":
+            return ("bool", 1)
+        enum_info = self.enums.get(c_type)
+        if enum_info and enum_info["values"]:
+            values = [int(value["value"]) for value in enum_info["values"]]
+            width = max(1, max(values).bit_length())
+            if min(values) >= 0 and width < 8:
+                return ("unsigned", width)
+        return None
+
+    def _c_struct_members(self, class_name):
+        """C member declarations of a lowered class, packed when planned"""
+        layout = self.struct_layouts.get(class_name)
+        if layout:
+            return layout.declarations
+        return [self._c_field_declaration(field) for field in self.classes[class_name]["fields"]]
+
+    def _check_stack_depth(self, graph):
+        """
+        Compare the deepest call chains from main and the interrupt handlers
+        with the hardware stack of the target device, and look for recursion.
+        Inlined methods take no stack level; functions doing multi-byte
+        arithmetic take one more on parts without a hardware multiplier.
+
+        Returns:
+            Error message when stack_check is 'error' and a problem was found
+        """
+        interrupts = [root for root in self._entry_points() if root != "main"]
+        if not self.main_function and not interrupts:
+            return None
+
+        self.stack_report = analyze_stack(
+            graph,
+            "main" if self.main_function else None,
+            interrupts,
+            self.target_device,
+            free_calls=self.inlined_methods,
+            helper_callers=self._arithmetic_helper_callers(),
+        )
+        print(self.stack_report.format())
+
+        problems = self.stack_report.problems()
+        if problems and self.stack_check == "error":
+            return "; ".join(problems)
+        for problem in problems:
+            print(f"Warning: {problem}")
+        return None
+
+    def _arithmetic_helper_callers(self):
+        """
+        Functions of the program IR whose lowered code does a multiply,
+        divide or modulo XC8 implements with a library call on the target
+        (none on PIC18, which has a hardware multiplier)
+        """
+        if device_family(self.target_device) not in HELPER_CALL_FAMILIES:
+            return []
+
+        program = self.program_ir
+        sizes = self._type_sizes()
+
+        def element_size(c_type):
+            # An element of an array
+            return c_type_size(re.sub(r"\s*\[.*", "", c_type), sizes)
+
+        widths = {}
+        scalars = [(variable.name, variable.c_type) for variable in program.globals] + [
+            (field.name, field.c_type) for struct in program.structs for field in struct.fields
+        ]
+        for name, c_type in scalars:
+            # The widest of the fields sharing a name; vtable slots are no operands
+            if "(" not in c_type:
+                widths[name] = max(element_size(c_type), widths.get(name, 0))
+
+        type_names = {struct.name for struct in program.structs} | {
+            enum.name for enum in program.enums
+        }
+        return [
+            function.name
+            for function in program.functions
+            if calls_arithmetic_helper(
+                function.code,
+                dict(widths, **{
+                    parameter.name: element_size(parameter.c_type)
+                    for parameter in function.parameters
+                }),
+                self._is_static_constant,
+                type_names,
+            )
+        ]
+
+    def _plan_internal_linkage(self, graph):
+        """
+        Give internal linkage (static, no prototype in the shared headers) to
+        the functions, methods and globals only the unit defining them uses,
+        once dead code elimination and inlining are decided.
+
+        Does nothing without an entry point: a library's symbols are used by
+        units outside the batch.
+        """
+        roots = self._entry_points()
+        if not roots:
+            return 0
+        live = self.live_symbols if self.live_symbols is not None else graph.reachable(roots)
+        self.internal_symbols = self.linked_program.internal_symbols(
+            live, self.inlined_methods
+        )
+        if self.internal_symbols:
+            print(f"Internal linkage: {', '.join(sorted(self.internal_symbols))}")
+        return len(self.internal_symbols)
+
+    def _eliminate_dead_code(self, graph):
+        """
+        Restrict the emitted C to the symbols reachable from main and the
+        interrupt handlers (flash is the scarcest resource on PIC). Methods,
+        classes, enums and globals nothing reaches are dropped, and so are the
+        Class_init/Class_cleanup helpers no lowered code calls.
+
+        Does nothing when there is no entry point (e.g. a library translated
+        on its own).
+        """
+        roots = self._entry_points()
+        if not roots:
+            return
+
+        self.live_symbols = graph.reachable(roots)
+
+        removed = sorted(set(graph.symbols) - self.live_symbols)
+        if removed:
+            print(
+                f"Dead code elimination: removed {len(removed)} of "
+                f"{len(graph.symbols)} symbols ({', '.join(removed)})"
+            )
+        return len(removed)
+
+    def _select_inlined_methods(self, graph):
+        """
+        Choose the small leaf methods emitted as static inline functions,
+        following the inline cost model and the stack depth they run at.
+        The lowered bodies and the parameters come from the program IR.
+
+        Like dead code elimination this needs the whole program: without an
+        entry point nothing is inlined.
+        """
+        roots = self._entry_points()
+        if not roots:
+            return
+
+        candidates = {}
+        arguments = {}
+        for method in self.program_ir.functions:
+            if (
+                method.kind == "method" and method.body
+                and self._is_live(method.owner) and self._is_live(method.name)
+            ):
+                candidates[method.name] = method.code
+                self_argument = 0 if method.owner in self.singletons else 1
+                arguments[method.name] = self_argument + len(method.parameters)
+
+        # Singleton methods reach their instance, declared before any inline
+        # definition
+        global_names = [
+            var["name"] for var in self._global_variables()
+            if var["name"] not in self.singletons.values()
+        ]
+
+        self.inlined_methods = select_inline_candidates(
+            graph,
+            candidates,
+            arguments,
+            roots,
+            self.inline_model,
+            global_names,
+        )
+        if self.inlined_methods:
+            print(f"Inlined methods: {', '.join(sorted(self.inlined_methods))}")
+        return len(self.inlined_methods)
+
+    def _is_inlined(self, class_name, method):
+        """Check whether a method is emitted as a static inline function"""
+        return f"{class_name}_{method['name']}" in self.inlined_methods
+
+    def _c_inline_definition(self, class_name, method, body):
+        """static inline definition of a method, body already lowered and indented"""
+        prototype = self._c_prototype(method, f"{class_name}_{method['name']}", class_name)
+        return f"static inline {prototype} {{\n{body}}}\n"
+
+    def _is_live(self, name):
+        """Check whether a C symbol is emitted"""
+        return self.live_symbols is None or name in self.live_symbols
+
+    def _live_classes(self):
+        """(name, info) of the classes emitted"""
+        return [(name, info) for name, info in self.classes.items() if self._is_live(name)]
+
+    def _live_methods(self, class_name):
+        """Methods of a class that are emitted"""
+        return [
+            method for method in self.classes[class_name]["methods"]
+            if self._is_live(f"{class_name}_{method['name']}")
+            # A pure virtual method without definition has no C function
+            and (method.get("body") or not method.get("is_pure"))
+        ]
+
+    def _live_enums(self):
+        """(name, info) of the enums emitted"""
+        return [(name, info) for name, info in self.enums.items() if self._is_live(name)]
+
+    def _live_functions(self):
+        """Standalone functions emitted"""
+        return [func for func in self.functions if self._is_live(func["name"])]
+
+    def _live_variables(self):
+        """Global variables emitted"""
+        return [var for var in self._global_variables() if self._is_live(var["name"])]
+
+    def _enum_storage_type(self, enum_info):
+        """
+        C type used to store a scoped enum: its declared underlying type, or
+        the smallest exact-width type holding its values when Clang reports
+        the default int (XC8 would otherwise make the enum int-sized).
+        """
+        underlying_type = enum_info.get("underlying_type", "int")
+        c_type = self.map_cpp_type_to_c(underlying_type, enum_info.get("canonical_type"))
+        if c_type != "int":
+            return c_type
+        return smallest_integer_type(int(value["value"]) for value in enum_info["values"])
+
+    def _enum_constant_name(self, enum_name, constant_name):
+        """C name of a scoped enum constant (LedId::LED_0 -> LedId_LED_0)"""
+        return f"{enum_name}_{constant_name}"
+
+    def _c_enum_definition(self, enum_name, enum_info):
+        """
+        C definition of a scoped enum: a typedef of its storage type plus an
+        anonymous enum of prefixed constants, e.g.
+
+            typedef uint8_t LedId;
+            enum {
+                LedId_LED_0 = 0,
+            };
+        """
+        definition = f"typedef {self._enum_storage_type(enum_info)} {enum_name};\n"
+        if enum_info["values"]:
+            definition += "enum {\n"
+            for value in enum_info["values"]:
+                constant = self._enum_constant_name(enum_name, value["name"])
+                definition += f"    {constant} = {value['value']},\n"
+            definition += "};\n"
+        return definition + "\n"
+
+    def _lower_enum_references(self, code):
+        """
+        Rewrite scoped enum constants to their prefixed C names
+        (ButtonState::RELEASED -> ButtonState_RELEASED).
+        """
+        def lower(match):
+            enum_name = match.group(1)
+            if enum_name in self.enums:
+                return self._enum_constant_name(enum_name, match.group(2))
+            return match.group(0)
+
+        return re.sub(r"\b(\w+)::(\w+)", lower, code)
+
+    def _lower_static_members(self, code):
+        """
+        Rewrite qualified static members to the globals they become
+        (Button::DEBOUNCE_THRESHOLD -> DEBOUNCE_THRESHOLD).
+        """
+        members = {
+            (variable["static_member_of"], variable["name"])
+            for variable in self.variables if variable.get("static_member_of")
+        }
+        if not members:
+            return code
+
+        def lower(match):
+            if (match.group(1), match.group(2)) in members:
+                return match.group(2)
+            return match.group(0)
+
+        return re.sub(r"\b(\w+)::(\w+)", lower, code)
+
+    def _referenced_enums(self, body):
+        """Scoped enums whose constants a body references"""
+        return sorted(set(re.findall(r"\b(\w+)::\w+", body)) & set(self.enums))
+
+    def _c_field_type(self, field):
+        """C type of a struct field"""
+        if field.get("vptr"):
+            # Pointer to the vtable type, declared after the structs
+            return field["type"]
+        return self.map_cpp_type_to_c(field["type"], field.get("canonical_type"))
+
+    def _c_field_declaration(self, field):
+        """C declaration of a struct field ("uint8_t buffer[16]")"""
+        return c_declaration(self._c_field_type(field), field["name"])
+
+    def _c_variable_declaration(self, variable):
+        """C declaration of a global variable, without initializer"""
+        if variable["name"] in self.bit_variables:
+            return f"__bit {variable['name']}"
+        declaration = c_declaration(self._c_variable_type(variable), variable["name"])
+        qualifier = self.data_placement.qualifier(variable["name"]) if self.data_placement else ""
+        return f"{qualifier} {declaration}" if qualifier else declaration
+
+    def _field_zero_initializer(self, field):
+        """
+        Value a field is cleared to by the generated _init function, or None
+        for fields left alone (structs, arrays)
+        """
+        c_type = self._c_field_type(field)
+        if c_type == "bool":
+            return "false"
+        if c_type.endswith("*"):
+            return "0"
+        if "[" in c_type or c_type in self.classes:
+            return None
+        if c_type in self.enums or "int" in c_type or c_type in (
+            "char", "signed char", "unsigned char", "short", "unsigned short",
+            "long", "unsigned long", "long long", "unsigned long long",
+        ):
+            return "0"
+        return None
+
+    def _field_initial_value(self, class_name, field):
+        """
+        Value the generated Class_init function gives a field: the vtable of
+        the class for the vptr, its tag for the type tag, the zero
+        initializer otherwise
+        """
+        if field.get("vptr"):
+            return f"&{class_name}_vtable"
+        if field.get("tag"):
+            return f"{class_name}_TAG"
+        return self._field_zero_initializer(field)
+
+    def _return_c_type(self, declaration):
+        """C return type of a method or function declaration"""
+        return_type = self.extract_return_type(declaration.get("type", "void ()"))
+        canonical_type = declaration.get("canonical_type")
+        if canonical_type:
+            canonical_type = self.extract_return_type(canonical_type)
+        return self.map_cpp_type_to_c(return_type, canonical_type)
+
+    def _c_parameters(self, declaration):
+        """
+        C parameter list of a method or function (without self).
+
+        Uses the ParmVarDecl types and names of the AST; declarations parsed
+        without them fall back to guessing names from the body.
+        """
+        params = declaration.get("params")
+        if params:
+            return ", ".join(
+                c_declaration(
+                    self.map_cpp_type_to_c(param["type"], param.get("canonical_type")),
+                    param["name"] or f"param{index}",
+                )
+                for index, param in enumerate(params)
+            )
+
+        return self._extract_method_parameters(
+            declaration.get("type", "void ()"),
+            declaration.get("body") or "",
+            declaration["name"],
+        )
+
+    def _c_prototype(self, declaration, c_name, class_name=None):
+        """
+        C prototype of a method or function, e.g.
+        "unsigned char Timer0_getValue(const Timer0* self)".
+        Methods (class_name given) take the instance as first parameter,
+        through a pointer to const for const methods of classes without
+        mutable members; methods of singleton classes take none.
+        """
+        params = self._c_parameters(declaration)
+        if class_name and class_name not in self.singletons:
+            self_type = f"{class_name}*"
+            fields = self.classes.get(class_name, {}).get("fields", [])
+            if declaration.get("is_const") and not any(field.get("mutable") for field in fields):
+                self_type = f"const {self_type}"
+            params = f"{self_type} self" + (f", {params}" if params else "")
+        return_type = "__bit" if c_name in self.bit_functions else self._return_c_type(declaration)
+        return f"{return_type} {c_name}({params or 'void'})"
+
+    def _transpile_method_body(self, body, class_name):
+        """Transpile C++ method body to C"""
+        if not body:
+            return "    // Empty method body\n"
+        if body in self.dispatch_bodies:
+            return self._indent_lowered_body(body)
+
+        lowered = self._memoized_lowering(
+            "method",
+            body,
+            [class_name, self._referenced_enums(body)],
+            lambda: self._transpile_lines(
+                body, lambda line: self._transpile_statement(line, class_name)
+            ),
+        )
+        lowered = self._lower_method_dispatch(lowered, class_name)
+        if class_name in self.singletons:
+            lowered = bind_instance(lowered, self.singletons[class_name])
+        return lowered
+
+    def _transpile_lines(self, body, transpile_statement):
+        """Transpile a body line by line, keeping blank lines and comments"""
+        lines = body.split("\n")
+        transpiled_lines = []
 
         for line in lines:
             line = line.strip()
             if not line or line.startswith("//"):
                 transpiled_lines.append(f"    {line}\n")
             else:
-                transpiled_line = self._transpile_statement(line, class_name)
+                transpiled_line = transpile_statement(line)
                 transpiled_lines.append(f"    {transpiled_line}\n")
 
         return "".join(transpiled_lines)
@@ -1028,7 +3860,8 @@ class PythonTranspiler:
         """Transpile a single C++ statement to C"""
         original_statement = statement
         
-        # Handle enum class access: LedId::LED_0 -> LED_0, ButtonState::PRESSED -> PRESSED
+        # Handle enum class access: LedId::LED_0 -> LedId_LED_0
+        statement = self._lower_enum_references(statement)
         statement = re.sub(r'\b\w+::([\w_]+)', r'\1', statement)
         
         # Handle member variable access for common class variables
@@ -1041,8 +3874,13 @@ class PythonTranspiler:
         for var in all_member_vars:
             statement = re.sub(rf'\b{var}\b(?!\s*\()', rf'self->{var}', statement)
         
-        # Handle method calls within the same class
+        # Handle method calls within the same class (and their specialized
+        # clones)
         method_calls = ['turnOn', 'turnOff', 'toggle', 'delay50ms', 'readHardwareState']
+        method_calls += [
+            method['name'] for method in self.classes.get(class_name, {}).get('methods', [])
+            if method.get('specialization_of')
+        ]
         for method in method_calls:
             statement = re.sub(
                 rf'\b{method}\(\)', rf'{class_name}_{method}(self)', statement
@@ -1071,10 +3909,11 @@ class PythonTranspiler:
 
     def _generate_main_function(self, f):
         """Generate C code for the main function"""
-        return_type = self.extract_return_type(self.main_function["type"])
-        c_return_type = self.map_cpp_type_to_c(return_type)
+        c_return_type = self._return_c_type(self.main_function)
 
         f.write(f"{c_return_type} main(void) {{\n")
+        if self._c_global_constructors():
+            f.write("    global_constructors();\n")
 
         if self.main_function.get("body"):
             transpiled_body = self._transpile_main_body(self.main_function["body"])
@@ -1087,11 +3926,9 @@ class PythonTranspiler:
 
     def _generate_function(self, f, function):
         """Generate C code for a standalone function"""
-        return_type = self.extract_return_type(function["type"])
-        c_return_type = self.map_cpp_type_to_c(return_type)
-        func_name = function["name"]
+        c_return_type = self._return_c_type(function)
 
-        f.write(f"{c_return_type} {func_name}(void) {{\n")
+        f.write(f"{self._c_prototype(function, function['name'])} {{\n")
 
         if function.get("body"):
             transpiled_body = self._transpile_function_body(function["body"])
@@ -1101,25 +3938,14 @@ class PythonTranspiler:
             if c_return_type != "void":
                 if c_return_type == "bool":
                     f.write("    return false;\n")
-                elif "int" in c_return_type:
+                elif c_return_type not in self.classes:
                     f.write("    return 0;\n")
 
         f.write("}\n\n")
 
     def _generate_global_variable(self, f, variable):
-        """Generate C code for a global variable declaration"""
-        var_name = variable["name"]
-        var_type = variable["type"]
-        constructor_args = variable.get("constructor_args")
-        
-        # Generate variable declaration
-        f.write(f"{var_type} {var_name}")
-        
-        # Add initialization if constructor arguments are present
-        if constructor_args:
-            f.write(f" = {{{constructor_args}}}")
-        
-        f.write(";\n")
+        """Generate C code for a global variable definition"""
+        f.write(f"{self._c_global_definition(variable)}\n")
 
     def _get_variable_type(self, var_name):
         """Get the type of a variable from global variables list"""
@@ -1133,45 +3959,37 @@ class PythonTranspiler:
         if not body:
             return "    // Empty function body\n"
 
-        lines = body.split("\n")
-        transpiled_lines = []
-
-        for line in lines:
-            line = line.strip()
-            if not line or line.startswith("//"):
-                transpiled_lines.append(f"    {line}\n")
-            else:
-                transpiled_line = self._transpile_main_statement(line)
-                transpiled_lines.append(f"    {transpiled_line}\n")
-
-        return "".join(transpiled_lines)
+        return self._lower_method_dispatch(self._memoized_lowering(
+            "main",
+            body,
+            self._main_statement_environment(body),
+            lambda: self._transpile_lines(body, self._transpile_main_statement),
+        ))
 
     def _transpile_main_body(self, body):
         """Transpile C++ main function body to C"""
         if not body:
             return "    return 0;\n"
 
-        lines = body.split("\n")
-        transpiled_lines = []
-
-        for line in lines:
-            line = line.strip()
-            if not line or line.startswith("//"):
-                transpiled_lines.append(f"    {line}\n")
-            else:
-                transpiled_line = self._transpile_main_statement(line)
-                transpiled_lines.append(f"    {transpiled_line}\n")
-
-        return "".join(transpiled_lines)
+        return self._lower_method_dispatch(self._memoized_lowering(
+            "main",
+            body,
+            self._main_statement_environment(body),
+            lambda: self._transpile_lines(body, self._transpile_main_statement),
+        ))
 
     def _transpile_main_statement(self, statement):
         """Transpile a main function statement"""
+        statement = self._lower_enum_references(statement)
+
         # Handle class instantiation: ClassName varName; -> ClassName varName; ClassName_init(&varName);
         class_instantiation = re.match(r"^(\w+)\s+(\w+);$", statement)
         if class_instantiation:
             class_type = class_instantiation.group(1)
             var_name = class_instantiation.group(2)
             if class_type in self.classes:
+                if not self._class_has_initializer(class_type):
+                    return f"{class_type} {var_name};"
                 return f"{class_type} {var_name};\n    {class_type}_init(&{var_name});"
 
         # Handle method calls: varName.methodName() -> ClassName_methodName(&varName)
@@ -1222,22 +4040,15 @@ class PythonTranspiler:
 
         return statement
 
-    def map_cpp_type_to_c(self, cpp_type):
-        """Type mapping from C++ to C"""
-        # First check if it's a known enum type
-        if cpp_type in self.enums:
-            return cpp_type
-            
-        type_map = {
-            "bool": "bool",
-            "int": "int",
-            "unsigned int": "unsigned int",
-            "float": "float",
-            "double": "double",
-            "char": "char",
-            "void": "void",
-        }
-        return type_map.get(cpp_type, "int")
+    def map_cpp_type_to_c(self, cpp_type, canonical_type=None):
+        """
+        Type mapping from C++ to C (see c_types.map_type). Exact-width
+        integers, signedness, pointers and arrays are kept; typedefs unknown
+        to C resolve through their canonical type.
+        """
+        return map_type(
+            cpp_type, canonical_type, list(self.classes) + list(self.enums)
+        )
 
     def extract_return_type(self, function_type):
         """Extract return type from function signature"""
@@ -1245,82 +4056,6 @@ class PythonTranspiler:
             return function_type.split("(")[0].strip()
         return "void"
 
-    def _extract_method_parameters(self, function_type, method_body=None, method_name=None):
-        """Extract parameters from method signature and detect missing ones from method body"""
-        params = []
-        
-        # First extract parameters from function signature
-        if "(" in function_type:
-            params_match = re.search(r'\(([^)]*)\)', function_type)
-            if params_match:
-                params_str = params_match.group(1).strip()
-                if params_str:
-                    param_types = [p.strip() for p in params_str.split(',') if p.strip()]
-                    
-                    for i, param_type in enumerate(param_types):
-                        c_type = self.map_cpp_type_to_c(param_type)
-                        # Generate parameter names based on method patterns
-                        if param_type == "bool":
-                            param_name = "newState"
-                        elif "int" in param_type:
-                            if i == 0:
-                                param_name = "count"
-                            elif i == 1:
-                                param_name = "delayMs" 
-                            else:
-                                param_name = f"value{i}"
-                        else:
-                            param_name = f"param{i}"
-                        
-                        params.append(f"{c_type} {param_name}")
-        
-        # Then analyze method body to detect missing parameters
-        if method_body:
-            missing_params = self._detect_missing_parameters(method_body, method_name)
-            for param_type, param_name in missing_params:
-                param_str = f"{param_type} {param_name}"
-                if param_str not in params:  # Avoid duplicates
-                    params.append(param_str)
-        
-        return ", ".join(params)
-    
-    def _detect_missing_parameters(self, method_body, method_name):
-        """Detect parameters that are used in method body but not declared"""
-        missing_params = []
-        
-        # Known parameter patterns based on specific method names
-        if method_name == 'delay':
-            # Timer0_delay only needs milliseconds parameter - be very explicit
-            if 'milliseconds' in method_body:
-                missing_params.append(('unsigned int', 'milliseconds'))
-            # Do NOT add any other parameters for delay methods
-            return missing_params
-        
-        if method_name == 'setState':
-            # Led_setState needs newState parameter
-            if 'newState' in method_body:
-                missing_params.append(('bool', 'newState'))
-            
-        if method_name == 'blink':
-            # Led_blink needs count and delayMs parameters
-            if re.search(r'\bcount\b(?!s)', method_body):
-                missing_params.append(('unsigned int', 'count'))
-            if 'delayMs' in method_body:
-                missing_params.append(('unsigned int', 'delayMs'))
-        
-        # Look for other common parameter patterns (but not for delay methods)
-        if re.search(r'\bnewState\b', method_body) and ('bool', 'newState') not in missing_params:
-            missing_params.append(('bool', 'newState'))
-            
-        # Be more precise with count - look for it in for loops but not as 'counts'
-        if re.search(r'\bcount\b(?!s)', method_body) and ('unsigned int', 'count') not in missing_params:
-            missing_params.append(('unsigned int', 'count'))
-            
-        if re.search(r'\bdelayMs\b', method_body) and ('unsigned int', 'delayMs') not in missing_params:
-            missing_params.append(('unsigned int', 'delayMs'))
-        
-        return missing_params
-
     def cleanup_temp_files(self):
         """Clean up temporary files"""
         for temp_file in self.temp_files:
@@ -1344,18 +4079,60 @@ class PythonTranspiler:
         Returns:
             Dictionary mapping input files to TranspilerResult objects
         """
-        results = {}
-        
         print(f"Batch transpilation: {len(cpp_files)} files -> {output_dir}")
-        
+
+        # Steps 1-2: Collect and read all related files from all input files
+        all_related_files = self._load_batch_sources(cpp_files)
+
+        # Step 3: Analyze all files with Clang AST (collect all information)
+        ast_dumps = [self.analyze_with_clang(file_path) for file_path in all_related_files]
+
+        return self._complete_batch(cpp_files, output_dir, all_related_files, ast_dumps)
+
+    async def transpile_batch_async(self, cpp_files, output_dir, semaphore=None):
+        """
+        Asynchronous variant of transpile_batch().
+
+        Clang analyses of all related files run concurrently (bounded by
+        ``semaphore`` when given); the merge and generation steps run in the
+        default executor.
+        """
+        import asyncio
+
+        print(f"Batch transpilation: {len(cpp_files)} files -> {output_dir}")
+
+        all_related_files = self._load_batch_sources(cpp_files)
+
+        ast_dumps = await asyncio.gather(
+            *(
+                self.analyze_with_clang_async(file_path, semaphore)
+                for file_path in all_related_files
+            )
+        )
+
+        loop = asyncio.get_running_loop()
+        return await loop.run_in_executor(
+            None,
+            functools.partial(
+                self._complete_batch,
+                cpp_files,
+                output_dir,
+                all_related_files,
+                ast_dumps,
+            ),
+        )
+
+    def _load_batch_sources(self, cpp_files):
+        """Collect and read all files related to the batch inputs"""
         # Step 1: Collect all related files from all input files
         all_related_files = set()
         for cpp_file in cpp_files:
             related_files = self._discover_related_files(str(cpp_file))
             all_related_files.update(related_files)
-        
+        all_related_files = sorted(all_related_files)
+
         print(f"Found {len(all_related_files)} total related files")
-        
+
         # Step 2: Read all source files
         self.source_files = {}
         for file_path in all_related_files:
@@ -1365,31 +4142,84 @@ class PythonTranspiler:
             except Exception as e:
                 print(f"Failed to read file {file_path}: {e}")
                 continue
-        
+
         # Copy source files for compatibility
         self.all_source_codes = self.source_files.copy()
-        
-        # Step 3: Analyze all files with Clang AST (collect all information)
-        for file_path in all_related_files:
-            ast_dump = self.analyze_with_clang(file_path)
+
+        return all_related_files
+
+    def _complete_batch(self, cpp_files, output_dir, all_related_files, ast_dumps):
+        """Merge the AST dumps of all batch files and generate the C outputs"""
+        results = {}
+
+        for file_path, ast_dump in zip(all_related_files, ast_dumps):
             if not ast_dump:
                 print(f"Failed to analyze {file_path} with Clang")
                 continue
-            
+
             # Parse AST semantically for each file (additive approach)
             self.parse_ast_dump(ast_dump, source_file=file_path)
-        
+
         # Step 4: Extract method bodies from implementation files
         self._extract_method_bodies_from_implementations()
+        self._lower_reference_parameters()
+
+        # Drop unreachable code, pick the methods to inline and check the
+        # hardware stack
+        stack_error = self._run_program_passes(
+            self._lower_body,
+            self._lower_body,
+            self._lower_body,
+            link_units=True,
+        )
+        if stack_error:
+            print(f"Error: {stack_error}")
+            for cpp_file in cpp_files:
+                result = TranspilerResult()
+                result.success = False
+                result.error_message = stack_error
+                result.metrics = self.pass_manager.metrics()
+                results[str(cpp_file)] = result
+            return results
+        # Bodies lowered from here on are written out
+        self.emitting = True
+
+        if self.amalgamate:
+            # One C file for the whole batch, shared by every input's result
+            output_file = Path(output_dir) / AMALGAMATED_FILENAME
+            result = TranspilerResult()
+            try:
+                self.generate_amalgamated_file(cpp_files, str(output_file))
+                with open(output_file, "r", encoding="utf-8") as f:
+                    result.generated_c_code = f.read()
+                result.success = True
+            except Exception as e:
+                result.error_message = f"Failed to generate {output_file}: {e}"
+                print(f"Error generating {output_file}: {e}")
+            self._save_lowering_memo()
+            self._report_passes()
+            result.metrics = self.pass_manager.metrics()
+            for cpp_file in cpp_files:
+                results[str(cpp_file)] = result
+            print("SUCCESS: Batch transpilation completed!")
+            return results
         
         # Step 5: Generate shared header file with all common definitions
         shared_header_path = Path(output_dir) / "shared_definitions.h"
         self.generate_shared_header_file(str(shared_header_path))
         
-        # Step 6: Generate individual C files for each input file
-        for cpp_file in cpp_files:
-            output_file = Path(output_dir) / f"{Path(cpp_file).stem}.c"
+        # Step 6: Generate one C file per translation unit (led.cpp and led.hpp
+        # share led.c), holding the definitions located in that unit
+        unit_results = {}
+        for cpp_file in sorted(cpp_files, key=str):
+            unit = self._unit_name(cpp_file)
+            if unit in unit_results:
+                results[str(cpp_file)] = unit_results[unit]
+                continue
+
+            output_file = Path(output_dir) / f"{unit}.c"
             result = TranspilerResult()
+            unit_results[unit] = result
             
             try:
                 # Generate C file with only relevant content for this source file
@@ -1408,7 +4238,12 @@ class PythonTranspiler:
                 print(f"Error generating {output_file}: {e}")
             
             results[str(cpp_file)] = result
-        
+
+        self._save_lowering_memo()
+        self._report_passes()
+        for result in unit_results.values():
+            result.metrics = self.pass_manager.metrics()
+
         print("SUCCESS: Batch transpilation completed!")
         return results
 
@@ -1425,7 +4260,73 @@ class PythonTranspiler:
  * Contains common enums, structs, and function declarations
  */
 
-#include <xc.h>
+"""
+        header_content += self._c_type_definitions()
+
+        # Add global variable declarations
+        live_variables = self._live_variables()
+        if live_variables:
+            header_content += "// === Global Variable Declarations ===\n"
+            for var in live_variables:
+                if var["name"] not in self.internal_symbols:
+                    header_content += f"extern {self._c_variable_declaration(var)};\n"
+            header_content += "\n"
+
+        vtables = [
+            class_name for class_name in self._live_vtables()
+            if f"{class_name}_vtable" not in self.internal_symbols
+        ]
+        if vtables:
+            header_content += "// === Virtual Table Declarations ===\n"
+            for class_name in vtables:
+                header_content += f"extern {self._c_vtable_declaration(class_name)};\n"
+            header_content += "\n"
+
+        # Add function declarations
+        if self.classes:
+            header_content += "// === Function Declarations ===\n"
+            for class_name, class_info in self._live_classes():
+                for method in self._live_methods(class_name):
+                    if self._is_inlined(class_name, method):
+                        body = self._lower_body(method['body'], class_name)
+                        body = self._indent_lowered_body(body)
+                        header_content += self._c_inline_definition(class_name, method, body)
+                        continue
+                    if f"{class_name}_{method['name']}" in self.internal_symbols:
+                        continue
+                    prototype = self._c_prototype(
+                        method, f"{class_name}_{method['name']}", class_name
+                    )
+                    header_content += f"{prototype};\n"
+                header_content += "\n"
+
+        # Add standalone function declarations
+        if self.functions:
+            header_content += "// === Standalone Function Declarations ===\n"
+            for func in self._live_functions():
+                # Skip main, and functions only their own unit calls
+                if func['name'] not in ['main'] and func['name'] not in self.internal_symbols:
+                    prototype = self._c_prototype(func, func['name'])
+                    if func['name'].startswith('PIN_MANAGER_'):
+                        header_content += f"{prototype}; // Implemented in pin_manager.c\n"
+                    else:
+                        header_content += f"{prototype};\n"
+            header_content += "\n"
+
+        if self._c_global_constructors():
+            header_content += "void global_constructors(void);\n\n"
+
+        header_content += "#endif // SHARED_DEFINITIONS_H\n"
+
+        # Write header file (unchanged content keeps its timestamp)
+        write_if_changed(header_file, header_content)
+
+    def _c_type_definitions(self):
+        """
+        Includes, enums, constants, pin definitions and structs every
+        generated C file of a batch needs
+        """
+        content = """#include <xc.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -1439,24 +4340,19 @@ class PythonTranspiler:
 
         # Add enums
         if self.enums:
-            header_content += "// === Enums ===\n"
-            for enum_name, enum_info in self.enums.items():
-                header_content += f"typedef enum {{\n"
-                for value_info in enum_info['values']:
-                    value_name = value_info['name']
-                    if 'value' in value_info and value_info['value'] is not None:
-                        header_content += f"    {value_name} = {value_info['value']},\n"
-                    else:
-                        header_content += f"    {value_name},\n"
-                header_content += f"}} {enum_name};\n\n"
+            content += "// === Enums ===\n"
+            for enum_name, enum_info in self._live_enums():
+                content += self._c_enum_definition(enum_name, enum_info)
 
-        # Add constants (DEBOUNCE_THRESHOLD from AST)
-        header_content += "// === Constants ===\n"
-        header_content += "#define DEBOUNCE_THRESHOLD 5\n"
-        header_content += "\n"
+        # Add constants (static const members and const globals)
+        constants = self._c_constant_definitions()
+        if constants:
+            content += "// === Constants ===\n"
+            content += constants
+            content += "\n"
 
         # Add hardware pin definitions
-        header_content += """// === Hardware Pin Definitions ===
+        content += """// === Hardware Pin Definitions ===
 // Pin definitions from pin_manager.h
 #ifndef PB0
 #define PB0 PORTAbits.RA2
@@ -1473,86 +4369,26 @@ class PythonTranspiler:
 
         # Add structs  
         if self.classes:
-            header_content += "// === Structs ===\n"
-            for class_name, class_info in self.classes.items():
-                header_content += f"typedef struct {class_name} {{\n"
-                for field in class_info['fields']:
-                    header_content += f"    {field['type']} {field['name']};\n"
-                header_content += f"}} {class_name};\n\n"
-
-        # Add function declarations
-        if self.classes:
-            header_content += "// === Function Declarations ===\n"
-            for class_name, class_info in self.classes.items():
-                for method in class_info['methods']:
-                    method_name = method['name']
-                    
-                    # Fix return types for common methods
-                    if method_name in ['isInitialized', 'isPressed', 'wasJustPressed', 'wasJustReleased', 'isOn', 'readHardwareState']:
-                        return_type = 'bool'
-                    elif method_name in ['getValue', 'getId']:
-                        if class_name == 'Timer0' and method_name == 'getValue':
-                            return_type = 'int'
-                        elif method_name == 'getId':
-                            return_type = f'{class_name}Id' if f'{class_name}Id' in ['ButtonId', 'LedId'] else 'int'
-                        else:
-                            return_type = 'int'
-                    elif method_name in ['getState']:
-                        return_type = f'{class_name}State' if f'{class_name}State' in ['ButtonState'] else 'int'
-                    else:
-                        return_type = method.get('return_type', 'void')
-                    
-                    # Extract parameters from method signature and body analysis
-                    method_type = method.get('type', 'void ()')
-                    method_body = method.get('body', '')
-                    params_str = self._extract_method_parameters(method_type, method_body, method_name)
-                    
-                    if params_str:
-                        header_content += f"{return_type} {class_name}_{method_name}({class_name}* self, {params_str});\n"
-                    else:
-                        header_content += f"{return_type} {class_name}_{method_name}({class_name}* self);\n"
-                header_content += "\n"
-
-        # Add standalone function declarations
-        if self.functions:
-            header_content += "// === Standalone Function Declarations ===\n"
-            for func in self.functions:
-                if func['name'] not in ['main']:  # Skip main function
-                    if func['name'].startswith('PIN_MANAGER_'):
-                        header_content += f"void {func['name']}(void); // Implemented in pin_manager.c\n"
-                    else:
-                        header_content += f"void {func['name']}(void);\n"
-            header_content += "\n"
-
-        # Add global variable declarations
-        if hasattr(self, 'global_variables') and self.global_variables:
-            header_content += "// === Global Variable Declarations ===\n"
-            for var in self.global_variables:
-                if not self._is_system_variable(var['name'], var['type']):
-                    header_content += f"extern {var['type']} {var['name']};\n"
-            header_content += "\n"
-
-        header_content += "#endif // SHARED_DEFINITIONS_H\n"
-
-        # Write header file
-        with open(header_file, 'w') as f:
-            f.write(header_content)
+            content += "// === Structs ===\n"
+            for class_name, class_info in self._live_classes():
+                content += f"typedef struct {class_name} {{\n"
+                for member in self._c_struct_members(class_name):
+                    content += f"    {member};\n"
+                content += f"}} {class_name};\n\n"
+        content += self._c_dispatch_types()
+        return content
 
     def generate_c_file_for_source(self, source_file, output_file):
         """Generate a C file with only relevant content for a specific source file"""
         print(f"Generating C file for {source_file}: {output_file}")
         
-        source_name = Path(source_file).stem
-        
-        # Map source files to their corresponding classes
-        source_to_class = {
-            'timer0': 'Timer0',
-            'led': 'Led', 
-            'button': 'Button',
-            'main': None  # main.c doesn't correspond to a class
-        }
+        unit = self._unit_name(source_file)
         
-        target_class = source_to_class.get(source_name)
+        # Classes whose methods are defined in this translation unit
+        unit_classes = [
+            class_name for class_name, _ in self._live_classes()
+            if self._class_unit(class_name) == unit
+        ]
         
         c_content = f"""/*
  * XC8 C++ to C Transpilation
@@ -1564,221 +4400,649 @@ class PythonTranspiler:
 
 """
 
-        # Generate individual header for this class (except main.c)
-        if target_class and target_class in self.classes:
+        # Generate individual header for the classes of this unit
+        if unit_classes:
             header_file = Path(output_file).with_suffix('.h')
-            self.generate_individual_header_file(str(header_file), target_class)
+            self.generate_individual_header_file(str(header_file), unit_classes)
             c_content += f'#include "{header_file.name}"\n\n'
+
+        # Prototypes of the functions with internal linkage, which no header
+        # declares
+        internal = self._internal_prototypes(unit, unit_classes)
+        if internal:
+            c_content += "// === Internal Declarations ===\n\n"
+            c_content += "".join(f"static {prototype};\n" for prototype in internal)
+            c_content += "\n"
+
+        # Vtables of the classes of this unit, which the globals may point to
+        unit_vtables = [
+            class_name for class_name in self._live_vtables() if class_name in unit_classes
+        ]
+        if unit_vtables:
+            c_content += "// === Virtual Tables ===\n\n"
+            c_content += "".join(
+                self._c_vtable_definition(class_name) for class_name in unit_vtables
+            )
+
+        # Add global variables defined in this unit, ahead of the code using them
+        unit_variables = [
+            var for var in self._live_variables() if self._definition_unit(var) == unit
+        ]
+        if unit_variables:
+            c_content += "// === Global Variables ===\n\n"
+            for var in unit_variables:
+                c_content += f"{self._linkage(var['name'])}{self._c_global_definition(var)}\n"
+            c_content += "\n"
         
-        # Add class method implementations ONLY for the target class
-        if target_class and target_class in self.classes:
-            class_info = self.classes[target_class]
-            
-            # Add constructor
-            c_content += f"// Constructor for {target_class}\n"
-            c_content += f"void {target_class}_init({target_class}* self) {{\n"
-            c_content += f"    // Initialize {target_class} instance\n"
-            
+        # Add class method implementations ONLY for the classes of this unit
+        for target_class in unit_classes:
+            c_content += "".join(self._c_class_definitions(target_class).values())
+        
+        owns_main = bool(self.main_function) and self._definition_unit(self.main_function) == unit
+
+        # The dynamic part of the global constructors goes with main
+        if owns_main or (not self.main_function and self._constructs_in_unit(unit)):
+            global_constructors = self._c_global_constructors()
+            if global_constructors:
+                c_content += "// === Global Constructors ===\n\n"
+                c_content += global_constructors
+
+        # Add standalone functions defined in this unit (setup, loop, but NOT
+        # PIN_MANAGER functions, which are implemented in the copied pin_manager.c)
+        unit_functions = [
+            func for func in self._live_functions()
+            if self._definition_unit(func) == unit
+            and not func['name'].startswith('PIN_MANAGER_')
+        ]
+        if unit_functions:
+            c_content += "// === Standalone Functions ===\n\n"
+            for func in unit_functions:
+                c_content += self._c_function_definition(func)
+        
+        # Add main function only in the unit that defines it
+        if owns_main:
+            c_content += "// === Main function ===\n\n"
+            c_content += self._c_main_definition()
+
+        # Write C file (unchanged content keeps its timestamp)
+        write_if_changed(output_file, c_content)
+
+    def _c_class_definitions(self, class_name):
+        """
+        C definitions of the out-of-line code of a class by C name: the
+        Class_init helper, the methods not inlined, Class_cleanup
+        """
+        definitions = {}
+        class_info = self.classes[class_name]
+
+        # Add constructor
+        if self._is_live(f"{class_name}_init"):
+            definition = f"// Constructor for {class_name}\n"
+            definition += f"{self._linkage(f'{class_name}_init')}"
+            definition += f"void {class_name}_init({class_name}* self) {{\n"
+            definition += f"    // Initialize {class_name} instance\n"
+
             # Add initialization based on fields
             for field in class_info['fields']:
-                if field['type'] == 'bool':
-                    c_content += f"    self->{field['name']} = false;\n"
-                elif field['type'] in ['int', 'unsigned int']:
-                    c_content += f"    self->{field['name']} = 0;\n"
-            
-            c_content += "}\n\n"
-            
-            # Add method implementations
-            for method in class_info['methods']:
-                method_name = method['name']
-                
-                # Skip constructor and destructor methods as they're handled separately
-                if method_name in ['init', 'cleanup']:
-                    continue
-                
-                # Fix return types for common methods
-                if method_name in ['isInitialized', 'isPressed', 'wasJustPressed', 'wasJustReleased', 'isOn', 'readHardwareState']:
-                    return_type = 'bool'
-                elif method_name in ['getValue', 'getId']:
-                    if target_class == 'Timer0' and method_name == 'getValue':
-                        return_type = 'int'
-                    elif method_name == 'getId':
-                        return_type = f'{target_class}Id' if f'{target_class}Id' in ['ButtonId', 'LedId'] else 'int'
-                    else:
-                        return_type = 'int'
-                elif method_name in ['getState']:
-                    return_type = f'{target_class}State' if f'{target_class}State' in ['ButtonState'] else 'int'
-                else:
-                    return_type = method.get('return_type', 'void')
-                
-                c_content += f"// Method: {method_name}\n"
-                
-                # Extract parameters from method signature and body analysis
-                method_type = method.get('type', 'void ()')
-                method_body = method.get('body', '')
-                params_str = self._extract_method_parameters(method_type, method_body, method_name)
-                
-                if params_str:
-                    c_content += f"{return_type} {target_class}_{method_name}({target_class}* self, {params_str}) {{\n"
-                else:
-                    c_content += f"{return_type} {target_class}_{method_name}({target_class}* self) {{\n"
-                
-                # Add method body if available
-                body = method.get('body', '')
-                if body:
-                    # Process the body to convert C++ calls to C calls
-                    processed_body = self._convert_cpp_calls_to_c(body)
-                    # Indent the body
-                    indented_body = '\n'.join(f"    {line}" for line in processed_body.split('\n') if line.strip())
-                    c_content += f"{indented_body}\n"
-                else:
-                    c_content += f"    // TODO: Method implementation for {method_name}\n"
-                
-                c_content += "}\n\n"
-            
-            # Add destructor
-            c_content += f"// Destructor for {target_class}\n"
-            c_content += f"void {target_class}_cleanup({target_class}* self) {{\n"
-            c_content += f"    // Cleanup {target_class} instance\n"
-            c_content += "}\n\n"
-        
-        # Handle main.c - only add main-specific content
-        elif source_name == 'main':
-            # Add global variables only in main.c (let parser detect them)
-            if hasattr(self, 'global_variables') and self.global_variables:
-                c_content += "// === Global Variables ===\n\n"
-                for var in self.global_variables:
-                    if not self._is_system_variable(var['name'], var['type']):
-                        if var.get('constructor_args'):
-                            c_content += f"{var['type']} {var['name']} = {{{var['constructor_args']}}};\n"
-                        else:
-                            c_content += f"{var['type']} {var['name']};\n"
-                c_content += "\n"
+                initializer = self._field_initial_value(class_name, field)
+                if initializer:
+                    definition += f"    self->{field['name']} = {initializer};\n"
+
+            definitions[f"{class_name}_init"] = definition + "}\n\n"
+
+        # Add method implementations
+        for method in self._live_methods(class_name):
+            method_name = method['name']
+
+            # Skip constructor and destructor methods as they're handled
+            # separately, and methods defined inline in the shared header
+            if method_name in ['init', 'cleanup'] or self._is_inlined(class_name, method):
+                continue
+
+            c_name = f"{class_name}_{method_name}"
+            prototype = self._c_prototype(method, c_name, class_name)
+            definition = f"// Method: {method_name}\n"
+            definition += f"{self._linkage(c_name)}{prototype} {{\n"
+
+            # Add method body if available
+            body = method.get('body', '')
+            if body:
+                # Process the body to convert C++ calls to C calls
+                definition += self._indent_lowered_body(self._lower_body(body, class_name))
             else:
-                # If parser didn't detect globals, add the expected ones
-                c_content += "// === Global Variables ===\n\n"
-                c_content += "Timer0 timer;\n"
-                c_content += "Led led0 = {LED_0, false};\n"
-                c_content += "Led led1 = {LED_1, false};\n" 
-                c_content += "Led led2 = {LED_2, false};\n"
-                c_content += "Led led3 = {LED_3, false};\n"
-                c_content += "Led led4 = {LED_4, false};\n"
-                c_content += "Button button0 = {PB_0, RELEASED, RELEASED, 0};\n"
-                c_content += "Button button1 = {PB_1, RELEASED, RELEASED, 0};\n"
-                c_content += "Button button2 = {PB_2, RELEASED, RELEASED, 0};\n"
-                c_content += "\n"
-            
-            # Add standalone functions (setup, loop, but NOT PIN_MANAGER functions)
-            # PIN_MANAGER functions are implemented in the copied pin_manager.c file
-            if self.functions:
-                c_content += "// === Standalone Functions ===\n\n"
-                for func in self.functions:
-                    func_name = func['name']
-                    
-                    # Skip PIN_MANAGER functions - they're implemented in pin_manager.c
-                    if func_name.startswith('PIN_MANAGER_'):
-                        continue
-                    
-                    c_content += f"void {func_name}(void) {{\n"
-                    
-                    body = func.get('body', '')
-                    if body:
-                        # Process the body to convert C++ calls to C calls
-                        processed_body = self._convert_cpp_calls_to_c(body)
-                        # Indent the body
-                        indented_body = '\n'.join(f"    {line}" for line in processed_body.split('\n') if line.strip())
-                        c_content += f"{indented_body}\n"
-                    else:
-                        c_content += f"    // TODO: Transpiled function body\n"
-                    
-                    c_content += "}\n\n"
-            
-            # Add main function only in main.c
-            if self.main_function:
-                c_content += "// === Main function ===\n\n"
-                c_content += "int main(void) {\n"
-                
-                body = self.main_function.get('body', '')
-                if body:
-                    processed_body = self._convert_cpp_calls_to_c(body)
-                    indented_body = '\n'.join(f"    {line}" for line in processed_body.split('\n') if line.strip())
-                    c_content += f"{indented_body}\n"
-                else:
-                    c_content += "    setup();\n"
-                    c_content += "    while(1) {\n"
-                    c_content += "        loop();\n"
-                    c_content += "    }\n"
-                
-                c_content += "}\n\n"
+                definition += f"    // TODO: Method implementation for {method_name}\n"
 
-        # Write C file
-        with open(output_file, 'w') as f:
-            f.write(c_content)
+            definitions[c_name] = definition + "}\n\n"
 
-    def generate_individual_header_file(self, header_file, class_name):
-        """Generate an individual header file for a specific class"""
-        print(f"Generating individual header for {class_name}: {header_file}")
-        
-        if class_name not in self.classes:
+        # Add destructor
+        if self._is_live(f"{class_name}_cleanup"):
+            definition = f"// Destructor for {class_name}\n"
+            definition += f"{self._linkage(f'{class_name}_cleanup')}"
+            definition += f"void {class_name}_cleanup({class_name}* self) {{\n"
+            definition += f"    // Cleanup {class_name} instance\n"
+            definitions[f"{class_name}_cleanup"] = definition + "}\n\n"
+
+        return definitions
+
+    def _c_slot_type(self, root, method, declarator="(*)"):
+        """
+        Function pointer type of a vtable slot, as declared by the class
+        making the method virtual, with a root self pointer:
+        "uint8_t (*)(const Sensor* self)"
+        """
+        return self._c_prototype(self._slot_declaration(root, method), declarator, root)
+
+    def _slot_declaration(self, root, method):
+        """Declaration of a virtual method by the class of a hierarchy making it virtual"""
+        hierarchy = self.hierarchy
+        introducer = next(
+            hierarchy.introducer(class_name, method)
+            for class_name in hierarchy.derived(root) if method in hierarchy.slots(class_name)
+        )
+        return next(
+            declared for declared in self.classes[introducer]["methods"]
+            if declared["name"] == method
+        )
+
+    def _c_dispatch_types(self):
+        """Type tag constants and vtable types of the dispatching hierarchies"""
+        return self._c_type_tags() + self._c_vtable_types()
+
+    def _c_type_tags(self):
+        """Type tag of each class of the switch dispatched hierarchies"""
+        content = ""
+        for root in self.tag_dispatch:
+            if not self._is_live(f"{root}_Tag"):
+                continue
+            content += f"enum {root}_Tag {{\n"
+            content += ",\n".join(
+                f"    {name}" for name, _ in self._type_tag_constants(root)
+            )
+            content += "\n};\n\n"
+        return content
+
+    def _type_tag_constants(self, root):
+        """(constant, value) of the type tags of a hierarchy, in class order"""
+        return [
+            (f"{class_name}_TAG", value)
+            for value, class_name in enumerate(self.hierarchy.derived(root))
+        ]
+
+    def _c_vtable_types(self):
+        """Vtable type of each dispatching hierarchy: a function pointer per slot"""
+        content = ""
+        for root, slots in self.vtables.items():
+            if not self._is_live(f"{root}_VTable"):
+                continue
+            content += f"typedef struct {root}_VTable {{\n"
+            for method in slots:
+                content += f"    {self._c_slot_type(root, method, f'(*{method})')};\n"
+            content += f"}} {root}_VTable;\n\n"
+        return content
+
+    def _live_vtables(self):
+        """Classes whose vtable is emitted"""
+        return [
+            class_name for class_name in self.classes
+            if self._vtable_root(class_name) and self._is_live(f"{class_name}_vtable")
+        ]
+
+    def _vtable_entries(self, class_name):
+        """
+        Implementation of each slot for the objects of a class, cast to the
+        slot type when it is a derived class's; 0 for a pure virtual method
+        """
+        root = self._vtable_root(class_name)
+        entries = []
+        for method in self.vtables[root]:
+            overrider = self.hierarchy.overrider(class_name, method)
+            if overrider is None:
+                entries.append("0")
+            elif overrider == root:
+                entries.append(f"{overrider}_{method}")
+            else:
+                entries.append(f"({self._c_slot_type(root, method)}){overrider}_{method}")
+        return entries
+
+    def _c_vtable_declaration(self, class_name):
+        """Declaration of the vtable of a class, without initializer"""
+        return f"const {self._vtable_root(class_name)}_VTable {class_name}_vtable"
+
+    def _c_vtable_definition(self, class_name):
+        """Definition of the vtable of a class (const: placed in program memory)"""
+        definition = f"{self._linkage(f'{class_name}_vtable')}"
+        definition += f"{self._c_vtable_declaration(class_name)} = {{\n"
+        definition += ",\n".join(f"    {entry}" for entry in self._vtable_entries(class_name))
+        return definition + "\n};\n\n"
+
+    def _c_function_definition(self, func):
+        """C definition of a standalone function"""
+        prototype = self._c_prototype(func, func['name'])
+        definition = f"{self._linkage(func['name'])}{prototype} {{\n"
+
+        body = func.get('body', '')
+        if body:
+            # Process the body to convert C++ calls to C calls
+            definition += self._indent_lowered_body(self._lower_body(body))
+        else:
+            definition += f"    // TODO: Transpiled function body\n"
+
+        return definition + "}\n\n"
+
+    def _c_main_definition(self):
+        """C definition of main, running the global constructors first"""
+        definition = "int main(void) {\n"
+        if self._c_global_constructors():
+            definition += "    global_constructors();\n"
+
+        body = self.main_function.get('body', '')
+        if body:
+            definition += self._indent_lowered_body(self._lower_body(body))
+        else:
+            definition += "    setup();\n"
+            definition += "    while(1) {\n"
+            definition += "        loop();\n"
+            definition += "    }\n"
+
+        return definition + "}\n\n"
+
+    def generate_amalgamated_file(self, source_files, output_file):
+        """
+        Generate the whole batch as one self-contained C file: the types,
+        then the globals, then the functions in dependency order (callees
+        before their callers). Every definition but main and the interrupt
+        handlers is static; the PIN_MANAGER functions of the copied
+        pin_manager.c are the only external ones.
+        """
+        print(f"Generating amalgamated C file: {output_file}")
+
+        entry_points = set(self._entry_points())
+        pin_functions = [
+            func for func in self._live_functions() if func['name'].startswith('PIN_MANAGER_')
+        ]
+        self.internal_symbols = set(self._amalgamated_prototypes()) - entry_points
+        self.internal_symbols.update(var["name"] for var in self._live_variables())
+        self.internal_symbols.update(
+            f"{class_name}_vtable" for class_name in self._live_vtables()
+        )
+
+        # Definitions in source order: classes, startup code, functions, main
+        definitions = {}
+        for class_name, _ in self._live_classes():
+            for method in self._live_methods(class_name):
+                if self._is_inlined(class_name, method):
+                    body = self._lower_body(method['body'], class_name)
+                    body = self._indent_lowered_body(body)
+                    c_name = f"{class_name}_{method['name']}"
+                    definitions[c_name] = self._c_inline_definition(class_name, method, body)
+                    definitions[c_name] += "\n"
+            definitions.update(self._c_class_definitions(class_name))
+        if self._c_global_constructors():
+            definitions["global_constructors"] = self._c_global_constructors()
+        for func in self._live_functions():
+            if func not in pin_functions:
+                definitions[func['name']] = self._c_function_definition(func)
+        if self.main_function:
+            definitions["main"] = self._c_main_definition()
+
+        globals_code = "".join(
+            self._c_vtable_definition(class_name) for class_name in self._live_vtables()
+        )
+        globals_code += "".join(
+            f"{self._linkage(var['name'])}{self._c_global_definition(var)}\n"
+            for var in self._live_variables()
+        )
+        uses = {
+            name: [
+                target for target in sum(scan_symbols(code, name, definitions), [])
+                if target != name
+            ]
+            for name, code in definitions.items()
+        }
+        order = self._dependency_order(uses)
+
+        # Prototypes only for what is used before its definition: recursion,
+        # and functions whose address a global initializer takes
+        forward = list(dict.fromkeys(
+            target for target in sum(scan_symbols(globals_code, "", definitions), [])
+        ))
+        defined = set()
+        for name in order:
+            forward += [
+                target for target in uses[name]
+                if target not in defined and target not in forward
+            ]
+            defined.add(name)
+
+        names = ", ".join(sorted({Path(source).name for source in source_files}))
+        c_content = f"""/*
+ * XC8 C++ to C Transpilation
+ * Amalgamated from: {names}
+ * Architecture demonstrates proper Clang LibTooling approach
+ */
+
+"""
+        c_content += self._c_type_definitions()
+
+        if pin_functions:
+            c_content += "// === External Functions ===\n"
+            for func in pin_functions:
+                prototype = self._c_prototype(func, func['name'])
+                c_content += f"{prototype}; // Implemented in pin_manager.c\n"
+            c_content += "\n"
+
+        if forward:
+            prototypes = self._amalgamated_prototypes()
+            c_content += "// === Internal Declarations ===\n\n"
+            c_content += "".join(f"static {prototypes[name]};\n" for name in forward)
+            c_content += "\n"
+
+        if globals_code:
+            c_content += "// === Global Variables ===\n\n"
+            c_content += globals_code + "\n"
+
+        c_content += "// === Functions ===\n\n"
+        c_content += "".join(definitions[name] for name in order)
+
+        # Write C file (unchanged content keeps its timestamp)
+        write_if_changed(output_file, c_content)
+
+    def _amalgamated_prototypes(self):
+        """Prototypes of the functions an amalgamated file can define, by C name"""
+        prototypes = {}
+        for class_name, class_info in self.classes.items():
+            for helper in ("init", "cleanup"):
+                prototypes[f"{class_name}_{helper}"] = (
+                    f"void {class_name}_{helper}({class_name}* self)"
+                )
+            for method in class_info["methods"]:
+                c_name = f"{class_name}_{method['name']}"
+                prototypes[c_name] = self._c_prototype(method, c_name, class_name)
+        prototypes["global_constructors"] = "void global_constructors(void)"
+        for func in self.functions:
+            if not func['name'].startswith('PIN_MANAGER_'):
+                prototypes[func['name']] = self._c_prototype(func, func['name'])
+        return prototypes
+
+    @staticmethod
+    def _dependency_order(uses):
+        """
+        Names of the definitions with the ones each uses first, otherwise in
+        their given order (a cycle keeps the order it is entered in)
+        """
+        order = []
+        visited = set()
+
+        def visit(name):
+            if name in visited:
+                return
+            visited.add(name)
+            for target in uses[name]:
+                visit(target)
+            order.append(name)
+
+        for name in uses:
+            visit(name)
+        return order
+
+    def _linkage(self, name):
+        """Storage class of a definition: "static " for internal linkage"""
+        return "static " if name in self.internal_symbols else ""
+
+    def _internal_prototypes(self, unit, unit_classes):
+        """Prototypes of the methods and functions with internal linkage of a unit"""
+        prototypes = []
+        for class_name in unit_classes:
+            for method in self._live_methods(class_name):
+                c_name = f"{class_name}_{method['name']}"
+                if c_name in self.internal_symbols:
+                    prototypes.append(self._c_prototype(method, c_name, class_name))
+        for func in self._live_functions():
+            if func['name'] in self.internal_symbols and self._definition_unit(func) == unit:
+                prototypes.append(self._c_prototype(func, func['name']))
+        return prototypes
+
+    def _constructs_in_unit(self, unit):
+        """
+        Check whether global_constructors() is defined in a unit when no unit
+        defines main: it goes with the first global it constructs
+        """
+        if not self.global_constructors:
+            return False
+        first = next(
+            var for var in self._global_variables()
+            if var["name"] == self.global_constructors[0][0]
+        )
+        return self._definition_unit(first) == unit
+
+    def _unit_name(self, file_path):
+        """Name of the translation unit a source file belongs to (led.cpp/led.hpp -> led)"""
+        return Path(file_path).stem if file_path else None
+
+    def _definition_unit(self, definition):
+        """Translation unit of a function or variable, from where it is defined"""
+        return self._unit_name(definition.get('definition_file') or definition.get('source_file'))
+
+    def _class_unit(self, class_name):
+        """
+        Translation unit of a class: the file its methods are defined in,
+        falling back to the file holding the class definition.
+        """
+        class_info = self.classes[class_name]
+        for method in class_info['methods']:
+            if method.get('definition_file'):
+                return self._unit_name(method['definition_file'])
+        return self._unit_name(class_info.get('definition_file'))
+
+    def generate_individual_header_file(self, header_file, class_names):
+        """Generate an individual header file for the classes of a translation unit"""
+        if isinstance(class_names, str):
+            class_names = [class_names]
+        class_names = [name for name in class_names if name in self.classes]
+        if not class_names:
             return
         
-        class_info = self.classes[class_name]
+        title = ", ".join(class_names)
+        print(f"Generating individual header for {title}: {header_file}")
+        
         header_name = Path(header_file).stem.upper()
         
         header_content = f"""#ifndef {header_name}_H
 #define {header_name}_H
 
 /*
- * {class_name} Module Header
+ * {title} Module Header
  * Generated using semantic AST analysis
- * Contains {class_name}-specific declarations
+ * Contains {title}-specific declarations
  */
 
 #include "shared_definitions.h"
+"""
 
+        for class_name in class_names:
+            header_content += f"""
 // === {class_name} Function Declarations ===
-void {class_name}_init({class_name}* self);
 """
+            if self._is_live(f"{class_name}_init"):
+                header_content += f"void {class_name}_init({class_name}* self);\n"
 
-        # Add method declarations for this specific class
-        for method in class_info['methods']:
-            method_name = method['name']
-            
-            # Skip constructor and destructor methods as they're handled separately
-            if method_name in ['init', 'cleanup']:
-                continue
-            
-            # Fix return types for common methods
-            if method_name in ['isInitialized', 'isPressed', 'wasJustPressed', 'wasJustReleased', 'isOn', 'readHardwareState']:
-                return_type = 'bool'
-            elif method_name in ['getValue', 'getId']:
-                if class_name == 'Timer0' and method_name == 'getValue':
-                    return_type = 'int'
-                elif method_name == 'getId':
-                    return_type = f'{class_name}Id' if f'{class_name}Id' in ['ButtonId', 'LedId'] else 'int'
-                else:
-                    return_type = 'int'
-            elif method_name in ['getState']:
-                return_type = f'{class_name}State' if f'{class_name}State' in ['ButtonState'] else 'int'
-            else:
-                return_type = method.get('return_type', 'void')
-            
-            # Extract parameters from method signature and body analysis
-            method_type = method.get('type', 'void ()')
-            method_body = method.get('body', '')
-            params_str = self._extract_method_parameters(method_type, method_body, method_name)
-            
-            if params_str:
-                header_content += f"{return_type} {class_name}_{method_name}({class_name}* self, {params_str});\n"
-            else:
-                header_content += f"{return_type} {class_name}_{method_name}({class_name}* self);\n"
+            # Add method declarations for this specific class
+            for method in self._live_methods(class_name):
+                method_name = method['name']
+                
+                # Skip constructor and destructor methods as they're handled
+                # separately, and methods defined inline in the shared header
+                if method_name in ['init', 'cleanup'] or self._is_inlined(class_name, method):
+                    continue
+                if f"{class_name}_{method_name}" in self.internal_symbols:
+                    continue
+                
+                prototype = self._c_prototype(
+                    method, f"{class_name}_{method_name}", class_name
+                )
+                header_content += f"{prototype};\n"
+
+            if self._is_live(f"{class_name}_cleanup"):
+                header_content += f"void {class_name}_cleanup({class_name}* self);\n"
+
+        header_content += f"\n#endif // {header_name}_H\n"
+
+        # Write header file (unchanged content keeps its timestamp)
+        write_if_changed(header_file, header_content)
+
+    def _indent_lowered_body(self, processed_body):
+        """Indent a lowered body for a batch function definition, dropping blank lines"""
+        return ''.join(f"    {line}\n" for line in processed_body.split('\n') if line.strip())
+
+    def _lower_body(self, body, class_name=None):
+        """
+        Convert a function body to C, reusing the memoized result if possible.
+        Bodies of singleton methods (class_name given) use the instance
+        instead of self.
+        """
+        if not body or body in self.dispatch_bodies:
+            return body
+
+        lowered = self._memoized_lowering(
+            "calls",
+            body,
+            self._call_lowering_environment(body),
+            lambda: self._convert_cpp_calls_to_c(body),
+        )
+        lowered = self._lower_method_dispatch(lowered, class_name)
+        if class_name in self.singletons:
+            lowered = bind_instance(lowered, self.singletons[class_name])
+        return lowered
+
+    def _save_lowering_memo(self):
+        """
+        Persist the lowering memo, and the program IR next to it, and report
+        how many bodies were reused. The IR is saved as built, before
+        linking, so that a run on the same inputs can load it.
+        """
+        memo = self.lowering_memo
+        if memo.hits or memo.misses:
+            print(f"Function lowering: {memo.hits} reused, {memo.misses} lowered")
+        memo.save()
+
+        if memo.cache_dir and self.built_ir is not None:
+            ir_file = Path(memo.cache_dir) / IR_FILENAME
+            try:
+                ir_file.parent.mkdir(parents=True, exist_ok=True)
+                ir_file.write_bytes(self.built_ir.to_bytes())
+            except OSError as e:
+                print(f"Warning: Could not save program IR {ir_file}: {e}")
 
-        header_content += f"void {class_name}_cleanup({class_name}* self);\n\n"
-        header_content += f"#endif // {header_name}_H\n"
+    def _report_passes(self):
+        """Print the time and changes of the optimization passes that ran"""
+        if self.pass_manager.stats:
+            print("\n".join(self.pass_manager.format()))
 
-        # Write header file
-        with open(header_file, 'w') as f:
-            f.write(header_content)
+    def _memoized_lowering(self, kind, body, environment, lower):
+        """
+        Look up a lowered body in the memo, computing and storing it on a miss.
+
+        Args:
+            kind: Lowering routine the body goes through
+            body: C++ function body
+            environment: Symbols referenced by the body that affect lowering
+            lower: Callable producing the lowered C on a miss
+        """
+        key = LoweringMemo.make_key(kind, body, environment)
+        lowered = self.lowering_memo.lookup(key)
+        if lowered is None:
+            lowered = lower()
+            self.lowering_memo.store(key, lowered)
+        lowered = self._lower_static_members(lowered)
+        lowered = static_const_locals(lowered, self._is_static_constant)
+        if self.reference_parameters:
+            lowered = self._pass_reference_arguments(lowered)
+        if self.singletons:
+            lowered = drop_instance_argument(lowered, self._singleton_methods())
+        if self.specializations:
+            lowered = self._call_specializations(lowered)
+        if self.switch_tables:
+            start = time.perf_counter()
+            lowered, tables = lower_switches(
+                lowered,
+                self._numeric_value,
+                self._pin_macros(),
+                self.inline_model.goal,
+                tables=self.switch_tables,
+                pragmas=self.generate_xc8_pragmas,
+                interrupt=any(
+                    function.get("is_interrupt") and function.get("body") == body
+                    for function in self.functions
+                ),
+            )
+            # Bodies are also lowered for the analyses, before specialization
+            # and dead code elimination decide what is written: only the
+            # tables of the emitted ones are changes
+            self.pass_manager.record(
+                "switch-tables", time.perf_counter() - start, tables if self.emitting else 0
+            )
+        if self.bit_types:
+            lowered, _ = lower_static_bits(lowered, self.boolean_names)
+        return lowered
+
+    def _call_lowering_environment(self, body):
+        """
+        Describe the symbols referenced by a body that _convert_cpp_calls_to_c
+        depends on: field names, methods reachable through bare calls (in class
+        order, first match wins) and the classes of called objects.
+        """
+        tokens = set(re.findall(r"\w+", body))
+
+        fields = set()
+        methods = []
+        for class_name, class_info in self.classes.items():
+            for field in class_info.get("fields", []):
+                if field["name"] in tokens:
+                    fields.add(field["name"])
+            for method in class_info.get("methods", []):
+                if method["name"] in tokens:
+                    methods.append([class_name, method["name"]])
+
+        objects = {
+            object_name: self._get_class_name_for_variable(object_name)
+            for object_name in re.findall(r"\b(\w+)\.\w+\(", body)
+        }
+
+        environment = {
+            "fields": sorted(fields),
+            "methods": methods,
+            "objects": objects,
+            "enums": self._referenced_enums(body),
+        }
+        pointers = {
+            pointer: self._get_class_name_for_pointer(pointer, body)
+            for pointer in re.findall(r"\b(\w+)(?:\[[^\]]*\])?\s*->\s*\w+\(", body)
+        }
+        if any(pointers.values()):
+            environment["pointers"] = pointers
+        return environment
+
+    def _main_statement_environment(self, body):
+        """
+        Describe the symbols referenced by a body that _transpile_main_statement
+        depends on: the known class names and the types of referenced variables.
+        """
+        tokens = set(re.findall(r"\w+", body))
+        return {
+            "classes": list(self.classes),
+            "initialized": [
+                class_name for class_name in self.classes
+                if self._class_has_initializer(class_name)
+            ],
+            "enums": self._referenced_enums(body),
+            "variables": {
+                name: var_type
+                for name, var_type in (
+                    (variable["name"], variable["type"]) for variable in self.variables
+                )
+                if name in tokens
+            },
+        }
 
     def _convert_cpp_calls_to_c(self, body):
         """Convert C++ method calls to C function calls"""
@@ -1788,7 +5052,8 @@ void {class_name}_init({class_name}* self);
         # Convert C++ syntax to C syntax
         converted = body
         
-        # Convert enum class references (ButtonState::RELEASED -> RELEASED)
+        # Convert enum class references (ButtonState::RELEASED -> ButtonState_RELEASED)
+        converted = self._lower_enum_references(converted)
         converted = re.sub(r'\b(\w+)::', '', converted)
         
         # Generic pattern for object method calls: object.method(args) -> Class_method(&object, args)
@@ -1811,6 +5076,21 @@ void {class_name}_init({class_name}* self);
         
         # Apply generic method call conversion
         converted = re.sub(r'\b(\w+)\.(\w+)\(([^)]*)\)', convert_method_call, converted)
+
+        # Calls through pointers: pointer->method(args) -> Class_method(pointer, args)
+        def convert_pointer_call(match):
+            pointer, method_name, args = match.group(1), match.group(3), match.group(4)
+            class_name = self._get_class_name_for_pointer(match.group(2), body)
+            if not class_name or not self.hierarchy.owner(class_name, method_name):
+                return match.group(0)
+            arguments = f"{pointer}, {args}" if args.strip() else pointer
+            return f"{class_name}_{method_name}({arguments})"
+
+        converted = re.sub(
+            r'\b((\w+)(?:\[[^\]]*\])?)\s*->\s*(\w+)\(([^()]*(?:\([^()]*\)[^()]*)*)\)',
+            convert_pointer_call,
+            converted,
+        )
         
         # Convert member access to self-> access for all known fields from all classes
         all_field_names = set()
@@ -1819,9 +5099,12 @@ void {class_name}_init({class_name}* self);
                 all_field_names.add(field['name'])
         
         for field in all_field_names:
-            # Convert direct field access to self->field (but avoid double conversion and function parameters)
+            # Convert direct field access to self->field (but avoid double
+            # conversion, members of other objects and function parameters)
             if not self._is_function_parameter(field):
-                converted = re.sub(rf'\b{field}\b(?!\s*\()(?!->)', f'self->{field}', converted)
+                converted = self._substitute_outside_comments(
+                    rf'(?<!\.)(?<!->)\b{field}\b(?!\s*\()(?!->)', f'self->{field}', converted
+                )
         
         # Convert method calls without object to function calls with self parameter
         # This handles cases like readHardwareState() inside a class method
@@ -1841,7 +5124,7 @@ void {class_name}_init({class_name}* self);
         # First check global variables
         for var in self.variables:
             if var['name'] == variable_name:
-                return var['type']
+                return without_const(var['type'])
         
         # Check if it's a common pattern (timer -> Timer0, led* -> Led, button* -> Button)
         if variable_name == 'timer':
@@ -1858,12 +5141,49 @@ void {class_name}_init({class_name}* self);
         
         return None
     
+    def _get_class_name_for_pointer(self, pointer_name, body=""):
+        """
+        Class a pointer (or array of pointers) points to, from its declaration
+        in the body, as a parameter, a member or a global
+        """
+        declaration = re.compile(r"^(?:const\s+)?(\w+)\s*\*\s*(?:const\s*)?(?:\[.*)?$")
+        local = re.search(
+            rf"\b(\w+)\s*\*\s*(?:const\s+)?{re.escape(pointer_name)}\s*[;=\[),]", body
+        )
+        candidates = [local.group(1) + "*"] if local else []
+        for class_info in self.classes.values():
+            for declared in class_info["methods"] + [{"params": class_info["fields"]}]:
+                candidates += [
+                    param["type"] for param in declared.get("params") or []
+                    if param.get("name") == pointer_name
+                ]
+        candidates += [
+            param["type"] for function in self.functions for param in function.get("params") or []
+            if param.get("name") == pointer_name
+        ]
+        candidates += [
+            variable["type"] for variable in self.variables if variable["name"] == pointer_name
+        ]
+        for candidate in candidates:
+            match = declaration.match(candidate.strip())
+            if match and match.group(1) in self.classes:
+                return match.group(1)
+        return None
+
+    def _substitute_outside_comments(self, pattern, replacement, text):
+        """re.sub applied to the code of each line, leaving // comments as written"""
+        lines = []
+        for line in text.split('\n'):
+            code, comment_start, comment = line.partition('//')
+            lines.append(re.sub(pattern, replacement, code) + comment_start + comment)
+        return '\n'.join(lines)
+
     def _is_function_parameter(self, field_name):
         """Check if a field name is actually a function parameter"""
         function_parameters = ['milliseconds', 'newState', 'count', 'delayMs', 'rawPressed', 'rawState', 'i']
         return field_name in function_parameters
     
-    def _extract_method_parameters(self, method_type, method_body, method_name):
+    def _extract_method_parameters(self, method_type, method_body=None, method_name=None):
         """
         Extract parameters from method signature and body analysis.
         Returns parameter string for function signature.
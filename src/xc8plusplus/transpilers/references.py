@@ -0,0 +1,82 @@
+"""
+Reference parameter lowering
+
+C has no references: a parameter declared T& (or const T&) is lowered to a
+T* (see c_types.map_type). For that, the body of its function reaches the
+argument through the pointer (out = total becomes (*out) = total, p.x
+becomes p->x) and every call passes the address of its argument
+(Acc_swapInto(&acc, &v)).
+"""
+
+import re
+from typing import Callable, Dict, Iterable
+
+from .virtuals import rewrite_calls
+
+# Object a pointer can point to: a variable, an element or a member
+_OBJECT = re.compile(
+    r"[A-Za-z_]\w*(?:\s*\[[^\[\]]*\])*(?:\s*(?:->|\.)\s*\w+(?:\s*\[[^\[\]]*\])*)*"
+)
+
+
+def dereference_parameters(body: str, names: Iterable[str]) -> str:
+    """
+    Rewrite the uses of reference parameters in a C++ body to go through
+    the pointers they are lowered to: p.x -> p->x, out = 0 -> (*out) = 0,
+    f(p) -> f((*p)) (the caller of f then passes p itself, see pass_addresses).
+
+    Args:
+        body: C++ function body
+        names: Reference parameters of the function
+    """
+    names = sorted(set(names), key=len, reverse=True)
+    if not names:
+        return body
+    alternatives = "|".join(map(re.escape, names))
+    body = re.sub(rf"(?<![\w.])(?<!->)(?<!::)\b({alternatives})\b(?!\s*::)", r"(*\1)", body)
+    return re.sub(rf"\(\*({alternatives})\)\s*\.\s*", r"\1->", body)
+
+
+def address_of(argument: str, pointee: str, is_constant: Callable[[str], bool]) -> str:
+    """
+    Argument passed for a reference parameter lowered to a pointer to
+    pointee. An object is passed by address and a dereferenced pointer as
+    is; a value (a const T& bound to a temporary or a constant) becomes a
+    compound literal: &(const uint8_t){x + 1}.
+
+    Args:
+        argument: Lowered argument
+        pointee: C type the parameter points to
+        is_constant: Tells the constant expressions (literals, enum
+            constants, #define), which have no address
+    """
+    argument = argument.strip()
+    dereference = re.fullmatch(r"\(\s*\*\s*(\w+)\s*\)|\*\s*(\w+)", argument)
+    if dereference:
+        return dereference.group(1) or dereference.group(2)
+    if _OBJECT.fullmatch(argument) and not is_constant(argument):
+        return f"&{argument}"
+    return f"&({pointee}){{{argument}}}"
+
+
+def pass_addresses(
+    code: str, parameters: Dict[str, Dict[int, str]], is_constant: Callable[[str], bool]
+) -> str:
+    """
+    Pass the address of the arguments of reference parameters in lowered C
+    (see address_of): Acc_swapInto(&acc, v) -> Acc_swapInto(&acc, &v).
+
+    Args:
+        code: Lowered C
+        parameters: Reference parameters of the functions, as
+            {function: {argument index: type pointed to}}; self counts
+        is_constant: Tells the constant expressions, see address_of
+    """
+
+    def rewrite(name, arguments):
+        for index, pointee in parameters[name].items():
+            if index < len(arguments):
+                arguments[index] = address_of(arguments[index], pointee, is_constant)
+        return f"{name}(" + ", ".join(arguments) + ")"
+
+    return rewrite_calls(code, rewrite, parameters)
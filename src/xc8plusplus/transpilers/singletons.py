@@ -0,0 +1,55 @@
+"""
+Self pointer elimination for singleton classes
+
+A method lowered to C receives its instance as `Class* self`, so every field
+access is an indirect access (FSR/INDF on PIC16, after loading the pointer)
+and every call passes the pointer. Peripheral drivers such as `Timer0 timer`
+have a single statically allocated instance though: when a class has exactly
+one instance in the whole program and neither the instance's address nor
+`this` escapes, its methods can work on the global directly. They lose the
+self parameter, `self->field` becomes `timer.field` (a direct access XC8
+resolves at link time) and calls lose their first argument.
+"""
+
+import re
+from typing import Iterable
+
+from .staticinit import matching_close, split_arguments
+
+
+def drop_instance_argument(code: str, functions: Iterable[str]) -> str:
+    """
+    Remove the first argument of the calls to functions in lowered C
+    ("Timer0_delay(&timer, 200)" -> "Timer0_delay(200)").
+    """
+    functions = sorted(set(functions), key=len, reverse=True)
+    if not functions:
+        return code
+    call = re.compile(rf"\b(?:{'|'.join(map(re.escape, functions))})\s*\(")
+
+    result = []
+    position = 0
+    for match in call.finditer(code):
+        if match.start() < position:
+            continue
+        close = matching_close(code, match.end() - 1)
+        if close < 0:
+            continue
+        arguments = split_arguments(code[match.end():close])
+        result.append(code[position:match.end()])
+        # Nested calls in the remaining arguments are rewritten as well
+        result.append(drop_instance_argument(", ".join(arguments[1:]), functions))
+        result.append(")")
+        position = close + 1
+    result.append(code[position:])
+    return "".join(result)
+
+
+def bind_instance(code: str, instance: str) -> str:
+    """
+    Rewrite the self pointer of a lowered method body to the singleton
+    instance: self->field becomes instance.field and self &instance.
+    """
+    code = re.sub(r"\(\s*\*\s*self\s*\)\s*\.", f"{instance}.", code)
+    code = re.sub(r"\bself\s*->\s*", f"{instance}.", code)
+    return re.sub(r"(?<![\w.>])self\b", f"&{instance}", code)
@@ -0,0 +1,179 @@
+"""
+Partial evaluation of methods for constant-configured objects
+
+Driver objects are typically configured once: `Led led0(LedId::LED_0)` stores
+an ID its methods then dispatch on at every call (`switch (ledId)` selecting
+the pin to write). When a field is written only by the constructor and each
+instance is constructed with a constant, the methods reading it can be cloned
+per value with the field replaced by that value and the dispatch folded
+away: `Led_turnOn__LED_0` sets one pin bit, a single BSF. Calls on the
+constant-configured objects then target the clones.
+
+The helpers here work on C++ method bodies, before lowering, so the clones
+go through the same lowering and passes as any other method.
+"""
+
+import re
+from typing import Callable, Dict, Iterable, List, Optional
+
+from .staticinit import matching_close
+
+_COMMENT = re.compile(r"//[^\n]*|/\*.*?\*/", re.DOTALL)
+
+CASE_LABEL = re.compile(r"\b(?:case\s+((?:[^:]|::)+?)\s*:(?!:)|default\s*:(?!:))")
+
+
+def mask_comments(code: str) -> str:
+    """Blank out comments, keeping every other character at its position"""
+    return _COMMENT.sub(lambda match: re.sub(r"[^\n]", " ", match.group()), code)
+
+
+def substitute_field(body: str, field: str, value: str) -> str:
+    """Replace the reads of a member (field, this->field) by a value"""
+    return re.sub(
+        rf"(?:\bthis\s*->\s*|(?<![\w.>:]))\b{re.escape(field)}\b(?!\s*\()", value, body
+    )
+
+
+def rename_calls(body: str, renames: Dict[str, str]) -> str:
+    """Rename the calls to methods of the same object (method(), this->method())"""
+    if not renames:
+        return body
+    names = "|".join(re.escape(name) for name in sorted(renames, key=len, reverse=True))
+    return re.sub(
+        rf"(\bthis\s*->\s*|(?<![\w.>:]))\b({names})(?=\s*\()",
+        lambda match: match.group(1) + renames[match.group(2)],
+        body,
+    )
+
+
+def top_level_matches(masked: str, start: int, end: int, pattern) -> List[re.Match]:
+    """Matches of pattern in masked[start:end] outside nested brackets"""
+    matches = []
+    depth = 0
+    index = start
+    while index < end:
+        char = masked[index]
+        if char in "([{":
+            depth += 1
+        elif char in ")]}":
+            depth -= 1
+        elif depth == 0:
+            match = pattern.match(masked, index, end)
+            previous = masked[index - 1] if index else " "
+            if match and not (previous.isalnum() or previous == "_"):
+                matches.append(match)
+                index = match.end()
+                continue
+        index += 1
+    return matches
+
+
+def _reindent(text: str, indent: str) -> str:
+    """Strip the common indentation of text and indent it again"""
+    lines = [line.rstrip() for line in text.strip("\n").split("\n")]
+    lines = [line for line in lines if line.strip()]
+    if not lines:
+        return ""
+    common = min(len(line) - len(line.lstrip()) for line in lines)
+    return "\n".join(indent + line[common:] for line in lines)
+
+
+def _selected_statements(
+    body: str, masked: str, open_brace: int, close_brace: int, key: str,
+    evaluate: Callable[[str], Optional[str]],
+) -> Optional[str]:
+    """
+    Statements a switch on the constant key executes, or None when the
+    switch cannot be folded (non-constant labels, an inner break).
+    """
+    labels = top_level_matches(masked, open_brace + 1, close_brace, CASE_LABEL)
+    groups = []
+    for index, label in enumerate(labels):
+        end = labels[index + 1].start() if index + 1 < len(labels) else close_brace
+        value = None
+        if label.group(1) is not None:
+            value = evaluate(body[label.start(1):label.end(1)])
+            if value is None:
+                return None
+        groups.append((value, label.group(1) is None, label.end(), end))
+
+    chosen = next((i for i, group in enumerate(groups) if group[0] == key), None)
+    if chosen is None:
+        chosen = next((i for i, group in enumerate(groups) if group[1]), None)
+    if chosen is None:
+        return ""
+
+    # Run on from the chosen label (fallthrough) to the first break/return
+    stop = re.compile(r"break\s*;|return\b[^;]*;")
+    statements = []
+    for _, _, start, end in groups[chosen:]:
+        found = top_level_matches(masked, start, end, stop)
+        if found:
+            first = found[0]
+            before = masked[:first.start()].rstrip()
+            if before and before[-1] not in ";{}:":
+                # Conditional exit (if (x) break;): the case is not linear
+                return None
+            end = first.start() if first.group().startswith("break") else first.end()
+        if re.search(r"\bbreak\b", masked[start:end]):
+            return None
+        statements.append(body[start:end])
+        if found:
+            break
+    return "\n".join(statements)
+
+
+def fold_constant_switches(body: str, evaluate: Callable[[str], Optional[str]]) -> str:
+    """
+    Replace each switch on a constant by the statements of the case it
+    selects.
+
+    Args:
+        body: C++ (or C) function body
+        evaluate: Canonical value of a constant expression, None for an
+            expression that is not constant; case labels and the switch
+            expression are compared through it
+    """
+    position = 0
+    while True:
+        masked = mask_comments(body)
+        match = re.compile(r"\bswitch\s*\(").search(masked, position)
+        if not match:
+            return body
+        close_paren = matching_close(masked, match.end() - 1)
+        brace = re.compile(r"\s*\{").match(masked, close_paren + 1) if close_paren > 0 else None
+        if not brace:
+            position = match.end()
+            continue
+        open_brace = brace.end() - 1
+        close_brace = matching_close(masked, open_brace)
+        key = evaluate(body[match.end():close_paren])
+        if key is None or close_brace < 0:
+            position = match.end()
+            continue
+        selected = _selected_statements(body, masked, open_brace, close_brace, key, evaluate)
+        if selected is None:
+            position = match.end()
+            continue
+        line_start = body.rfind("\n", 0, match.start()) + 1
+        indent = re.match(r"[ \t]*", body[line_start:]).group()
+        replacement = _reindent(selected, indent).lstrip()
+        body = body[:match.start()] + replacement + body[close_brace + 1:]
+        position = match.start() + len(replacement)
+
+
+def clone_suffix(values: Iterable[str], prefixes: Iterable[str] = ()) -> str:
+    """
+    Name suffix of a clone for the values of its constant fields
+    ("LedId_LED_0" -> "LED_0", "-1" -> "m1").
+    """
+    prefixes = sorted(prefixes, key=len, reverse=True)
+    parts = []
+    for value in values:
+        for prefix in prefixes:
+            if value.startswith(f"{prefix}_"):
+                value = value[len(prefix) + 1:]
+                break
+        parts.append(re.sub(r"\W", "_", value.replace("-", "m")))
+    return "_".join(parts)
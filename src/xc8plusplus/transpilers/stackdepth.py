@@ -0,0 +1,335 @@
+"""
+Hardware return-stack depth analysis
+
+PIC parts keep return addresses in a small hardware stack (8 levels on
+mid-range PIC16) that silently wraps on overflow, and XC8 cannot compile
+recursion for them. This pass walks the call graph of the lowered program to
+find the deepest call chain from main and from each interrupt handler, and
+any recursive cycle. An interrupt can fire at the deepest point of main and
+its entry takes a level of its own, so the worst case is main's depth plus
+the depth of every handler (PIC18 high-priority interrupts can preempt
+low-priority ones).
+
+Parts without a hardware multiplier (PIC10/12/16) have no multiply or divide
+instruction: XC8 calls a library routine (__wmul, __lwdiv, __lwmod, ...)
+for a multi-byte *, / or %, which takes one more level below the function
+doing it.
+"""
+
+import re
+from dataclasses import dataclass, field
+from typing import Callable, Dict, Iterable, List, Mapping, Optional
+
+from .c_types import c_type_size
+from .callgraph import CallGraph, strip_comments_and_literals
+
+STACK_CHECKS = ("warn", "error", "off")
+
+# Device family per part number prefix, most specific prefix first
+_DEVICE_FAMILIES = (
+    ("PIC10F2", "baseline"),
+    ("PIC12F5", "baseline"),
+    ("PIC16F5", "baseline"),
+    ("PIC12F1", "enhanced"),
+    ("PIC16F1", "enhanced"),
+    ("PIC18", "pic18"),
+    ("PIC10", "midrange"),
+    ("PIC12", "midrange"),
+    ("PIC16", "midrange"),
+)
+
+# Hardware return-stack levels per device family
+FAMILY_STACK_LEVELS = {"baseline": 2, "midrange": 8, "enhanced": 16, "pic18": 31}
+
+# Families where XC8 does multi-byte multiply, divide and modulo in a
+# library routine
+HELPER_CALL_FAMILIES = ("baseline", "midrange", "enhanced")
+
+# Step of a call chain standing for such a routine
+RUNTIME_HELPER = "<runtime helper>"
+
+# Operands of a binary *, / or %: a name, member or element, a literal, or
+# a parenthesized expression or call (its closing/opening parenthesis)
+_LEFT_OPERAND = r"(\w+(?:\s*(?:->|\.)\s*\w+)*(?:\s*\[[^\[\]]*\])*|\))"
+_RIGHT_OPERAND = r"(\w+(?:\s*(?:->|\.)\s*\w+)*|\()"
+_ARITHMETIC = re.compile(rf"{_LEFT_OPERAND}\s*[*/%]=?\s*{_RIGHT_OPERAND}")
+
+# Scalar declarations of a body (parameters and locals)
+_SCALAR_DECLARATION = re.compile(
+    r"\b((?:(?:un)?signed\s+)?(?:char|short|int|long\s+long|long)|u?int\d+_t|bool|"
+    r"float|double)\s+(\w+)\s*[=;,)\[]"
+)
+
+# Words that precede a dereference, not an operand
+_KEYWORDS = {"return", "case", "else", "do", "sizeof", "const", "volatile"}
+
+# Type words a * can follow in a declaration
+_TYPE_WORDS = {
+    "void", "bool", "char", "short", "int", "long", "signed", "unsigned", "float", "double",
+}
+
+
+def device_family(device: str) -> str:
+    """
+    Family of a PIC device: 'baseline', 'midrange', 'enhanced' (enhanced
+    mid-range PIC12F1xxx/PIC16F1xxx) or 'pic18'. Unknown parts are taken
+    for mid-range.
+    """
+    device = device.upper()
+    for prefix, family in _DEVICE_FAMILIES:
+        if device.startswith(prefix):
+            # PIC16F1xx without a fourth digit is not an enhanced part
+            if family == "enhanced" and len(device) < len(prefix) + 3:
+                continue
+            return family
+    return "midrange"
+
+
+def device_stack_levels(device: str) -> int:
+    """
+    Hardware return-stack levels of a PIC device.
+
+    Enhanced mid-range parts (PIC12F1xxx/PIC16F1xxx) have 16 levels, PIC18
+    parts 31, baseline parts 2 and the other mid-range parts 8.
+    """
+    return FAMILY_STACK_LEVELS[device_family(device)]
+
+
+def _literal_value(operand: str) -> Optional[int]:
+    """Value of an integer literal operand, None for anything else"""
+    literal = re.fullmatch(r"(?:0[xX]([0-9a-fA-F]+)|(\d+))[uUlL]*", operand)
+    if not literal:
+        return None
+    return int(literal.group(1), 16) if literal.group(1) else int(literal.group(2))
+
+
+def _operand_width(
+    operand: str, widths: Mapping[str, int], is_constant: Callable[[str], bool]
+) -> Optional[int]:
+    """Bytes of an operand; None when they are not known"""
+    value = _literal_value(operand)
+    if value is not None:
+        return 1 if value <= 0xFF else 2
+    if operand in ("(", ")") or is_constant(operand):
+        return None
+    return widths.get(re.findall(r"\w+", re.sub(r"\[[^\[\]]*\]", "", operand))[-1])
+
+
+def _is_power_of_two(operand: str) -> bool:
+    """Check whether an operand is a literal power of two (a shift or mask)"""
+    value = _literal_value(operand)
+    return bool(value) and value & (value - 1) == 0
+
+
+def _is_type(word: str, type_names) -> bool:
+    """Check whether the word before a * names a type (T *p, a declaration)"""
+    return word in _TYPE_WORDS or word in type_names or bool(re.fullmatch(r"\w+_t", word))
+
+
+def calls_arithmetic_helper(
+    code: str,
+    widths: Mapping[str, int],
+    is_constant: Callable[[str], bool] = lambda operand: False,
+    type_names: Iterable[str] = (),
+) -> bool:
+    """
+    Check whether lowered C code does a multiply, divide or modulo XC8 calls
+    a library routine for on parts without a hardware multiplier: one with an
+    operand wider than a byte (or of unknown width) that is neither folded
+    (two constants) nor a shift or mask (a power of two).
+
+    Args:
+        code: Lowered C code
+        widths: Bytes of the globals, fields and parameters; the scalars
+            declared in code are added
+        is_constant: Tells the named constants (enum constants, #define)
+        type_names: Types of the program, so T *p is not read as T * p
+    """
+    code = strip_comments_and_literals(code)
+    widths = dict(widths)
+    for c_type, name in _SCALAR_DECLARATION.findall(code):
+        widths[name] = c_type_size(re.sub(r"\s+", " ", c_type))
+    type_names = set(type_names)
+
+    for match in _ARITHMETIC.finditer(code):
+        left, right = match.group(1), match.group(2)
+        if left in _KEYWORDS or _is_type(left, type_names):
+            continue
+        operator = code[match.end(1):match.start(2)].strip()[0]
+        if _is_power_of_two(right) or operator == "*" and _is_power_of_two(left):
+            continue
+        constants = [
+            _literal_value(operand) is not None or is_constant(operand) for operand in (left, right)
+        ]
+        if all(constants):
+            continue
+        sizes = [_operand_width(operand, widths, is_constant) for operand in (left, right)]
+        if any(size is None or size > 1 for size in sizes):
+            return True
+    return False
+
+
+@dataclass
+class StackPath:
+    """Deepest call chain from an entry point"""
+
+    root: str
+    path: List[str]
+    depth: int
+    interrupt: bool = False
+
+
+@dataclass
+class StackReport:
+    """
+    Result of the stack depth analysis.
+
+    Attributes:
+        device: Target PIC device
+        budget: Hardware return-stack levels of the device
+        paths: Deepest call chain of each entry point; the depth of an
+            interrupt handler includes its entry level
+        recursion: Recursive call cycles reachable from the entry points
+        helper_callers: Functions counted one level deeper for calling an
+            arithmetic library routine
+    """
+
+    device: str
+    budget: int
+    paths: List[StackPath] = field(default_factory=list)
+    recursion: List[List[str]] = field(default_factory=list)
+    helper_callers: List[str] = field(default_factory=list)
+
+    @property
+    def worst_case(self) -> int:
+        """Deepest stack use: main plus every interrupt handler on top of it"""
+        return sum(path.depth for path in self.paths)
+
+    def problems(self) -> List[str]:
+        """Stack overflow and recursion found, as messages"""
+        problems = []
+        if self.worst_case > self.budget:
+            problems.append(
+                f"worst-case call depth {self.worst_case} exceeds the "
+                f"{self.budget}-level hardware stack of {self.device}"
+            )
+        for cycle in self.recursion:
+            problems.append(f"recursion is not supported by XC8: {' -> '.join(cycle)}")
+        return problems
+
+    def format(self) -> str:
+        """Human-readable report of the deepest paths"""
+        lines = [f"Stack depth ({self.device}, {self.budget} levels):"]
+        for path in self.paths:
+            entry = " (interrupt entry included)" if path.interrupt else ""
+            lines.append(
+                f"  {path.root}: {path.depth} levels{entry}: {' -> '.join(path.path)}"
+            )
+        if self.helper_callers:
+            lines.append(
+                f"  arithmetic library calls (one level): {', '.join(self.helper_callers)}"
+            )
+        lines.append(f"  worst case: {self.worst_case} of {self.budget} levels")
+        for cycle in self.recursion:
+            lines.append(f"  recursion: {' -> '.join(cycle)}")
+        return "\n".join(lines)
+
+
+def _recursive_cycles(graph: CallGraph, roots: Iterable[str]) -> List[List[str]]:
+    """Call cycles reachable from roots, each starting and ending at one symbol"""
+    cycles = []
+    seen = set()
+    on_path: Dict[str, int] = {}
+    path: List[str] = []
+
+    def visit(name):
+        on_path[name] = len(path)
+        path.append(name)
+        for callee in graph.calls.get(name, ()):
+            if callee in on_path:
+                cycles.append(path[on_path[callee]:] + [callee])
+            elif callee not in seen:
+                visit(callee)
+        path.pop()
+        del on_path[name]
+        seen.add(name)
+
+    for root in roots:
+        if root in graph.calls and root not in seen:
+            visit(root)
+    return cycles
+
+
+def _deepest_path(graph: CallGraph, root: str, free_calls, helper_callers) -> List[str]:
+    """
+    Deepest acyclic call chain from root; calls to free_calls cost no level,
+    helper_callers call RUNTIME_HELPER
+    """
+    memo: Dict[str, tuple] = {}
+    active = set()
+
+    def deepest(name):
+        if name in memo:
+            return memo[name]
+        active.add(name)
+        best = (1, [name, RUNTIME_HELPER]) if name in helper_callers else (0, [name])
+        for callee in graph.calls.get(name, ()):
+            if callee in active:
+                continue
+            depth, chain = deepest(callee)
+            depth += 0 if callee in free_calls else 1
+            if depth > best[0]:
+                best = (depth, [name] + chain)
+        active.discard(name)
+        memo[name] = best
+        return best
+
+    return deepest(root)[1]
+
+
+def analyze_stack(
+    graph: CallGraph,
+    main: Optional[str],
+    interrupts: Iterable[str],
+    device: str,
+    budget: Optional[int] = None,
+    free_calls: Iterable[str] = (),
+    helper_callers: Iterable[str] = (),
+) -> StackReport:
+    """
+    Find the deepest call chains and the recursion of a program.
+
+    Args:
+        graph: Call graph of the lowered program
+        main: Name of main, or None when there is none
+        interrupts: Names of the interrupt handlers
+        device: Target PIC device
+        budget: Stack levels available (default: those of the device)
+        free_calls: Functions whose calls use no stack level (inlined)
+        helper_callers: Functions calling an XC8 arithmetic library routine,
+            one level deeper (see calls_arithmetic_helper)
+
+    Returns:
+        StackReport with one path per entry point
+    """
+    free_calls = set(free_calls)
+    helper_callers = set(helper_callers)
+    interrupts = [name for name in interrupts if name in graph.calls]
+    report = StackReport(
+        device=device,
+        budget=device_stack_levels(device) if budget is None else budget,
+    )
+
+    roots = ([main] if main in graph.calls else []) + interrupts
+    reachable = graph.reachable(roots)
+    report.helper_callers = sorted(name for name in helper_callers if name in reachable)
+    for root in roots:
+        chain = _deepest_path(graph, root, free_calls, helper_callers)
+        depth = sum(1 for callee in chain[1:] if callee not in free_calls)
+        interrupt = root in interrupts
+        report.paths.append(
+            StackPath(root, chain, depth + (1 if interrupt else 0), interrupt)
+        )
+
+    report.recursion = _recursive_cycles(graph, roots)
+    return report
@@ -0,0 +1,314 @@
+"""
+Compile-time evaluation of global constructors
+
+A C++ global such as `Led led0(LedId::LED_0);` runs its constructor before
+main. Most of what a constructor does is storing constants into members (the
+member initializer list, `field = value;` at the top of the body), and that
+part can become a constant aggregate initializer: XC8 then places the object
+in initialized data, copied from program memory by the startup code, instead
+of running code to build it. Only what is genuinely dynamic - calls such as
+`turnOff()` that touch a port, or values that are not constant expressions -
+is left for a generated routine that main calls before anything else.
+"""
+
+import re
+from dataclasses import dataclass, field
+from typing import Dict, Iterable, List, Optional, Set, Tuple
+
+_COMMENT = re.compile(r"//[^\n]*|/\*.*?\*/", re.DOTALL)
+
+_NUMBER = r"(?:0[xX][0-9a-fA-F]+|0[bB][01]+|\d+\.?\d*(?:[eE][-+]?\d+)?|\.\d+(?:[eE][-+]?\d+)?)[uUlLfF]*"
+
+_TOKEN = re.compile(
+    r"(?P<space>\s+)"
+    rf"|(?P<number>{_NUMBER})"
+    r"|(?P<char>'(?:\\.|[^'\\])')"
+    r'|(?P<string>"(?:\\.|[^"\\])*")'
+    r"|(?P<name>[A-Za-z_]\w*)"
+    r"|(?P<op><<|>>|==|!=|<=|>=|&&|\|\||[-+*/%~!<>&|^?:(){},])"
+)
+
+# Values every constant expression may use besides literals
+_CONSTANT_NAMES = {"true", "false", "NULL"}
+
+# Initializers equivalent to the zero-initialization of static storage
+_ZERO = re.compile(r"[{}\s,]*(?:(?:0+(?:\.0*)?[uUlLfF]*|false|NULL)[{}\s,]*)*")
+
+
+@dataclass
+class Constructor:
+    """
+    A constructor found in the source.
+
+    Attributes:
+        params: (name, default argument or None) of each parameter
+        initializers: Member initializer list, member name -> C++ expression
+        body: Constructor body (C++, comments removed)
+        defined: False for a declaration without body, which may still
+            carry the default arguments
+    """
+
+    params: List[Tuple[Optional[str], Optional[str]]]
+    initializers: Dict[str, str] = field(default_factory=dict)
+    body: str = ""
+    defined: bool = True
+
+    def accepts(self, count: int) -> bool:
+        """Check whether the constructor can be called with count arguments"""
+        required = sum(1 for _, default in self.params if default is None)
+        return required <= count <= len(self.params)
+
+
+def strip_comments(code: str) -> str:
+    """Remove the comments of C/C++ code"""
+    return _COMMENT.sub(" ", code)
+
+
+def matching_close(text: str, start: int) -> int:
+    """Index of the bracket closing the one at start, or -1"""
+    pairs = {"(": ")", "{": "}", "[": "]"}
+    stack = []
+    for index in range(start, len(text)):
+        char = text[index]
+        if char in pairs:
+            stack.append(pairs[char])
+        elif stack and char == stack[-1]:
+            stack.pop()
+            if not stack:
+                return index
+    return -1
+
+
+def split_arguments(text: str) -> List[str]:
+    """Split an argument or initializer list at its top-level commas"""
+    parts = []
+    depth = 0
+    start = 0
+    for index, char in enumerate(text):
+        if char in "([{":
+            depth += 1
+        elif char in ")]}":
+            depth -= 1
+        elif char == "," and depth == 0:
+            parts.append(text[start:index].strip())
+            start = index + 1
+    last = text[start:].strip()
+    if last or parts:
+        parts.append(last)
+    return parts
+
+
+def _parameter(declaration: str) -> Tuple[Optional[str], Optional[str]]:
+    """(name, default) of a parameter declaration ("LedId id = LedId::LED_0")"""
+    default = None
+    flat_depth = 0
+    for index, char in enumerate(declaration):
+        if char in "([{<":
+            flat_depth += 1
+        elif char in ")]}>":
+            flat_depth -= 1
+        elif char == "=" and flat_depth == 0:
+            default = declaration[index + 1:].strip()
+            declaration = declaration[:index]
+            break
+    declaration = re.sub(r"\[[^\]]*\]", "", declaration).strip()
+    words = re.findall(r"[A-Za-z_]\w*", declaration)
+    # A lone type ("int") has no name
+    name = words[-1] if len(words) > 1 else None
+    return name, default
+
+
+def _member_initializers(text: str, start: int) -> Tuple[Dict[str, str], int]:
+    """
+    Parse a member initializer list ("a(x), b{y}") starting at start.
+
+    Returns:
+        The initializers and the index of the body's opening brace (-1 when
+        the list does not parse)
+    """
+    initializers = {}
+    index = start
+    while True:
+        match = re.compile(r"\s*([A-Za-z_][\w:]*)\s*([({])").match(text, index)
+        if not match:
+            return initializers, -1
+        close = matching_close(text, match.end(2) - 1)
+        if close < 0:
+            return initializers, -1
+        initializers[match.group(1)] = text[match.end(2):close].strip()
+        separator = re.compile(r"\s*([,{])").match(text, close + 1)
+        if not separator:
+            return initializers, -1
+        if separator.group(1) == "{":
+            return initializers, separator.end(1) - 1
+        index = separator.end(1)
+
+
+def find_constructors(source: str, class_name: str) -> List[Constructor]:
+    """
+    Find the constructors of a class in a source file: definitions, both
+    out of class (`Led::Led(LedId id) : ledId(id) { ... }`) and in class,
+    and declarations (`Led(LedId id = LedId::LED_0);`).
+    """
+    source = strip_comments(source)
+    name = re.escape(class_name)
+    pattern = re.compile(rf"(?:\b{name}\s*::\s*|(?<![\w:~.>]))\b{name}\s*\(")
+
+    constructors = []
+    for match in pattern.finditer(source):
+        close = matching_close(source, match.end() - 1)
+        if close < 0:
+            continue
+        params = [
+            _parameter(param)
+            for param in split_arguments(source[match.end():close])
+            if param and param != "void"
+        ]
+        after = re.compile(r"\s*([:{;])").match(source, close + 1)
+        if not after:
+            continue
+        if after.group(1) == ";":
+            constructors.append(Constructor(params, defined=False))
+            continue
+        initializers = {}
+        brace = after.end(1) - 1
+        if after.group(1) == ":":
+            initializers, brace = _member_initializers(source, after.end(1))
+            if brace < 0:
+                continue
+        end = matching_close(source, brace)
+        if end < 0:
+            continue
+        constructors.append(Constructor(params, initializers, source[brace + 1:end].strip()))
+    return constructors
+
+
+def split_statements(body: str) -> List[str]:
+    """
+    Split a body into its top-level statements; compound statements
+    (if/else, loops, blocks) stay whole.
+    """
+    statements = []
+    depth = 0
+    start = 0
+    index = 0
+    while index < len(body):
+        char = body[index]
+        end = None
+        if char in "([{":
+            depth += 1
+        elif char in ")]}":
+            depth -= 1
+            if char == "}" and depth == 0:
+                end = index + 1
+        elif char == ";" and depth == 0:
+            end = index + 1
+        if end is not None:
+            # An else belongs to the if statement just closed
+            if re.match(r"\s*else\b", body[end:]):
+                index += 1
+                continue
+            statement = body[start:end].strip()
+            if statement and statement != ";":
+                statements.append(statement)
+            start = end
+        index += 1
+    rest = body[start:].strip()
+    if rest:
+        statements.append(rest)
+    return statements
+
+
+def member_assignment(statement: str) -> Optional[Tuple[str, str]]:
+    """(member, value) of a plain store "field = value;" / "this->field = value;" """
+    match = re.fullmatch(
+        r"(?:this\s*->\s*)?([A-Za-z_]\w*)\s*=(?!=)\s*(.+?)\s*;", statement.strip(), re.DOTALL
+    )
+    return (match.group(1), match.group(2)) if match else None
+
+
+def substitute_names(code: str, values: Dict[str, str]) -> str:
+    """
+    Replace parameter names by their values in C/C++ code, leaving member
+    accesses (obj.name, this->name) alone. Values that are not a single
+    operand are parenthesized.
+    """
+    if not values:
+        return code
+
+    def replace(match):
+        value = values[match.group(1)]
+        if re.fullmatch(r"&?\s*[\w.]+|'(?:\\.|[^'\\])'", value):
+            return value
+        return f"({value})"
+
+    names = "|".join(re.escape(name) for name in sorted(values, key=len, reverse=True))
+    return re.sub(rf"(?<![\w.>])\b({names})\b", replace, code)
+
+
+def is_constant_expression(
+    expr: str, constants: Iterable[str] = (), addresses: Iterable[str] = ()
+) -> bool:
+    """
+    Check whether a C expression can initialize an object of static storage.
+
+    Args:
+        expr: C expression, or a brace-enclosed initializer list
+        constants: Names of compile-time constants (enum constants)
+        addresses: Names of objects with static storage; their address
+            (&name) is a link-time constant
+
+    Returns:
+        True for literals (a string literal stands for its address),
+        constants and addresses combined with operators; False for anything
+        reading a variable or calling a function
+    """
+    constants = _CONSTANT_NAMES | set(constants)
+    addresses = set(addresses)
+    if not expr or not expr.strip():
+        return False
+
+    previous = None
+    position = 0
+    tokens = []
+    while position < len(expr):
+        match = _TOKEN.match(expr, position)
+        if not match:
+            return False
+        position = match.end()
+        if match.lastgroup != "space":
+            tokens.append((match.lastgroup, match.group()))
+
+    for index, (kind, text) in enumerate(tokens):
+        following = tokens[index + 1][1] if index + 1 < len(tokens) else None
+        if kind == "name":
+            if following == "(":
+                return False
+            if text not in constants and not (text in addresses and previous == "&"):
+                return False
+        previous = text
+    return True
+
+
+def is_zero_initializer(initializer: str) -> bool:
+    """Check whether an initializer only holds zeros (static storage's default)"""
+    return bool(_ZERO.fullmatch(initializer))
+
+
+def order_by_dependency(names: List[str], dependencies: Dict[str, Set[str]]) -> List[str]:
+    """
+    Order names so that each comes after the names it depends on, keeping
+    the given order otherwise (and for cycles).
+    """
+    remaining = list(names)
+    ordered: List[str] = []
+    while remaining:
+        for name in remaining:
+            pending = (dependencies.get(name, set()) & set(remaining)) - {name}
+            if not pending:
+                break
+        else:
+            name = remaining[0]
+        ordered.append(name)
+        remaining.remove(name)
+    return ordered
@@ -0,0 +1,335 @@
+"""
+Lowering of dense dispatch switches
+
+XC8 compiles a switch into a chain of compare-and-branch instructions (or a
+jump table it picks by heuristics), so a switch mapping an enum to a pin or a
+value costs a few words per case and runs in time linear in the case index.
+When every case does the same thing with a different constant - returning a
+value, storing a value to one variable, setting, clearing or reading one pin
+bit - the switch is a lookup: the constants go to a const table XC8 keeps in
+program memory, indexed by the switch expression.
+
+    switch (self->ledId) {          *switch_ports[self->ledId] |=
+        case LedId_LED_0:               switch_masks[self->ledId];
+            LED0 = 1; break;
+        ...
+
+Pins are resolved through their `#define LED0 PORTAbits.RA3` macros (or the
+XC8 RA3/LATA3 bit names) to a port and bit mask. A switch whose table does
+not pay for itself under the optimization goal keeps its form and gets a
+`#pragma switch` telling XC8 how to encode it instead.
+"""
+
+import re
+from dataclasses import dataclass, field
+from typing import Callable, Dict, List, Optional, Tuple
+
+from .c_types import smallest_integer_type
+from .specialize import CASE_LABEL, mask_comments, top_level_matches
+from .staticinit import matching_close
+
+# #pragma switch encoding for each optimization goal, and for switches in an
+# interrupt handler, whose latency should not depend on the case taken
+SWITCH_PRAGMAS = {"size": "space", "speed": "speed"}
+INTERRUPT_SWITCH_PRAGMA = "time"
+
+# A table replaces switches of at least this many cases
+MIN_TABLE_CASES = 3
+
+# Approximate cost in words (and cycles) of the two encodings: a compare and
+# branch per case plus the case body and its exit, against a table lookup
+# (bounds check, indexed load) plus one RETLW word per table byte
+CASE_COMPARE_WORDS = 3
+CASE_BODY_WORDS = 2
+VALUE_LOOKUP_WORDS = 8
+PIN_LOOKUP_WORDS = 14
+
+Pin = Tuple[str, int]
+
+_PIN_FIELD = re.compile(r"(PORT|LAT)([A-Z])bits\s*\.\s*(?:R|LAT)[A-Z](\d)")
+_PIN_NAME = re.compile(r"(R|LAT)([A-Z])(\d)")
+_PIN_MACRO = re.compile(
+    r"^\s*#\s*define\s+(\w+)\s+\(?\s*((?:PORT|LAT)[A-Z]bits\s*\.\s*\w+)\s*\)?\s*$", re.M
+)
+
+
+def pin_definitions(sources) -> Dict[str, str]:
+    """Pin macros (#define LED0 PORTAbits.RA3) found in source texts"""
+    pins = {}
+    for source in sources:
+        pins.update(dict(_PIN_MACRO.findall(source)))
+    return pins
+
+
+def resolve_pin(name: str, macros: Dict[str, str]) -> Optional[Pin]:
+    """(port register, bit) a pin expression writes or reads, or None"""
+    name = macros.get(name.strip(), name.strip())
+    match = _PIN_FIELD.fullmatch(name)
+    if match:
+        return f"{match.group(1)}{match.group(2)}", int(match.group(3))
+    match = _PIN_NAME.fullmatch(name)
+    if match:
+        register = "PORT" if match.group(1) == "R" else "LAT"
+        return f"{register}{match.group(2)}", int(match.group(3))
+    return None
+
+
+@dataclass
+class CaseAction:
+    """
+    What one case does with its constant.
+
+    Attributes:
+        kind: "return" (return value), "assign" (target = value), "write"
+            (pin = value) or "read" (return the pin, or its complement)
+        target: Assigned variable, or the polarity of a read ("1", "0")
+        value: Returned or stored constant, as written
+        pin: Pin written or read
+    """
+
+    kind: str
+    target: str = ""
+    value: str = ""
+    pin: Optional[Pin] = None
+
+    def shape(self):
+        """What must be equal across cases for one table to cover them"""
+        if self.kind == "write":
+            return (self.kind, self.value)
+        return (self.kind, self.target)
+
+
+@dataclass
+class DispatchSwitch:
+    """A switch on constants whose cases are all one-action"""
+
+    expression: str
+    cases: List[Tuple[int, CaseAction]] = field(default_factory=list)
+    default: Optional[str] = None
+
+
+def _case_action(statements: str, value_of, macros) -> Optional[CaseAction]:
+    """Classify the statements of a case (up to its break/return)"""
+    text = " ".join(statements.split())
+    match = re.fullmatch(r"return\s+\(?\s*(.+?)\s*\)?\s*;", text)
+    if match:
+        expression = match.group(1)
+        compared = re.fullmatch(r"\(?\s*(.+?)\s*(==|!=)\s*([01])\s*\)?", expression)
+        if compared:
+            pin = resolve_pin(compared.group(1), macros)
+            if pin:
+                polarity = (compared.group(2) == "==") == (compared.group(3) == "1")
+                return CaseAction("read", "1" if polarity else "0", pin=pin)
+        pin = resolve_pin(expression, macros)
+        if pin:
+            return CaseAction("read", "1", pin=pin)
+        if value_of(expression) is not None:
+            return CaseAction("return", value=expression)
+        return None
+    match = re.fullmatch(r"([\w.]+(?:\s*->\s*\w+)*)\s*=\s*([^=;]+?)\s*;\s*break\s*;", text)
+    if match and value_of(match.group(2)) is not None:
+        pin = resolve_pin(match.group(1), macros)
+        if pin and match.group(2) in ("0", "1"):
+            return CaseAction("write", value=match.group(2), pin=pin)
+        if not pin:
+            return CaseAction("assign", target=match.group(1), value=match.group(2))
+    return None
+
+
+def parse_dispatch(body: str, masked: str, open_brace: int, close_brace: int,
+                   expression: str, value_of, macros) -> Optional[DispatchSwitch]:
+    """Parse the block of a switch into a DispatchSwitch, None if it is not one"""
+    labels = top_level_matches(masked, open_brace + 1, close_brace, CASE_LABEL)
+    if not labels or masked[open_brace + 1:labels[0].start()].strip():
+        return None
+    dispatch = DispatchSwitch(expression)
+    pending = []
+    for index, label in enumerate(labels):
+        end = labels[index + 1].start() if index + 1 < len(labels) else close_brace
+        statements = body[label.end():end].strip()
+        statements = mask_comments(statements).strip()
+        if label.group(1) is None:
+            if pending or index + 1 < len(labels):
+                # default in the middle of the cases, or falling through to it
+                return None
+            statements = re.sub(r"\bbreak\s*;\s*$", "", statements).strip()
+            if re.search(r"\bbreak\b|\bcase\b", statements):
+                return None
+            dispatch.default = statements
+            continue
+        value = value_of(body[label.start(1):label.end(1)])
+        if value is None:
+            return None
+        pending.append(value)
+        if not statements:
+            continue
+        action = _case_action(statements, value_of, macros)
+        if action is None:
+            return None
+        dispatch.cases += [(case, action) for case in pending]
+        pending = []
+    if pending:
+        return None
+    return dispatch
+
+
+def _table_pays_off(dispatch: DispatchSwitch, span: int, entry_bytes: int,
+                    lookup_words: int, goal: str) -> bool:
+    """Compare the table lookup against the compare-and-branch chain"""
+    cases = len(dispatch.cases)
+    if cases < MIN_TABLE_CASES:
+        return False
+    if goal == "speed":
+        # Average cycles to reach a case against the constant lookup time
+        return lookup_words < CASE_COMPARE_WORDS * (cases + 1) / 2
+    chain = cases * (CASE_COMPARE_WORDS + CASE_BODY_WORDS)
+    return lookup_words + span * entry_bytes < chain
+
+
+def _lookup(dispatch: DispatchSwitch, value_of, goal: str, suffix: str) -> Optional[str]:
+    """Table-based replacement of a dispatch switch, None if it does not pay"""
+    actions = [action for _, action in dispatch.cases]
+    if len({action.shape() for action in actions}) != 1:
+        return None
+    if not re.fullmatch(r"[\w.\s]+(?:->[\w.\s]+)*", dispatch.expression):
+        # The expression is evaluated twice (bounds check, index)
+        return None
+    kind = actions[0].kind
+    numbers = [value for value, _ in dispatch.cases]
+    if len(set(numbers)) != len(numbers):
+        return None
+    low = min(numbers)
+    span = max(numbers) - low + 1
+    expression = dispatch.expression.strip()
+    index = expression if low == 0 else f"{expression} - {low}"
+    entries = dict(dispatch.cases)
+    default = dispatch.default or ""
+    lines = []
+
+    if kind in ("return", "assign"):
+        filler = None
+        if span != len(numbers):
+            # Holes take the default value
+            fallback = _case_action(default + ("" if kind == "return" else " break;"), value_of, {})
+            if fallback is None or fallback.shape() != actions[0].shape():
+                return None
+            filler = fallback.value
+        values = [entries[low + i].value if low + i in entries else filler for i in range(span)]
+        c_type = smallest_integer_type(int(value_of(value)) for value in values)
+        entry_bytes = 1 if c_type.endswith("8_t") else 2
+        if not _table_pays_off(dispatch, span, entry_bytes, VALUE_LOOKUP_WORDS, goal):
+            return None
+        table = f"switch_values{suffix}"
+        lines.append(f"static const {c_type} {table}[] = {{{', '.join(values)}}};")
+        if kind == "return":
+            lookup = f"return {table}[{index}];"
+        else:
+            lookup = f"{actions[0].target} = {table}[{index}];"
+    else:
+        if span != len(numbers) and (kind == "read" or default):
+            return None
+        pins = [entries[low + i].pin if low + i in entries else None for i in range(span)]
+        ports = sorted({pin[0] for pin in pins if pin})
+        entry_bytes = 1 if len(ports) == 1 else 2
+        if not _table_pays_off(dispatch, span, entry_bytes, PIN_LOOKUP_WORDS, goal):
+            return None
+        masks = f"switch_masks{suffix}"
+        lines.append(
+            f"static const uint8_t {masks}[] = {{"
+            + ", ".join(f"0x{1 << pin[1]:02X}" if pin else "0x00" for pin in pins) + "};"
+        )
+        if len(ports) == 1:
+            port = ports[0]
+        else:
+            port_table = f"switch_ports{suffix}"
+            lines.append(
+                f"static volatile unsigned char* const {port_table}[] = {{"
+                + ", ".join(f"&{pin[0] if pin else ports[0]}" for pin in pins) + "};"
+            )
+            port = f"*{port_table}[{index}]"
+        mask = f"{masks}[{index}]"
+        if kind == "write":
+            lookup = f"{port} |= {mask};" if actions[0].value == "1" else f"{port} &= ~{mask};"
+        else:
+            comparison = "!=" if actions[0].target == "1" else "=="
+            lookup = f"return ({port} & {mask}) {comparison} 0;"
+
+    bound = f"(unsigned)({index}) < {span}" if low else f"(unsigned){index} < {span}"
+    lines.append(f"if ({bound}) {{")
+    lines.append(f"    {lookup}")
+    if default:
+        lines.append("} else {")
+        lines += [f"    {line.strip()}" for line in default.split("\n") if line.strip()]
+    lines.append("}")
+    return "{\n" + "\n".join(f"    {line}" for line in lines) + "\n}"
+
+
+def lower_switches(
+    code: str,
+    value_of: Callable[[str], Optional[int]],
+    macros: Dict[str, str],
+    goal: str = "size",
+    tables: bool = True,
+    pragmas: bool = True,
+    interrupt: bool = False,
+) -> Tuple[str, int]:
+    """
+    Rewrite the dispatch switches of a lowered body into table lookups where
+    that pays off, and give the others a #pragma switch.
+
+    Args:
+        code: Lowered C body
+        value_of: Numeric value of a case label or constant, None if the
+            expression is not constant
+        macros: Pin macros (name -> PORTxbits.Rxn)
+        goal: Optimization goal, "size" or "speed"
+        tables: Replace switches by tables
+        pragmas: Emit #pragma switch for the switches left
+        interrupt: The body is an interrupt handler
+
+    Returns:
+        The rewritten body and the number of switches turned into tables
+    """
+    position = 0
+    count = 0
+    while True:
+        masked = mask_comments(code)
+        match = re.compile(r"\bswitch\s*\(").search(masked, position)
+        if not match:
+            return code, count
+        position = match.end()
+        close_paren = matching_close(masked, match.end() - 1)
+        brace = re.compile(r"\s*\{").match(masked, close_paren + 1) if close_paren > 0 else None
+        if not brace:
+            continue
+        open_brace = brace.end() - 1
+        close_brace = matching_close(masked, open_brace)
+        if close_brace < 0:
+            continue
+        labels = top_level_matches(masked, open_brace + 1, close_brace, CASE_LABEL)
+        if not labels or any(
+            value_of(code[label.start(1):label.end(1)]) is None
+            for label in labels if label.group(1) is not None
+        ):
+            # Not a dispatch on constants
+            continue
+        line_start = code.rfind("\n", 0, match.start()) + 1
+        indent = re.match(r"[ \t]*", code[line_start:]).group()
+
+        dispatch = parse_dispatch(
+            code, masked, open_brace, close_brace,
+            code[match.end():close_paren], value_of, macros,
+        )
+        replacement = None
+        if tables and dispatch is not None:
+            replacement = _lookup(dispatch, value_of, goal, f"_{count + 1}" if count else "")
+        if replacement is not None:
+            count += 1
+            replacement = replacement.replace("\n", "\n" + indent)
+            code = code[:match.start()] + replacement + code[close_brace + 1:]
+            position = match.start() + len(replacement)
+        elif pragmas and not re.search(r"#pragma\s+switch[^\n]*\n[ \t]*$", code[:match.start()]):
+            encoding = INTERRUPT_SWITCH_PRAGMA if interrupt else SWITCH_PRAGMAS[goal]
+            pragma = f"#pragma switch {encoding}\n{indent}"
+            code = code[:match.start()] + pragma + code[match.start():]
+            position = match.end() + len(pragma)
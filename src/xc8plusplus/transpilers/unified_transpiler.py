@@ -6,24 +6,29 @@ C++ code to C for XC8 compatibility. Users can explicitly choose between
 native (LLVM LibTooling) and python (Clang AST) backends.
 """
 
+import functools
+import os
 import warnings
 from pathlib import Path
 from typing import Dict, List, Optional, Union
 
-# Import transpiler backends
-try:
-    from .native_backend import (
-        NativeTranspiler,
-        TranspilerConfig,
-        get_version,
-        check_llvm,
-    )
+from .depfile import write_depfile
+from .inliner import InlineCostModel
+from .passes import PassManager
+from .python_backend import PythonTranspiler, TranspilerResult
+from .stackdepth import device_stack_levels
 
-    NATIVE_AVAILABLE = True
-except ImportError:
-    NATIVE_AVAILABLE = False
 
-from .python_backend import PythonTranspiler, TranspilerResult
+def _import_native_backend():
+    """
+    Import the native backend module on demand.
+    Returns None if the module cannot be imported.
+    """
+    try:
+        from . import native_backend
+    except ImportError:
+        return None
+    return native_backend
 
 
 class XC8Transpiler:
@@ -46,18 +51,53 @@ class XC8Transpiler:
         target_device: str = "PIC16F876A",
         include_paths: Optional[List[str]] = None,
         defines: Optional[List[str]] = None,
+        max_concurrency: Optional[int] = None,
+        cache_dir: Optional[str] = None,
+        inline_goal: Optional[str] = None,
+        stack_check: str = "warn",
+        pack_structs: bool = False,
+        bit_types: bool = False,
+        bank_placement: bool = False,
+        opt_level: Optional[str] = None,
+        passes: Optional[List[str]] = None,
+        opt_bisect_limit: Optional[int] = None,
+        amalgamate: bool = False,
     ):
         """
         Initialize the XC8 transpiler.
 
         Args:
             backend: Backend to use ('native' or 'python')
-            enable_optimization: Enable XC8-specific optimizations
+            enable_optimization: Enable XC8-specific optimizations (-Os when
+                opt_level is not given, -O0 when off)
             generate_xc8_pragmas: Generate XC8 configuration pragmas
             preserve_comments: Preserve comments in generated code
             target_device: Target PIC device name
             include_paths: Additional include directories
             defines: Preprocessor definitions
+            max_concurrency: Maximum number of concurrent Clang processes or
+                native engine calls for the async API (default: CPU count)
+            cache_dir: Directory for the persistent function lowering memo
+                (python backend only)
+            inline_goal: Inlining cost model goal, 'size' or 'speed'
+                (default: the goal of the optimization level; python backend
+                only)
+            stack_check: What exceeding the device's hardware stack or
+                recursing does: 'warn', 'error' or 'off' (python backend only)
+            pack_structs: Pack bool and small enum fields into bit-fields
+                (python backend only)
+            bit_types: Lower eligible bool globals, static locals and
+                predicate return values to __bit (python backend only)
+            bank_placement: Place globals in common RAM and banks by their
+                accesses (python backend only)
+            opt_level: Optimization level, '0', 's' or '2' (python backend
+                only; the native backend only tells -O0 from the others)
+            passes: Optimization passes to enable ('inline') or disable
+                ('no-inline') on top of the level (python backend only)
+            opt_bisect_limit: Run only this many optimization passes
+                (python backend only)
+            amalgamate: Emit a batch as one self-contained firmware.c
+                (python backend only)
         """
         # Validate backend selection
         if backend not in ["native", "python"]:
@@ -66,20 +106,43 @@ class XC8Transpiler:
             )
 
         # Check if requested backend is available
-        if backend == "native" and not NATIVE_AVAILABLE:
+        if backend == "native" and _import_native_backend() is None:
             raise RuntimeError(
                 f"Native backend requested but not available. Please build the native transpiler or use --backend python"
             )
 
         self.backend = backend
 
+        # Validates the level and pass names before any backend is built
+        if opt_level is None:
+            opt_level = "s" if enable_optimization else "0"
+        pass_manager = PassManager(opt_level, passes or [], opt_bisect_limit)
+
         # Configuration
-        self.enable_optimization = enable_optimization
+        self.opt_level = pass_manager.level
+        self.passes = list(passes or [])
+        self.opt_bisect_limit = opt_bisect_limit
+        self.enable_optimization = self.opt_level != "0"
         self.generate_xc8_pragmas = generate_xc8_pragmas
         self.preserve_comments = preserve_comments
         self.target_device = target_device
         self.include_paths = include_paths or []
         self.defines = defines or []
+        self.max_concurrency = max_concurrency or os.cpu_count() or 4
+        self.cache_dir = cache_dir
+        self.inline_model = InlineCostModel(
+            goal=inline_goal or pass_manager.goal,
+            stack_budget=device_stack_levels(target_device),
+        )
+        self.stack_check = stack_check
+        self.pack_structs = pack_structs
+        self.bit_types = bit_types
+        self.bank_placement = bank_placement
+        self.amalgamate = amalgamate
+
+        # Per-event-loop concurrency limiter for the async API
+        self._async_semaphore = None
+        self._async_semaphore_loop = None
 
         # Backend instances
         self._native_transpiler = None
@@ -91,36 +154,56 @@ class XC8Transpiler:
     def _initialize_backend(self):
         """Initialize the requested transpiler backend"""
         if self.backend == "native":
-            config = TranspilerConfig(
-                enable_optimization=self.enable_optimization,
-                generate_xc8_pragmas=self.generate_xc8_pragmas,
-                preserve_comments=self.preserve_comments,
-                target_device=self.target_device,
-                include_paths=self.include_paths,
-                defines=self.defines,
-            )
-            self._native_transpiler = NativeTranspiler(config)
+            self._native_transpiler = self._create_native_transpiler()
             print("🚀 Using native C++ transpiler with LLVM LibTooling")
 
         elif self.backend == "python":
-            self._python_transpiler = PythonTranspiler(
-                enable_optimization=self.enable_optimization,
-                generate_xc8_pragmas=self.generate_xc8_pragmas,
-                preserve_comments=self.preserve_comments,
-                target_device=self.target_device,
-                include_paths=self.include_paths,
-                defines=self.defines,
-            )
+            self._python_transpiler = self._create_python_transpiler()
             print("Using Python backend with Clang AST analysis")
 
+    def _create_native_transpiler(self):
+        """Create a native transpiler instance from the current configuration"""
+        native_backend = _import_native_backend()
+        config = native_backend.TranspilerConfig(
+            enable_optimization=self.enable_optimization,
+            generate_xc8_pragmas=self.generate_xc8_pragmas,
+            preserve_comments=self.preserve_comments,
+            target_device=self.target_device,
+            include_paths=self.include_paths,
+            defines=self.defines,
+        )
+        return native_backend.NativeTranspiler(config)
+
+    def _create_python_transpiler(self):
+        """Create a Python transpiler instance from the current configuration"""
+        return PythonTranspiler(
+            enable_optimization=self.enable_optimization,
+            generate_xc8_pragmas=self.generate_xc8_pragmas,
+            preserve_comments=self.preserve_comments,
+            target_device=self.target_device,
+            include_paths=self.include_paths,
+            defines=self.defines,
+            cache_dir=self.cache_dir,
+            inline_model=self.inline_model,
+            stack_check=self.stack_check,
+            pack_structs=self.pack_structs,
+            bit_types=self.bit_types,
+            bank_placement=self.bank_placement,
+            opt_level=self.opt_level,
+            passes=self.passes,
+            opt_bisect_limit=self.opt_bisect_limit,
+            amalgamate=self.amalgamate,
+        )
+
     def get_backend_info(self) -> Dict[str, Union[str, bool]]:
         """Get information about the active backend"""
         if self.backend == "native":
+            native_backend = _import_native_backend()
             return {
                 "backend": "native",
                 "description": "C++ backend using LLVM LibTooling",
-                "version": get_version(),
-                "llvm_available": check_llvm(),
+                "version": native_backend.get_version(),
+                "llvm_available": native_backend.check_llvm(),
                 "features": [
                     "semantic_analysis",
                     "type_safety",
@@ -196,12 +279,167 @@ class XC8Transpiler:
         else:
             return self._python_transpiler.transpile_batch(cpp_files, output_dir)
 
+    def write_depfile(self, depfile, outputs, cpp_files, extra_dependencies=()):
+        """
+        Write a Makefile-format depfile (.d) for generated outputs.
+
+        Dependencies are resolved by Clang with the configured include paths
+        and defines, for either backend.
+
+        Args:
+            depfile: Path of the depfile to write
+            outputs: Generated files (the first one is the primary target)
+            cpp_files: C++ sources the outputs were generated from
+            extra_dependencies: Additional inputs (e.g. copied supporting files)
+
+        Returns:
+            List of dependencies written to the depfile
+        """
+        scanner = self._python_transpiler or self._create_python_transpiler()
+        dependencies = scanner.collect_dependencies(cpp_files)
+        dependencies.extend(str(path) for path in extra_dependencies)
+
+        # A generated header next to its source (led.h for led.cpp) would be
+        # discovered as a related file; an output never depends on itself
+        generated = {Path(output).resolve() for output in outputs}
+        dependencies = [
+            dep for dep in dependencies if Path(dep).resolve() not in generated
+        ]
+
+        write_depfile(depfile, outputs, dependencies)
+        return dependencies
+
+    async def transpile_string_async(
+        self, cpp_source: str, filename: str = "input.cpp"
+    ) -> TranspilerResult:
+        """
+        Transpile C++ source code from string without blocking the event loop.
+
+        Args:
+            cpp_source: C++ source code
+            filename: Filename for diagnostics
+
+        Returns:
+            TranspilerResult with generated C code or error information
+        """
+        semaphore = self._get_async_semaphore()
+
+        if self.backend == "native":
+            return await self._run_native_async(
+                semaphore, "transpile_string", cpp_source, filename
+            )
+
+        # Each call gets its own backend instance: analysis state is per run
+        transpiler = self._create_python_transpiler()
+        return await transpiler.transpile_string_async(
+            cpp_source, filename, semaphore
+        )
+
+    async def transpile_file_async(
+        self, input_file: str, output_file: Optional[str] = None
+    ) -> TranspilerResult:
+        """
+        Transpile C++ source code from file without blocking the event loop.
+
+        Args:
+            input_file: Path to input C++ file
+            output_file: Path to output C file (optional)
+
+        Returns:
+            TranspilerResult with generated C code or error information
+        """
+        semaphore = self._get_async_semaphore()
+
+        if self.backend == "native":
+            return await self._run_native_async(
+                semaphore, "transpile_file", input_file, output_file
+            )
+
+        transpiler = self._create_python_transpiler()
+        return await transpiler.transpile_file_async(
+            input_file, output_file, semaphore
+        )
+
+    async def transpile_batch_async(self, cpp_files, output_dir):
+        """
+        Transpile multiple C++ files together without blocking the event loop.
+
+        Args:
+            cpp_files: List of C++ file paths to transpile
+            output_dir: Output directory for generated files
+
+        Returns:
+            Dictionary mapping input files to TranspilerResult objects
+        """
+        import asyncio
+
+        semaphore = self._get_async_semaphore()
+
+        if self.backend == "native":
+            outputs = [
+                str(Path(output_dir) / f"{Path(cpp_file).stem}.c")
+                for cpp_file in cpp_files
+            ]
+            native_results = await asyncio.gather(
+                *(
+                    self._run_native_async(
+                        semaphore, "transpile_file", str(cpp_file), output_file
+                    )
+                    for cpp_file, output_file in zip(cpp_files, outputs)
+                )
+            )
+            return {
+                str(cpp_file): result
+                for cpp_file, result in zip(cpp_files, native_results)
+            }
+
+        transpiler = self._create_python_transpiler()
+        return await transpiler.transpile_batch_async(cpp_files, output_dir, semaphore)
+
+    def _get_async_semaphore(self):
+        """Return the concurrency limiter bound to the running event loop"""
+        import asyncio
+
+        loop = asyncio.get_running_loop()
+        if self._async_semaphore is None or self._async_semaphore_loop is not loop:
+            self._async_semaphore = asyncio.Semaphore(self.max_concurrency)
+            self._async_semaphore_loop = loop
+        return self._async_semaphore
+
+    async def _run_native_async(self, semaphore, method, *args) -> TranspilerResult:
+        """Run a native engine call in the default executor"""
+        import asyncio
+
+        async with semaphore:
+            loop = asyncio.get_running_loop()
+            return await loop.run_in_executor(
+                None, functools.partial(self._call_native_isolated, method, *args)
+            )
+
+    def _call_native_isolated(self, method, *args) -> TranspilerResult:
+        """
+        Call the native engine on a dedicated handle, since a single native
+        instance is not guaranteed to be safe to share between threads.
+        """
+        try:
+            native = self._create_native_transpiler()
+        except Exception as e:
+            result = TranspilerResult()
+            result.success = False
+            result.error_message = f"Native transpiler error: {str(e)}"
+            return result
+
+        if method == "transpile_string":
+            return self._transpile_string_native(*args, native=native)
+        return self._transpile_file_native(*args, native=native)
+
     def _transpile_string_native(
-        self, cpp_source: str, filename: str
+        self, cpp_source: str, filename: str, native=None
     ) -> TranspilerResult:
         """Transpile using native C++ backend"""
+        native = native or self._native_transpiler
         try:
-            native_result = self._native_transpiler.transpile_string(
+            native_result = native.transpile_string(
                 cpp_source, filename
             )
 
@@ -222,11 +460,12 @@ class XC8Transpiler:
             return result
 
     def _transpile_file_native(
-        self, input_file: str, output_file: Optional[str]
+        self, input_file: str, output_file: Optional[str], native=None
     ) -> TranspilerResult:
         """Transpile file using native C++ backend"""
+        native = native or self._native_transpiler
         try:
-            native_result = self._native_transpiler.transpile_file(
+            native_result = native.transpile_file(
                 input_file, output_file
             )
 
@@ -249,9 +488,10 @@ class XC8Transpiler:
 
 def get_native_version() -> str:
     """Get the version of the native transpiler backend"""
-    if NATIVE_AVAILABLE:
+    native_backend = _import_native_backend()
+    if native_backend is not None:
         try:
-            return get_version()
+            return native_backend.get_version()
         except:
             return "unknown"
     return "not available"
@@ -259,9 +499,10 @@ def get_native_version() -> str:
 
 def check_llvm() -> bool:
     """Check if LLVM is available for the native backend"""
-    if NATIVE_AVAILABLE:
+    native_backend = _import_native_backend()
+    if native_backend is not None:
         try:
-            return check_llvm()
+            return native_backend.check_llvm()
         except:
             return False
     return False
@@ -0,0 +1,324 @@
+"""
+Virtual functions and devirtualization
+
+A lowered class is a struct whose methods take it as `Class* self`. With
+inheritance, a derived struct starts with the members of its base, in the
+same order, so a pointer to a derived object can be passed where a pointer
+to its base is expected, and the methods it inherits are called on it
+through a cast (`Device_enable((Device*)&sensor)`).
+
+A virtual call runs the implementation of the object's dynamic type. In C,
+each class of a hierarchy with virtual methods gets a const vtable, which
+XC8 places in program memory, holding a pointer to the implementation of
+each virtual method (its slots). The root class of the hierarchy gets a
+`vptr` member pointing to the vtable of the object's class, and a call
+through a pointer loads the slot: `p->vptr->read((Sensor*)p)`.
+
+An indirect call is costly on PIC16: the computed call through PCLATH/PCL is
+slow, and XC8 cannot follow it when it builds the compiled stack. A call is
+made direct when the target is known:
+
+- a call on an object, not a pointer, runs the object's own class;
+- class hierarchy analysis: when every instantiated class deriving from the
+  static type of the pointer (final classes and methods have none) resolves
+  the method to the same implementation, that implementation is the target.
+
+A hierarchy whose calls are all direct needs neither vtables nor the vptr
+member.
+
+A small hierarchy can dispatch with a switch instead: its root gets a
+1-byte `type_tag` member holding the class of the object, and each slot a
+dispatch function switching on it, with a direct call per implementation:
+
+    uint8_t Sensor_read_dispatch(Sensor* self) {
+        switch (self->type_tag) {
+        case Thermistor_TAG:
+            return Thermistor_read((Thermistor*)self);
+        default:
+            return Photocell_read((Photocell*)self);
+        }
+    }
+
+Every call stays direct, so XC8 still builds a precise call graph and can
+overlay the locals of the implementations in its compiled stack, and a
+tag takes one byte of RAM where a vptr takes two. The compare per arm
+makes it worth it for a few classes only: a whole program switches the
+hierarchies of up to TAG_DISPATCH_MAX_CLASSES classes that can be
+instantiated, and an attribute on the root class chooses either way:
+`class [[clang::annotate("xc8::switch_dispatch")]] Sensor` (or
+"xc8::vtable_dispatch"). A library only switches when told to: its users
+may derive classes of their own.
+"""
+
+import re
+from dataclasses import dataclass, field
+from typing import Callable, Dict, Iterable, List, Optional, Set, Tuple
+
+from .staticinit import matching_close, split_arguments
+
+# Member of the root class pointing to the vtable of the object's class
+VPTR_FIELD = "vptr"
+
+# Member of the root class holding the class of the object (switch dispatch)
+TAG_FIELD = "type_tag"
+
+# Largest hierarchy (classes that can be instantiated) dispatched with a
+# switch by default: a PIC16 vtable call costs about as much as four arms
+TAG_DISPATCH_MAX_CLASSES = 4
+
+# Annotations of a root class choosing how its hierarchy dispatches
+DISPATCH_ANNOTATIONS = {"xc8::switch_dispatch": "switch", "xc8::vtable_dispatch": "vtable"}
+
+# Null pointer constants, which convert to any pointer without a cast
+NULL_POINTERS = ("0", "NULL", "nullptr")
+
+# Pointer (or address of an object) usable as is before "->" or after a cast
+_ELEMENT = r"\w+(?:\s*\[[^\[\]]*\])*"
+_SIMPLE_OBJECT = re.compile(rf"&?\s*{_ELEMENT}(?:\s*(?:->|\.)\s*{_ELEMENT})*")
+_CAST = re.compile(r"\(\s*(?:const\s+)?\w+\s*\*\s*\)\s*")
+
+
+@dataclass
+class ClassHierarchy:
+    """
+    Inheritance of the classes of a program.
+
+    Attributes:
+        bases: Base class of each class (None for a root)
+        methods: Methods each class declares, in declaration order
+        virtual: (class, method) declared virtual
+        pure: (class, method) declared pure virtual
+        final_classes: Classes declared final
+        final_methods: (class, method) declared final
+    """
+
+    bases: Dict[str, Optional[str]] = field(default_factory=dict)
+    methods: Dict[str, List[str]] = field(default_factory=dict)
+    virtual: Set[Tuple[str, str]] = field(default_factory=set)
+    pure: Set[Tuple[str, str]] = field(default_factory=set)
+    final_classes: Set[str] = field(default_factory=set)
+    final_methods: Set[Tuple[str, str]] = field(default_factory=set)
+
+    def chain(self, class_name: str) -> List[str]:
+        """The class followed by its bases, up to the root"""
+        chain = []
+        while class_name is not None and class_name not in chain:
+            chain.append(class_name)
+            class_name = self.bases.get(class_name)
+        return chain
+
+    def root(self, class_name: str) -> str:
+        """Root class of the hierarchy of a class"""
+        return self.chain(class_name)[-1]
+
+    def derived(self, class_name: str) -> List[str]:
+        """The class and every class deriving from it, in class order"""
+        return [name for name in self.bases if class_name in self.chain(name)]
+
+    def in_hierarchy(self, class_name: str) -> bool:
+        """Check whether a class has a base or a derived class"""
+        return self.bases.get(class_name) is not None or len(self.derived(class_name)) > 1
+
+    def owner(self, class_name: str, method: str) -> Optional[str]:
+        """Nearest class of the chain declaring a method"""
+        return next(
+            (name for name in self.chain(class_name) if method in self.methods.get(name, ())),
+            None,
+        )
+
+    def is_virtual(self, class_name: str, method: str) -> bool:
+        """Check whether a method is virtual for a class (declared so in the chain)"""
+        return any((name, method) in self.virtual for name in self.chain(class_name))
+
+    def overrider(self, class_name: str, method: str) -> Optional[str]:
+        """Class whose implementation an object of class_name runs, or None when pure"""
+        owner = self.owner(class_name, method)
+        if owner is None or (owner, method) in self.pure:
+            return None
+        return owner
+
+    def is_abstract(self, class_name: str) -> bool:
+        """Check whether a class leaves a virtual method without implementation"""
+        return any(
+            self.overrider(class_name, method) is None for method in self.slots(class_name)
+        )
+
+    def slots(self, class_name: str) -> List[str]:
+        """Virtual methods callable on a class, those of its root first"""
+        slots = []
+        for name in reversed(self.chain(class_name)):
+            for method in self.methods.get(name, ()):
+                if self.is_virtual(name, method) and method not in slots:
+                    slots.append(method)
+        return slots
+
+    def root_slots(self, root: str) -> List[str]:
+        """Vtable layout of a hierarchy: the slots of all its classes"""
+        slots = []
+        for name in self.derived(root):
+            slots += [method for method in self.slots(name) if method not in slots]
+        return slots
+
+    def introducer(self, class_name: str, method: str) -> str:
+        """Class declaring the signature of a slot: the first to make it virtual"""
+        return next(
+            name for name in reversed(self.chain(class_name))
+            if (name, method) in self.virtual or (
+                method in self.methods.get(name, ()) and self.is_virtual(name, method)
+            )
+        )
+
+    def concrete(self, root: str) -> List[str]:
+        """Classes of a hierarchy that can be instantiated (not abstract)"""
+        return [name for name in self.derived(root) if not self.is_abstract(name)]
+
+    def dispatch_arms(self, root: str, method: str) -> List[Tuple[List[str], str]]:
+        """
+        Arms of the switch dispatching a slot: the classes running each
+        implementation, with the class implementing it
+        """
+        arms: Dict[str, List[str]] = {}
+        for name in self.concrete(root):
+            arms.setdefault(self.overrider(name, method), []).append(name)
+        return [(classes, target) for target, classes in arms.items()]
+
+    def is_final(self, class_name: str, method: str) -> bool:
+        """Check whether no class derived from class_name can override a method"""
+        owner = self.owner(class_name, method)
+        return class_name in self.final_classes or (owner, method) in self.final_methods
+
+    def resolve(
+        self, class_name: str, method: str, instantiated: Optional[Iterable[str]]
+    ) -> Optional[str]:
+        """
+        Class whose implementation a virtual call through a class_name
+        pointer always runs, or None when it depends on the object.
+
+        Args:
+            class_name: Static type of the pointer
+            method: Method called
+            instantiated: Classes the program has objects of; with none
+                deriving from class_name, any object is the static type.
+                None when the program is not whole (a library): only final
+                makes the target known
+        """
+        if self.is_final(class_name, method):
+            return self.overrider(class_name, method)
+        if instantiated is None:
+            return None
+        instantiated = set(instantiated)
+        candidates = [name for name in self.derived(class_name) if name in instantiated]
+        targets = {self.overrider(name, method) for name in candidates or [class_name]}
+        if len(targets) == 1:
+            return targets.pop()
+        return None
+
+
+def is_object_argument(argument: str) -> bool:
+    """Check whether a lowered self argument is the address of an object (&x)"""
+    return _CAST.sub("", argument, count=1).lstrip().startswith("&")
+
+
+def dispatch_object(argument: str) -> str:
+    """A self argument ready to be dereferenced (parenthesized when needed)"""
+    if _SIMPLE_OBJECT.fullmatch(argument.strip()) and not argument.strip().startswith("&"):
+        return argument.strip()
+    return f"({argument.strip()})"
+
+
+def cast_object(argument: str, class_name: str) -> str:
+    """A self argument cast to a pointer to class_name (a base of its class)"""
+    argument = argument.strip()
+    if not _SIMPLE_OBJECT.fullmatch(argument):
+        argument = f"({argument})"
+    return f"({class_name}*){argument}"
+
+
+def pointer_class(
+    argument: str, objects: Dict[str, str], pointers: Dict[str, str]
+) -> Optional[str]:
+    """
+    Class a pointer argument of lowered C evidently points to: the class of
+    a cast ((Sensor*)x), of an object whose address is taken (&thermistor,
+    &motors[i]) or of a pointer variable or element (cell, sensors[i]).
+    None when it is not evident.
+
+    Args:
+        argument: Lowered argument
+        objects: Class of the objects (and arrays of objects) by name
+        pointers: Class pointed to by the pointers (and arrays of pointers) by name
+    """
+    argument = argument.strip()
+    cast = re.match(r"\(\s*(?:const\s+)?(\w+)\s*\*\s*\)", argument)
+    if cast:
+        return cast.group(1)
+    variable = re.fullmatch(r"(&)?\s*(\w+)(?:\s*\[[^\[\]]*\])*", argument)
+    if not variable:
+        return None
+    return (objects if variable.group(1) else pointers).get(variable.group(2))
+
+
+def tag_switch(
+    arms: List[Tuple[List[str], str]], call: Callable[[str], str], returns: bool
+) -> str:
+    """
+    Body of a dispatch function: a switch on the type tag of self with a
+    direct call per implementation. The last arm is the default case,
+    which saves its compare.
+
+    Args:
+        arms: Classes running each implementation, with its class
+        call: Gives the call of the implementation of a class
+        returns: Whether the method returns a value
+    """
+    if len(arms) == 1:
+        return f"{'return ' if returns else ''}{call(arms[0][1])};"
+    lines = [f"switch (self->{TAG_FIELD}) {{"]
+    for index, (classes, target) in enumerate(arms):
+        if index == len(arms) - 1:
+            lines.append("default:")
+        else:
+            lines += [f"case {name}_TAG:" for name in classes]
+        if returns:
+            lines.append(f"    return {call(target)};")
+        else:
+            lines += [f"    {call(target)};", "    break;"]
+    return "\n".join(lines + ["}"])
+
+
+def rewrite_calls(code: str, rewrite: Callable[[str, List[str]], Optional[str]], names) -> str:
+    """
+    Rewrite the calls to some functions in lowered C.
+
+    Args:
+        code: Lowered C
+        rewrite: Gives the replacement of a call from the function name and
+            its (already rewritten) arguments, or None to keep it
+        names: Functions whose calls are rewritten
+    """
+    names = sorted(set(names), key=len, reverse=True)
+    if not names:
+        return code
+    call = re.compile(rf"(?<![\w.>])(?:{'|'.join(map(re.escape, names))})\s*\(")
+
+    result = []
+    position = 0
+    for match in call.finditer(code):
+        if match.start() < position:
+            continue
+        close = matching_close(code, match.end() - 1)
+        if close < 0:
+            continue
+        name = code[match.start():match.end() - 1].strip()
+        arguments = [
+            rewrite_calls(argument, rewrite, names)
+            for argument in split_arguments(code[match.end():close])
+        ]
+        replacement = rewrite(name, arguments)
+        if replacement is None:
+            replacement = f"{code[match.start():match.end()]}{', '.join(arguments)})"
+        result.append(code[position:match.start()])
+        result.append(replacement)
+        position = close + 1
+    result.append(code[position:])
+    return "".join(result)
@@ -1,6 +1,10 @@
 """Pytest configuration for xc8plusplus tests."""
 
+import itertools
+import re
 import sys
+import tempfile
+from dataclasses import dataclass
 from pathlib import Path
 
 import pytest
@@ -62,3 +66,108 @@ int main() {
     return 0;
 }
 """
+
+
+CANNED_CLANG = """
+import sys
+from pathlib import Path
+source = sys.argv[-1]
+canned = Path(source + ".ast")
+if canned.exists():
+    sys.stdout.write(canned.read_text())
+deps = Path(source + ".deps")
+if "-MF" in sys.argv and deps.exists():
+    Path(sys.argv[sys.argv.index("-MF") + 1]).write_text(deps.read_text())
+"""
+
+
+@pytest.fixture
+def canned_clang(monkeypatch, tmp_path):
+    """
+    Route Clang invocations of the Python backend to canned AST dumps and
+    dependency lists.
+
+    Returns a function registering the AST dump printed for a source file
+    (and optionally the dependency rule written with -MD -MF).
+    """
+    from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+    stub = tmp_path / "canned_clang.py"
+    stub.write_text(CANNED_CLANG)
+
+    def fake_command(self, cpp_file, dependency_file=None):
+        command = [sys.executable, str(stub)]
+        if dependency_file is not None:
+            command.extend(["-MD", "-MF", str(dependency_file)])
+        return command + [str(cpp_file)]
+
+    monkeypatch.setattr(PythonTranspiler, "_clang_command", fake_command)
+
+    def register(source_file, ast_dump, dependencies=None):
+        Path(str(source_file) + ".ast").write_text(ast_dump)
+        if dependencies is not None:
+            Path(str(source_file) + ".deps").write_text(dependencies)
+
+    return register
+
+
+# Node of an AST dump line ("| |-FieldDecl <...>"), before its address
+_AST_NODE = re.compile(r"^([|`\- ]*)(\w+(?:Decl|Attr))(?= )", re.MULTILINE)
+
+
+def number_nodes(ast_dump):
+    """Give each declaration and attribute of an AST dump an address, as Clang does"""
+    addresses = itertools.count(1)
+    return _AST_NODE.sub(
+        lambda match: f"{match.group(1)}{match.group(2)} {hex(next(addresses))}", ast_dump
+    )
+
+
+@dataclass
+class TranspiledBatch:
+    """Outcome of a batch transpiled by the transpile_batch fixture"""
+
+    transpiler: object
+    results: dict
+    out: Path
+    src: Path
+
+    def result(self, name):
+        """TranspilerResult of a source file"""
+        return self.results[str(self.src / name)]
+
+    def text(self, name=None):
+        """Content of a generated file, or of all of them"""
+        if name is not None:
+            return (self.out / name).read_text()
+        return "".join(path.read_text() for path in sorted(self.out.iterdir()))
+
+
+@pytest.fixture
+def transpile_batch(tmp_path, canned_clang):
+    """
+    Transpile C++ sources as a batch through canned AST dumps.
+
+    Returns a function taking the sources, {file name: (code, AST dump)},
+    written to tmp_path/src ("{src}" in a dump stands for that directory,
+    and its nodes are given addresses), the files of the batch (all of
+    them by default) and the PythonTranspiler options. Each call gets its
+    own output directory; with check, every file must succeed.
+    """
+    from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+    src = tmp_path / "src"
+    src.mkdir()
+
+    def transpile(sources, batch=None, check=True, **options):
+        for name, (code, ast_dump) in sources.items():
+            (src / name).write_text(code)
+            canned_clang(src / name, number_nodes(ast_dump.replace("{src}", str(src))))
+        out = Path(tempfile.mkdtemp(prefix="out", dir=tmp_path))
+        transpiler = PythonTranspiler(**options)
+        results = transpiler.transpile_batch([src / name for name in batch or sources], out)
+        if check:
+            assert all(result.success for result in results.values())
+        return TranspiledBatch(transpiler, results, out, src)
+
+    return transpile
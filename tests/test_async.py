@@ -0,0 +1,126 @@
+"""Tests for the asyncio-native transpilation API."""
+
+import asyncio
+import sys
+import time
+from pathlib import Path
+
+from xc8plusplus import XC8Transpiler
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+STUB_CLANG = """
+import sys, time
+time.sleep(float(sys.argv[2]))
+with open(sys.argv[1], "a") as log:
+    log.write("done\\n")
+print("|-CXXRecordDecl 0x1 <input.cpp:1:1, line:5:1> line:1:7 class Counter definition")
+print("| |-FieldDecl 0x2 <line:3:5, col:9> col:9 value 'int'")
+print("| |-CXXMethodDecl 0x3 <line:4:5, col:20> col:10 get 'int ()'")
+"""
+
+
+def _use_stub_clang(monkeypatch, tmp_path, delay=0.0):
+    """Route Clang invocations to a portable Python stub"""
+    stub = tmp_path / "stub_clang.py"
+    stub.write_text(STUB_CLANG)
+    log = tmp_path / "clang.log"
+
+    def fake_command(self, cpp_file, dependency_file=None):
+        return [sys.executable, str(stub), str(log), str(delay), str(cpp_file)]
+
+    monkeypatch.setattr(PythonTranspiler, "_clang_command", fake_command)
+    return log
+
+
+class TestAsyncAPI:
+    """Test cases for the async transpilation coroutines."""
+
+    def test_transpile_string_async(self, monkeypatch, tmp_path):
+        """The async string API produces the same C code as the sync one."""
+        _use_stub_clang(monkeypatch, tmp_path)
+        transpiler = XC8Transpiler(backend="python")
+
+        result = asyncio.run(
+            transpiler.transpile_string_async("class Counter { int value; };")
+        )
+
+        assert result.success
+        assert "typedef struct Counter" in result.generated_c_code
+        assert "Counter_get(Counter* self)" in result.generated_c_code
+
+    def test_transpile_file_async_does_not_block_loop(self, monkeypatch, tmp_path):
+        """Clang runs as an asyncio subprocess while the loop keeps running."""
+        _use_stub_clang(monkeypatch, tmp_path, delay=0.3)
+        source = tmp_path / "counter.cpp"
+        source.write_text("class Counter { int value; };")
+        transpiler = XC8Transpiler(backend="python")
+
+        async def run():
+            ticks = 0
+
+            async def ticker():
+                nonlocal ticks
+                while True:
+                    await asyncio.sleep(0.01)
+                    ticks += 1
+
+            task = asyncio.ensure_future(ticker())
+            result = await transpiler.transpile_file_async(
+                str(source), str(tmp_path / "counter.c")
+            )
+            task.cancel()
+            return result, ticks
+
+        result, ticks = asyncio.run(run())
+
+        assert result.success
+        assert ticks >= 10
+        assert (tmp_path / "counter.h").exists()
+
+    def test_concurrency_limit(self, monkeypatch, tmp_path):
+        """max_concurrency bounds the number of Clang processes in flight."""
+        log = _use_stub_clang(monkeypatch, tmp_path, delay=0.3)
+        sources = []
+        for i in range(4):
+            source = tmp_path / f"unit{i}.cpp"
+            source.write_text("class Counter { int value; };")
+            sources.append(source)
+        transpiler = XC8Transpiler(backend="python", max_concurrency=2)
+
+        async def run():
+            return await asyncio.gather(
+                *(
+                    transpiler.transpile_file_async(
+                        str(source), str(source.with_suffix(".c"))
+                    )
+                    for source in sources
+                )
+            )
+
+        start = time.monotonic()
+        results = asyncio.run(run())
+        elapsed = time.monotonic() - start
+
+        assert all(result.success for result in results)
+        assert log.read_text().count("done") == 4
+        # Two waves of two processes each
+        assert elapsed >= 0.6
+
+    def test_transpile_batch_async(self, monkeypatch, tmp_path):
+        """The async batch API writes the shared header and per-file outputs."""
+        _use_stub_clang(monkeypatch, tmp_path)
+        source_dir = tmp_path / "src"
+        source_dir.mkdir()
+        (source_dir / "counter.cpp").write_text("class Counter { int value; };")
+        output_dir = tmp_path / "out"
+        output_dir.mkdir()
+        transpiler = XC8Transpiler(backend="python")
+
+        results = asyncio.run(
+            transpiler.transpile_batch_async(
+                [source_dir / "counter.cpp"], output_dir
+            )
+        )
+
+        assert results[str(source_dir / "counter.cpp")].success
+        assert (Path(output_dir) / "shared_definitions.h").exists()
@@ -0,0 +1,158 @@
+"""Tests for XC8 __bit lowering."""
+
+from xc8plusplus.transpilers.bits import (
+    is_boolean_expression,
+    lower_static_bits,
+    stores_are_boolean,
+)
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+SENSOR_HPP = """class Sensor {
+    int level;
+    bool ready;
+public:
+    bool isReady();
+    bool hasLevel();
+};
+"""
+
+SENSOR_CPP = """#include "sensor.hpp"
+bool Sensor::isReady() {
+    return ready && level > 0;
+}
+bool Sensor::hasLevel() {
+    return level;
+}
+"""
+
+MAIN_CPP = """#include "sensor.hpp"
+Sensor sensor;
+bool firstRun() {
+    static bool first = true;
+    if (first) {
+        first = false;
+        return true;
+    }
+    return false;
+}
+int main() {
+    while (firstRun() || sensor.isReady() || sensor.hasLevel()) {
+    }
+    return 0;
+}
+"""
+
+FLAGS_CPP = """bool alarm;
+bool latched;
+bool* watched = &latched;
+int count;
+int main() {
+    alarm = count > 3;
+    latched = count;
+    return 0;
+}
+"""
+
+
+def _sensor_ast(path):
+    return (
+        f"|-CXXRecordDecl 0x1 <{path}:1:1, line:7:1> line:1:7 class Sensor definition\n"
+        "| |-FieldDecl 0x2 <line:2:5, col:9> col:9 referenced level 'int'\n"
+        "| |-FieldDecl 0x3 <line:3:5, col:10> col:10 referenced ready 'bool'\n"
+        "| |-CXXMethodDecl 0x4 <line:5:5, col:18> col:10 isReady 'bool ()'\n"
+        "| `-CXXMethodDecl 0x5 <line:6:5, col:19> col:10 hasLevel 'bool ()'\n"
+    )
+
+
+class TestBooleanExpressions:
+    """Test cases for recognizing 0/1-valued expressions."""
+
+    def test_boolean_expressions(self):
+        """Comparisons, logic, literals and boolean names are boolean."""
+        names = {"ready", "Led_isOn"}
+        assert is_boolean_expression("a == b")
+        assert is_boolean_expression("a && b")
+        assert is_boolean_expression("!count")
+        assert is_boolean_expression("self->ready", names)
+        assert is_boolean_expression("Led_isOn(self)", names)
+        assert is_boolean_expression("c ? true : false")
+
+    def test_integer_expressions(self):
+        """Anything that may be wider than a bit is not."""
+        assert not is_boolean_expression("count")
+        assert not is_boolean_expression("a == b | mask")
+        assert not is_boolean_expression("!x + 1")
+        assert not is_boolean_expression("c ? 2 : 0")
+
+    def test_stores(self):
+        """Integer stores and taking the address disqualify a variable."""
+        assert stores_are_boolean("flag = a > b; flag = true;", "flag")
+        assert not stores_are_boolean("flag = count;", "flag")
+        assert not stores_are_boolean("watch(&flag);", "flag")
+
+    def test_static_locals(self):
+        """Only static bools with boolean stores are lowered."""
+        code, lowered = lower_static_bits(
+            "static bool first = true;\nfirst = false;\n"
+            "static bool odd = false;\nodd = count;\n"
+        )
+
+        assert lowered == {"first"}
+        assert "static __bit first = true;" in code
+        assert "static bool odd = false;" in code
+
+
+class TestBitLowering:
+    """Test cases for __bit in the generated C."""
+
+    def test_predicates_and_static_locals(self, tmp_path, canned_clang):
+        """Boolean-valued predicates return __bit; integer-valued ones keep bool."""
+        src = tmp_path / "src"
+        src.mkdir()
+        (src / "sensor.hpp").write_text(SENSOR_HPP)
+        (src / "sensor.cpp").write_text(SENSOR_CPP)
+        (src / "main.cpp").write_text(MAIN_CPP)
+        header = src / "sensor.hpp"
+        canned_clang(header, _sensor_ast(header))
+        canned_clang(src / "sensor.cpp", _sensor_ast(header))
+        canned_clang(
+            src / "main.cpp",
+            _sensor_ast(header)
+            + f"|-VarDecl 0x6 <{src / 'main.cpp'}:2:1, col:8> col:8 used sensor 'Sensor' callinit\n"
+            "|-FunctionDecl 0x7 <line:3:1, line:10:1> line:3:6 used firstRun 'bool ()'\n"
+            "`-FunctionDecl 0x8 <line:11:1, line:15:1> line:11:5 main 'int ()'\n",
+        )
+        out = tmp_path / "out"
+        out.mkdir()
+
+        results = PythonTranspiler(bit_types=True).transpile_batch(
+            [src / "main.cpp", src / "sensor.cpp", src / "sensor.hpp"], out
+        )
+
+        assert all(result.success for result in results.values())
+        code = "".join(path.read_text() for path in sorted(out.iterdir()))
+        # sensor is the only Sensor: its methods take no self pointer
+        assert "__bit Sensor_isReady(void)" in code
+        assert "bool Sensor_hasLevel(void)" in code
+        assert "__bit firstRun(void)" in code
+        assert "static __bit first = true;" in code
+
+    def test_globals_fall_back_when_unsafe(self, tmp_path, canned_clang):
+        """A global whose address is taken or that stores an int stays bool."""
+        source = tmp_path / "flags.cpp"
+        source.write_text(FLAGS_CPP)
+        canned_clang(
+            source,
+            f"|-VarDecl 0x1 <{source}:1:1, col:6> col:6 used alarm 'bool'\n"
+            "|-VarDecl 0x2 <line:2:1, col:6> col:6 used latched 'bool'\n"
+            "|-VarDecl 0x3 <line:3:1, col:17> col:7 watched 'bool *' cinit\n"
+            "|-VarDecl 0x4 <line:4:1, col:5> col:5 used count 'int'\n"
+            "`-FunctionDecl 0x5 <line:5:1, line:9:1> line:5:5 main 'int ()'\n",
+        )
+        output = tmp_path / "flags.c"
+
+        assert PythonTranspiler(bit_types=True).transpile(str(source), str(output))
+
+        code = output.read_text()
+        assert "__bit alarm;" in code
+        assert "bool latched;" in code
@@ -0,0 +1,121 @@
+"""Tests for the generated XC8 build graph."""
+
+import shutil
+import subprocess
+import sys
+import time
+
+import pytest
+
+from xc8plusplus.transpilers.buildgraph import (
+    device_flags,
+    generate_makefile,
+    generate_ninja,
+    local_header_dependencies,
+    write_build_file,
+)
+
+STUB_CC = """
+import sys
+args = sys.argv[1:]
+out = args[args.index("-o") + 1]
+with open(sys.argv[0] + ".log", "a") as log:
+    log.write(out + "\\n")
+with open(out, "w") as f:
+    f.write("object\\n")
+"""
+
+
+def _generated_tree(tmp_path):
+    """Output directory as written by a batch transpilation"""
+    out = tmp_path / "out"
+    out.mkdir()
+    (out / "shared_definitions.h").write_text("#include <xc.h>\n")
+    (out / "led.h").write_text('#include "shared_definitions.h"\n')
+    (out / "led.c").write_text('#include "shared_definitions.h"\n#include "led.h"\n')
+    (out / "main.c").write_text('#include "shared_definitions.h"\n')
+    (out / "pin_manager.h").write_text("#include <xc.h>\n")
+    (out / "pin_manager.c").write_text('#include "pin_manager.h"\n')
+    return out
+
+
+class TestBuildGraph:
+    """Test cases for Makefile/Ninja generation."""
+
+    def test_header_dependencies(self, tmp_path):
+        """Quoted includes are followed transitively, system includes are not."""
+        out = _generated_tree(tmp_path)
+
+        assert local_header_dependencies(out / "led.c", out) == [
+            "shared_definitions.h",
+            "led.h",
+        ]
+        assert local_header_dependencies(out / "pin_manager.c", out) == [
+            "pin_manager.h"
+        ]
+
+    def test_ninja_graph(self, tmp_path):
+        """Each C file gets its own object edge with implicit header inputs."""
+        out = _generated_tree(tmp_path)
+
+        ninja = generate_ninja(
+            out, ["main.c", "led.c"], "PIC16F876A", "firmware", "sdcc"
+        )
+
+        assert "cc = sdcc" in ninja
+        assert "device_flags = -mpic14 -p16f876a" in ninja
+        assert "command = $cc $device_flags $cflags -c -o $out $in" in ninja
+        assert "build led.p1: cc led.c | shared_definitions.h led.h" in ninja
+        assert "build firmware.hex: link led.p1 main.p1" in ninja
+
+    def test_device_flags(self, tmp_path):
+        """The device flags follow the compiler and sit next to it."""
+        out = _generated_tree(tmp_path)
+
+        makefile = generate_makefile(out, ["main.c"], "PIC16F876A", "firmware")
+
+        assert "CC = xc8-cc\nDEVICE ?= PIC16F876A\nDEVICE_FLAGS ?= -mcpu=$(DEVICE)\n" in makefile
+        assert "\t$(CC) $(DEVICE_FLAGS) $(CFLAGS) -c -o $@ $<" in makefile
+        assert makefile.count("-mcpu") == 1
+        assert device_flags("/opt/sdcc/bin/sdcc", "PIC18F45K22", "$device") == (
+            "-mpic16 -p18f45k22"
+        )
+        assert device_flags("xc8-cc", "PIC18F45K22", "$device") == "-mcpu=$device"
+
+    @pytest.mark.skipif(shutil.which("make") is None, reason="make not available")
+    def test_makefile_rebuilds_one_object(self, tmp_path):
+        """Editing one module rebuilds only its object, then relinks."""
+        out = _generated_tree(tmp_path)
+        stub = tmp_path / "stub_cc.py"
+        stub.write_text(STUB_CC)
+        log = tmp_path / "stub_cc.py.log"
+
+        write_build_file(
+            "make",
+            out,
+            ["led.c", "main.c", "pin_manager.c"],
+            "PIC16F876A",
+            "firmware",
+            f"{sys.executable} {stub}",
+        )
+        subprocess.run(["make", "-j4"], cwd=out, check=True, capture_output=True)
+
+        assert (out / "firmware.hex").exists()
+        assert sorted(log.read_text().split()) == [
+            "firmware.hex",
+            "led.p1",
+            "main.p1",
+            "pin_manager.p1",
+        ]
+
+        log.write_text("")
+        time.sleep(0.01)
+        (out / "led.c").write_text('#include "led.h"\nint x;\n')
+        subprocess.run(["make"], cwd=out, check=True, capture_output=True)
+
+        assert log.read_text().split() == ["led.p1", "firmware.hex"]
+
+    def test_invalid_build_system(self, tmp_path):
+        """Unknown build systems are rejected."""
+        with pytest.raises(ValueError):
+            write_build_file("scons", tmp_path, [], "PIC16F876A", "firmware")
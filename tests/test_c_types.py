@@ -0,0 +1,128 @@
+"""Tests for C++ to C type mapping."""
+
+from xc8plusplus.transpilers.c_types import c_declaration, map_type, split_ast_type
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+SENSOR_HPP = """#include <stdint.h>
+class Sensor {
+    uint8_t channel;
+    int16_t offset;
+    uint8_t samples[4];
+    const char *label;
+public:
+    uint8_t read(uint8_t gain, int16_t bias);
+};
+"""
+
+SENSOR_CPP = """#include "sensor.hpp"
+uint8_t Sensor::read(uint8_t gain, int16_t bias) {
+    return channel;
+}
+"""
+
+
+def _sensor_ast(path):
+    return (
+        f"|-CXXRecordDecl 0x1 <{path}:2:1, line:9:1> line:2:7 class Sensor definition\n"
+        "| |-FieldDecl 0x2 <line:3:5, col:13> col:13 referenced channel 'uint8_t':'unsigned char'\n"
+        "| |-FieldDecl 0x3 <line:4:5, col:13> col:13 offset 'int16_t':'short'\n"
+        "| |-FieldDecl 0x4 <line:5:5, col:22> col:13 samples 'uint8_t[4]'\n"
+        "| |-FieldDecl 0x5 <line:6:5, col:17> col:17 label 'const char *'\n"
+        "| |-CXXMethodDecl 0x6 <line:8:5, col:44> col:13 read "
+        "'uint8_t (uint8_t, int16_t)':'unsigned char (unsigned char, short)'\n"
+        "| | |-ParmVarDecl 0x7 <col:18, col:26> col:26 gain 'uint8_t':'unsigned char'\n"
+        "| | `-ParmVarDecl 0x8 <col:32, col:40> col:40 bias 'int16_t':'short'\n"
+    )
+
+
+class TestTypeMapping:
+    """Test cases for the type mapping helpers."""
+
+    def test_split_ast_type(self):
+        """Spelled and canonical types are split apart."""
+        assert split_ast_type("'uint8_t':'unsigned char'") == ("uint8_t", "unsigned char")
+        assert split_ast_type("col:5 x 'int'") == ("int", None)
+
+    def test_exact_width_and_signedness_preserved(self):
+        """Exact-width typedefs and signedness are not widened to int."""
+        assert map_type("uint8_t", "unsigned char") == "uint8_t"
+        assert map_type("int16_t") == "int16_t"
+        assert map_type("unsigned char") == "unsigned char"
+        assert map_type("signed char") == "signed char"
+        assert map_type("unsigned long") == "unsigned long"
+
+    def test_typedefs_resolve_through_canonical_type(self):
+        """Project typedefs unknown to C use their canonical type."""
+        assert map_type("pin_t", "unsigned char") == "unsigned char"
+        assert map_type("unknown_type") == "int"
+
+    def test_pointers_arrays_and_references(self):
+        """Declarators are kept; references become pointers."""
+        assert map_type("const char *") == "const char *"
+        assert map_type("uint8_t[16]") == "uint8_t [16]"
+        assert map_type("Point &", known_types=["Point"]) == "Point *"
+        assert map_type("volatile uint8_t *") == "volatile uint8_t *"
+
+    def test_array_references(self):
+        """A reference to an array is a pointer to its element."""
+        assert map_type("uint8_t (&)[4]") == "uint8_t *"
+        assert map_type("const buf_t (&)[4]", "const unsigned char (&)[4]") == (
+            "const unsigned char *"
+        )
+        assert c_declaration(map_type("uint8_t (&)[4]"), "buf") == "uint8_t *buf"
+        assert c_declaration(map_type("int16_t (&)[2][3]"), "grid") == "int16_t (*grid)[3]"
+
+    def test_multi_word_integers(self):
+        """Integer spellings in any specifier order keep their width."""
+        assert map_type("long long int") == "int64_t"
+        assert map_type("signed long") == "int32_t"
+        assert map_type("long unsigned int") == "uint32_t"
+        assert map_type("short unsigned") == "uint16_t"
+        assert map_type("char unsigned") == "unsigned char"
+        assert map_type("const long long int *") == "const int64_t *"
+
+    def test_c_declaration(self):
+        """Names are placed inside array and function pointer declarators."""
+        assert c_declaration("uint8_t [16]", "buffer") == "uint8_t buffer[16]"
+        assert c_declaration("const char *", "label") == "const char *label"
+        assert c_declaration("void (*)(int)", "handler") == "void (*handler)(int)"
+
+
+class TestTypeLowering:
+    """Test cases for types carried through the generated C."""
+
+    def test_batch_output_keeps_exact_widths(self, tmp_path, canned_clang):
+        """Fields, parameters and return types keep their declared widths."""
+        src = tmp_path / "src"
+        src.mkdir()
+        (src / "sensor.hpp").write_text(SENSOR_HPP)
+        (src / "sensor.cpp").write_text(SENSOR_CPP)
+        canned_clang(src / "sensor.hpp", _sensor_ast(src / "sensor.hpp"))
+        canned_clang(src / "sensor.cpp", _sensor_ast(src / "sensor.hpp"))
+        out = tmp_path / "out"
+        out.mkdir()
+
+        results = PythonTranspiler().transpile_batch(
+            [src / "sensor.cpp", src / "sensor.hpp"], out
+        )
+
+        assert all(result.success for result in results.values())
+        shared = (out / "shared_definitions.h").read_text()
+        assert "uint8_t channel;" in shared
+        assert "int16_t offset;" in shared
+        assert "uint8_t samples[4];" in shared
+        assert "const char *label;" in shared
+        assert "uint8_t Sensor_read(Sensor* self, uint8_t gain, int16_t bias)" in shared
+
+        sensor_c = (out / "sensor.c").read_text()
+        assert "self->channel = 0;" in sensor_c
+        assert "return self->channel;" in sensor_c
+
+    def test_parameters_are_not_globals(self, tmp_path, canned_clang):
+        """ParmVarDecl lines no longer produce global variables."""
+        transpiler = PythonTranspiler()
+        transpiler.parse_ast_dump(_sensor_ast(tmp_path / "sensor.hpp"))
+
+        assert transpiler.variables == []
+        method = transpiler.classes["Sensor"]["methods"][0]
+        assert [param["name"] for param in method["params"]] == ["gain", "bias"]
@@ -0,0 +1,139 @@
+"""Tests for call-graph based dead code elimination."""
+
+from xc8plusplus.transpilers.callgraph import CallGraph
+
+PUMP_HPP = """#include <stdint.h>
+enum class Mode { IDLE, RUN };
+enum class Fault { NONE, DRY };
+class Pump {
+    bool running;
+public:
+    void start();
+    void stop();
+    void tick();
+};
+"""
+
+PUMP_CPP = """#include "pump.hpp"
+void Pump::start() {
+    running = true;
+}
+void Pump::stop() {
+    running = false;
+}
+void Pump::tick() {
+    running = !running;
+}
+"""
+
+MAIN_CPP = """#include <xc.h>
+#include "pump.hpp"
+Pump pump;
+void unused_helper() {
+    pump.stop();
+}
+void __interrupt() isr(void) {
+    pump.tick();
+}
+int main() {
+    pump.start();
+    return 0;
+}
+"""
+
+
+PUMP_AST = (
+    "|-EnumDecl <{src}/pump.hpp:2:1, col:30> col:12 class Mode 'int'\n"
+    "| |-EnumConstantDecl <col:19> col:19 IDLE 'Mode'\n"
+    "| `-EnumConstantDecl <col:25> col:25 RUN 'Mode'\n"
+    "|-EnumDecl <line:3:1, col:30> col:12 class Fault 'int'\n"
+    "| |-EnumConstantDecl <col:20> col:20 NONE 'Fault'\n"
+    "| `-EnumConstantDecl <col:26> col:26 DRY 'Fault'\n"
+    "|-CXXRecordDecl <line:4:1, line:10:1> line:4:7 class Pump definition\n"
+    "| |-FieldDecl <line:5:5, col:10> col:10 referenced running 'bool'\n"
+    "| |-CXXMethodDecl <line:7:5, col:16> col:10 start 'void ()'\n"
+    "| |-CXXMethodDecl <line:8:5, col:15> col:10 stop 'void ()'\n"
+    "| `-CXXMethodDecl <line:9:5, col:15> col:10 tick 'void ()'\n"
+)
+
+
+def _sources(main_cpp=MAIN_CPP):
+    main_ast = PUMP_AST + (
+        "|-VarDecl <{src}/main.cpp:3:1, col:6> col:6 used pump 'Pump' callinit\n"
+        "|-FunctionDecl <line:4:1, line:6:1> line:4:6 unused_helper 'void ()'\n"
+        "|-FunctionDecl <line:7:1, line:9:1> line:7:21 isr 'void (void)'\n"
+    )
+    if "int main" in main_cpp:
+        main_ast += "`-FunctionDecl <line:10:1, line:13:1> line:10:5 main 'int ()'\n"
+    return {
+        "main.cpp": (main_cpp, main_ast),
+        "pump.cpp": (PUMP_CPP, PUMP_AST),
+        "pump.hpp": (PUMP_HPP, PUMP_AST),
+    }
+
+
+class TestCallGraph:
+    """Test cases for the lowered-C call graph."""
+
+    def test_calls_and_references(self):
+        """Calls, references and aliases become edges; comments do not."""
+        graph = CallGraph(
+            {
+                "main": "Led_on(&led); // Led_off(&led)",
+                "Led_on": "Led LedId_A",
+                "Led_off": "Led",
+                "Led": "LedId id",
+                "LedId": "uint8_t",
+                "led": "Led",
+            },
+            aliases={"LedId_A": "LedId"},
+        )
+
+        assert graph.calls["main"] == ["Led_on"]
+        assert graph.references["main"] == ["led"]
+        assert graph.reachable(["main"]) == {"main", "Led_on", "Led", "LedId", "led"}
+
+
+class TestDeadCodeElimination:
+    """Test cases for dropping code main and the ISRs cannot reach."""
+
+    def test_unreachable_code_is_dropped(self, transpile_batch):
+        """Uncalled methods and functions, unused enums and helpers go away."""
+        batch = transpile_batch(_sources())
+
+        shared = batch.text("shared_definitions.h")
+        pump_c = batch.text("pump.c")
+        main_c = batch.text("main.c")
+        assert "void Pump_start(void) {" in shared + pump_c
+        assert "Pump_stop" not in pump_c
+        assert "Pump_stop" not in shared
+        assert "unused_helper" not in main_c
+        assert "Pump_init" not in pump_c
+        assert "Pump_cleanup" not in pump_c
+        assert "Fault" not in shared
+        assert "Mode" not in shared
+        assert "typedef struct Pump" in shared
+
+    def test_interrupt_handlers_are_roots(self, transpile_batch):
+        """Code only called from an __interrupt function is kept."""
+        batch = transpile_batch(_sources())
+
+        assert "void isr(void) {" in batch.text("main.c")
+        pump_c = batch.text("shared_definitions.h") + batch.text("pump.c")
+        assert "void Pump_tick(void) {" in pump_c
+
+    def test_disabled_without_optimization(self, transpile_batch):
+        """enable_optimization=False emits everything."""
+        batch = transpile_batch(_sources(), enable_optimization=False)
+
+        pump_c = batch.text("pump.c")
+        assert "void Pump_stop(Pump* self) {" in pump_c
+        assert "void Pump_init(Pump* self) {" in pump_c
+        assert "void unused_helper(void) {" in batch.text("main.c")
+
+    def test_library_without_entry_point_is_kept(self, transpile_batch):
+        """Without main or an ISR there is no root, so nothing is dropped."""
+        library = MAIN_CPP.replace("__interrupt() ", "").split("int main")[0]
+        batch = transpile_batch(_sources(library))
+
+        assert "void Pump_stop(Pump* self) {" in batch.text("pump.c")
@@ -0,0 +1,96 @@
+"""Tests for Makefile-format depfile emission."""
+
+from pathlib import Path
+
+from xc8plusplus import XC8Transpiler
+from xc8plusplus.transpilers.depfile import format_depfile, parse_make_dependencies
+
+
+class TestDepfile:
+    """Test cases for depfile parsing, formatting and generation."""
+
+    def test_parse_clang_rule(self):
+        """Continuations, escaped spaces and drive letters are handled."""
+        rule = (
+            "led.o: src/led.cpp src/led.hpp \\\n"
+            "  C:\\xc8\\include\\xc.h my\\ dir/pins.h \\\n"
+            "  src/led.hpp\n"
+        )
+
+        assert parse_make_dependencies(rule) == [
+            "src/led.cpp",
+            "src/led.hpp",
+            "C:\\xc8\\include\\xc.h",
+            "my dir/pins.h",
+        ]
+
+    def test_format_round_trip(self):
+        """Formatted depfiles parse back to the same dependencies."""
+        dependencies = ["src/led.cpp", "my dir/pins.h", "src/led.cpp", "$lib/#1.h"]
+
+        text = format_depfile(["out/led.c", "out/led.h"], dependencies)
+
+        assert text.startswith("out/led.c out/led.h: \\\n  src/led.cpp")
+        assert "$$lib/\\#1.h" in text
+        assert parse_make_dependencies(text) == ["src/led.cpp", "my dir/pins.h", "$lib/#1.h"]
+
+    def test_write_depfile_uses_clang_includes(self, tmp_path, canned_clang):
+        """Headers resolved by Clang, including include paths, are listed."""
+        source = tmp_path / "led.cpp"
+        source.write_text('#include "led.hpp"\n')
+        header = tmp_path / "led.hpp"
+        header.write_text('#include <xc.h>\n')
+        xc_h = tmp_path / "include" / "xc.h"
+        canned_clang(source, "", f"led.o: {source} {header} \\\n  {xc_h}\n")
+        canned_clang(header, "", f"led.o: {header} {xc_h}\n")
+        output = tmp_path / "led.c"
+        depfile = tmp_path / "led.d"
+
+        transpiler = XC8Transpiler(
+            backend="python", include_paths=[str(tmp_path / "include")]
+        )
+        transpiler.write_depfile(depfile, [output], [source])
+
+        assert parse_make_dependencies(depfile.read_text()) == [
+            str(source),
+            str(header),
+            str(xc_h),
+        ]
+        assert depfile.read_text().startswith(f"{output}:")
+
+    def test_generated_outputs_are_not_dependencies(self, tmp_path, canned_clang):
+        """A generated header next to its source is not listed as an input."""
+        source = tmp_path / "blink.cpp"
+        source.write_text("int main() { return 0; }\n")
+        generated_header = tmp_path / "blink.h"
+        generated_header.write_text("/* generated */\n")
+        canned_clang(source, "", f"blink.o: {source}\n")
+        depfile = tmp_path / "blink.d"
+
+        XC8Transpiler(backend="python").write_depfile(
+            depfile, [tmp_path / "blink.c", generated_header], [source]
+        )
+
+        assert parse_make_dependencies(depfile.read_text()) == [str(source)]
+
+    def test_dependencies_come_from_the_ast_pass(self, tmp_path, canned_clang):
+        """Clang lists the includes while dumping the AST; it is not run again."""
+        source = tmp_path / "blink.cpp"
+        source.write_text('#include "pins.h"\nint main() { return 0; }\n')
+        pins = tmp_path / "pins.h"
+        pins.write_text("#define LED 1\n")
+        canned_clang(
+            source,
+            f"`-FunctionDecl 0x1 <{source}:2:1, col:24> col:5 main 'int ()'\n",
+            f"blink.o: {source} {pins}\n",
+        )
+        out = tmp_path / "out"
+        out.mkdir()
+        transpiler = XC8Transpiler(backend="python")
+        transpiler.transpile_batch([str(source)], out)
+        # A second Clang run would now list no headers
+        Path(f"{source}.deps").unlink()
+
+        dependencies = transpiler.write_depfile(tmp_path / "blink.d", [out / "blink.c"], [source])
+
+        assert dependencies == [str(source), str(pins)]
@@ -0,0 +1,105 @@
+"""Tests for scoped enum lowering."""
+
+from xc8plusplus.transpilers.c_types import smallest_integer_type
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+LAMP_HPP = """#include <stdint.h>
+enum class Color : uint16_t { RED, GREEN };
+enum class Level { LOW, HIGH };
+class Lamp {
+    Level level;
+public:
+    void on();
+};
+"""
+
+LAMP_CPP = """#include "lamp.hpp"
+void Lamp::on() {
+    if (level == Level::LOW) {
+        level = Level::HIGH;
+    }
+}
+"""
+
+
+def _lamp_ast(path):
+    return (
+        f"|-EnumDecl 0x1 <{path}:2:1, col:44> col:12 class Color 'uint16_t':'unsigned short'\n"
+        "| |-EnumConstantDecl 0x2 <col:31> col:31 RED 'Color'\n"
+        "| `-EnumConstantDecl 0x3 <col:36> col:36 GREEN 'Color'\n"
+        "|-EnumDecl 0x4 <line:3:1, col:31> col:12 referenced class Level 'int'\n"
+        "| |-EnumConstantDecl 0x5 <col:20> col:20 referenced LOW 'Level'\n"
+        "| `-EnumConstantDecl 0x6 <col:25> col:25 referenced HIGH 'Level'\n"
+        "|-CXXRecordDecl 0x7 <line:4:1, line:8:1> line:4:7 class Lamp definition\n"
+        "| |-FieldDecl 0x8 <line:5:5, col:11> col:11 referenced level 'Level'\n"
+        "| `-CXXMethodDecl 0x9 <line:7:5, col:13> col:10 on 'void ()'\n"
+    )
+
+
+class TestEnumStorage:
+    """Test cases for the storage type of scoped enums."""
+
+    def test_smallest_integer_type(self):
+        """Value ranges narrow to the smallest exact-width type."""
+        assert smallest_integer_type([0, 4]) == "uint8_t"
+        assert smallest_integer_type([-1, 1]) == "int8_t"
+        assert smallest_integer_type([0, 300]) == "uint16_t"
+        assert smallest_integer_type([-200, 0]) == "int16_t"
+        assert smallest_integer_type([]) == "uint8_t"
+
+    def test_declared_and_inferred_underlying_types(self):
+        """Fixed underlying types are kept; default int enums are narrowed."""
+        transpiler = PythonTranspiler()
+        transpiler.parse_ast_dump(_lamp_ast("lamp.hpp"))
+
+        color = transpiler.enums["Color"]
+        level = transpiler.enums["Level"]
+        assert [v["value"] for v in color["values"]] == ["0", "1"]
+        assert transpiler._enum_storage_type(color) == "uint16_t"
+        assert transpiler._enum_storage_type(level) == "uint8_t"
+
+    def test_explicit_values(self):
+        """Enumerator values printed by Clang override the implicit ones."""
+        transpiler = PythonTranspiler()
+        transpiler.parse_ast_dump(
+            "|-EnumDecl 0x1 <a.hpp:1:1, col:40> col:12 class Mode 'int'\n"
+            "| |-EnumConstantDecl 0x2 <col:19> col:19 OFF 'Mode'\n"
+            "| | `-ConstantExpr 0x3 <col:25> 'int'\n"
+            "| |   |-value: Int -1\n"
+            "| `-EnumConstantDecl 0x4 <col:29> col:29 ON 'Mode'\n"
+        )
+
+        values = transpiler.enums["Mode"]["values"]
+        assert [(v["name"], v["value"]) for v in values] == [("OFF", "-1"), ("ON", "0")]
+        assert transpiler._enum_storage_type(transpiler.enums["Mode"]) == "int8_t"
+
+
+class TestEnumLowering:
+    """Test cases for the generated enum definitions and references."""
+
+    def test_batch_output_uses_typedef_and_prefixed_constants(self, tmp_path, canned_clang):
+        """Enums become sized typedefs; references use the prefixed constants."""
+        src = tmp_path / "src"
+        src.mkdir()
+        (src / "lamp.hpp").write_text(LAMP_HPP)
+        (src / "lamp.cpp").write_text(LAMP_CPP)
+        canned_clang(src / "lamp.hpp", _lamp_ast(src / "lamp.hpp"))
+        canned_clang(src / "lamp.cpp", _lamp_ast(src / "lamp.hpp"))
+        out = tmp_path / "out"
+        out.mkdir()
+
+        results = PythonTranspiler().transpile_batch(
+            [src / "lamp.cpp", src / "lamp.hpp"], out
+        )
+
+        assert all(result.success for result in results.values())
+        shared = (out / "shared_definitions.h").read_text()
+        assert "typedef uint16_t Color;" in shared
+        assert "typedef uint8_t Level;" in shared
+        assert "    Level_LOW = 0,\n    Level_HIGH = 1,\n" in shared
+        assert "Level level;" in shared
+
+        # Lamp_on is small enough to be inlined into the shared header
+        lamp_c = shared + (out / "lamp.c").read_text()
+        assert "if (self->level == Level_LOW) {" in lamp_c
+        assert "self->level = Level_HIGH;" in lamp_c
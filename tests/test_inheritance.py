@@ -222,7 +222,7 @@ public:
         transpiler = XC8Transpiler()
 
         # Test basic type mappings
-        assert transpiler.map_cpp_type_to_c("uint8_t") == "int"  # Default fallback
+        assert transpiler.map_cpp_type_to_c("uint8_t") == "uint8_t"  # Exact width kept
         assert transpiler.map_cpp_type_to_c("bool") == "bool"
         assert transpiler.map_cpp_type_to_c("float") == "float"
         assert transpiler.map_cpp_type_to_c("int") == "int"
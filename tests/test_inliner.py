@@ -0,0 +1,139 @@
+"""Tests for inlining small leaf methods."""
+
+import pytest
+
+from xc8plusplus.transpilers.callgraph import CallGraph
+from xc8plusplus.transpilers.inliner import InlineCostModel, select_inline_candidates
+
+LED_HPP = """class Led {
+    bool on;
+public:
+    bool isOn();
+    void toggle();
+};
+"""
+
+LED_CPP = """#include "led.hpp"
+bool Led::isOn() {
+    return on;
+}
+void Led::toggle() {
+    on = !isOn();
+}
+"""
+
+MAIN_CPP = """#include "led.hpp"
+Led led;
+int main() {
+    led.toggle();
+    while (led.isOn()) {
+    }
+    return 0;
+}
+"""
+
+
+LED_AST = (
+    "|-CXXRecordDecl <{src}/led.hpp:1:1, line:6:1> line:1:7 class Led definition\n"
+    "| |-FieldDecl <line:2:5, col:10> col:10 referenced on 'bool'\n"
+    "| |-CXXMethodDecl <line:4:5, col:15> col:10 isOn 'bool ()'\n"
+    "| `-CXXMethodDecl <line:5:5, col:17> col:10 toggle 'void ()'\n"
+)
+
+SOURCES = {
+    "main.cpp": (
+        MAIN_CPP,
+        LED_AST
+        + "|-VarDecl <{src}/main.cpp:2:1, col:5> col:5 used led 'Led' callinit\n"
+        "`-FunctionDecl <line:3:1, line:8:1> line:3:5 main 'int ()'\n",
+    ),
+    "led.cpp": (LED_CPP, LED_AST),
+    "led.hpp": (LED_HPP, LED_AST),
+}
+
+
+class TestInlineCostModel:
+    """Test cases for the inlining cost model."""
+
+    def test_size_goal_inlines_only_when_smaller(self):
+        """A small body is inlined; a larger one called often is not."""
+        model = InlineCostModel()
+
+        assert model.should_inline(body_cost=2, call_sites=5, arguments=1, depth=1)
+        assert not model.should_inline(body_cost=12, call_sites=5, arguments=1, depth=1)
+
+    def test_speed_goal_inlines_small_leaves(self):
+        """Optimizing for speed inlines anything up to the speed limit."""
+        model = InlineCostModel(goal="speed")
+
+        assert model.should_inline(body_cost=12, call_sites=5, arguments=1, depth=1)
+        assert not model.should_inline(body_cost=40, call_sites=5, arguments=1, depth=1)
+
+    def test_deep_calls_are_inlined_to_save_stack(self):
+        """Calls past the stack budget are inlined even when that grows code."""
+        model = InlineCostModel(stack_budget=8, stack_reserve=1)
+
+        assert not model.should_inline(body_cost=12, call_sites=5, arguments=1, depth=7)
+        assert model.should_inline(body_cost=12, call_sites=5, arguments=1, depth=8)
+
+    def test_only_small_side_effect_free_bodies(self):
+        """Stores, loops, switches, directives and long bodies rule a body out."""
+        model = InlineCostModel()
+
+        assert model.is_inlinable("return self->on;")
+        assert model.is_inlinable("uint8_t level = self->level >> 2;\nreturn level;")
+        assert model.is_inlinable("return self->count <= 3 && self->on != 0;")
+        assert not model.is_inlinable("self->on = true;")
+        assert not model.is_inlinable("self->count++;")
+        assert not model.is_inlinable("return self->mask <<= 1;")
+        assert not model.is_inlinable("#pragma switch space\nswitch (self->id) {}")
+        assert not model.is_inlinable("while (!TMR0IF) {}")
+        assert not model.is_inlinable("uint8_t a = 1;\nuint8_t b = 2;\nreturn a + b;")
+
+    def test_invalid_goal(self):
+        """Only 'size' and 'speed' are accepted."""
+        with pytest.raises(ValueError):
+            InlineCostModel(goal="fast")
+
+    def test_only_leaves_without_globals_are_candidates(self):
+        """Functions that call others, touch globals or store stay out of line."""
+        definitions = {
+            "main": "Led_toggle(&led); Led_isOn(&led); Led_count(&led); Led_set(&led);",
+            "Led_isOn": "return self->on;",
+            "Led_toggle": "self->on = !Led_isOn(self);",
+            "Led_count": "return ticks;",
+            "Led_set": "self->on = true;",
+            "ticks": "uint8_t",
+            "led": "",
+        }
+        graph = CallGraph(definitions)
+        bodies = {name: text for name, text in definitions.items() if name.startswith("Led_")}
+
+        selected = select_inline_candidates(
+            graph, bodies, {}, ["main"], InlineCostModel(), ["ticks"]
+        )
+
+        assert selected == {"Led_isOn"}
+
+
+class TestInlining:
+    """Test cases for static inline emission."""
+
+    def test_accessor_is_emitted_static_inline(self, transpile_batch):
+        """The accessor moves to the shared header; its caller stays in the unit."""
+        batch = transpile_batch(SOURCES)
+
+        shared = batch.text("shared_definitions.h")
+        led_c = batch.text("led.c")
+        # led is the only Led, so the methods work on it directly
+        assert "static inline bool Led_isOn(void) {\n    return led.on;\n}" in shared
+        assert "Led_isOn(void) {" not in led_c
+        assert "Led_isOn" not in batch.text("led.h")
+        assert "void Led_toggle(void) {" in led_c
+
+    def test_disabled_without_optimization(self, transpile_batch):
+        """enable_optimization=False keeps every method out of line."""
+        batch = transpile_batch(SOURCES, enable_optimization=False)
+
+        assert "static inline" not in batch.text("shared_definitions.h")
+        assert "bool Led_isOn(Led* self) {" in batch.text("led.c")
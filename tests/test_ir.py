@@ -0,0 +1,185 @@
+"""Tests for the typed IR of the lowered program."""
+
+import pytest
+
+from xc8plusplus.transpilers.ir import (
+    IRProgram,
+    IRVariable,
+    ProgramBuilder,
+    load_program,
+    lowered_statements,
+    parse_parameters,
+)
+from xc8plusplus.transpilers.link import link
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+MOTOR_CPP = """#include <stdint.h>
+enum class Dir { FWD, REV };
+class Motor {
+    Dir dir;
+    uint8_t speed;
+public:
+    void run(uint8_t value);
+};
+void Motor::run(uint8_t value) {
+    speed = value;
+    dir = Dir::FWD;
+}
+Motor motor;
+int main() {
+    motor.run(3);
+    return 0;
+}
+"""
+
+
+def _program():
+    builder = ProgramBuilder()
+    builder.enum("Dir", "uint8_t", [("Dir_FWD", 0), ("Dir_REV", -1)])
+    builder.struct("Motor", [IRVariable("dir", "Dir"), IRVariable("log", "uint8_t [4]")])
+    builder.variable("motor", "Motor")
+    builder.function(
+        "Motor_run", "method", "void", [IRVariable("value", "uint8_t")],
+        "self->dir = Dir_FWD; // ; }\nhelper(); helper();", "Motor",
+    )
+    builder.function("helper", "function", "void", (), "")
+    builder.function("main", "main", "int", (), "Motor_run(&motor, 3);")
+    return builder.build()
+
+
+class TestProgram:
+    """Test cases for building and resolving the IR."""
+
+    def test_statements_resolve_symbols(self):
+        """Calls are counted per expression; constants resolve to their enum."""
+        run = _program().function("Motor_run")
+
+        assert [statement.text for statement in run.body] == [
+            "self->dir = Dir_FWD;", "helper();", "helper();"
+        ]
+        assert run.body[0].references == ("Dir",)
+        assert run.header.references == ("Motor",)
+        assert _program().function("main").body[0].references == ("motor",)
+
+    def test_call_graph(self):
+        """The graph follows the resolved edges of every symbol."""
+        graph = _program().call_graph()
+
+        assert graph.calls["main"] == ["Motor_run"]
+        assert graph.call_sites["helper"] == 2
+        assert graph.reachable(["main"]) == {
+            "main", "Motor_run", "motor", "Motor", "Dir", "helper"
+        }
+
+    def test_comments_do_not_split(self):
+        """A ';' in a comment stays within its statement."""
+        assert lowered_statements("a(); /* b(); */ c(x; // }\n);") == ["a();", "c(x; // }\n);"]
+
+    def test_parameters(self):
+        """C parameter lists parse back to typed parameters."""
+        assert parse_parameters("uint8_t data[4], unsigned int count") == (
+            IRVariable("data", "uint8_t[4]"),
+            IRVariable("count", "unsigned int"),
+        )
+        assert parse_parameters("void") == ()
+
+
+class TestSerialization:
+    """Test cases for the binary form."""
+
+    def test_round_trip(self):
+        """Reading back gives an equal program, strings stored once."""
+        program = _program()
+        data = program.to_bytes()
+
+        assert IRProgram.from_bytes(data) == program
+        # Length-prefixed entry of the string table
+        assert data.count(b"\x09Motor_run") == 1
+
+    def test_rejects_other_data(self):
+        """Foreign data and other versions are refused."""
+        data = _program().to_bytes()
+
+        with pytest.raises(ValueError, match="Not a serialized IR"):
+            IRProgram.from_bytes(b"{}")
+        with pytest.raises(ValueError, match="version 4"):
+            IRProgram.from_bytes(data[:4] + b"\x04" + data[5:])
+
+    def test_load_checks_fingerprint(self, tmp_path):
+        """A saved program is only loaded for the inputs it was built from."""
+        ir_file = tmp_path / "program.xir"
+        program = IRProgram(functions=_program().functions, fingerprint="abc")
+        ir_file.write_bytes(program.to_bytes())
+
+        assert load_program(ir_file, "abc") == program
+        assert load_program(ir_file, "def") is None
+        assert load_program(tmp_path / "missing.xir", "abc") is None
+        ir_file.write_bytes(program.to_bytes()[:20])
+        assert load_program(ir_file, "abc") is None
+
+
+class TestGeneratedProgram:
+    """Test cases for the IR of a transpiled program."""
+
+    @pytest.fixture
+    def motor_source(self, tmp_path, canned_clang):
+        source = tmp_path / "motor.cpp"
+        source.write_text(MOTOR_CPP)
+        canned_clang(
+            source,
+            f"|-EnumDecl 0x1 <{source}:2:1, col:26> col:12 referenced class Dir 'int'\n"
+            "| |-EnumConstantDecl 0x2 <col:18> col:18 referenced FWD 'Dir'\n"
+            "| `-EnumConstantDecl 0x3 <col:23> col:23 REV 'Dir'\n"
+            "|-CXXRecordDecl 0x4 <line:3:1, line:8:1> line:3:7 class Motor definition\n"
+            "| |-FieldDecl 0x5 <line:4:5, col:9> col:9 referenced dir 'Dir'\n"
+            "| |-FieldDecl 0x6 <line:5:5, col:13> col:13 referenced speed 'uint8_t':'unsigned char'\n"
+            "| `-CXXMethodDecl 0x7 <line:7:5, col:28> col:10 used run 'void (uint8_t)'\n"
+            "|   `-ParmVarDecl 0x8 <col:14, col:22> col:22 value 'uint8_t':'unsigned char'\n"
+            "|-VarDecl 0x9 <line:13:1, col:7> col:7 used motor 'Motor' callinit\n"
+            "`-FunctionDecl 0xa <line:14:1, line:17:1> line:14:5 main 'int ()'\n",
+        )
+        return source
+
+    def test_transpiler_keeps_and_caches_ir(self, tmp_path, motor_source):
+        """The typed IR of the lowered program is written to the cache directory."""
+        out = tmp_path / "out"
+        out.mkdir()
+        cache = tmp_path / "cache"
+        transpiler = PythonTranspiler(cache_dir=str(cache))
+
+        results = transpiler.transpile_batch([motor_source], out)
+
+        assert all(result.success for result in results.values())
+        # Saved as built; the passes run on the linked program
+        program = IRProgram.from_bytes((cache / "program.xir").read_bytes())
+        assert program == transpiler.built_ir
+        assert program.fingerprint
+        assert link(program.split_units()).program == transpiler.program_ir
+        motor = next(struct for struct in program.structs if struct.name == "Motor")
+        assert motor.fields == (IRVariable("dir", "Dir"), IRVariable("speed", "uint8_t"))
+        run = program.function("Motor_run")
+        assert run.parameters == (IRVariable("value", "uint8_t"),)
+        assert [enum.constants for enum in program.enums] == [(("Dir_FWD", 0), ("Dir_REV", 1))]
+
+    def test_warm_run_loads_ir(self, tmp_path, motor_source, monkeypatch, capsys):
+        """A run on the same inputs loads program.xir instead of building the IR."""
+        cache = tmp_path / "cache"
+        outputs = []
+        for run in ("cold", "warm"):
+            out = tmp_path / run
+            out.mkdir()
+            transpiler = PythonTranspiler(cache_dir=str(cache))
+            if run == "warm":
+                monkeypatch.setattr(transpiler, "build_ir", pytest.fail)
+            transpiler.transpile_batch([motor_source], out)
+            outputs.append((out / "motor.c").read_text())
+
+        assert "Program IR: loaded program.xir" in capsys.readouterr().out
+        assert outputs[0] == outputs[1]
+
+        # Other inputs build it again
+        motor_source.write_text(MOTOR_CPP.replace("run(3)", "run(4)"))
+        transpiler = PythonTranspiler(cache_dir=str(cache))
+        transpiler.transpile_batch([motor_source], tmp_path / "warm")
+        assert "Program IR: loaded" not in capsys.readouterr().out
+        assert "Motor_run(4)" in transpiler.built_ir.function("main").code
@@ -0,0 +1,121 @@
+"""Tests for struct layout packing."""
+
+from xc8plusplus.transpilers.c_types import c_type_size
+from xc8plusplus.transpilers.layout import Member, pack_struct
+
+VALVE_HPP = """#include <stdint.h>
+enum class Port { A, B, C };
+class Valve {
+    bool open;
+    uint16_t cycles;
+    bool fault;
+    Port port;
+    bool armed;
+public:
+    void toggle();
+};
+"""
+
+VALVE_CPP = """#include "valve.hpp"
+void watch(bool* flag);
+void Valve::toggle() {
+    open = !open;
+    cycles = cycles + 1;
+    if (fault && port == Port::A) {
+        watch(&armed);
+    }
+}
+"""
+
+
+VALVE_AST = (
+    "|-EnumDecl <{src}/valve.hpp:2:1, col:28> col:12 referenced class Port 'int'\n"
+    "| |-EnumConstantDecl <col:19> col:19 referenced A 'Port'\n"
+    "| |-EnumConstantDecl <col:22> col:22 B 'Port'\n"
+    "| `-EnumConstantDecl <col:25> col:25 C 'Port'\n"
+    "|-CXXRecordDecl <line:3:1, line:11:1> line:3:7 class Valve definition\n"
+    "| |-FieldDecl <line:4:5, col:10> col:10 referenced open 'bool'\n"
+    "| |-FieldDecl <line:5:5, col:14> col:14 referenced cycles 'uint16_t':'unsigned short'\n"
+    "| |-FieldDecl <line:6:5, col:10> col:10 referenced fault 'bool'\n"
+    "| |-FieldDecl <line:7:5, col:10> col:10 referenced port 'Port'\n"
+    "| |-FieldDecl <line:8:5, col:10> col:10 referenced armed 'bool'\n"
+    "| `-CXXMethodDecl <line:10:5, col:17> col:10 toggle 'void ()'\n"
+)
+
+SOURCES = {"valve.cpp": (VALVE_CPP, VALVE_AST), "valve.hpp": (VALVE_HPP, VALVE_AST)}
+
+
+class TestPackStruct:
+    """Test cases for the bit-field packing plan."""
+
+    def test_type_sizes(self):
+        """Sizes follow XC8 on 8-bit PIC."""
+        assert c_type_size("bool") == 1
+        assert c_type_size("int") == 2
+        assert c_type_size("uint24_t") == 3
+        assert c_type_size("uint8_t *") == 2
+        assert c_type_size("uint16_t [4]") == 8
+        assert c_type_size("Led", {"Led": 3}) == 3
+
+    def test_packable_members_are_grouped(self):
+        """Packable members move together into as few bytes as possible."""
+        layout = pack_struct([
+            Member("on", "bool on", 1, ("bool", 1)),
+            Member("count", "uint16_t count", 2),
+            Member("mode", "Mode mode", 1, ("unsigned", 2)),
+        ])
+
+        assert layout.declarations == ["uint16_t count", "unsigned mode : 2", "bool on : 1"]
+        assert (layout.size_before, layout.size_after) == (4, 3)
+
+    def test_positional_layout_keeps_order(self):
+        """Without reordering only adjacent packable members are merged."""
+        members = [
+            Member("on", "bool on", 1, ("bool", 1)),
+            Member("count", "uint16_t count", 2),
+            Member("mode", "Mode mode", 1, ("unsigned", 2)),
+            Member("ready", "bool ready", 1, ("bool", 1)),
+        ]
+
+        layout = pack_struct(members, reorder=False)
+
+        assert layout.declarations == [
+            "bool on", "uint16_t count", "unsigned mode : 2", "bool ready : 1",
+        ]
+        assert layout.size_after == 4
+
+    def test_no_saving_keeps_plain_layout(self):
+        """A lone bool stays a plain member."""
+        layout = pack_struct([
+            Member("count", "uint8_t count", 1),
+            Member("on", "bool on", 1, ("bool", 1)),
+        ])
+
+        assert layout.declarations == ["uint8_t count", "bool on"]
+        assert layout.packed == []
+
+
+class TestStructPacking:
+    """Test cases for packed struct emission."""
+
+    def test_fields_without_escaping_address_are_packed(self, transpile_batch):
+        """Bools and small enums are packed; a field whose address is taken is not."""
+        batch = transpile_batch(SOURCES, pack_structs=True)
+        shared = batch.text("shared_definitions.h")
+
+        assert (
+            "    uint16_t cycles;\n"
+            "    bool armed;\n"
+            "    unsigned port : 2;\n"
+            "    bool open : 1;\n"
+            "    bool fault : 1;\n"
+        ) in shared
+        layout = batch.transpiler.struct_layouts["Valve"]
+        assert (layout.size_before, layout.size_after) == (6, 4)
+
+    def test_disabled_by_default(self, transpile_batch):
+        """Without pack_structs the fields keep their declarations."""
+        shared = transpile_batch(SOURCES).text("shared_definitions.h")
+
+        assert "    bool open;\n    uint16_t cycles;\n" in shared
+        assert " : " not in shared
@@ -0,0 +1,130 @@
+"""Tests for the link step of batch transpilation."""
+
+from xc8plusplus.transpilers.ir import IRVariable, ProgramBuilder
+from xc8plusplus.transpilers.link import link
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+UTIL_CPP = """#include <stdint.h>
+uint8_t scale(uint8_t raw) {
+    return raw / 4;
+}
+uint8_t reading(uint8_t raw) {
+    return scale(raw);
+}
+"""
+
+MAIN_CPP = """#include <stdint.h>
+uint8_t reading(uint8_t raw);
+uint8_t last;
+int main() {
+    last = reading(100);
+    return 0;
+}
+"""
+
+
+def _units():
+    builder = ProgramBuilder()
+    builder.struct("Led", [IRVariable("on", "bool")], unit="led")
+    builder.function("Led_set", "method", "void", (), "self->on = true;", "Led", unit="led")
+    builder.function("Led_helper", "method", "void", (), "Led_set(self);", "Led", unit="led")
+    builder.function("Led_fast", "method", "void", (), "Led_set(self);", "Led", unit="led")
+    builder.variable("led", "Led", unit="main")
+    builder.variable("count", "uint8_t", unit="main")
+    builder.function("count_up", "function", "void", (), "count++;", unit="main")
+    builder.function(
+        "main", "main", "int", (), "count_up(); Led_helper(&led); Led_fast(&led);", unit="main"
+    )
+    return builder.build().split_units()
+
+
+class TestLink:
+    """Test cases for merging the IR of the translation units."""
+
+    def test_units_imports_and_instances(self):
+        """Each symbol gets its unit; uses of another unit's symbols are imports."""
+        linked = link(_units())
+
+        assert linked.units["Led_set"] == "led"
+        assert linked.units["count"] == "main"
+        assert linked.imports["main"] == {"Led_helper": "led", "Led_fast": "led", "Led": "led"}
+        assert linked.instances == {"Led": ("led",)}
+        assert {symbol.name for symbol in linked.program.functions} >= {"main", "Led_set"}
+
+    def test_multiple_definitions(self):
+        """A function defined by two units is reported, the first kept."""
+        units = _units()
+        other = ProgramBuilder()
+        other.function("count_up", "function", "void", (), "return;", unit="extra")
+        units["extra"] = other.build()
+
+        linked = link(units)
+
+        assert linked.duplicates == {"count_up": ("main", "extra")}
+        assert linked.program.function("count_up").unit == "main"
+        assert "count_up is defined in main, extra" in linked.format()
+
+    def test_internal_symbols(self):
+        """Symbols only their unit uses are internal; inline callers count everywhere."""
+        linked = link(_units())
+        live = set(linked.units)
+
+        assert linked.internal_symbols(live) == {"Led_set", "count", "count_up", "led"}
+        assert linked.internal_symbols(live, shared={"Led_fast"}) == {"count", "count_up", "led"}
+
+
+SOURCES = {
+    "main.cpp": (
+        MAIN_CPP,
+        "|-VarDecl <{src}/main.cpp:3:1, col:9> col:9 used last 'uint8_t':'unsigned char'\n"
+        "`-FunctionDecl <line:4:1, line:7:1> line:4:5 main 'int ()'\n",
+    ),
+    "util.cpp": (
+        UTIL_CPP,
+        "|-FunctionDecl <{src}/util.cpp:2:1, line:4:1> line:2:9 used scale 'uint8_t (uint8_t)'\n"
+        "| `-ParmVarDecl <col:15, col:23> col:23 raw 'uint8_t':'unsigned char'\n"
+        "`-FunctionDecl <line:5:1, line:7:1> line:5:9 reading 'uint8_t (uint8_t)'\n"
+        "  `-ParmVarDecl <col:17, col:25> col:25 raw 'uint8_t':'unsigned char'\n",
+    ),
+}
+
+
+class TestGeneratedLinkage:
+    """Test cases for the linkage in the generated C."""
+
+    def test_unit_local_symbols_are_static(self, transpile_batch):
+        """scale and last stay in their unit; reading is shared."""
+        batch = transpile_batch(SOURCES)
+        transpiler, out = batch.transpiler, batch.out
+
+        util_c = (out / "util.c").read_text()
+        header = (out / "shared_definitions.h").read_text()
+        assert transpiler.linked_program.imports["main"] == {"reading": "util"}
+        assert "static uint8_t scale(uint8_t raw);" in util_c
+        assert "static uint8_t scale(uint8_t raw) {" in util_c
+        assert "\nuint8_t reading(uint8_t raw) {" in util_c
+        assert "static uint8_t last;" in (out / "main.c").read_text()
+        assert "scale" not in header
+        assert "last" not in header
+        assert "uint8_t reading(uint8_t raw);" in header
+
+    def test_amalgamated_firmware(self, transpile_batch):
+        """One firmware.c: everything static but main, callees defined first."""
+        batch = transpile_batch(SOURCES, amalgamate=True)
+
+        assert sorted(path.name for path in batch.out.iterdir()) == ["firmware.c"]
+        code = batch.text("firmware.c")
+        assert batch.result("util.cpp").generated_c_code == code
+        assert "static uint8_t last;" in code
+        assert "#include \"" not in code
+        scale = code.index("static uint8_t scale(uint8_t raw) {")
+        reading = code.index("static uint8_t reading(uint8_t raw) {")
+        assert scale < reading < code.index("\nint main(void) {")
+        # No forward declarations needed without recursion
+        assert "Internal Declarations" not in code
+
+    def test_dependency_order(self):
+        """Callees come first; a cycle is entered once."""
+        uses = {"main": ["even"], "even": ["odd"], "odd": ["even"], "unused": []}
+
+        assert PythonTranspiler._dependency_order(uses) == ["odd", "even", "main", "unused"]
@@ -0,0 +1,96 @@
+"""Tests for the function-level lowering memo."""
+
+from xc8plusplus.transpilers.lowering_memo import LoweringMemo
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+
+def _led_transpiler(cache_dir=None):
+    """Transpiler with a pre-parsed Led class"""
+    transpiler = PythonTranspiler(cache_dir=cache_dir)
+    transpiler.classes["Led"] = {
+        "methods": [
+            {"name": "turnOn", "type": "void ()", "body": "state = true;"},
+            {"name": "turnOff", "type": "void ()", "body": "state = false;"},
+            {"name": "toggle", "type": "void ()", "body": "if (state) turnOff();"},
+        ],
+        "fields": [{"name": "state", "type": "bool"}],
+        "constructors": [],
+        "destructor": None,
+    }
+    return transpiler
+
+
+def _lower_all(transpiler):
+    return [
+        transpiler._lower_body(method["body"])
+        for method in transpiler.classes["Led"]["methods"]
+    ]
+
+
+class TestLoweringMemo:
+    """Test cases for memoized function lowering."""
+
+    def test_unchanged_functions_are_reused(self):
+        """A second run lowering the same bodies is served from the memo."""
+        transpiler = _led_transpiler()
+
+        first = _lower_all(transpiler)
+        # Lowering again within the run is not counted
+        assert _lower_all(transpiler) == first
+        assert transpiler.lowering_memo.misses == 3
+        assert transpiler.lowering_memo.hits == 0
+
+        transpiler.lowering_memo.begin_run()
+        second = _lower_all(transpiler)
+
+        assert first == second
+        assert first[2] == "if (self->state) Led_turnOff(self);"
+        assert transpiler.lowering_memo.misses == 0
+        assert transpiler.lowering_memo.hits == 3
+
+    def test_only_edited_function_is_relowered(self):
+        """Editing one method re-lowers that method only."""
+        transpiler = _led_transpiler()
+        _lower_all(transpiler)
+
+        transpiler.lowering_memo.begin_run()
+        transpiler.classes["Led"]["methods"][0]["body"] = "state = !false;"
+        _lower_all(transpiler)
+
+        assert transpiler.lowering_memo.misses == 1
+        assert transpiler.lowering_memo.hits == 2
+
+    def test_referenced_environment_change_invalidates(self):
+        """Renaming a referenced field changes the key of dependent bodies only."""
+        transpiler = _led_transpiler()
+        transpiler._lower_body("state = true;")
+        transpiler._lower_body("PORTB = 0;")
+
+        transpiler.lowering_memo.begin_run()
+        transpiler.classes["Led"]["fields"] = [{"name": "level", "type": "bool"}]
+
+        assert transpiler._lower_body("state = true;") == "state = true;"
+        assert transpiler._lower_body("PORTB = 0;") == "PORTB = 0;"
+        assert transpiler.lowering_memo.misses == 1
+        assert transpiler.lowering_memo.hits == 1
+
+    def test_memo_persists_across_runs(self, tmp_path):
+        """A memo saved to the cache directory is reused by the next run."""
+        transpiler = _led_transpiler(cache_dir=str(tmp_path))
+        expected = _lower_all(transpiler)
+        transpiler._save_lowering_memo()
+
+        assert (tmp_path / "lowering_memo.json").exists()
+
+        next_run = _led_transpiler(cache_dir=str(tmp_path))
+        assert _lower_all(next_run) == expected
+        assert next_run.lowering_memo.hits == 3
+        assert next_run.lowering_memo.misses == 0
+
+    def test_corrupt_memo_is_ignored(self, tmp_path):
+        """An unreadable memo file is treated as empty."""
+        (tmp_path / "lowering_memo.json").write_text("{not json")
+
+        memo = LoweringMemo(str(tmp_path))
+
+        assert memo.entries == {}
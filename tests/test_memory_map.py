@@ -0,0 +1,141 @@
+"""Tests for the device memory maps and bank placement."""
+
+from xc8plusplus.transpilers.memorymap import (
+    COMPILED_STACK_RESERVE,
+    LOOP_WEIGHT,
+    PlacedObject,
+    count_accesses,
+    device_memory_map,
+    plan_placement,
+)
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+TICKS_CPP = """#include <stdint.h>
+volatile uint8_t ticks;
+uint8_t history[40];
+uint8_t mode;
+void __interrupt() isr(void) {
+    ticks++;
+}
+int main() {
+    while (1) {
+        if (ticks > 10) {
+            ticks = 0;
+            mode++;
+        }
+    }
+    history[0] = mode;
+    return 0;
+}
+"""
+
+
+class TestMemoryMap:
+    """Test cases for the device memory maps."""
+
+    def test_pic16f876a(self):
+        """368 bytes: four banks and 16 bytes of common RAM."""
+        memory_map = device_memory_map("PIC16F876A")
+
+        total = sum(memory_map.bank_size(bank) for bank in range(len(memory_map.banks)))
+        assert total + 16 == 368
+        assert memory_map.common == (0x70, 0x7F)
+        assert memory_map.is_sfr(0x05) and memory_map.is_sfr(0x85)
+        assert not memory_map.is_sfr(0x20)
+
+    def test_pic16f873a(self):
+        """192 bytes in two banks, mirrored by banks 2 and 3, no common RAM."""
+        memory_map = device_memory_map("PIC16F873A")
+
+        assert memory_map.banks == ((0x20, 0x7F), (0xA0, 0xFF))
+        assert memory_map.common is None and memory_map.common_size == 0
+
+    def test_listed_parts_only(self):
+        """Parts sharing a layout are listed; others get no map at all."""
+        assert device_memory_map("PIC18F2550").common == (0x000, 0x05F)
+        assert device_memory_map("PIC16F887").device == "PIC16F887"
+        assert device_memory_map("PIC16F1827") is None
+        assert device_memory_map("PIC16F84A") is None
+        assert device_memory_map("PIC10F200") is None
+
+
+class TestPlacement:
+    """Test cases for the access counts and the placement."""
+
+    def test_loop_accesses_weigh_more(self):
+        """Each enclosing loop multiplies the weight of an access."""
+        counts = count_accesses(
+            "mode = 1;\nwhile (ready) {\n    for (;;) {\n        ticks++;\n    }\n}\n"
+            "do {\n    mode--;\n} while (mode);\n",
+            {"mode", "ready", "ticks"},
+        )
+
+        assert counts["ticks"] == LOOP_WEIGHT ** 2
+        assert counts["ready"] == LOOP_WEIGHT
+        assert counts["mode"] == 1 + 2 * LOOP_WEIGHT
+
+    def test_common_ram_by_density(self):
+        """Hot small objects and interrupt-shared ones take common RAM."""
+        memory_map = device_memory_map("PIC16F876A")
+        placement = plan_placement(
+            [
+                PlacedObject("buffer", 8, 100),
+                PlacedObject("flag", 1, 40),
+                PlacedObject("ticks", 2, 5, interrupt_shared=True),
+                PlacedObject("unused", 1, 0),
+            ],
+            {},
+            memory_map,
+        )
+
+        assert placement.common == ["ticks", "flag"]
+        assert placement.qualifier("buffer") == "__bank(0)"
+        assert placement.qualifier("unused") == ""
+
+    def test_objects_used_together_share_a_bank(self):
+        """An object follows the bank of the objects it is used with."""
+        memory_map = device_memory_map("PIC16F876A")
+        bank_size = memory_map.bank_size(0) - COMPILED_STACK_RESERVE
+        placement = plan_placement(
+            [
+                PlacedObject("big", bank_size - 1, 50),
+                PlacedObject("table", 30, 20),
+                PlacedObject("index", 30, 10),
+            ],
+            {("index", "table"): 10},
+            memory_map,
+        )
+
+        assert placement.banks == {"big": 0, "table": 1, "index": 1}
+
+
+class TestBankQualifiers:
+    """Test cases for the qualifiers in the generated C."""
+
+    def test_qualifiers_on_definitions_and_externs(self, tmp_path, canned_clang):
+        """Placed globals carry __near/__bank(n) wherever they are declared."""
+        source = tmp_path / "ticks.cpp"
+        source.write_text(TICKS_CPP)
+        canned_clang(
+            source,
+            f"|-VarDecl 0x1 <{source}:2:1, col:18> col:18 used ticks 'volatile uint8_t':'volatile unsigned char'\n"
+            "|-VarDecl 0x2 <line:3:1, col:19> col:9 used history 'uint8_t[40]'\n"
+            "|-VarDecl 0x3 <line:4:1, col:9> col:9 used mode 'uint8_t':'unsigned char'\n"
+            "|-FunctionDecl 0x4 <line:5:1, line:7:1> line:5:17 isr 'void (void)'\n"
+            "`-FunctionDecl 0x5 <line:8:1, line:17:1> line:8:5 main 'int ()'\n",
+        )
+        out = tmp_path / "out"
+        out.mkdir()
+        # Keep the globals external, for the declarations of the shared header
+        transpiler = PythonTranspiler(bank_placement=True, passes=["no-internalize"])
+
+        results = transpiler.transpile_batch([source], out)
+
+        assert all(result.success for result in results.values())
+        code = (out / "ticks.c").read_text()
+        header = (out / "shared_definitions.h").read_text()
+        assert "__near volatile uint8_t ticks;" in code
+        assert "__near uint8_t mode;" in code
+        assert "__bank(0) uint8_t history[40];" in code
+        assert "extern __near volatile uint8_t ticks;" in header
+        assert transpiler.data_placement.objects["ticks"].interrupt_shared
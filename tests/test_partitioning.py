@@ -0,0 +1,104 @@
+"""Tests for per-translation-unit output partitioning."""
+
+import os
+
+from xc8plusplus.transpilers.inliner import InlineCostModel
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+
+# Keep every method out of line so it lands in its own unit
+NO_INLINING = InlineCostModel(speed_limit=0)
+
+DRIVE_HPP = """class Motor {
+    int speed;
+public:
+    void stop();
+};
+"""
+
+DRIVE_CPP = """#include "drive.hpp"
+void Motor::stop() {
+    speed = 0;
+}
+"""
+
+APP_CPP = """#include "drive.hpp"
+Motor motor;
+void loop() {
+    motor.stop();
+}
+int main() {
+    loop();
+    return 0;
+}
+"""
+
+
+def _motor_ast(path):
+    return (
+        f"|-CXXRecordDecl 0x1 <{path}:1:1, line:5:1> line:1:7 class Motor definition\n"
+        "| |-FieldDecl 0x2 <line:2:5, col:9> col:9 speed 'int'\n"
+        "| |-CXXMethodDecl 0x3 <line:4:5, col:15> col:10 stop 'void ()'\n"
+    )
+
+
+def _project(tmp_path, canned_clang):
+    """Write a two-unit project whose file names match no built-in mapping"""
+    src = tmp_path / "src"
+    src.mkdir()
+    files = {"drive.hpp": DRIVE_HPP, "drive.cpp": DRIVE_CPP, "app.cpp": APP_CPP}
+    for name, content in files.items():
+        (src / name).write_text(content)
+
+    header = src / "drive.hpp"
+    canned_clang(header, _motor_ast(header))
+    canned_clang(src / "drive.cpp", _motor_ast(header))
+    canned_clang(
+        src / "app.cpp",
+        _motor_ast(header)
+        + f"|-VarDecl 0x6 <{src / 'app.cpp'}:2:1, col:7> col:7 used motor 'Motor' callinit\n"
+        + "|-FunctionDecl 0x4 <line:3:1, line:5:1> line:3:6 loop 'void ()'\n"
+        + "`-FunctionDecl 0x5 <line:6:1, line:9:1> line:6:5 main 'int ()'\n",
+    )
+    return [src / "app.cpp", src / "drive.cpp", src / "drive.hpp"]
+
+
+class TestPartitioning:
+    """Test cases for output partitioning and write suppression."""
+
+    def test_definitions_follow_source_location(self, tmp_path, canned_clang):
+        """Classes go to the unit defining their methods, main to its own unit."""
+        sources = _project(tmp_path, canned_clang)
+        out = tmp_path / "out"
+        out.mkdir()
+
+        results = PythonTranspiler(inline_model=NO_INLINING).transpile_batch(sources, out)
+
+        assert all(result.success for result in results.values())
+        drive_c = (out / "drive.c").read_text()
+        app_c = (out / "app.c").read_text()
+        assert "void Motor_stop(void)" in drive_c
+        assert '#include "drive.h"' in drive_c
+        assert "Motor_stop(void) {" not in app_c
+        assert "int main(void)" in app_c
+        assert "void loop(void)" in app_c
+        assert "int main(void)" not in drive_c
+        assert not (out / "app.h").exists()
+
+    def test_unchanged_outputs_keep_mtime(self, tmp_path, canned_clang):
+        """A second run over unchanged inputs leaves every output untouched."""
+        sources = _project(tmp_path, canned_clang)
+        out = tmp_path / "out"
+        out.mkdir()
+        PythonTranspiler(inline_model=NO_INLINING).transpile_batch(sources, out)
+
+        outputs = sorted(out.iterdir())
+        contents = {path: path.read_bytes() for path in outputs}
+        for path in outputs:
+            os.utime(path, (1_000_000, 1_000_000))
+
+        PythonTranspiler(inline_model=NO_INLINING).transpile_batch(list(reversed(sources)), out)
+
+        assert sorted(out.iterdir()) == outputs
+        for path in outputs:
+            assert path.read_bytes() == contents[path]
+            assert path.stat().st_mtime == 1_000_000
@@ -0,0 +1,98 @@
+"""Tests for the optimization pass manager."""
+
+import pytest
+
+from xc8plusplus.transpilers.passes import PassManager
+
+APP_CPP = """#include <stdint.h>
+uint8_t used(uint8_t x) {
+    return x + 1;
+}
+uint8_t unused(uint8_t x) {
+    return x - 1;
+}
+int main() {
+    used(1);
+    return 0;
+}
+"""
+
+
+APP_AST = (
+    "|-FunctionDecl <{src}/app.cpp:2:1, line:4:1> line:2:9 used used 'uint8_t (uint8_t)'\n"
+    "| `-ParmVarDecl <col:14, col:22> col:22 x 'uint8_t':'unsigned char'\n"
+    "|-FunctionDecl <line:5:1, line:7:1> line:5:9 unused 'uint8_t (uint8_t)'\n"
+    "| `-ParmVarDecl <col:16, col:24> col:24 x 'uint8_t':'unsigned char'\n"
+    "`-FunctionDecl <line:8:1, line:11:1> line:8:5 main 'int ()'\n"
+)
+
+
+SOURCES = {"app.cpp": (APP_CPP, APP_AST)}
+
+
+class TestPassSelection:
+    """Test cases for the levels and toggles."""
+
+    def test_levels_select_passes_and_goal(self):
+        """-O0 runs nothing; -Os and -O2 differ in goal; opt-in passes stay off."""
+        assert not PassManager("0").enabled("dce")
+        assert PassManager("Os").enabled("dce")
+        assert PassManager("Os").goal == "size"
+        assert PassManager("O2").goal == "speed"
+        assert not PassManager("2").enabled("bit-types")
+
+    def test_toggles_override_the_level(self):
+        """-fNAME and -fno-NAME switch one pass on top of the level."""
+        passes = PassManager("s", ["no-inline", "bit-types"])
+
+        assert not passes.enabled("inline")
+        assert passes.enabled("bit-types")
+        assert PassManager("0", ["dce"]).enabled("dce")
+
+    def test_unknown_level_or_pass(self):
+        """Bad names are rejected with the valid choices."""
+        with pytest.raises(ValueError, match="O0, Os, O2"):
+            PassManager("3")
+        with pytest.raises(ValueError, match="Unknown optimization pass 'unroll'"):
+            PassManager("s", ["no-unroll"])
+
+    def test_bisect_limit_skips_later_passes(self, capsys):
+        """Only the first N enabled passes run; disabled ones do not count."""
+        passes = PassManager("s", ["no-singletons"], bisect_limit=1)
+
+        assert not passes.run("singletons", lambda: 1)
+        assert passes.run("specialize", lambda: 2)
+        assert not passes.run("dce", lambda: 3)
+        assert "skipping pass 2 (dce)" in capsys.readouterr().out
+        assert [entry["changes"] for entry in passes.metrics()["passes"]] == [2]
+
+
+class TestPassMetrics:
+    """Test cases for the pass statistics of a transpilation."""
+
+    def test_result_reports_pass_changes(self, transpile_batch):
+        """Dead code elimination counts the function it removed."""
+        batch = transpile_batch(SOURCES)
+        result = batch.result("app.cpp")
+        code = batch.text("app.c")
+
+        assert result.metrics["opt_level"] == "Os"
+        changes = {entry["name"]: entry["changes"] for entry in result.metrics["passes"]}
+        assert changes["dce"] == 1
+        assert "unused" not in code
+
+    def test_disabled_pass_leaves_code(self, transpile_batch):
+        """With -fno-dce the unreachable function is kept and dce does not report."""
+        batch = transpile_batch(SOURCES, passes=["no-dce"])
+        result = batch.result("app.cpp")
+        code = batch.text("app.c")
+
+        assert "dce" not in [entry["name"] for entry in result.metrics["passes"]]
+        assert "uint8_t unused(uint8_t x)" in code
+
+    def test_no_optimization_is_o0(self, transpile_batch):
+        """enable_optimization=False runs no pass."""
+        batch = transpile_batch(SOURCES, enable_optimization=False)
+        result = batch.result("app.cpp")
+
+        assert result.metrics == {"opt_level": "O0", "passes": []}
@@ -0,0 +1,113 @@
+"""Tests for program-memory placement of const data."""
+
+from xc8plusplus.transpilers.progmem import (
+    is_const_object,
+    program_memory_read,
+    program_memory_words,
+    static_const_locals,
+    without_const,
+)
+from xc8plusplus.transpilers.stackdepth import device_family
+
+FONT_CPP = """#include <stdint.h>
+class Font {
+public:
+    static const uint8_t WIDTH = 5;
+    uint8_t glyph(uint8_t index) const;
+};
+uint8_t Font::glyph(uint8_t index) const {
+    const uint8_t columns[3] = {0x1F, 0x11, 0x1F};
+    return columns[index % 3] + WIDTH;
+}
+const uint8_t table[3] = {1, 2, 3};
+const uint16_t LIMIT = 400;
+Font font;
+Font bold;
+int main() {
+    uint8_t total = font.glyph(table[0]) + Font::WIDTH;
+    while (total < LIMIT) {
+        total++;
+    }
+    return 0;
+}
+"""
+
+
+FONT_AST = (
+    "|-CXXRecordDecl <{src}/font.cpp:2:1, line:6:1> line:2:7 class Font definition\n"
+    "| |-CXXRecordDecl <col:1, col:7> col:7 implicit class Font\n"
+    "| |-AccessSpecDecl <line:3:1, col:7> col:1 public\n"
+    "| |-VarDecl <line:4:5, col:38> col:26 used WIDTH 'const uint8_t':'const unsigned char' static cinit\n"
+    "| `-CXXMethodDecl <line:5:5, col:38> col:13 used glyph 'uint8_t (uint8_t) const'\n"
+    "|   `-ParmVarDecl <col:19, col:27> col:27 index 'uint8_t':'unsigned char'\n"
+    "|-VarDecl <line:11:1, col:37> col:15 used table 'const uint8_t[3]' cinit\n"
+    "|-VarDecl <line:12:1, col:23> col:16 used LIMIT 'const uint16_t':'const unsigned short' cinit\n"
+    "|-VarDecl <line:13:1, col:6> col:6 used font 'Font' callinit\n"
+    "|-VarDecl <line:14:1, col:6> col:6 bold 'Font' callinit\n"
+    "`-FunctionDecl <line:15:1, line:21:1> line:15:5 main 'int ()'\n"
+)
+
+
+SOURCES = {"font.cpp": (FONT_CPP, FONT_AST)}
+
+
+class TestConstQualifiers:
+    """Test cases for the const helpers."""
+
+    def test_const_objects(self):
+        """Only objects that are themselves const qualify."""
+        assert is_const_object("const uint8_t [4]")
+        assert is_const_object("const Led")
+        assert is_const_object("char * const")
+        assert not is_const_object("const char *")
+        assert without_const("const uint8_t [4]") == "uint8_t [4]"
+        assert without_const("const char * const") == "const char *"
+
+    def test_static_const_locals(self):
+        """Const local tables with a constant initializer become static."""
+        code = static_const_locals(
+            "const uint8_t lut[2] = {1, 2};\nconst uint8_t copy[1] = {value};\n",
+            lambda initializer: "value" not in initializer,
+        )
+
+        assert "static const uint8_t lut[2] = {1, 2};" in code
+        assert "\nconst uint8_t copy[1] = {value};" in code
+
+    def test_device_families(self):
+        """How const data is read back depends on the device family."""
+        assert device_family("PIC16F876A") == "midrange"
+        assert device_family("PIC16F1619") == "enhanced"
+        assert device_family("PIC18F4550") == "pic18"
+        assert program_memory_read("PIC16F876A") == "RETLW tables"
+        assert program_memory_words(5, "PIC18F4550") == 3
+        assert program_memory_words(5, "PIC16F876A") == 5
+
+
+class TestProgramMemoryData:
+    """Test cases for const data in the generated C."""
+
+    def test_const_table_keeps_its_qualifier(self, transpile_batch):
+        """A const table is defined const so XC8 places it in program memory."""
+        batch = transpile_batch(SOURCES)
+        code = batch.text()
+
+        assert "const uint8_t table[3] = {1, 2, 3};" in code
+        assert batch.transpiler.program_memory_data == {"table": 3}
+
+    def test_integral_constants_become_defines(self, transpile_batch):
+        """Static const members and const scalars take no memory."""
+        batch = transpile_batch(SOURCES)
+        code = batch.text()
+
+        assert "#define WIDTH 5\n" in code
+        assert "#define LIMIT 400\n" in code
+        assert "uint16_t LIMIT" not in code
+        assert "+ WIDTH" in code and "Font::" not in code
+
+    def test_const_methods_take_const_self(self, transpile_batch):
+        """Const methods receive a pointer to const, local tables are static."""
+        batch = transpile_batch(SOURCES)
+        code = batch.text()
+
+        assert "uint8_t Font_glyph(const Font* self, uint8_t index) {" in code
+        assert "static const uint8_t columns[3] = {0x1F, 0x11, 0x1F};" in code
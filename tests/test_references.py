@@ -0,0 +1,141 @@
+"""Tests for the lowering of reference parameters to pointers."""
+
+from xc8plusplus.transpilers.references import (
+    address_of,
+    dereference_parameters,
+    pass_addresses,
+)
+
+ACC_CPP = """#include <stdint.h>
+struct Point {
+    int16_t x;
+    int16_t y;
+};
+class Acc {
+    int16_t total;
+public:
+    void add(const Point& p) { total += p.x; }
+    void swapInto(int16_t& out) { out = total; }
+};
+Acc acc;
+Point pt = {1, 2};
+void addTwice(const Point& p) {
+    acc.add(p);
+    acc.add(p);
+}
+int main() {
+    int16_t v = 0;
+    acc.add(pt);
+    addTwice(pt);
+    acc.swapInto(v);
+    return v;
+}
+"""
+
+ACC_AST = (
+    "|-CXXRecordDecl <{src}/acc.cpp:2:1, line:5:1> line:2:8 referenced struct Point definition\n"
+    "| |-FieldDecl <line:3:5, col:13> col:13 referenced x 'int16_t':'short'\n"
+    "| `-FieldDecl <line:4:5, col:13> col:13 y 'int16_t':'short'\n"
+    "|-CXXRecordDecl <line:6:1, line:11:1> line:6:7 class Acc definition\n"
+    "| |-FieldDecl <line:7:5, col:13> col:13 referenced total 'int16_t':'short'\n"
+    "| |-CXXMethodDecl <line:9:5, col:47> col:10 used add 'void (const Point &)'\n"
+    "| | `-ParmVarDecl <col:14, col:27> col:27 used p 'const Point &'\n"
+    "| `-CXXMethodDecl <line:10:5, col:49> col:10 used swapInto 'void (int16_t &)'\n"
+    "|   `-ParmVarDecl <col:19, col:28> col:28 used out 'int16_t &':'short &'\n"
+    "|-VarDecl <line:12:1, col:5> col:5 used acc 'Acc' callinit\n"
+    "|-VarDecl <line:13:1, col:18> col:7 used pt 'Point' cinit\n"
+    "|-FunctionDecl <line:14:1, line:17:1> line:14:6 used addTwice 'void (const Point &)'\n"
+    "| `-ParmVarDecl <col:15, col:28> col:28 used p 'const Point &'\n"
+    "`-FunctionDecl <line:18:1, line:24:1> line:18:5 main 'int ()'\n"
+)
+
+SOURCES = {"acc.cpp": (ACC_CPP, ACC_AST)}
+
+SUM_CPP = """#include <stdint.h>
+uint8_t table[4] = {1, 2, 3, 4};
+uint8_t sum(const uint8_t (&values)[4]) {
+    uint8_t total = 0;
+    for (uint8_t i = 0; i < 4; i++) total += values[i];
+    return total;
+}
+int main() {
+    return sum(table);
+}
+"""
+
+SUM_AST = (
+    "|-VarDecl <{src}/sum.cpp:2:1, col:32> col:9 used table 'uint8_t[4]':'unsigned char[4]' cinit\n"
+    "|-FunctionDecl <line:3:1, line:7:1> line:3:9 used sum 'uint8_t (const uint8_t (&)[4])'\n"
+    "| `-ParmVarDecl <col:13, col:39> col:29 used values "
+    "'const uint8_t (&)[4]':'const unsigned char (&)[4]'\n"
+    "`-FunctionDecl <line:8:1, line:10:1> line:8:5 main 'int ()'\n"
+)
+
+
+class TestReferenceLowering:
+    """Test cases for the rewriting of bodies and calls."""
+
+    def test_dereference_parameters(self):
+        """Uses go through the pointer; members of other objects are left alone."""
+        body = "out = p.x + other.p;\nsum(p, &out);\nif (p.y > out) return;"
+
+        assert dereference_parameters(body, ["p", "out"]) == (
+            "(*out) = p->x + other.p;\nsum((*p), &(*out));\nif (p->y > (*out)) return;"
+        )
+        assert dereference_parameters(body, []) == body
+
+    def test_address_of(self):
+        """Objects by address, pointers as is, values as compound literals."""
+        def is_constant(expr):
+            return expr.isdigit() or expr == "LED_COUNT"
+
+        assert address_of("v", "int16_t", is_constant) == "&v"
+        assert address_of("self->points[i]", "Point", is_constant) == "&self->points[i]"
+        assert address_of("(*p)", "const Point", is_constant) == "p"
+        assert address_of("5", "const int16_t", is_constant) == "&(const int16_t){5}"
+        assert address_of("LED_COUNT", "const uint8_t", is_constant) == (
+            "&(const uint8_t){LED_COUNT}"
+        )
+        assert address_of("v + 1", "const int16_t", is_constant) == "&(const int16_t){v + 1}"
+
+    def test_pass_addresses(self):
+        """Only the reference arguments of the listed functions change."""
+        code = pass_addresses(
+            "Acc_swapInto(&acc, v); report(v);", {"Acc_swapInto": {1: "int16_t"}}, str.isdigit
+        )
+
+        assert code == "Acc_swapInto(&acc, &v); report(v);"
+
+
+class TestGeneratedReferences:
+    """Test cases for transpiled programs taking references."""
+
+    def test_reference_parameters(self, transpile_batch):
+        """Bodies dereference, callers pass addresses, the struct is emitted."""
+        code = transpile_batch(SOURCES, amalgamate=True).text("firmware.c")
+
+        assert "typedef struct Point {\n    int16_t x;\n    int16_t y;\n} Point;" in code
+        assert "static Point pt = {1, 2};" in code
+        assert "void Acc_add(const Point *p) {\n    acc.total += p->x;" in code
+        assert "(*out) = acc.total;" in code
+        assert "Acc_add(&pt);" in code
+        assert "addTwice(&pt);" in code
+        assert "Acc_swapInto(&v);" in code
+        # A reference passed on is the pointer itself
+        assert "Acc_add(p);" in code
+
+    def test_array_reference(self, transpile_batch):
+        """A reference to an array is a pointer to its element, passed the array."""
+        code = transpile_batch({"sum.cpp": (SUM_CPP, SUM_AST)}, amalgamate=True).text()
+
+        assert "uint8_t sum(const uint8_t *values) {" in code
+        assert "total += values[i];" in code
+        assert "return sum(table);" in code
+
+    def test_without_optimization(self, transpile_batch):
+        """Methods keep their self pointer before the reference."""
+        code = transpile_batch(SOURCES, amalgamate=True, opt_level="0").text("firmware.c")
+
+        assert "static void Acc_swapInto(Acc* self, int16_t *out) {" in code
+        assert "Acc_add(&acc, &pt);" in code
+        assert "Acc_swapInto(&acc, &v);" in code
@@ -0,0 +1,102 @@
+"""Tests for self pointer elimination in singleton classes."""
+
+from xc8plusplus.transpilers.singletons import bind_instance, drop_instance_argument
+
+BOARD_CPP = """#include <stdint.h>
+class Timer {
+    uint8_t ticks;
+public:
+    void tick();
+    uint8_t get();
+};
+void Timer::tick() {
+    ticks++;
+}
+uint8_t Timer::get() {
+    return ticks;
+}
+class Led {
+    bool on;
+public:
+    void toggle();
+};
+void Led::toggle() {
+    on = !on;
+}
+Timer timer;
+Led red;
+Led green;
+int main() {
+    while (timer.get() < 10) {
+        timer.tick();
+        red.toggle();
+        green.toggle();
+    }
+    return 0;
+}
+"""
+
+
+BOARD_AST = (
+    "|-CXXRecordDecl <{src}/board.cpp:2:1, line:7:1> line:2:7 class Timer definition\n"
+    "| |-FieldDecl <line:3:5, col:13> col:13 referenced ticks 'uint8_t':'unsigned char'\n"
+    "| |-CXXMethodDecl <line:5:5, col:15> col:10 used tick 'void ()'\n"
+    "| `-CXXMethodDecl <line:6:5, col:17> col:13 used get 'uint8_t ()'\n"
+    "|-CXXRecordDecl <line:14:1, line:18:1> line:14:7 class Led definition\n"
+    "| |-FieldDecl <line:15:5, col:10> col:10 referenced on 'bool'\n"
+    "| `-CXXMethodDecl <line:17:5, col:17> col:10 used toggle 'void ()'\n"
+    "|-VarDecl <line:22:1, col:7> col:7 used timer 'Timer' callinit\n"
+    "|-VarDecl <line:23:1, col:5> col:5 used red 'Led' callinit\n"
+    "|-VarDecl <line:24:1, col:5> col:5 used green 'Led' callinit\n"
+)
+
+
+def _sources(source_code=BOARD_CPP, extra_ast=""):
+    ast = BOARD_AST + extra_ast + "`-FunctionDecl <line:25:1, line:32:1> line:25:5 main 'int ()'\n"
+    return {"board.cpp": (source_code, ast)}
+
+
+class TestInstanceRewriting:
+    """Test cases for the call and body rewriting."""
+
+    def test_calls_lose_the_instance(self):
+        """The first argument goes, nested calls included."""
+        code = drop_instance_argument(
+            "Timer_wait(&timer, Timer_get(&timer) + 1);\nLed_toggle(&red);",
+            {"Timer_wait", "Timer_get"},
+        )
+
+        assert code == "Timer_wait(Timer_get() + 1);\nLed_toggle(&red);"
+
+    def test_self_becomes_the_instance(self):
+        """Member accesses and self itself refer to the global."""
+        code = bind_instance("self->ticks++;\nwatch(self);\nother.self = 1;", "timer")
+
+        assert code == "timer.ticks++;\nwatch(&timer);\nother.self = 1;"
+
+
+class TestSingletonClasses:
+    """Test cases for singleton detection in the generated C."""
+
+    def test_single_instance_methods_take_no_self(self, transpile_batch):
+        """Timer has one instance; Led has two and keeps its self pointer."""
+        batch = transpile_batch(_sources())
+        transpiler, code = batch.transpiler, batch.text()
+
+        assert transpiler.singletons == {"Timer": "timer"}
+        assert "void Timer_tick(void) {\n    timer.ticks++;" in code
+        assert "while (Timer_get() < 10)" in code
+        assert "Led_toggle(Led* self)" in code
+        assert "Led_toggle(&red);" in code
+
+    def test_escaping_instance_keeps_self(self, transpile_batch):
+        """Taking the address of the instance disqualifies the class."""
+        source_code = BOARD_CPP.replace("Led green;\n", "Led green;\nTimer* active = &timer;\n")
+
+        batch = transpile_batch(_sources(
+            source_code, "|-VarDecl <line:25:1, col:24> col:8 active 'Timer *' cinit\n"
+        ))
+        transpiler, code = batch.transpiler, batch.text()
+
+        assert transpiler.singletons == {}
+        assert "void Timer_tick(Timer* self)" in code
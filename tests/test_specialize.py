@@ -0,0 +1,157 @@
+"""Tests for method specialization on constant-configured objects."""
+
+from xc8plusplus.transpilers.inliner import InlineCostModel
+from xc8plusplus.transpilers.specialize import (
+    clone_suffix,
+    fold_constant_switches,
+    rename_calls,
+    substitute_field,
+)
+
+CONSTANTS = {"Pin_A": "Pin_A", "Pin_B": "Pin_B", "Pin::A": "Pin_A", "Pin::B": "Pin_B", "2": "2"}
+
+LEDS_CPP = """#include <xc.h>
+enum class Pin { A, B };
+class Led {
+    Pin pin;
+    bool on;
+public:
+    Led(Pin p);
+    void set();
+    void flash();
+};
+Led::Led(Pin p) : pin(p), on(false) {
+}
+void Led::set() {
+    on = true;
+    switch (pin) {
+        case Pin::A:
+            RA0 = 1;
+            break;
+        case Pin::B:
+            RB0 = 1;
+            break;
+    }
+}
+void Led::flash() {
+    for (int i = 0; i < 10; i++) {
+        set();
+        on = false;
+        __delay_ms(100);
+        on = true;
+        __delay_ms(100);
+        on = false;
+        __delay_ms(100);
+    }
+}
+Led red(Pin::A);
+Led green(Pin::B);
+int main() {
+    red.set();
+    green.flash();
+    return 0;
+}
+"""
+
+
+LEDS_AST = (
+    "|-EnumDecl <{src}/leds.cpp:2:1, col:25> col:12 referenced class Pin 'int'\n"
+    "| |-EnumConstantDecl <col:18> col:18 referenced A 'Pin'\n"
+    "| `-EnumConstantDecl <col:21> col:21 referenced B 'Pin'\n"
+    "|-CXXRecordDecl <line:3:1, line:10:1> line:3:7 class Led definition\n"
+    "| |-FieldDecl <line:4:5, col:9> col:9 referenced pin 'Pin'\n"
+    "| |-FieldDecl <line:5:5, col:10> col:10 referenced on 'bool'\n"
+    "| |-CXXMethodDecl <line:8:5, col:14> col:10 used set 'void ()'\n"
+    "| `-CXXMethodDecl <line:9:5, col:16> col:10 used flash 'void ()'\n"
+    "|-VarDecl <line:47:1, col:15> col:5 used red 'Led' callinit\n"
+    "|-VarDecl <line:48:1, col:17> col:5 used green 'Led' callinit\n"
+    "`-FunctionDecl <line:49:1, line:53:1> line:49:5 main 'int ()'\n"
+)
+
+
+SIZE = InlineCostModel(goal="size")
+
+
+class TestSwitchFolding:
+    """Test cases for the body rewriting helpers."""
+
+    def test_switch_reduces_to_the_selected_case(self):
+        """The matching case runs up to its break, labels and braces go."""
+        body = (
+            "on = true;\n"
+            "switch (Pin::B) {\n"
+            "    case Pin::A:\n"
+            "        RA0 = 1;\n"
+            "        break;\n"
+            "    case Pin::B:\n"
+            "        RB0 = 1;\n"
+            "        break;\n"
+            "}\n"
+        )
+
+        assert fold_constant_switches(body, CONSTANTS.get) == "on = true;\nRB0 = 1;\n"
+
+    def test_fallthrough_and_default(self):
+        """Fallthrough continues to the next case; no match takes default."""
+        body = "switch (2) {\ncase Pin::A: a(); break;\ndefault: b();\ncase Pin::B: c(); return;\n}"
+
+        assert fold_constant_switches(body, CONSTANTS.get) == "b();\nc(); return;"
+
+    def test_unknown_switches_stay(self):
+        """Non-constant switches and cases leaving early through a nested break remain."""
+        dynamic = "switch (mode) {\ncase Pin::A: a(); break;\n}"
+        nested = "switch (Pin::A) {\ncase Pin::A: if (x) break; a(); break;\n}"
+
+        assert fold_constant_switches(dynamic, CONSTANTS.get) == dynamic
+        assert fold_constant_switches(nested, CONSTANTS.get) == nested
+
+    def test_fields_and_self_calls(self):
+        """Field reads become the value; calls on the same object the clones."""
+        body = "if (this->pin == Pin::A) set();\nother.set();\nx = pin;"
+
+        body = rename_calls(substitute_field(body, "pin", "Pin_B"), {"set": "set__B"})
+
+        assert body == "if (Pin_B == Pin::A) set__B();\nother.set();\nx = Pin_B;"
+        assert clone_suffix(["Pin_B", "-1"], ["Pin"]) == "B_m1"
+
+
+class TestSpecialization:
+    """Test cases for the method clones in the generated C."""
+
+    def test_constant_instances_call_folded_clones(self, transpile_batch):
+        """Each Led calls a clone writing its own pin; the original goes."""
+        batch = transpile_batch({"leds.cpp": (LEDS_CPP, LEDS_AST)}, inline_model=SIZE)
+        transpiler, code = batch.transpiler, batch.text()
+
+        assert transpiler.specializations["Led_set"] == {
+            "red": "Led_set__A",
+            "green": "Led_set__B",
+        }
+        assert "Led_set__A(&red);" in code
+        assert "Led_flash__B(&green);" in code
+        assert "Led_set__B(self);" in code
+        assert "switch" not in code
+        assert "Led_set(Led* self)" not in code
+
+    def test_size_goal_rejects_growing_clones(self, transpile_batch):
+        """Two copies of flash cost more than the switch they fold."""
+        source_code = LEDS_CPP.replace("    red.set();\n", "    red.flash();\n")
+
+        batch = transpile_batch({"leds.cpp": (source_code, LEDS_AST)}, inline_model=SIZE)
+        transpiler, code = batch.transpiler, batch.text()
+
+        assert transpiler.specializations == {}
+        assert "Led_flash(&red);" in code
+        assert "switch (self->pin)" in code
+
+    def test_speed_goal_takes_any_folding(self, transpile_batch):
+        """With the speed goal a shrinking clone is enough."""
+        source_code = LEDS_CPP.replace("    red.set();\n", "    red.flash();\n")
+
+        batch = transpile_batch(
+            {"leds.cpp": (source_code, LEDS_AST)}, inline_model=InlineCostModel(goal="speed")
+        )
+        code = batch.text()
+
+        assert "Led_flash__A(&red);" in code
+        assert "switch" not in code
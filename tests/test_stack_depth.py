@@ -0,0 +1,185 @@
+"""Tests for the hardware stack depth analysis."""
+
+import pytest
+
+from xc8plusplus.transpilers.callgraph import CallGraph
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+from xc8plusplus.transpilers.stackdepth import (
+    RUNTIME_HELPER,
+    analyze_stack,
+    calls_arithmetic_helper,
+    device_stack_levels,
+)
+
+COUNTER_HPP = """class Counter {
+    int value;
+public:
+    void step();
+    void countDown();
+};
+"""
+
+COUNTER_CPP = """#include "counter.hpp"
+void Counter::step() {
+    value = value - 1;
+    countDown();
+}
+void Counter::countDown() {
+    if (value > 0) {
+        step();
+    }
+}
+"""
+
+MAIN_CPP = """#include "counter.hpp"
+Counter counter;
+int main() {
+    counter.countDown();
+    return 0;
+}
+"""
+
+
+COUNTER_AST = (
+    "|-CXXRecordDecl <{src}/counter.hpp:1:1, line:6:1> line:1:7 class Counter definition\n"
+    "| |-FieldDecl <line:2:5, col:9> col:9 referenced value 'int'\n"
+    "| |-CXXMethodDecl <line:4:5, col:15> col:10 step 'void ()'\n"
+    "| `-CXXMethodDecl <line:5:5, col:20> col:10 countDown 'void ()'\n"
+)
+
+SCALE_CPP = """#include <stdint.h>
+uint16_t scale(uint16_t raw) {
+    return raw / 10;
+}
+int main() {
+    return scale(500);
+}
+"""
+
+SCALE_AST = (
+    "|-FunctionDecl <{src}/scale.cpp:2:1, line:4:1> line:2:10 used scale "
+    "'uint16_t (uint16_t)':'unsigned short (unsigned short)'\n"
+    "| `-ParmVarDecl <col:16, col:25> col:25 used raw 'uint16_t':'unsigned short'\n"
+    "`-FunctionDecl <line:5:1, line:7:1> line:5:5 main 'int ()'\n"
+)
+
+SOURCES = {
+    "main.cpp": (
+        MAIN_CPP,
+        COUNTER_AST
+        + "|-VarDecl <{src}/main.cpp:2:1, col:9> col:9 used counter 'Counter' callinit\n"
+        "`-FunctionDecl <line:3:1, line:6:1> line:3:5 main 'int ()'\n",
+    ),
+    "counter.cpp": (COUNTER_CPP, COUNTER_AST),
+    "counter.hpp": (COUNTER_HPP, COUNTER_AST),
+}
+
+
+class TestStackAnalysis:
+    """Test cases for call depth, interrupt levels and recursion."""
+
+    def test_device_stack_levels(self):
+        """Stack levels follow the device family."""
+        assert device_stack_levels("PIC16F876A") == 8
+        assert device_stack_levels("PIC16F1829") == 16
+        assert device_stack_levels("PIC18F4550") == 31
+        assert device_stack_levels("PIC12F508") == 2
+
+    def test_deepest_paths_and_interrupt_level(self):
+        """Each root reports its deepest chain; an ISR adds its entry level."""
+        graph = CallGraph(
+            {
+                "main": "loop();",
+                "loop": "Led_toggle(&led); Led_isOn(&led);",
+                "Led_toggle": "Led_turnOn(self);",
+                "Led_turnOn": "",
+                "Led_isOn": "",
+                "isr": "Timer_tick(&timer);",
+                "Timer_tick": "",
+            }
+        )
+
+        report = analyze_stack(graph, "main", ["isr"], "PIC16F876A")
+
+        main_path, isr_path = report.paths
+        assert main_path.path == ["main", "loop", "Led_toggle", "Led_turnOn"]
+        assert main_path.depth == 3
+        assert isr_path.depth == 2
+        assert report.worst_case == 5
+        assert report.problems() == []
+
+    def test_overflow_and_inlined_calls(self):
+        """Exceeding the budget is reported; inlined calls cost no level."""
+        graph = CallGraph({"main": "a();", "a": "b();", "b": "c();", "c": ""})
+
+        assert analyze_stack(graph, "main", [], "PIC16F876A", budget=2).problems()
+        report = analyze_stack(graph, "main", [], "PIC16F876A", budget=2, free_calls={"c"})
+        assert report.worst_case == 2
+        assert report.problems() == []
+
+    def test_arithmetic_helpers(self):
+        """Multi-byte *, / and % call a library routine; bytes, shifts and constants do not."""
+        widths = {"ticks": 2, "count": 1}
+
+        assert calls_arithmetic_helper("void f(unsigned int ms) { n = ms / 50; }", widths)
+        assert calls_arithmetic_helper("void f(void) { self->ticks %= 10; }", widths)
+        assert calls_arithmetic_helper("void f(void) { x = (a + b) * c; }", widths)
+        assert not calls_arithmetic_helper("void f(uint8_t a) { x = a * count; }", widths)
+        assert not calls_arithmetic_helper("void f(void) { x = ticks / 8 + 4 * ticks; }", widths)
+        assert not calls_arithmetic_helper("void f(void) { x = 10 * 1000; }", widths)
+        assert not calls_arithmetic_helper(
+            "void f(Led *p, uint8_t *q) { return *q; }", widths, type_names=["Led"]
+        )
+
+    def test_helper_takes_a_level(self):
+        """A function calling a library routine is one level deeper."""
+        graph = CallGraph({"main": "a();", "a": "b();", "b": ""})
+
+        report = analyze_stack(graph, "main", [], "PIC16F876A", helper_callers={"b"})
+
+        assert report.paths[0].path == ["main", "a", "b", RUNTIME_HELPER]
+        assert report.worst_case == 3
+        assert "arithmetic library calls (one level): b" in report.format()
+
+    def test_recursion_is_detected(self):
+        """A call cycle reachable from main is reported."""
+        graph = CallGraph({"main": "a();", "a": "b();", "b": "a();"})
+
+        report = analyze_stack(graph, "main", [], "PIC16F876A")
+
+        assert report.recursion == [["a", "b", "a"]]
+        assert "recursion" in report.problems()[0]
+
+
+class TestStackCheck:
+    """Test cases for the stack check of a transpilation."""
+
+    def test_recursion_warns_by_default(self, transpile_batch):
+        """The default check reports recursion but still generates code."""
+        batch = transpile_batch(SOURCES)
+
+        assert batch.transpiler.stack_report.recursion
+
+    def test_recursion_fails_in_error_mode(self, transpile_batch):
+        """stack_check='error' fails every unit and writes nothing."""
+        batch = transpile_batch(SOURCES, check=False, stack_check="error")
+
+        assert not any(result.success for result in batch.results.values())
+        assert "recursion" in batch.result("main.cpp").error_message
+        assert not (batch.out / "counter.c").exists()
+
+    def test_division_counts_on_pic16_only(self, transpile_batch):
+        """PIC18 divides without a deeper call chain; PIC16 calls a routine."""
+        sources = {"scale.cpp": (SCALE_CPP, SCALE_AST)}
+
+        pic16 = transpile_batch(sources, target_device="PIC16F876A").transpiler
+        pic18 = transpile_batch(sources, target_device="PIC18F4550").transpiler
+
+        assert pic16.stack_report.worst_case == 2
+        assert pic16.stack_report.helper_callers == ["scale"]
+        assert pic18.stack_report.worst_case == 1
+
+    def test_invalid_stack_check(self):
+        """Only 'warn', 'error' and 'off' are accepted."""
+        with pytest.raises(ValueError):
+            PythonTranspiler(stack_check="ignore")
@@ -0,0 +1,70 @@
+"""Tests for CLI startup cost."""
+
+import os
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+SRC_DIR = str(Path(__file__).resolve().parent.parent / "src")
+
+# Budget for `xc8plusplus version` on top of a bare interpreter start
+STARTUP_BUDGET_MS = float(os.environ.get("XC8PLUSPLUS_STARTUP_BUDGET_MS", "100"))
+
+
+def _env():
+    env = dict(os.environ)
+    env["PYTHONPATH"] = SRC_DIR + os.pathsep + env.get("PYTHONPATH", "")
+    return env
+
+
+def _best_time(args, runs=5):
+    """Best wall-clock time of several runs, in milliseconds"""
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(args, env=_env(), check=True, capture_output=True)
+        elapsed = (time.perf_counter() - start) * 1000
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+class TestStartup:
+    """Test cases for lazy imports and the version fast path."""
+
+    def test_cli_import_is_lazy(self):
+        """Importing the CLI does not load rich, asyncio or the backends."""
+        code = (
+            "import sys, xc8plusplus.cli\n"
+            "heavy = ['rich.console', 'asyncio', 'ctypes',\n"
+            "         'xc8plusplus.transpilers.python_backend',\n"
+            "         'xc8plusplus.transpilers.native_backend']\n"
+            "print(','.join(m for m in heavy if m in sys.modules))\n"
+        )
+        result = subprocess.run(
+            [sys.executable, "-c", code], env=_env(), capture_output=True, text=True
+        )
+
+        assert result.returncode == 0, result.stderr
+        assert result.stdout.strip() == ""
+
+    def test_version_fast_path(self):
+        """The version query matches the Typer command output."""
+        from xc8plusplus import __version__
+
+        result = subprocess.run(
+            [sys.executable, "-m", "xc8plusplus", "version"],
+            env=_env(),
+            capture_output=True,
+            text=True,
+        )
+
+        assert result.returncode == 0
+        assert result.stdout.startswith(f"xc8plusplus version {__version__}")
+
+    def test_version_startup_budget(self):
+        """`xc8plusplus version` stays within the startup budget."""
+        baseline = _best_time([sys.executable, "-c", "pass"])
+        elapsed = _best_time([sys.executable, "-m", "xc8plusplus", "version"])
+
+        assert elapsed - baseline < STARTUP_BUDGET_MS
@@ -0,0 +1,145 @@
+"""Tests for the compile-time evaluation of global constructors."""
+
+from xc8plusplus.transpilers.staticinit import (
+    find_constructors,
+    is_constant_expression,
+    order_by_dependency,
+    split_statements,
+)
+
+LAMP_HPP = """#include <stdint.h>
+enum class Channel { A, B };
+class Lamp {
+    Channel channel;
+    bool lit;
+    uint8_t level;
+public:
+    Lamp(Channel c, uint8_t l = 3);
+    void on();
+    uint8_t getLevel();
+};
+"""
+
+LAMP_CPP = """#include "lamp.hpp"
+Lamp::Lamp(Channel c, uint8_t l) : channel(c), lit(false) {
+    // Levels are set before the lamp is lit
+    level = l;
+    on();
+}
+void Lamp::on() {
+    lit = true;
+}
+uint8_t Lamp::getLevel() {
+    return level;
+}
+Lamp porch(Channel::B, 7);
+Lamp hall(Channel::A);
+"""
+
+APP_CPP = """#include "lamp.hpp"
+extern Lamp porch;
+uint8_t brightness = porch.getLevel();
+uint8_t limit = 2 * 5;
+int main() {
+    while (brightness < limit) {
+    }
+    return 0;
+}
+"""
+
+
+LAMP_AST = (
+    "|-EnumDecl <{src}/lamp.hpp:2:1, col:27> col:12 referenced class Channel 'int'\n"
+    "| |-EnumConstantDecl <col:22> col:22 referenced A 'Channel'\n"
+    "| `-EnumConstantDecl <col:25> col:25 referenced B 'Channel'\n"
+    "|-CXXRecordDecl <line:3:1, line:11:1> line:3:7 class Lamp definition\n"
+    "| |-FieldDecl <line:4:5, col:13> col:13 referenced channel 'Channel'\n"
+    "| |-FieldDecl <line:5:5, col:10> col:10 referenced lit 'bool'\n"
+    "| |-FieldDecl <line:6:5, col:13> col:13 referenced level 'uint8_t':'unsigned char'\n"
+    "| |-CXXMethodDecl <line:9:5, col:13> col:10 on 'void ()'\n"
+    "| `-CXXMethodDecl <line:10:5, col:22> col:13 getLevel 'uint8_t ()':'unsigned char ()'\n"
+)
+
+SOURCES = {
+    "app.cpp": (
+        APP_CPP,
+        LAMP_AST
+        + "|-VarDecl <{src}/app.cpp:2:1, col:13> col:13 used porch 'Lamp' extern\n"
+        "|-VarDecl <line:3:1, col:36> col:9 used brightness 'uint8_t':'unsigned char' cinit\n"
+        "|-VarDecl <line:4:1, col:23> col:9 used limit 'uint8_t':'unsigned char' cinit\n"
+        "`-FunctionDecl <line:5:1, line:9:1> line:5:5 main 'int ()'\n",
+    ),
+    "lamp.cpp": (
+        LAMP_CPP,
+        LAMP_AST
+        + "|-VarDecl <{src}/lamp.cpp:13:1, col:25> col:6 used porch 'Lamp' callinit\n"
+        "`-VarDecl <line:14:1, col:21> col:6 hall 'Lamp' callinit\n",
+    ),
+    "lamp.hpp": (LAMP_HPP, LAMP_AST),
+}
+
+
+class TestConstructorEvaluation:
+    """Test cases for the constructor parsing and constant checks."""
+
+    def test_out_of_class_and_in_class_constructors(self):
+        """Parameters, defaults, member initializers and body are found."""
+        source = (
+            "Lamp::Lamp(Channel c, uint8_t l = 3) : channel(c), lit{false} { on(); }\n"
+            "class Box {\n    Box() : size(2) {}\n};\n"
+        )
+
+        lamp = find_constructors(source, "Lamp")[0]
+        box = find_constructors(source, "Box")[0]
+
+        assert lamp.params == [("c", None), ("l", "3")]
+        assert lamp.initializers == {"channel": "c", "lit": "false"}
+        assert lamp.body == "on();"
+        assert lamp.accepts(1) and not lamp.accepts(0)
+        assert box.initializers == {"size": "2"}
+
+    def test_constant_expressions(self):
+        """Literals, constants and addresses of globals are constant."""
+        assert is_constant_expression("2 * (5 + 1)")
+        assert is_constant_expression("Channel_B", {"Channel_B"})
+        assert is_constant_expression("&porch", addresses={"porch"})
+        assert is_constant_expression("{1, 2, 3}")
+        assert not is_constant_expression("porch", addresses={"porch"})
+        assert not is_constant_expression("readLevel()")
+
+    def test_statements_and_dependencies(self):
+        """Compound statements stay whole; dependencies come first."""
+        assert split_statements("a = 1; if (a) { b(); } else { c(); } d();") == [
+            "a = 1;", "if (a) { b(); } else { c(); }", "d();",
+        ]
+        assert order_by_dependency(["panel", "lamp", "fan"], {"panel": {"lamp"}}) == [
+            "lamp", "panel", "fan",
+        ]
+
+
+class TestStaticInitialization:
+    """Test cases for the generated global definitions."""
+
+    def test_constant_effects_become_initializers(self, transpile_batch):
+        """Member initializers and leading constant stores are folded."""
+        batch = transpile_batch(SOURCES)
+
+        lamp = batch.text("lamp.c")
+        assert "Lamp porch = {Channel_B, false, 7};" in lamp
+        assert "Lamp hall = {Channel_A, false, 3};" in lamp
+        assert "uint8_t limit = 2 * 5;" in batch.text("app.c")
+        assert "extern Lamp porch;" in batch.text("shared_definitions.h")
+
+    def test_dynamic_effects_run_before_main(self, transpile_batch):
+        """Calls and non-constant values run from global_constructors()."""
+        batch = transpile_batch(SOURCES)
+
+        # app.cpp is parsed before lamp.cpp, but brightness reads porch
+        main = batch.text("app.c")
+        assert "uint8_t brightness;" in main
+        assert [name for name, _ in batch.transpiler.global_constructors] == [
+            "porch", "brightness", "hall",
+        ]
+        assert "    Lamp_on(&porch);\n" in main
+        assert "    brightness = Lamp_getLevel(&porch);\n" in main
+        assert "int main(void) {\n    global_constructors();\n" in main
@@ -0,0 +1,165 @@
+"""Tests for the lowering of dispatch switches."""
+
+from xc8plusplus.transpilers.python_backend import PythonTranspiler
+from xc8plusplus.transpilers.switches import lower_switches, pin_definitions, resolve_pin
+
+PINS_H = """#define RELAY0 PORTBbits.RB0
+#define RELAY1 PORTBbits.RB1
+#define RELAY2 PORTCbits.RC4
+#define RELAY3 LATDbits.LATD7
+#define RELAY4 PORTBbits.RB2
+#define RELAY5 PORTBbits.RB3
+#define RELAY6 PORTCbits.RC5
+#define RELAY7 PORTCbits.RC6
+"""
+
+MODES = {"Mode_OFF": 0, "Mode_LOW": 1, "Mode_HIGH": 2, "Mode_BOOST": 3}
+
+
+def _value_of(expr):
+    expr = expr.strip()
+    if expr in MODES:
+        return MODES[expr]
+    return int(expr) if expr.lstrip("-").isdigit() else None
+
+
+def _relay_switch(value, count=8):
+    return (
+        "switch (channel) {\n"
+        + "".join(
+            f"    case {index}:\n        RELAY{index} = {value};\n        break;\n"
+            for index in range(count)
+        )
+        + "}"
+    )
+
+
+class TestPins:
+    """Test cases for the pin resolution."""
+
+    def test_macros_and_bit_names(self):
+        """Macros resolve to their port register and bit; so do RA3/LATA3."""
+        macros = pin_definitions([PINS_H])
+
+        assert resolve_pin("RELAY2", macros) == ("PORTC", 4)
+        assert resolve_pin("RELAY3", macros) == ("LATD", 7)
+        assert resolve_pin("RA3", macros) == ("PORTA", 3)
+        assert resolve_pin("counter", macros) is None
+
+
+class TestSwitchTables:
+    """Test cases for the table lookups."""
+
+    def test_pin_writes_become_port_and_mask_tables(self):
+        """Each case setting one pin becomes an indexed port OR mask."""
+        code, tables = lower_switches(_relay_switch(1), _value_of, pin_definitions([PINS_H]))
+
+        assert tables == 1
+        assert "switch (" not in code
+        assert "switch_masks[] = {0x01, 0x02, 0x10, 0x80, 0x04, 0x08, 0x20, 0x40};" in code
+        assert "{&PORTB, &PORTB, &PORTC, &LATD, &PORTB, &PORTB, &PORTC, &PORTC};" in code
+        assert "if ((unsigned)channel < 8) {" in code
+        assert "*switch_ports[channel] |= switch_masks[channel];" in code
+
+    def test_pins_of_one_port_need_no_port_table(self):
+        """Clearing pins of a single port indexes the masks only."""
+        macros = {f"RELAY{index}": f"PORTBbits.RB{index + 4}" for index in range(4)}
+
+        code, _ = lower_switches(_relay_switch(0, 4), _value_of, macros)
+
+        assert "switch_ports" not in code
+        assert "PORTB &= ~switch_masks[channel];" in code
+
+    def test_values_with_holes_and_default(self):
+        """Missing cases take the default value, which also guards the bounds."""
+        code, _ = lower_switches(
+            "switch (mode) {\n"
+            "case Mode_LOW: return 10;\ncase Mode_HIGH: return 200;\n"
+            "case Mode_BOOST: return 250;\ndefault: return 0;\n}",
+            _value_of,
+            {},
+        )
+
+        assert "static const uint8_t switch_values[] = {10, 200, 250};" in code
+        assert "if ((unsigned)(mode - 1) < 3) {" in code
+        assert "return switch_values[mode - 1];" in code
+        assert code.endswith("} else {\n        return 0;\n    }\n}")
+
+
+class TestSwitchPragmas:
+    """Test cases for the switches left to XC8."""
+
+    def test_small_switches_get_the_goal_pragma(self):
+        """Two cases do not pay for a table; the pragma follows the goal."""
+        code = "    switch (mode) {\n    case Mode_OFF: a(); break;\n    case Mode_LOW: b(); break;\n    }"
+        lowered, tables = lower_switches(code, _value_of, {})
+
+        assert tables == 0
+        assert lowered.startswith("    #pragma switch space\n    switch")
+        assert "#pragma switch speed" in lower_switches(code, _value_of, {}, goal="speed")[0]
+        assert "#pragma switch time" in lower_switches(code, _value_of, {}, interrupt=True)[0]
+        assert lower_switches(code, _value_of, {}, pragmas=False) == (code, 0)
+
+    def test_switches_on_variables_are_left_alone(self):
+        """A case label that is not constant is no dispatch."""
+        code = "switch (mode) {\ncase limit: a(); break;\n}"
+
+        assert lower_switches(code, _value_of, {}) == (code, 0)
+
+
+class TestGeneratedSwitches:
+    """Test cases for switch lowering in the generated C."""
+
+    def test_header_pins_give_a_table(self, tmp_path, canned_clang):
+        """Pin macros of an included header are resolved."""
+        (tmp_path / "pins.h").write_text(PINS_H)
+        source = tmp_path / "relays.cpp"
+        source.write_text(
+            '#include "pins.h"\n#include <stdint.h>\n'
+            "void set_relay(uint8_t channel) {\n    " + _relay_switch(1).replace("\n", "\n    ")
+            + "\n}\nint main() {\n    set_relay(2);\n    return 0;\n}\n"
+        )
+        canned_clang(
+            source,
+            f"|-FunctionDecl 0x1 <{source}:3:1, line:19:1> line:3:6 used set_relay "
+            "'void (uint8_t)'\n"
+            "| `-ParmVarDecl 0x2 <col:16, col:24> col:24 channel 'uint8_t':'unsigned char'\n"
+            "`-FunctionDecl 0x3 <line:20:1, line:23:1> line:20:5 main 'int ()'\n",
+        )
+        out = tmp_path / "out"
+        out.mkdir()
+
+        results = PythonTranspiler().transpile_batch([source], out)
+
+        assert all(result.success for result in results.values())
+        code = (out / "relays.c").read_text()
+        assert "*switch_ports[channel] |= switch_masks[channel];" in code
+
+        # The report counts the tables emitted, not the bodies lowered
+        passes = results[str(source)].metrics["passes"]
+        changes = {entry["name"]: entry["changes"] for entry in passes}
+        assert code.count("static const uint8_t switch_masks[]") == 1
+        assert changes["switch-tables"] == 1
+
+    def test_no_pragma_without_optimization(self, transpile_batch):
+        """-O0 keeps the switch as written; -Os gives it the goal pragma."""
+        source = (
+            "#include <stdint.h>\nuint8_t level;\nvoid set_mode(uint8_t mode) {\n"
+            "    switch (mode) {\n    case 0: level = 1; break;\n"
+            "    case 1: level = 7; break;\n    }\n}\n"
+            "int main() {\n    set_mode(1);\n    return 0;\n}\n"
+        )
+        ast = (
+            "|-VarDecl <{src}/mode.cpp:2:1, col:9> col:9 used level 'uint8_t':'unsigned char'\n"
+            "|-FunctionDecl <line:3:1, line:8:1> line:3:6 used set_mode 'void (uint8_t)'\n"
+            "| `-ParmVarDecl <col:15, col:23> col:23 mode 'uint8_t':'unsigned char'\n"
+            "`-FunctionDecl <line:9:1, line:12:1> line:9:5 main 'int ()'\n"
+        )
+        sources = {"mode.cpp": (source, ast)}
+
+        optimized = transpile_batch(sources, amalgamate=True).text()
+        plain = transpile_batch(sources, amalgamate=True, opt_level="0").text()
+
+        assert "#pragma switch space" in optimized
+        assert "#pragma" not in plain
+        assert "switch (mode) {" in plain
@@ -0,0 +1,303 @@
+"""Tests for virtual function lowering and devirtualization."""
+
+from xc8plusplus.transpilers.virtuals import (
+    ClassHierarchy,
+    cast_object,
+    dispatch_object,
+    pointer_class,
+    rewrite_calls,
+    tag_switch,
+)
+
+SENSORS_CPP = """#include <stdint.h>
+class Sensor {
+protected:
+    uint8_t channel;
+public:
+    Sensor(uint8_t ch) : channel(ch) {}
+    virtual uint8_t read() = 0;
+    uint8_t getChannel() const { return channel; }
+};
+class Thermistor : public Sensor {
+    uint8_t last;
+public:
+    Thermistor(uint8_t ch) : Sensor(ch), last(0) {}
+    uint8_t read() override { last = channel * 2; return last; }
+};
+class Photocell final : public Sensor {
+public:
+    Photocell(uint8_t ch) : Sensor(ch) {}
+    uint8_t read() override { return getChannel() + 1; }
+};
+Thermistor thermistor(3);
+Photocell photocell(4);
+Sensor* sensors[2] = {&thermistor, &photocell};
+uint8_t sample(Sensor* sensor) {
+    return sensor->read();
+}
+uint8_t sampleLight(Photocell* cell) {
+    return cell->read();
+}
+int main() {
+    uint8_t total = sample(sensors[0]) + sampleLight(&photocell);
+    return total + photocell.getChannel();
+}
+"""
+
+SENSORS_AST = (
+    "|-CXXRecordDecl <{src}/sensors.cpp:2:1, line:9:1> line:2:7 class Sensor definition\n"
+    "| |-FieldDecl <line:4:5, col:13> col:13 referenced channel 'uint8_t':'unsigned char'\n"
+    "| |-CXXMethodDecl <line:7:5, col:30> col:21 used read 'uint8_t ()' virtual pure\n"
+    "| `-CXXMethodDecl <line:8:5, col:50> col:13 used getChannel 'uint8_t () const'\n"
+    "|-CXXRecordDecl <line:10:1, line:15:1> line:10:7 class Thermistor definition\n"
+    "| |-public 'Sensor'\n"
+    "| |-FieldDecl <line:11:5, col:13> col:13 referenced last 'uint8_t':'unsigned char'\n"
+    "| `-CXXMethodDecl <line:14:5, col:60> col:13 used read 'uint8_t ()' virtual\n"
+    "|-CXXRecordDecl <line:16:1, line:20:1> line:16:7 class Photocell definition\n"
+    "| |-FinalAttr <col:17> final\n"
+    "| |-public 'Sensor'\n"
+    "| `-CXXMethodDecl <line:19:5, col:55> col:13 used read 'uint8_t ()' virtual\n"
+    "|-VarDecl <line:21:1, col:24> col:12 used thermistor 'Thermistor' callinit\n"
+    "|-VarDecl <line:22:1, col:22> col:11 used photocell 'Photocell' callinit\n"
+    "|-VarDecl <line:23:1, col:46> col:9 used sensors 'Sensor *[2]' cinit\n"
+    "|-FunctionDecl <line:24:1, line:26:1> line:24:9 used sample 'uint8_t (Sensor *)'\n"
+    "| `-ParmVarDecl <col:16, col:24> col:24 used sensor 'Sensor *'\n"
+    "|-FunctionDecl <line:27:1, line:29:1> line:27:9 used sampleLight 'uint8_t (Photocell *)'\n"
+    "| `-ParmVarDecl <col:21, col:32> col:32 used cell 'Photocell *'\n"
+    "`-FunctionDecl <line:30:1, line:33:1> line:30:5 main 'int ()'\n"
+)
+
+
+def _firmware(transpile_batch, source_code=SENSORS_CPP, ast=SENSORS_AST, **options):
+    batch = transpile_batch({"sensors.cpp": (source_code, ast)}, amalgamate=True, **options)
+    return batch.transpiler, batch.text("firmware.c")
+
+
+def _hierarchy():
+    return ClassHierarchy(
+        bases={"Sensor": None, "Thermistor": "Sensor", "Photocell": "Sensor", "Led": None},
+        methods={
+            "Sensor": ["read", "channel"],
+            "Thermistor": ["read"],
+            "Photocell": ["read", "lux"],
+            "Led": ["on"],
+        },
+        virtual={("Sensor", "read"), ("Photocell", "lux")},
+        pure={("Sensor", "read")},
+        final_classes={"Photocell"},
+    )
+
+
+class TestClassHierarchy:
+    """Test cases for the hierarchy queries and class hierarchy analysis."""
+
+    def test_slots_and_layout(self):
+        """Root slots first; a slot introduced below the root is added after."""
+        hierarchy = _hierarchy()
+
+        assert hierarchy.chain("Thermistor") == ["Thermistor", "Sensor"]
+        assert hierarchy.slots("Thermistor") == ["read"]
+        assert hierarchy.root_slots("Sensor") == ["read", "lux"]
+        assert hierarchy.is_abstract("Sensor")
+        assert not hierarchy.is_abstract("Thermistor")
+        assert not hierarchy.in_hierarchy("Led")
+
+    def test_resolve(self):
+        """One instantiated implementation is the target; final needs no analysis."""
+        hierarchy = _hierarchy()
+
+        assert hierarchy.resolve("Sensor", "read", {"Thermistor"}) == "Thermistor"
+        assert hierarchy.resolve("Sensor", "read", {"Thermistor", "Photocell"}) is None
+        assert hierarchy.resolve("Sensor", "channel", {"Thermistor", "Photocell"}) == "Sensor"
+        # A library may be derived from by its users: only final counts
+        assert hierarchy.resolve("Thermistor", "read", None) is None
+        assert hierarchy.resolve("Photocell", "read", None) == "Photocell"
+
+    def test_dispatch_arms(self):
+        """One arm per implementation, abstract classes have none."""
+        hierarchy = _hierarchy()
+        hierarchy.bases["Thermocouple"] = "Thermistor"
+
+        assert hierarchy.concrete("Sensor") == ["Thermistor", "Photocell", "Thermocouple"]
+        assert hierarchy.dispatch_arms("Sensor", "read") == [
+            (["Thermistor", "Thermocouple"], "Thermistor"),
+            (["Photocell"], "Photocell"),
+        ]
+
+
+class TestCallRewriting:
+    """Test cases for the rewriting of lowered calls."""
+
+    def test_nested_calls(self):
+        """Arguments are rewritten before the call holding them."""
+        code = rewrite_calls(
+            "x = Sensor_read(sensors[i]) + Led_on(Sensor_read(s));",
+            lambda name, arguments: f"{name}_({', '.join(arguments)})",
+            ["Sensor_read"],
+        )
+
+        assert code == "x = Sensor_read_(sensors[i]) + Led_on(Sensor_read_(s));"
+
+    def test_objects(self):
+        """Paths stay bare; other expressions are parenthesized."""
+        assert dispatch_object("self->sensors[i]") == "self->sensors[i]"
+        assert dispatch_object("&thermistor") == "(&thermistor)"
+        assert cast_object("&thermistor", "Sensor") == "(Sensor*)&thermistor"
+        assert cast_object("next(p)", "Sensor") == "(Sensor*)(next(p))"
+
+    def test_pointer_class(self):
+        """Casts, addresses of objects and pointer variables have an evident class."""
+        objects = {"thermistor": "Thermistor"}
+        pointers = {"sensors": "Sensor", "cell": "Photocell"}
+
+        assert pointer_class("&thermistor", objects, pointers) == "Thermistor"
+        assert pointer_class("sensors[i + 1]", objects, pointers) == "Sensor"
+        assert pointer_class("cell", objects, pointers) == "Photocell"
+        assert pointer_class("(Sensor*)cell", objects, pointers) == "Sensor"
+        assert pointer_class("next(cell)", objects, pointers) is None
+        assert pointer_class("thermistor", objects, pointers) is None
+
+    def test_tag_switch(self):
+        """The last arm is the default; a single arm needs no switch."""
+        arms = [(["Thermistor", "Thermocouple"], "Thermistor"), (["Photocell"], "Photocell")]
+
+        def call(target):
+            return f"{target}_reset(({target}*)self)"
+
+        assert tag_switch(arms, call, returns=False) == (
+            "switch (self->type_tag) {\n"
+            "case Thermistor_TAG:\n"
+            "case Thermocouple_TAG:\n"
+            "    Thermistor_reset((Thermistor*)self);\n"
+            "    break;\n"
+            "default:\n"
+            "    Photocell_reset((Photocell*)self);\n"
+            "    break;\n"
+            "}"
+        )
+        assert tag_switch(arms[1:], call, returns=True) == (
+            "return Photocell_reset((Photocell*)self);"
+        )
+
+
+class TestGeneratedVirtuals:
+    """Test cases for the lowered hierarchy."""
+
+    def test_vtables_and_devirtualization(self, transpile_batch):
+        """Derived structs start like their base; known targets are called directly."""
+        transpiler, code = _firmware(transpile_batch, passes=["no-tag-dispatch"])
+
+        assert (
+            "typedef struct Thermistor {\n"
+            "    const struct Sensor_VTable *vptr;\n"
+            "    uint8_t channel;\n"
+            "    uint8_t last;\n"
+            "} Thermistor;"
+        ) in code
+        assert "    uint8_t (*read)(Sensor* self);\n} Sensor_VTable;" in code
+        assert "(uint8_t (*)(Sensor* self))Thermistor_read" in code
+        assert "static Thermistor thermistor = {&Thermistor_vtable, 3, 0};" in code
+        assert "{(Sensor*)&thermistor, (Sensor*)&photocell};" in code
+        # Two classes are instantiated: the call through Sensor* dispatches
+        assert "return sensor->vptr->read(sensor);" in code
+        # Photocell is final
+        assert "return Photocell_read(cell);" in code
+        assert "Sensor_getChannel((Sensor*)self) + 1" in code
+        assert "Sensor_getChannel((Sensor*)&photocell)" in code
+        # Abstract Sensor is never instantiated, its pure read has no function
+        assert "Sensor_vtable" not in code
+        assert "Sensor_read" not in code
+        # The indirect call reaches every implementation
+        assert transpiler.stack_report is not None
+        assert {"Thermistor_read", "Photocell_read"} <= set(
+            transpiler.program_ir.call_graph().calls["sample"]
+        )
+
+    def test_small_hierarchy_switches_on_type_tag(self, transpile_batch):
+        """Two classes: a dispatch function with direct calls replaces the vtables."""
+        transpiler, code = _firmware(transpile_batch)
+
+        assert transpiler.tag_dispatch == {"Sensor": ["read"]}
+        assert "vptr" not in code and "VTable" not in code
+        assert (
+            "typedef struct Photocell {\n"
+            "    uint8_t type_tag;\n"
+            "    uint8_t channel;\n"
+            "} Photocell;"
+        ) in code
+        assert (
+            "enum Sensor_Tag {\n    Sensor_TAG,\n    Thermistor_TAG,\n    Photocell_TAG\n};"
+        ) in code
+        assert "static Thermistor thermistor = {Thermistor_TAG, 3, 0};" in code
+        assert (
+            "static uint8_t Sensor_read_dispatch(Sensor* self) {\n"
+            "    switch (self->type_tag) {\n"
+            "    case Thermistor_TAG:\n"
+            "        return Thermistor_read((Thermistor*)self);\n"
+            "    default:\n"
+            "        return Photocell_read((Photocell*)self);\n"
+            "    }\n"
+            "}"
+        ) in code
+        assert "return Sensor_read_dispatch(sensor);" in code
+        assert "return Photocell_read(cell);" in code
+        # Every call is direct: the call graph is exact
+        calls = transpiler.program_ir.call_graph().calls
+        assert calls["sample"] == ["Sensor_read_dispatch"]
+        assert set(calls["Sensor_read_dispatch"]) == {"Thermistor_read", "Photocell_read"}
+
+    def test_local_objects_and_upcasts(self, transpile_batch):
+        """A local gets its vptr like a global; a derived pointer is cast to its base."""
+        source_code = SENSORS_CPP.replace(
+            "    uint8_t total = sample(sensors[0]) + sampleLight(&photocell);\n",
+            "    Thermistor probe(5);\n"
+            "    uint8_t total = sample(sensors[0]) + sampleLight(&photocell) + sample(&probe);\n",
+        )
+        ast = SENSORS_AST.replace("line:30:1, line:33:1", "line:30:1, line:34:1")
+        _, code = _firmware(transpile_batch, source_code, ast, passes=["no-tag-dispatch"])
+
+        assert "    Thermistor probe = {&Thermistor_vtable, 5, 0};\n" in code
+        assert "sample(sensors[0]) + sampleLight(&photocell) + sample((Sensor*)&probe);" in code
+
+        _, code = _firmware(transpile_batch, source_code, ast)
+
+        assert "    Thermistor probe = {Thermistor_TAG, 5, 0};\n" in code
+
+    def test_dispatch_attribute(self, transpile_batch):
+        """An annotation of the root class overrides the level and the size."""
+        annotated = SENSORS_AST.replace(
+            "class Sensor definition\n",
+            "class Sensor definition\n"
+            "| |-AnnotateAttr <line:2:9, col:42> \"xc8::vtable_dispatch\"\n",
+        )
+        transpiler, code = _firmware(transpile_batch, ast=annotated)
+
+        assert transpiler.tag_dispatch == {}
+        assert "return sensor->vptr->read(sensor);" in code
+
+        transpiler, code = _firmware(
+            transpile_batch, ast=annotated.replace("vtable_dispatch", "switch_dispatch"),
+            opt_level="0",
+        )
+
+        assert transpiler.vtables == {}
+        assert "return Sensor_read_dispatch((Sensor*)cell);" in code
+
+    def test_single_implementation_needs_no_vtable(self, transpile_batch):
+        """With one instantiated class, every call is direct and there is no vptr."""
+        source_code = SENSORS_CPP.replace(
+            "Photocell photocell(4);", "Thermistor spare(4);"
+        ).replace("&photocell", "&spare").replace("photocell.", "spare.")
+        ast = SENSORS_AST.replace("photocell 'Photocell'", "spare 'Thermistor'")
+        transpiler, code = _firmware(transpile_batch, source_code, ast)
+
+        assert transpiler.vtables == {}
+        assert "vptr" not in code
+        assert "return Thermistor_read((Thermistor*)sensor);" in code
+
+    def test_without_optimization_every_call_dispatches(self, transpile_batch):
+        """-O0 keeps the virtual calls, even on a final class."""
+        _, code = _firmware(transpile_batch, opt_level="0")
+
+        assert "return cell->vptr->read((Sensor*)cell);" in code
+        assert "static const Sensor_VTable Sensor_vtable = {\n    0\n};" in code